@@ -0,0 +1,476 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+#ifndef VERTEX_CHANNELS
+#define VERTEX_CHANNELS 3
+#endif
+
+/**
+ * @brief A local maximum of the hough space of one class.
+ */
+struct HoughPeak
+{
+  int cls;
+  int x;
+  int y;
+  int votes;
+};
+
+/**
+ * @brief Multi-threaded CPU Hough voting for object centers.
+ *
+ * Every labeled pixel casts votes along its predicted center direction into the accumulator
+ * of its class. There is one planar height x width accumulator per class. The pixels are
+ * bucketed by class with a parallel counting sort. The pixels of a class are split among the
+ * threads, each thread votes into a private plane and records the rows it voted into; only
+ * those rows are merged by a row-parallel reduction which also clears them for the next class.
+ * All buffers are kept between calls.
+ */
+class HoughVotingCPU
+{
+public:
+  HoughVotingCPU() : height_(0), width_(0), num_classes_(0), num_centers_(0) {}
+
+  /**
+   * @brief Accumulates the votes of all labeled pixels (label > 0).
+   *
+   * @param labelmap Label map, height x width.
+   * @param vertmap Vertex map, height x width x (VERTEX_CHANNELS * num_classes).
+   */
+  void vote(const int* labelmap, const float* vertmap, int height, int width, int num_classes)
+  {
+    const int plane = height * width;
+    const int num_threads = omp_get_max_threads();
+
+    if (height != height_ || width != width_ || num_classes != num_classes_ || tiles_.size() != num_threads * plane)
+    {
+      height_ = height;
+      width_ = width;
+      num_classes_ = num_classes;
+      accumulator_.assign(num_classes * plane, 0);
+      tiles_.assign(num_threads * plane, 0);
+      planeRows_.assign(2 * num_classes, 0); // the planes are zero, empty row ranges
+    }
+
+    bucket(labelmap, plane, num_classes, num_threads);
+
+    tileRows_.resize(2 * num_threads);
+    for (int c = 1; c < num_classes; c++)
+    {
+      if (count(c) == 0)
+        continue;
+
+      int* votes = accumulator_.data() + c * plane;
+      const int* pixels = pixels_.data() + offsets_[c];
+      const int n = count(c);
+      int* rows = tileRows_.data();
+
+      #pragma omp parallel
+      {
+        const int t = omp_get_thread_num();
+        int* tile = tiles_.data() + t * plane;
+        int ymin = height;
+        int ymax = 0;
+
+        #pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < n; i++)
+        {
+          int index = pixels[i];
+          int offset = VERTEX_CHANNELS * c + VERTEX_CHANNELS * num_classes * index;
+          castRay(tile, index % width, index / width, vertmap[offset], vertmap[offset + 1], ymin, ymax);
+        }
+        rows[2 * t] = ymin;
+        rows[2 * t + 1] = ymax;
+        #pragma omp barrier
+
+        // only the rows some thread voted into are merged, the tiles are cleared on the way,
+        // rows of the last votes of the class outside of them are cleared
+        const int nt = omp_get_num_threads();
+        int lo = height;
+        int hi = 0;
+        for (int k = 0; k < nt; k++)
+        {
+          if (rows[2 * k] > rows[2 * k + 1])
+            continue;
+          lo = std::min(lo, rows[2 * k]);
+          hi = std::max(hi, rows[2 * k + 1] + 1);
+        }
+        const int prev_lo = planeRows_[2 * c];
+        const int prev_hi = planeRows_[2 * c + 1];
+
+        #pragma omp for schedule(static)
+        for (int y = std::min(lo, prev_lo); y < std::max(hi, prev_hi); y++)
+        {
+          int* row = votes + y * width;
+          for (int x = 0; x < width; x++)
+            row[x] = 0;
+          for (int k = 0; k < nt; k++)
+          {
+            if (y < rows[2 * k] || y > rows[2 * k + 1])
+              continue;
+            int* src = tiles_.data() + k * plane + y * width;
+            for (int x = 0; x < width; x++)
+            {
+              row[x] += src[x];
+              src[x] = 0;
+            }
+          }
+        }
+
+        #pragma omp single
+        {
+          planeRows_[2 * c] = lo < hi ? lo : 0;
+          planeRows_[2 * c + 1] = lo < hi ? hi : 0;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Finds up to maxPeaks object centers per class in the hough space of the last call of vote().
+   *
+   * A cell is a peak candidate if it has at least threshold votes and is the maximum of the
+   * (2 * window + 1)^2 neighbourhood around it. The maximum filter is separable: a horizontal
+   * pass fills a ring buffer of 2 * window + 1 rows, which is reduced vertically, so each plane
+   * is read once. Candidates are then taken in order of decreasing votes, dropping every
+   * candidate closer than radius to an accepted peak.
+   *
+   * @return const std::vector<HoughPeak>& Peaks grouped by class, strongest first within a class.
+   */
+  const std::vector<HoughPeak>& findPeaks(int threshold, int window, float radius, int maxPeaks)
+  {
+    const int rows = 2 * window + 1;
+    const float radius2 = radius * radius;
+
+    classes_.clear();
+    for (int c = 1; c < num_classes_; c++)
+      if (count(c) > 0)
+        classes_.push_back(c);
+
+    candidates_.resize(num_classes_);
+    filter_.resize(omp_get_max_threads() * (rows + 1) * width_);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int k = 0; k < classes_.size(); k++)
+    {
+      int c = classes_[k];
+      const int* votes = this->votes(c);
+      int* ring = filter_.data() + omp_get_thread_num() * (rows + 1) * width_;
+      int* vmax = ring + rows * width_;
+      std::vector<HoughPeak>& candidates = candidates_[c];
+      candidates.clear();
+
+      int filtered = 0; // number of rows in the ring buffer so far
+      for (int y = 0; y < height_; y++)
+      {
+        // horizontal maximum of the rows up to y + window
+        for (; filtered < height_ && filtered <= y + window; filtered++)
+        {
+          const int* src = votes + filtered * width_;
+          int* dst = ring + (filtered % rows) * width_;
+          for (int x = 0; x < width_; x++)
+          {
+            int m = src[x];
+            for (int dx = std::max(0, x - window); dx <= std::min(width_ - 1, x + window); dx++)
+              m = std::max(m, src[dx]);
+            dst[x] = m;
+          }
+        }
+
+        // vertical maximum
+        for (int x = 0; x < width_; x++)
+          vmax[x] = 0;
+        for (int r = std::max(0, y - window); r <= std::min(height_ - 1, y + window); r++)
+        {
+          const int* src = ring + (r % rows) * width_;
+          for (int x = 0; x < width_; x++)
+            vmax[x] = std::max(vmax[x], src[x]);
+        }
+
+        const int* row = votes + y * width_;
+        for (int x = 0; x < width_; x++)
+        {
+          if (row[x] >= threshold && row[x] > 0 && row[x] == vmax[x])
+          {
+            HoughPeak peak = {c, x, y, row[x]};
+            candidates.push_back(peak);
+          }
+        }
+      }
+
+      // strongest first, ties in row-major order
+      std::stable_sort(candidates.begin(), candidates.end(),
+        [](const HoughPeak& a, const HoughPeak& b) { return a.votes > b.votes; });
+
+      // radius suppression, keeps the accepted peaks at the front
+      int accepted = 0;
+      for (int i = 0; i < candidates.size() && accepted < maxPeaks; i++)
+      {
+        bool suppressed = false;
+        for (int j = 0; j < accepted && !suppressed; j++)
+        {
+          float dx = candidates[i].x - candidates[j].x;
+          float dy = candidates[i].y - candidates[j].y;
+          suppressed = dx * dx + dy * dy < radius2;
+        }
+        if (!suppressed)
+          candidates[accepted++] = candidates[i];
+      }
+      candidates.resize(accepted);
+    }
+
+    peaks_.clear();
+    for (int k = 0; k < classes_.size(); k++)
+      peaks_.insert(peaks_.end(), candidates_[classes_[k]].begin(), candidates_[classes_[k]].end());
+
+    return peaks_;
+  }
+
+  /**
+   * @brief Collects the inlier statistics of several centers of a class in one pass over its pixels.
+   *
+   * A pixel is an inlier of a center if the cosine between its voting direction and the
+   * direction to the center is larger than inlierThreshold. Per center, the number of inliers,
+   * the sum of their distances (exp of the vertex map) and histograms of their horizontal and
+   * vertical offsets to the center are accumulated. The pixels are split into one chunk per
+   * thread, every thread keeps its own statistics which are summed at the end.
+   *
+   * @param centers Centers of class c, in pixels of the last call of vote().
+   */
+  void computeExtents(const float* vertmap, int c, const HoughPeak* centers, int n, float inlierThreshold)
+  {
+    const int num_threads = omp_get_max_threads();
+    const int stride = n * (1 + width_ + height_); // counts, x histograms, y histograms
+    const int* pixels = this->pixels(c);
+    const int num = count(c);
+    const float threshold2 = inlierThreshold * inlierThreshold;
+
+    stats_.assign(num_threads * stride, 0);
+    sums_.assign(num_threads * n, 0);
+
+    #pragma omp parallel
+    {
+      int* counts = stats_.data() + omp_get_thread_num() * stride;
+      int* hist_x = counts + n;
+      int* hist_y = hist_x + n * width_;
+      float* sums = sums_.data() + omp_get_thread_num() * n;
+
+      #pragma omp for schedule(static)
+      for (int i = 0; i < num; i++)
+      {
+        int index = pixels[i];
+        int x = index % width_;
+        int y = index / width_;
+        int offset = VERTEX_CHANNELS * c + VERTEX_CHANNELS * num_classes_ * index;
+        float u = vertmap[offset];
+        float v = vertmap[offset + 1];
+        float nn = u * u + v * v;
+        float distance = exp(vertmap[offset + 2]);
+
+        for (int k = 0; k < n; k++)
+        {
+          int dx = centers[k].x - x;
+          int dy = centers[k].y - y;
+          float dot = u * dx + v * dy;
+
+          // cos > inlierThreshold, without the square roots
+          if (dot > 0 && dot * dot > threshold2 * nn * (dx * dx + dy * dy))
+          {
+            counts[k]++;
+            sums[k] += distance;
+            hist_x[k * width_ + std::abs(dx)]++;
+            hist_y[k * height_ + std::abs(dy)]++;
+          }
+        }
+      }
+    }
+
+    // sum the statistics of the threads into the first block
+    for (int t = 1; t < num_threads; t++)
+    {
+      const int* src = stats_.data() + t * stride;
+      for (int i = 0; i < stride; i++)
+        stats_[i] += src[i];
+      for (int k = 0; k < n; k++)
+        sums_[k] += sums_[t * n + k];
+    }
+    num_centers_ = n;
+  }
+
+  /**
+   * @brief Number of inliers of the k-th center of the last call of computeExtents().
+   */
+  int inliers(int k) const { return stats_[k]; }
+
+  /**
+   * @brief Sum of the inlier distances of the k-th center of the last call of computeExtents().
+   */
+  float distanceSum(int k) const { return sums_[k]; }
+
+  /**
+   * @brief Mean inlier distance of the k-th center of the last call of computeExtents(), 0 without inliers.
+   */
+  float meanDistance(int k) const { return stats_[k] > 0 ? sums_[k] / stats_[k] : 0; }
+
+  /**
+   * @brief Quantile q of the horizontal inlier offsets of the k-th center, ignoring offsets larger than limit.
+   */
+  int offsetQuantileX(int k, int limit, float q) const
+  {
+    return quantile(stats_.data() + num_centers_ + k * width_, width_, limit, q);
+  }
+
+  /**
+   * @brief Quantile q of the vertical inlier offsets of the k-th center, ignoring offsets larger than limit.
+   */
+  int offsetQuantileY(int k, int limit, float q) const
+  {
+    return quantile(stats_.data() + num_centers_ * (1 + width_) + k * height_, height_, limit, q);
+  }
+
+  /**
+   * @brief Number of pixels of a class in the last call of vote().
+   */
+  int count(int c) const { return offsets_[c + 1] - offsets_[c]; }
+
+  /**
+   * @brief Accumulator plane of a class, height x width. Only valid if count(c) > 0.
+   */
+  const int* votes(int c) const { return accumulator_.data() + c * height_ * width_; }
+
+  /**
+   * @brief Pixel indices (y * width + x) of a class in the last call of vote().
+   */
+  const int* pixels(int c) const { return pixels_.data() + offsets_[c]; }
+
+  int height() const { return height_; }
+  int width() const { return width_; }
+
+private:
+  /**
+   * @brief Buckets the pixels by class with a parallel counting sort, labels outside [0, num_classes) are ignored.
+   *
+   * Every thread counts the labels of a contiguous chunk of the image, the counts give each
+   * thread its start in every bucket, so the pixels of a class stay in row-major order.
+   */
+  void bucket(const int* labelmap, int plane, int num_classes, int num_threads)
+  {
+    counts_.assign(num_threads * num_classes, 0);
+    offsets_.assign(num_classes + 1, 0);
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+      const int t = omp_get_thread_num();
+      const int nt = omp_get_num_threads();
+      const int begin = (long) plane * t / nt;
+      const int end = (long) plane * (t + 1) / nt;
+      int* counts = counts_.data() + t * num_classes;
+
+      for (int i = begin; i < end; i++)
+        if (labelmap[i] >= 0 && labelmap[i] < num_classes)
+          counts[labelmap[i]]++;
+      #pragma omp barrier
+
+      // exclusive prefix sum over the classes and, within a class, over the threads
+      #pragma omp single
+      {
+        int sum = 0;
+        for (int c = 0; c < num_classes; c++)
+        {
+          offsets_[c] = sum;
+          for (int k = 0; k < nt; k++)
+          {
+            int n = counts_[k * num_classes + c];
+            counts_[k * num_classes + c] = sum;
+            sum += n;
+          }
+        }
+        offsets_[num_classes] = sum;
+        pixels_.resize(sum);
+      }
+
+      for (int i = begin; i < end; i++)
+        if (labelmap[i] >= 0 && labelmap[i] < num_classes)
+          pixels_[counts[labelmap[i]]++] = i;
+    }
+  }
+
+  /**
+   * @brief Value at position int(n * q) of the sorted values up to limit, given their histogram.
+   */
+  static int quantile(const int* hist, int size, int limit, float q)
+  {
+    int n = 0;
+    for (int v = 0; v < size && v <= limit; v++)
+      n += hist[v];
+    if (n == 0)
+      return 0;
+
+    int k = int(n * q);
+    for (int v = 0; v < size; v++)
+    {
+      k -= hist[v];
+      if (k < 0)
+        return v;
+    }
+    return size - 1;
+  }
+
+  /**
+   * @brief Votes for all cells along the ray from pixel (x, y) in direction (u, v).
+   *
+   * DDA walk: one unit step along the major axis per cell, starting at the pixel center,
+   * until the ray leaves the image. The pixel itself does not vote. Extends [ymin, ymax] to the
+   * rows voted into.
+   */
+  inline void castRay(int* plane, int x, int y, float u, float v, int& ymin, int& ymax) const
+  {
+    float norm = std::max(std::fabs(u), std::fabs(v));
+    if (!(norm > 0) || !std::isfinite(norm))
+      return;
+
+    float du = u / norm;
+    float dv = v / norm;
+
+    // number of steps until the ray leaves the image
+    float cx = x + 0.5f;
+    float cy = y + 0.5f;
+    float tx = du > 0 ? (width_ - cx) / du : (du < 0 ? -cx / du : 1e30f);
+    float ty = dv > 0 ? (height_ - cy) / dv : (dv < 0 ? -cy / dv : 1e30f);
+    int steps = (int) std::ceil(std::min(tx, ty));
+
+    for (int k = 1; k < steps; k++)
+    {
+      int ix = (int) (cx + k * du);
+      int iy = (int) (cy + k * dv);
+      if ((unsigned) ix < (unsigned) width_ && (unsigned) iy < (unsigned) height_)
+      {
+        plane[iy * width_ + ix]++;
+        ymin = std::min(ymin, iy);
+        ymax = std::max(ymax, iy);
+      }
+    }
+  }
+
+  int height_;
+  int width_;
+  int num_classes_;
+  std::vector<int> accumulator_; // num_classes x height x width
+  std::vector<int> tiles_; // per-thread accumulators, num_threads x height x width, kept zero
+  std::vector<int> tileRows_; // per-thread first and last row voted into for the current class
+  std::vector<int> planeRows_; // per-class rows [begin, end) of the accumulator plane that may be nonzero
+  std::vector<int> offsets_; // pixels of class c are pixels_[offsets_[c]] ... pixels_[offsets_[c + 1] - 1]
+  std::vector<int> counts_; // per-thread label counts, then bucket positions, of the counting sort
+  std::vector<int> pixels_;
+  std::vector<int> classes_; // classes with at least one pixel
+  std::vector<int> filter_; // per-thread ring buffer and row of the maximum filter
+  std::vector<std::vector<HoughPeak> > candidates_; // per-class peak candidates
+  std::vector<HoughPeak> peaks_;
+  int num_centers_; // number of centers of the last call of computeExtents()
+  std::vector<int> stats_; // per-thread inlier counts and offset histograms of the centers
+  std::vector<float> sums_; // per-thread inlier distance sums of the centers
+};
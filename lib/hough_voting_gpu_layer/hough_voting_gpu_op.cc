@@ -27,9 +27,12 @@ limitations under the License.
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/mutex.h"
 
 #define VERTEX_CHANNELS 3
 
+#include "hough_voting_cpu.h"
+
 using namespace tensorflow;
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
@@ -67,16 +70,15 @@ inline cv::Rect getBB2D(int imageWidth, int imageHeight, const std::vector<cv::P
 inline float getIoU(const cv::Rect& bb1, const cv::Rect bb2);
 inline float angle_distance(cv::Point2f x, cv::Point2f n, cv::Point2f p);
 
-void hough_voting(const int* labelmap, const float* vertmap, std::vector<std::vector<cv::Point3f>> bb3Ds,
-  int batch, int height, int width, int num_classes, int is_train,
+void hough_voting(HoughVotingCPU& voting, const int* labelmap, const float* vertmap, std::vector<std::vector<cv::Point3f>> bb3Ds,
+  int batch, int height, int width, int num_classes, int is_train, int threshold_vote,
   float fx, float fy, float px, float py, std::vector<cv::Vec<float, 14> >& outputs);
 
 void compute_target_weight(int height, int width, float* target, float* weight, std::vector<std::vector<cv::Point3f>> bb3Ds, 
   const float* poses_gt, int num_gt, int num_classes, float fx, float fy, float px, float py, std::vector<cv::Vec<float, 14> > outputs);
 
-inline void compute_width_height(const int* labelmap, const float* vertmap, cv::Point2f center, 
-  std::vector<std::vector<cv::Point3f>> bb3Ds, cv::Mat camMat, float inlierThreshold, 
-  int height, int width, int channel, int num_classes, int & bb_width, int & bb_height, float & bb_distance);
+inline void compute_width_height(const HoughVotingCPU& voting, int k, std::vector<std::vector<cv::Point3f>> bb3Ds, cv::Mat camMat,
+  int channel, int & bb_width, int & bb_height, float & bb_distance);
 
 // cuda functions
 void HoughVotingLaucher(OpKernelContext* context,
@@ -190,6 +192,7 @@ class HoughvotinggpuOp : public OpKernel {
 
     int index_meta_data = 0;
     float fx, fy, px, py;
+    mutex_lock lock(mu_);
     for (int n = 0; n < batch_size; n++)
     {
       const int* labelmap = bottom_label.flat<int>().data() + n * height * width;
@@ -198,7 +201,7 @@ class HoughvotinggpuOp : public OpKernel {
       fy = meta_data(index_meta_data + 4);
       px = meta_data(index_meta_data + 2);
       py = meta_data(index_meta_data + 5);
-      hough_voting(labelmap, vertmap, bb3Ds, n, height, width, num_classes, is_train_, fx, fy, px, py, outputs);
+      hough_voting(voting_, labelmap, vertmap, bb3Ds, n, height, width, num_classes, is_train_, threshold_vote_, fx, fy, px, py, outputs);
       index_meta_data += num_meta_data;
     }
 
@@ -267,6 +270,8 @@ class HoughvotinggpuOp : public OpKernel {
   int is_train_;
   int threshold_vote_;
   int skip_pixels_;
+  mutex mu_;
+  HoughVotingCPU voting_; // hough space and thread tiles, reused across images and calls
 };
 
 REGISTER_KERNEL_BUILDER(Name("Houghvotinggpu").Device(DEVICE_CPU).TypeConstraint<float>("T"), HoughvotinggpuOp<CPUDevice, float>);
@@ -445,8 +450,8 @@ class HoughvotinggpuGradOp : public OpKernel {
 // REGISTER_KERNEL_BUILDER(Name("HoughvotinggpuGrad").Device(DEVICE_CPU).TypeConstraint<float>("T"), HoughvotinggpuGradOp<CPUDevice, float>);
 REGISTER_KERNEL_BUILDER(Name("HoughvotinggpuGrad").Device(DEVICE_GPU).TypeConstraint<float>("T"), HoughvotinggpuGradOp<Eigen::GpuDevice, float>);
 
-void hough_voting(const int* labelmap, const float* vertmap, std::vector<std::vector<cv::Point3f>> bb3Ds, 
-  int batch, int height, int width, int num_classes, int is_train,
+void hough_voting(HoughVotingCPU& voting, const int* labelmap, const float* vertmap, std::vector<std::vector<cv::Point3f>> bb3Ds, 
+  int batch, int height, int width, int num_classes, int is_train, int threshold_vote,
   float fx, float fy, float px, float py, std::vector<cv::Vec<float, 14> >& outputs)
 {
   float inlierThreshold = 0.9;
@@ -460,175 +465,127 @@ void hough_voting(const int* labelmap, const float* vertmap, std::vector<std::ve
   camMat(0, 2) = px;
   camMat(1, 2) = py;
 
-  // initialize hough space
-  int* hough_space = (int*)malloc(sizeof(int) * height * width * num_classes);
-  memset(hough_space, 0, height * width * num_classes);
+  // accumulate the votes of all classes
+  voting.vote(labelmap, vertmap, height, width, num_classes);
 
-  int* flags = (int*)malloc(sizeof(int) * num_classes);
-  memset(flags, 0, num_classes);
+  // find the peaks in hough space, a single peak per class unless a vote threshold is given
+  int maxPeaks = threshold_vote > 0 ? 8 : 1;
+  const std::vector<HoughPeak>& peaks = voting.findPeaks(threshold_vote > 0 ? threshold_vote : votingThreshold, 3, 20, maxPeaks);
 
-  // for each pixel
-  for (int x = 0; x < width; x++)
+  for (int i = 0, first = 0; i < peaks.size(); i++)
   {
-    for (int y = 0; y < height; y++)
+    int c = peaks[i].cls;
+    int max_vote = peaks[i].votes;
+
+    // extents of all peaks of the class in one pass over its pixels
+    if (i == 0 || c != peaks[i - 1].cls)
     {
-      int c = labelmap[y * width + x];
-      if (c > 0)
-      {
-        flags[c] = 1;
-        // read the predict center direction
-        int offset = VERTEX_CHANNELS * c + VERTEX_CHANNELS * num_classes * (y * width + x);
-        float u = vertmap[offset];
-        float v = vertmap[offset + 1];
-        float norm = sqrt(u * u + v * v);
-        u /= norm;
-        v /= norm;
-
-        // voting
-	float delta = 1.0 / fabs(u);
-        float cx = x;
-        float cy = y;
-        while(1)
-        {
-          cx += delta * u;
-          cy += delta * v;
-          int center_x = int(cx);
-          int center_y = int(cy);
-          if (center_x >= 0 && center_x < width && center_y >= 0 && center_y < height)
-          {
-            offset = c + num_classes * (center_y * width + center_x);
-            hough_space[offset] += 1;
-          }
-          else
-            break;
-        }
-      }
+      int n = 1;
+      while (i + n < peaks.size() && peaks[i + n].cls == c)
+        n++;
+      voting.computeExtents(vertmap, c, &peaks[i], n, inlierThreshold);
+      first = i;
     }
-  }
 
-  // find the maximum in hough space
-  for (int c = 1; c < num_classes; c++)
-  {
-    if (flags[c])
+    // center
+    cv::Point2f center(peaks[i].x, peaks[i].y);
+    int bb_width, bb_height;
+    float bb_distance;
+    compute_width_height(voting, i - first, bb3Ds, camMat, c, bb_width, bb_height, bb_distance);
+
+    // construct output
+    cv::Vec<float, 14> roi;
+    roi(0) = batch;
+    roi(1) = c;
+
+    // bounding box
+    float scale = 0.05;
+    roi(2) = center.x - bb_width * (0.5 + scale);
+    roi(3) = center.y - bb_height * (0.5 + scale);
+    roi(4) = center.x + bb_width * (0.5 + scale);
+    roi(5) = center.y + bb_height * (0.5 + scale);
+
+    // score
+    roi(6) = max_vote;
+
+    // pose
+    float rx = (center.x - px) / fx;
+    float ry = (center.y - py) / fy;
+    roi(7) = 1;
+    roi(8) = 0;
+    roi(9) = 0;
+    roi(10) = 0;
+    roi(11) = rx * bb_distance;
+    roi(12) = ry * bb_distance;
+    roi(13) = bb_distance;
+
+    outputs.push_back(roi);
+
+    if (is_train)
     {
-      int max_vote = 0;
-      int max_x, max_y;
-      for (int x = 0; x < width; x++)
-      {
-        for (int y = 0; y < height; y++)
-        {
-          int offset = c + num_classes * (y * width + x);
-          if (hough_space[offset] > max_vote)
-          {
-            max_vote = hough_space[offset];
-            max_x = x;
-            max_y = y;
-          }
-        }
-      }
-      if (max_vote < votingThreshold)
-        continue;
+      // add jittering rois
+      float x1 = roi(2);
+      float y1 = roi(3);
+      float x2 = roi(4);
+      float y2 = roi(5);
+      float ww = x2 - x1;
+      float hh = y2 - y1;
+
+      // (-1, -1)
+      roi(2) = x1 - 0.05 * ww;
+      roi(3) = y1 - 0.05 * hh;
+      roi(4) = roi(2) + ww;
+      roi(5) = roi(3) + hh;
+      outputs.push_back(roi);
 
-      // center
-      cv::Point2f center(max_x, max_y);
-      int bb_width, bb_height;
-      float bb_distance;
-      compute_width_height(labelmap, vertmap, center, bb3Ds, camMat, inlierThreshold, height, width, c, num_classes, bb_width, bb_height, bb_distance);
+      // (+1, -1)
+      roi(2) = x1 + 0.05 * ww;
+      roi(3) = y1 - 0.05 * hh;
+      roi(4) = roi(2) + ww;
+      roi(5) = roi(3) + hh;
+      outputs.push_back(roi);
 
-      // construct output
-      cv::Vec<float, 14> roi;
-      roi(0) = batch;
-      roi(1) = c;
-
-      // bounding box
-      float scale = 0.05;
-      roi(2) = center.x - bb_width * (0.5 + scale);
-      roi(3) = center.y - bb_height * (0.5 + scale);
-      roi(4) = center.x + bb_width * (0.5 + scale);
-      roi(5) = center.y + bb_height * (0.5 + scale);
-
-      // score
-      roi(6) = max_vote;
-
-      // pose
-      float rx = (center.x - px) / fx;
-      float ry = (center.y - py) / fy;
-      roi(7) = 1;
-      roi(8) = 0;
-      roi(9) = 0;
-      roi(10) = 0;
-      roi(11) = rx * bb_distance;
-      roi(12) = ry * bb_distance;
-      roi(13) = bb_distance;
+      // (-1, +1)
+      roi(2) = x1 - 0.05 * ww;
+      roi(3) = y1 + 0.05 * hh;
+      roi(4) = roi(2) + ww;
+      roi(5) = roi(3) + hh;
+      outputs.push_back(roi);
 
+      // (+1, +1)
+      roi(2) = x1 + 0.05 * ww;
+      roi(3) = y1 + 0.05 * hh;
+      roi(4) = roi(2) + ww;
+      roi(5) = roi(3) + hh;
       outputs.push_back(roi);
 
-      if (is_train)
-      {
-        // add jittering rois
-        float x1 = roi(2);
-        float y1 = roi(3);
-        float x2 = roi(4);
-        float y2 = roi(5);
-        float ww = x2 - x1;
-        float hh = y2 - y1;
-
-        // (-1, -1)
-        roi(2) = x1 - 0.05 * ww;
-        roi(3) = y1 - 0.05 * hh;
-        roi(4) = roi(2) + ww;
-        roi(5) = roi(3) + hh;
-        outputs.push_back(roi);
-
-        // (+1, -1)
-        roi(2) = x1 + 0.05 * ww;
-        roi(3) = y1 - 0.05 * hh;
-        roi(4) = roi(2) + ww;
-        roi(5) = roi(3) + hh;
-        outputs.push_back(roi);
-
-        // (-1, +1)
-        roi(2) = x1 - 0.05 * ww;
-        roi(3) = y1 + 0.05 * hh;
-        roi(4) = roi(2) + ww;
-        roi(5) = roi(3) + hh;
-        outputs.push_back(roi);
-
-        // (+1, +1)
-        roi(2) = x1 + 0.05 * ww;
-        roi(3) = y1 + 0.05 * hh;
-        roi(4) = roi(2) + ww;
-        roi(5) = roi(3) + hh;
-        outputs.push_back(roi);
-
-        // (0, -1)
-        roi(2) = x1;
-        roi(3) = y1 - 0.05 * hh;
-        roi(4) = roi(2) + ww;
-        roi(5) = roi(3) + hh;
-        outputs.push_back(roi);
-
-        // (-1, 0)
-        roi(2) = x1 - 0.05 * ww;
-        roi(3) = y1;
-        roi(4) = roi(2) + ww;
-        roi(5) = roi(3) + hh;
-        outputs.push_back(roi);
-
-        // (0, +1)
-        roi(2) = x1;
-        roi(3) = y1 + 0.05 * hh;
-        roi(4) = roi(2) + ww;
-        roi(5) = roi(3) + hh;
-        outputs.push_back(roi);
-
-        // (+1, 0)
-        roi(2) = x1 + 0.05 * ww;
-        roi(3) = y1;
-        roi(4) = roi(2) + ww;
-        roi(5) = roi(3) + hh;
-        outputs.push_back(roi);
-      }
+      // (0, -1)
+      roi(2) = x1;
+      roi(3) = y1 - 0.05 * hh;
+      roi(4) = roi(2) + ww;
+      roi(5) = roi(3) + hh;
+      outputs.push_back(roi);
+
+      // (-1, 0)
+      roi(2) = x1 - 0.05 * ww;
+      roi(3) = y1;
+      roi(4) = roi(2) + ww;
+      roi(5) = roi(3) + hh;
+      outputs.push_back(roi);
+
+      // (0, +1)
+      roi(2) = x1;
+      roi(3) = y1 + 0.05 * hh;
+      roi(4) = roi(2) + ww;
+      roi(5) = roi(3) + hh;
+      outputs.push_back(roi);
+
+      // (+1, 0)
+      roi(2) = x1 + 0.05 * ww;
+      roi(3) = y1;
+      roi(4) = roi(2) + ww;
+      roi(5) = roi(3) + hh;
+      outputs.push_back(roi);
     }
   }
 }
@@ -638,46 +595,17 @@ inline float angle_distance(cv::Point2f x, cv::Point2f n, cv::Point2f p)
   return n.dot(x - p) / (cv::norm(n) * cv::norm(x - p));
 }
 
-inline void compute_width_height(const int* labelmap, const float* vertmap, cv::Point2f center, 
-  std::vector<std::vector<cv::Point3f>> bb3Ds, cv::Mat camMat, float inlierThreshold, 
-  int height, int width, int channel, int num_classes, int & bb_width, int & bb_height, float & bb_distance)
+inline void compute_width_height(const HoughVotingCPU& voting, int k, std::vector<std::vector<cv::Point3f>> bb3Ds, cv::Mat camMat,
+  int channel, int & bb_width, int & bb_height, float & bb_distance)
 {
-  float d = 0;
-  int count = 0;
-
-  // for each pixel
-  std::vector<float> dx;
-  std::vector<float> dy;
-  for (int x = 0; x < width; x++)
+  // statistics of the k-th center of the last call of computeExtents(), a center without inliers has a zero extent
+  bb_distance = voting.meanDistance(k);
+  if (voting.inliers(k) == 0)
   {
-    for (int y = 0; y < height; y++)
-    {
-      if (labelmap[y * width + x] == channel)
-      {
-        cv::Point2f point(x, y);
-  
-        // read out object coordinate
-        int offset = VERTEX_CHANNELS * channel + VERTEX_CHANNELS * num_classes * (y * width + x);
-        float u = vertmap[offset];
-        float v = vertmap[offset + 1];
-        float distance = exp(vertmap[offset + 2]);
-        float norm = sqrt(u * u + v * v);
-        u /= norm;
-        v /= norm;
-        cv::Point2f direction(u, v);
-
-        // inlier check
-        if(angle_distance(center, direction, point) > inlierThreshold)
-        {
-          dx.push_back(fabs(point.x - center.x));
-          dy.push_back(fabs(point.y - center.y));
-          d += distance;
-          count++;
-        }
-      }
-    }
+    bb_width = 0;
+    bb_height = 0;
+    return;
   }
-  bb_distance = d / count;
 
   // estimate a projection
   cv::Mat tvec(3, 1, CV_64F);
@@ -705,18 +633,9 @@ inline void compute_width_height(const int* labelmap, const float* vertmap, cv::
   }
   cv::Rect bb = cv::Rect(0, 0, (maxX - minX + 1), (maxY - minY + 1));
 
-  std::vector<float>::iterator it;
-  it = std::remove_if(dx.begin(), dx.end(), std::bind2nd(std::greater<float>(), std::max(bb.width, bb.height) ));
-  dx.erase(it, dx.end()); 
-
-  it = std::remove_if(dy.begin(), dy.end(), std::bind2nd(std::greater<float>(), std::max(bb.width, bb.height) ));
-  dy.erase(it, dy.end()); 
-
-  std::sort(dx.begin(), dx.end());
-  std::sort(dy.begin(), dy.end());
-
-  bb_width = 2 * dx[int(dx.size() * 0.95)];
-  bb_height = 2 * dy[int(dy.size() * 0.95)];
+  int limit = std::max(bb.width, bb.height);
+  bb_width = 2 * voting.offsetQuantileX(k, limit, 0.95);
+  bb_height = 2 * voting.offsetQuantileY(k, limit, 0.95);
 }
 
 
@@ -0,0 +1,78 @@
+// Checks of the CPU Hough voting, returns nonzero on failure.
+// g++ -std=c++11 -fopenmp -o test_hough_voting_cpu test_hough_voting_cpu.cpp && ./test_hough_voting_cpu
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "hough_voting_cpu.h"
+
+#define CHECK(condition) \
+  if (!(condition)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); return 1; }
+
+int main()
+{
+  const int height = 40;
+  const int width = 60;
+  const int num_classes = 3;
+  const int cx = 30;
+  const int cy = 20;
+
+  // class 1: a block of pixels without a voting direction, class 2: a ring of pixels voting for (cx, cy)
+  std::vector<int> labelmap(height * width, 0);
+  std::vector<float> vertmap(height * width * VERTEX_CHANNELS * num_classes, 0);
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      int index = y * width + x;
+      float* vertex = &vertmap[VERTEX_CHANNELS * num_classes * index];
+      int dx = cx - x;
+      int dy = cy - y;
+      if (x < 5 && y < 5)
+        labelmap[index] = 1;
+      else if (dx * dx + dy * dy > 16 && dx * dx + dy * dy < 100)
+      {
+        labelmap[index] = 2;
+        vertex[VERTEX_CHANNELS * 2] = dx;
+        vertex[VERTEX_CHANNELS * 2 + 1] = dy;
+        vertex[VERTEX_CHANNELS * 2 + 2] = std::log(0.5f);
+      }
+    }
+  }
+
+  HoughVotingCPU voting;
+  voting.vote(labelmap.data(), vertmap.data(), height, width, num_classes);
+  CHECK(voting.count(1) == 25);
+  CHECK(voting.votes(1)[cy * width + cx] == 0);
+
+  // only the class with votes has a peak, at the center, the rays passing it leave a few votes behind
+  const std::vector<HoughPeak> peaks = voting.findPeaks(50, 3, 20, 8);
+  CHECK(peaks.size() == 1);
+  CHECK(peaks[0].cls == 2 && peaks[0].x == cx && peaks[0].y == cy);
+
+  // a center of the class with zero votes has no inliers and a zero extent and distance, not NaN
+  HoughPeak center = {1, cx, cy, 0};
+  voting.computeExtents(vertmap.data(), 1, &center, 1, 0.9);
+  CHECK(voting.inliers(0) == 0);
+  CHECK(voting.meanDistance(0) == 0);
+  CHECK(voting.offsetQuantileX(0, width, 0.95) == 0);
+  CHECK(voting.offsetQuantileY(0, height, 0.95) == 0);
+
+  voting.computeExtents(vertmap.data(), 2, &peaks[0], 1, 0.9);
+  CHECK(voting.inliers(0) == voting.count(2));
+  CHECK(std::fabs(voting.meanDistance(0) - 0.5f) < 1e-5);
+  CHECK(voting.offsetQuantileX(0, width, 0.95) > 0);
+
+  // votes of an earlier frame do not leak into the next one
+  std::fill(labelmap.begin(), labelmap.end(), 0);
+  labelmap[0] = 2;
+  voting.vote(labelmap.data(), vertmap.data(), height, width, num_classes);
+  int sum = 0;
+  for (int i = 0; i < height * width; i++)
+    sum += voting.votes(2)[i];
+  CHECK(sum == 0);
+
+  printf("hough voting cpu: passed\n");
+  return 0;
+}
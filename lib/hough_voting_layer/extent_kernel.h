@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+#include "inlier_kernel.h"
+
+/**
+ * @brief Structure-of-arrays table of the 2D centers of one class, used to estimate their extents.
+ *
+ * All centers are tested against each pixel of the class in a single pass, so the pixel data
+ * is read once regardless of the number of centers.
+ */
+struct CenterTable
+{
+  std::vector<float> cx; // center position
+  std::vector<float> cy;
+  std::vector<float> maxDist; // inliers have to be closer to the center than this
+  std::vector<float> w; // result: maximum horizontal distance of an inlier to the center, -1 without inliers
+  std::vector<float> h; // result: maximum vertical distance of an inlier to the center, -1 without inliers
+  std::vector<float> partial; // per-thread maxima, num_threads x 2 x size()
+
+  int size() const { return cx.size(); }
+
+  void clear()
+  {
+    cx.clear();
+    cy.clear();
+    maxDist.clear();
+  }
+
+  void push_back(float x, float y, float dist)
+  {
+    cx.push_back(x);
+    cy.push_back(y);
+    maxDist.push_back(dist);
+  }
+
+  /**
+   * @brief Computes the extents of all centers from the pixels [begin, begin + count) of a PixelSoA.
+   *
+   * A pixel is an inlier of a center under the same test as in inlierMasks2D. The pixels are
+   * split into one chunk per thread, each thread keeps its own maxima which are reduced at the end.
+   */
+  void computeExtents(const PixelSoA& soa, int begin, int count, float inlierThreshold)
+  {
+    const int n = size();
+    const int num_threads = omp_get_max_threads();
+    const float* px = soa.x.data() + begin;
+    const float* py = soa.y.data() + begin;
+    const float* ux = soa.dx.data() + begin;
+    const float* uy = soa.dy.data() + begin;
+
+    partial.assign(num_threads * 2 * n, -1);
+
+    #pragma omp parallel
+    {
+      float* pw = partial.data() + omp_get_thread_num() * 2 * n;
+      float* ph = pw + n;
+
+      #pragma omp for schedule(static)
+      for (int i = 0; i < count; i++)
+      {
+        for (int j = 0; j < n; j++)
+        {
+          float rx = cx[j] - px[i];
+          float ry = cy[j] - py[i];
+          float line = fabs(ux[i] * ry - uy[i] * rx);
+          float dot = ux[i] * rx + uy[i] * ry;
+          float d2 = rx * rx + ry * ry;
+
+          if (line < inlierThreshold && dot > 0 && d2 < maxDist[j] * maxDist[j])
+          {
+            pw[j] = std::max(pw[j], std::fabs(rx));
+            ph[j] = std::max(ph[j], std::fabs(ry));
+          }
+        }
+      }
+    }
+
+    w.assign(n, -1);
+    h.assign(n, -1);
+    for (int t = 0; t < num_threads; t++)
+    {
+      const float* pw = partial.data() + t * 2 * n;
+      const float* ph = pw + n;
+      for (int j = 0; j < n; j++)
+      {
+        w[j] = std::max(w[j], pw[j]);
+        h[j] = std::max(h[j], ph[j]);
+      }
+    }
+  }
+};
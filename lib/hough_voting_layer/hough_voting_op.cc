@@ -25,12 +25,14 @@ limitations under the License.
 #include "ransac.h"
 #include "Hypothesis.h"
 #include "detection.h"
+#include "hyp_arena.h"
 #include <Eigen/Geometry> 
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/mutex.h"
 
 using namespace tensorflow;
 typedef Eigen::ThreadPoolDevice CPUDevice;
@@ -56,34 +58,17 @@ REGISTER_OP("HoughvotingGrad")
     .Output("output_label: T")
     .Output("output_vertex: T");
 
-/**
- * @brief Data used in NLOpt callback loop.
- */
-struct DataForOpt
-{
-  int imageWidth;
-  int imageHeight;
-  float rx, ry;
-  cv::Rect bb2D;
-  std::vector<cv::Point3f> bb3D;
-  cv::Mat_<float> camMat;
-};
-
-void getLabels(const int* label_map, std::vector<std::vector<int>>& labels, std::vector<int>& object_ids, int width, int height, int num_classes, int minArea);
+void getLabels(const int* label_map, LabelIndex& labels, std::vector<int>& object_ids, int width, int height, int num_classes, int minArea);
 void getBb3Ds(const float* extents, std::vector<std::vector<cv::Point3f>>& bb3Ds, int num_classes);
 inline bool samplePoint2D(jp::id_t objID, std::vector<cv::Point2f>& eyePts, std::vector<cv::Point2f>& objPts, std::vector<float>& distances, const cv::Point2f& pt2D, const float* vertmap, int width, int num_classes);
-std::vector<TransHyp*> getWorkingQueue(std::map<jp::id_t, std::vector<TransHyp>>& hypMap, int maxIt);
 inline float point2line(cv::Point2d x, cv::Point2f n, cv::Point2f p);
-inline void countInliers2D(TransHyp& hyp, const float * vertmap, const std::vector<std::vector<int>>& labels, float inlierThreshold, int width, int num_classes, int pixelBatch);
-inline void updateHyp2D(TransHyp& hyp, int maxPixels);
-inline void filterInliers2D(TransHyp& hyp, int maxInliers);
+inline void countInliers2D(TransHyp& hyp, const PixelSoA& pixels, const LabelIndex& labels, float inlierThreshold, int pixelBatch, int maxInliers);
+inline void updateHyp2D(TransHyp& hyp);
 inline cv::Point2f getMode2D(jp::id_t objID, const cv::Point2f& pt, const float* vertmap, float & distance, int width, int num_classes);
-static double optEnergy(const std::vector<double> &pose, std::vector<double> &grad, void *data);
-double poseWithOpt(std::vector<double> & vec, DataForOpt data, int iterations);
-void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::vector<cv::Point3f>> bb3Ds, int batch, int height, int width, int num_classes, int is_train,
+void estimateCenter(HypArena& arena, const int* labelmap, const float* vertmap, std::vector<std::vector<cv::Point3f>> bb3Ds, int batch, int height, int width, int num_classes, int is_train,
   float fx, float fy, float px, float py, std::vector<cv::Vec<float, 13> >& outputs);
 void compute_target_weight(int height, int width, float* target, float* weight, std::vector<std::vector<cv::Point3f>> bb3Ds, const float* poses_gt, int num_gt, int num_classes, float fx, float fy, float px, float py, std::vector<cv::Vec<float, 13> > outputs);
-inline void compute_width_height(TransHyp& hyp, const float* vertmap, const std::vector<std::vector<int>>& labels, float inlierThreshold, int width, int num_classes);
+inline void compute_width_height(HypArena& arena, jp::id_t objID, float inlierThreshold);
 
 template <typename Device, typename T>
 class HoughvotingOp : public OpKernel {
@@ -147,6 +132,9 @@ class HoughvotingOp : public OpKernel {
     std::vector<std::vector<cv::Point3f>> bb3Ds;
     getBb3Ds(extents, bb3Ds, num_classes);
 
+    // the hypothesis arena is shared by all images and calls
+    mutex_lock lock(mu_);
+
     int index_meta_data = 0;
     float fx, fy, px, py;
     for (int n = 0; n < batch_size; n++)
@@ -158,7 +146,7 @@ class HoughvotingOp : public OpKernel {
       px = meta_data(index_meta_data + 2);
       py = meta_data(index_meta_data + 5);
 
-      estimateCenter(labelmap, vertmap, bb3Ds, n, height, width, num_classes, is_train_, fx, fy, px, py, outputs);
+      estimateCenter(arena_, labelmap, vertmap, bb3Ds, n, height, width, num_classes, is_train_, fx, fy, px, py, outputs);
 
       index_meta_data += num_meta_data;
     }
@@ -231,6 +219,8 @@ class HoughvotingOp : public OpKernel {
   }
  private:
   int is_train_;
+  mutex mu_;
+  HypArena arena_; // preallocated RANSAC storage, reused across images and calls
 };
 
 REGISTER_KERNEL_BUILDER(Name("Houghvoting").Device(DEVICE_CPU).TypeConstraint<float>("T"), HoughvotingOp<CPUDevice, float>);
@@ -284,23 +274,14 @@ REGISTER_KERNEL_BUILDER(Name("HoughvotingGrad").Device(DEVICE_CPU).TypeConstrain
 
 
 // get label lists
-void getLabels(const int* label_map, std::vector<std::vector<int>>& labels, std::vector<int>& object_ids, int width, int height, int num_classes, int minArea)
+void getLabels(const int* label_map, LabelIndex& labels, std::vector<int>& object_ids, int width, int height, int num_classes, int minArea)
 {
-  for(int i = 0; i < num_classes; i++)
-    labels.push_back( std::vector<int>() );
-
-  // for each pixel
-  #pragma omp parallel for
-  for(int x = 0; x < width; x++)
-  for(int y = 0; y < height; y++)
-  {
-    int label = label_map[y * width + x];
-    labels[label].push_back(y * width + x);
-  }
+  // bucket the pixels by class
+  labels.build(label_map, width, height, num_classes);
 
   for(int i = 1; i < num_classes; i++)
   {
-    if (labels[i].size() > minArea)
+    if (labels.size(i) > minArea)
     {
       object_ids.push_back(i);
     }
@@ -354,38 +335,6 @@ inline bool samplePoint2D(jp::id_t objID, std::vector<cv::Point2f>& eyePts, std:
 }
 
 
-/**
- * @brief Creates a list of pose hypothesis (potentially belonging to multiple objects) which still have to be processed (e.g. refined).
- * 
- * The method includes all remaining hypotheses of an object if there is still more than one, or if there is only one remaining but it still needs to be refined.
- * 
- * @param hypMap Map of object ID to a list of hypotheses for that object.
- * @param maxIt Each hypotheses should be at least this often refined.
- * @return std::vector< Ransac3D::TransHyp*, std::allocator< void > > List of hypotheses to be processed further.
-*/
-std::vector<TransHyp*> getWorkingQueue(std::map<jp::id_t, std::vector<TransHyp>>& hypMap, int maxIt, int is_train)
-{
-  std::vector<TransHyp*> workingQueue;
-
-  if (is_train)
-  {      
-    for(auto it = hypMap.begin(); it != hypMap.end(); it++)
-    for(int h = 0; h < it->second.size(); h++)
-      if(it->second[h].refSteps < maxIt)
-        workingQueue.push_back(&(it->second[h]));
-  }
-  else
-  {
-    for(auto it = hypMap.begin(); it != hypMap.end(); it++)
-    for(int h = 0; h < it->second.size(); h++)
-      if(it->second.size() > 1 || it->second[h].refSteps < maxIt) //exclude a hypothesis if it is the only one remaining for an object and it has been refined enough already
-        workingQueue.push_back(&(it->second[h]));
-  }
-
-  return workingQueue;
-}
-
-
 inline float point2line(cv::Point2d x, cv::Point2f n, cv::Point2f p)
 {
   float n1 = -n.y;
@@ -405,85 +354,82 @@ inline float angle_distance(cv::Point2f x, cv::Point2f n, cv::Point2f p)
 }
 
 
-inline void countInliers2D(TransHyp& hyp, const float * vertmap, const std::vector<std::vector<int>>& labels, float inlierThreshold, int width, int num_classes, int pixelBatch)
+// maxInliers: capacity of the inlier buffer, further inliers replace stored ones by reservoir sampling
+// not scored through countInliers of inlier_scoring.h: the pixels of a class are already shuffled and
+// stored as SoA, so a prefix is tested in SIMD blocks instead of skipping through them one at a time
+inline void countInliers2D(TransHyp& hyp, const PixelSoA& pixels, const LabelIndex& labels, float inlierThreshold, int pixelBatch, int maxInliers)
 {
   // reset data of last RANSAC iteration
   hyp.inlierPts2D.clear();
   hyp.inliers = 0;
 
-  hyp.effPixels = 0; // num of pixels drawn
   hyp.maxPixels += pixelBatch; // max num of pixels to be drawn	
 
-  int maxPt = labels[hyp.objID].size(); // num of pixels of this class
-  float successRate = hyp.maxPixels / (float) maxPt; // probability to accept a pixel
+  // the pixels of a class are stored in random order, so the first maxPixels form a random subset
+  int begin = labels.offsets[hyp.objID];
+  int maxPt = std::min(hyp.maxPixels, labels.size(hyp.objID));
+  hyp.effPixels = maxPt; // num of pixels drawn
 
-  std::mt19937 generator;
-  std::negative_binomial_distribution<int> distribution(1, successRate); // lets you skip a number of pixels until you encounter the next pixel to accept
+  float cx = hyp.center.x;
+  float cy = hyp.center.y;
+  float maxDist = std::max(hyp.bb.width, hyp.bb.height);
 
-  for(unsigned ptIdx = 0; ptIdx < maxPt;)
+  // test the pixels in chunks, inlier masks stay on the stack
+  const int chunk = 256;
+  uint8_t masks[chunk / INLIER_BLOCK];
+
+  for(int start = 0; start < maxPt; start += chunk)
   {
-    int index = labels[hyp.objID][ptIdx];
-    cv::Point2d pt2D(index % width, index / width);
-  
-    hyp.effPixels++;
-  
-    // read out object coordinate
-    float distance;
-    cv::Point2d obj = getMode2D(hyp.objID, pt2D, vertmap, distance, width, num_classes);
-
-    // inlier check
-    float d = cv::norm(hyp.center - pt2D);
-    if(point2line(hyp.center, obj, pt2D) < inlierThreshold && angle_distance(hyp.center, obj, pt2D) > 0 && d < std::max(hyp.bb.width, hyp.bb.height))
+    int n = std::min(chunk, maxPt - start);
+    if(inlierMasks2D(pixels, begin + start, n, cx, cy, inlierThreshold, maxDist, masks) == 0)
+      continue;
+
+    for(int b = 0; b < (n + INLIER_BLOCK - 1) / INLIER_BLOCK; b++)
+    for(int bits = masks[b]; bits; bits &= bits - 1)
     {
-      hyp.inlierPts2D.push_back(std::pair<cv::Point2d, cv::Point2d>(obj, pt2D)); // store object coordinate - camera coordinate correspondence
-      hyp.inliers++; // keep track of the number of inliers (correspondences might be thinned out for speed later)
-    }
+      int i = begin + start + b * INLIER_BLOCK + __builtin_ctz(bits);
+      std::pair<cv::Point2d, cv::Point2d> inlier(cv::Point2d(pixels.dx[i], pixels.dy[i]), cv::Point2d(pixels.x[i], pixels.y[i]));
 
-    // advance to the next accepted pixel
-    if(successRate < 1)
-      ptIdx += std::max(1, distribution(generator));
-    else
-      ptIdx++;
+      // store object coordinate - camera coordinate correspondence, keep a uniform subsample once the buffer is full
+      if(hyp.inlierPts2D.size() < maxInliers)
+        hyp.inlierPts2D.push_back(inlier);
+      else
+      {
+        int idx = hyp.rng.irand(0, hyp.inliers + 1);
+        if(idx < maxInliers)
+          hyp.inlierPts2D[idx] = inlier;
+      }
+      hyp.inliers++; // keep track of the number of inliers (correspondences are thinned out for speed)
+    }
   }
 }
 
 
-inline void compute_width_height(TransHyp& hyp, const float* vertmap, const std::vector<std::vector<int>>& labels, float inlierThreshold, int width, int num_classes)
+inline void compute_width_height(HypArena& arena, jp::id_t objID, float inlierThreshold)
 {
-  float w = -1;
-  float h = -1;
-  int maxPt = labels[hyp.objID].size(); // num of pixels of this class
+  // all remaining hypotheses of the object are handled in one pass over its pixels
+  CenterTable& centers = arena.centers;
+  centers.clear();
+  for(int k = 0; k < arena.count(objID); k++)
+  {
+    const TransHyp& hyp = arena.hyp(objID, k);
+    centers.push_back(hyp.center.x, hyp.center.y, std::max(hyp.bb.width, hyp.bb.height));
+  }
+
+  centers.computeExtents(arena.pixels, arena.labels.offsets[objID], arena.labels.size(objID), inlierThreshold);
 
-  for(unsigned ptIdx = 0; ptIdx < maxPt; ptIdx++)
+  for(int k = 0; k < arena.count(objID); k++)
   {
-    int index = labels[hyp.objID][ptIdx];
-    cv::Point2d pt2D(index % width, index / width);
-  
-    // read out object coordinate
-    float distance;
-    cv::Point2d obj = getMode2D(hyp.objID, pt2D, vertmap, distance, width, num_classes);
-
-    // inlier check
-    float d = cv::norm(hyp.center - pt2D);
-    if(point2line(hyp.center, obj, pt2D) < inlierThreshold && angle_distance(hyp.center, obj, pt2D) > 0 && d < std::max(hyp.bb.width, hyp.bb.height))
-    {
-      float x = fabs(pt2D.x - hyp.center.x);
-      float y = fabs(pt2D.y - hyp.center.y);
-      if (x > w)
-        w = x;
-      if (y > h)
-        h = y;
-    }
+    TransHyp& hyp = arena.hyp(objID, k);
+    hyp.width_ = 2 * centers.w[k];
+    hyp.height_ = 2 * centers.h[k];
   }
-  hyp.width_ = 2 * w;
-  hyp.height_ = 2 * h;
 }
 
 
-inline void updateHyp2D(TransHyp& hyp, int maxPixels)
+inline void updateHyp2D(TransHyp& hyp)
 {
   if(hyp.inlierPts2D.size() < 4) return;
-  filterInliers2D(hyp, maxPixels); // limit the number of correspondences
       
   // data conversion
   cv::Point2d center = hyp.center;
@@ -495,25 +441,7 @@ inline void updateHyp2D(TransHyp& hyp, int maxPixels)
 }
 
 
-inline void filterInliers2D(TransHyp& hyp, int maxInliers)
-{
-  if(hyp.inlierPts2D.size() < maxInliers) return; // maximum number not reached, do nothing
-      		
-  std::vector<std::pair<cv::Point2d, cv::Point2d>> inlierPts; // filtered list of inlier correspondences
-	
-  // select random correspondences to keep
-  for(unsigned i = 0; i < maxInliers; i++)
-  {
-    int idx = irand(0, hyp.inlierPts2D.size());
-	    
-    inlierPts.push_back(hyp.inlierPts2D[idx]);
-  }
-	
-  hyp.inlierPts2D = inlierPts;
-}
-
-
-void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::vector<cv::Point3f>> bb3Ds, int batch, int height, int width, int num_classes, int is_train,
+void estimateCenter(HypArena& arena, const int* labelmap, const float* vertmap, std::vector<std::vector<cv::Point3f>> bb3Ds, int batch, int height, int width, int num_classes, int is_train,
   float fx, float fy, float px, float py, std::vector<cv::Vec<float, 13> >& outputs)
 {     
   //set parameters, see documentation of GlobalProperties
@@ -542,8 +470,11 @@ void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::
     refIt = 8;
   }
 
+  // random streams are addressed by frame, hypothesis and draw, so results do not depend on the number of threads
+  uint32_t frame = arena.frame++;
+
   // labels
-  std::vector<std::vector<int>> labels;
+  LabelIndex& labels = arena.labels;
   std::vector<int> object_ids;
   getLabels(labelmap, labels, object_ids, width, height, num_classes, minArea);
 
@@ -557,12 +488,15 @@ void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::
 
   if (object_ids.size() == 0)
     return;
+
+  // structure-of-arrays copy of the object pixels for inlier counting
+  arena.pixels.gather(labels, object_ids, vertmap, width, num_classes, VERTEX_CHANNELS, frame);
 	
   int imageWidth = width;
   int imageHeight = height;
 		
   // hold for each object a list of pose hypothesis, these are optimized until only one remains per object
-  std::map<jp::id_t, std::vector<TransHyp>> hypMap;
+  arena.reset(ransacIterations, maxPixels);
 	
   // sample initial pose hypotheses
   #pragma omp parallel for
@@ -573,14 +507,18 @@ void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::
     std::vector<cv::Point2f> eyePts;
     std::vector<cv::Point2f> objPts;
     std::vector<float> distances;
+
+    // each hypothesis draws from its own random stream, independent of the thread running it
+    Philox& rng = arena.hyps[h].rng;
+    if(i == 0) rng = Philox(frame, h);
 	    
     // sample first point and choose object ID
-    jp::id_t objID = object_ids[irand(0, object_ids.size())];
+    jp::id_t objID = object_ids[rng.irand(0, object_ids.size())];
 
     if(objID == 0) continue;
 
-    int pindex = irand(0, labels[objID].size());
-    int index = labels[objID][pindex];
+    int pindex = rng.irand(0, labels.size(objID));
+    int index = labels(objID, pindex);
     cv::Point2f pt1(index % width, index / width);
     
     // sample first correspondence
@@ -588,8 +526,8 @@ void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::
       continue;
 
     // sample other points in search radius, discard hypothesis if minimum distance constrains are violated
-    pindex = irand(0, labels[objID].size());
-    index = labels[objID][pindex];
+    pindex = rng.irand(0, labels.size(objID));
+    index = labels(objID, pindex);
     cv::Point2f pt2(index % width, index / width);
 
     if (cv::norm(pt1 - pt2) < minDist2D)
@@ -624,7 +562,8 @@ void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::
     }
     
     // create a hypothesis object to store meta data
-    TransHyp hyp(objID, center);
+    TransHyp& hyp = arena.hyps[h];
+    hyp.reset(objID, center);
 
     // estimate a projection
     cv::Mat tvec(3, 1, CV_64F);
@@ -659,25 +598,20 @@ void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::
     c.x = center.x;
     c.y = center.y;
     if (cv::norm(pt1 - c) > std::max(hyp.bb.width, hyp.bb.height) || cv::norm(pt2 - c) > std::max(hyp.bb.width, hyp.bb.height))
-      continue;
-    
-    #pragma omp critical
     {
-      hypMap[objID].push_back(hyp);
+      hyp.objID = 0;
+      continue;
     }
 
     break;
   }
 
   // create a list of all objects where hyptheses have been found
-  std::vector<jp::id_t> objList;
-  for(std::pair<jp::id_t, std::vector<TransHyp>> hypPair : hypMap)
-  {
-    objList.push_back(hypPair.first);
-  }
+  arena.groupByObject(num_classes);
+  const std::vector<jp::id_t>& objList = arena.objList;
 
   // create a working queue of all hypotheses to process
-  std::vector<TransHyp*> workingQueue = getWorkingQueue(hypMap, refIt, is_train);
+  std::vector<TransHyp*>& workingQueue = arena.getWorkingQueue(refIt, is_train);
 	
   // main preemptive RANSAC loop, it will stop if there is max one hypothesis per object remaining which has been refined a minimal number of times
   while(!workingQueue.empty())
@@ -685,45 +619,42 @@ void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::
     // draw a batch of pixels and check for inliers, the number of pixels looked at is increased in each iteration
     #pragma omp parallel for
     for(int h = 0; h < workingQueue.size(); h++)
-      countInliers2D(*(workingQueue[h]), vertmap, labels, inlierThreshold3D, width, num_classes, preemptiveBatch);
+      countInliers2D(*(workingQueue[h]), arena.pixels, labels, inlierThreshold3D, preemptiveBatch, arena.inlierCapacity);
 	    	    
     // sort hypothesis according to inlier count and discard bad half
     #pragma omp parallel for 
     for(unsigned o = 0; o < objList.size(); o++)
-    {
-      jp::id_t objID = objList[o];
-      if(hypMap[objID].size() > 1)
-      {
-	std::sort(hypMap[objID].begin(), hypMap[objID].end());
-	hypMap[objID].erase(hypMap[objID].begin() + hypMap[objID].size() / 2, hypMap[objID].end());
-      }
-    }
-    workingQueue = getWorkingQueue(hypMap, refIt, is_train);
+      arena.discardWorseHalf(objList[o]);
+    arena.getWorkingQueue(refIt, is_train);
 	    
     // refine
     #pragma omp parallel for
     for(int h = 0; h < workingQueue.size(); h++)
     {
-      updateHyp2D(*(workingQueue[h]), maxPixels);
+      updateHyp2D(*(workingQueue[h]));
       workingQueue[h]->refSteps++;
     }
     
-    workingQueue = getWorkingQueue(hypMap, refIt, is_train);
+    arena.getWorkingQueue(refIt, is_train);
   }
 
-  #pragma omp parallel for
-  for(auto it = hypMap.begin(); it != hypMap.end(); it++)
-  for(int h = 0; h < it->second.size(); h++)
+  // extents of the remaining hypotheses
+  for(unsigned o = 0; o < objList.size(); o++)
+    compute_width_height(arena, objList[o], inlierThreshold3D);
+
+  for(unsigned o = 0; o < objList.size(); o++)
+  for(int k = 0; k < arena.count(objList[o]); k++)
   {
+    TransHyp& hyp = arena.hyp(objList[o], k);
     cv::Vec<float, 13> roi;
     roi(0) = batch;
-    roi(1) = it->second[h].objID;
+    roi(1) = hyp.objID;
 
     // backproject the center
-    cv::Point2d center = it->second[h].center;
+    cv::Point2d center = hyp.center;
     float rx = (center.x - px) / fx;
     float ry = (center.y - py) / fy;
-    float distance = it->second[h].compute_distance(vertmap, num_classes, width);
+    float distance = hyp.compute_distance(vertmap, num_classes, width);
 
     // initial pose
     std::vector<double> vec(6);
@@ -755,12 +686,11 @@ void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::
     Eigen::Map<Eigen::Matrix3d> eigenT( (double*)pose_t.data );
     Eigen::Quaterniond quaternion(eigenT);
 
-    compute_width_height(it->second[h], vertmap, labels, inlierThreshold3D, width, num_classes);
     float scale = 0.05;
-    roi(2) = center.x - it->second[h].width_ * (0.5 + scale);
-    roi(3) = center.y - it->second[h].height_ * (0.5 + scale);
-    roi(4) = center.x + it->second[h].width_ * (0.5 + scale);
-    roi(5) = center.y + it->second[h].height_ * (0.5 + scale);
+    roi(2) = center.x - hyp.width_ * (0.5 + scale);
+    roi(3) = center.y - hyp.height_ * (0.5 + scale);
+    roi(4) = center.x + hyp.width_ * (0.5 + scale);
+    roi(5) = center.y + hyp.height_ * (0.5 + scale);
 
     roi(6) = quaternion.w();
     roi(7) = quaternion.x();
@@ -776,11 +706,11 @@ void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::
     std::cout << quaternion.w() << " " << quaternion.x() << " " << quaternion.y() << " " << quaternion.z() << std::endl;
     std::cout << pose.second << std::endl;
     
-    std::cout << "Inliers: " << it->second[h].inliers;
-    std::printf(" (Rate: %.1f\%)\n", it->second[h].getInlierRate() * 100);
-    std::cout << "Refined " << it->second[h].refSteps << " times. " << std::endl;
+    std::cout << "Inliers: " << hyp.inliers;
+    std::printf(" (Rate: %.1f\%)\n", hyp.getInlierRate() * 100);
+    std::cout << "Refined " << hyp.refSteps << " times. " << std::endl;
     std::cout << "Center " << center << std::endl;
-    std::cout << "Width: " << it->second[h].width_ << " Height: " << it->second[h].height_ << std::endl;
+    std::cout << "Width: " << hyp.width_ << " Height: " << hyp.height_ << std::endl;
     std::cout << "---------------------------------------------------" << std::endl;
     std::cout << roi << std::endl;
     */
@@ -857,68 +787,6 @@ void estimateCenter(const int* labelmap, const float* vertmap, std::vector<std::
 }
 
 
-static double optEnergy(const std::vector<double> &pose, std::vector<double> &grad, void *data)
-{
-  DataForOpt* dataForOpt = (DataForOpt*) data;
-
-  cv::Mat tvec(3, 1, CV_64F);
-  cv::Mat rvec(3, 1, CV_64F);
-      
-  for(int i = 0; i < 6; i++)
-  {
-    if(i > 2) 
-      tvec.at<double>(i-3, 0) = pose[i];
-    else 
-      rvec.at<double>(i, 0) = pose[i];
-  }
-	
-  jp::cv_trans_t trans(rvec, tvec);
-
-  // project the 3D bounding box according to the current pose
-  cv::Rect bb2D = getBB2D(dataForOpt->imageWidth, dataForOpt->imageHeight, dataForOpt->bb3D, dataForOpt->camMat, trans);
-
-  // compute IoU between boxes
-  float energy = -1 * getIoU(bb2D, dataForOpt->bb2D);
-
-  return energy;
-}
-
-
-double poseWithOpt(std::vector<double> & vec, DataForOpt data, int iterations) 
-{
-  // set up optimization algorithm (gradient free)
-  nlopt::opt opt(nlopt::LN_NELDERMEAD, 6); 
-
-  // set optimization bounds 
-  double rotRange = 180;
-  rotRange *= PI / 180;
-  double tRangeXY = 0.01;
-  double tRangeZ = 0.01; // pose uncertainty is larger in Z direction
-	
-  std::vector<double> lb(6);
-  lb[0] = vec[0]-rotRange; lb[1] = vec[1]-rotRange; lb[2] = vec[2]-rotRange;
-  lb[3] = vec[3]-tRangeXY; lb[4] = vec[4]-tRangeXY; lb[5] = vec[5]-tRangeZ;
-  opt.set_lower_bounds(lb);
-      
-  std::vector<double> ub(6);
-  ub[0] = vec[0]+rotRange; ub[1] = vec[1]+rotRange; ub[2] = vec[2]+rotRange;
-  ub[3] = vec[3]+tRangeXY; ub[4] = vec[4]+tRangeXY; ub[5] = vec[5]+tRangeZ;
-  opt.set_upper_bounds(ub);
-      
-  // configure NLopt
-  opt.set_min_objective(optEnergy, &data);
-  opt.set_maxeval(iterations);
-
-  // run optimization
-  double energy;
-  nlopt::result result = opt.optimize(vec, energy);
-
-  // std::cout << "IoU after optimization: " << -energy << std::endl;
-   
-  return energy;
-}
-
-
 // compute the pose target and weight
 void compute_target_weight(int height, int width, float* target, float* weight, std::vector<std::vector<cv::Point3f>> bb3Ds, 
   const float* poses_gt, int num_gt, int num_classes, float fx, float fy, float px, float py, std::vector<cv::Vec<float, 13> > outputs)
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "ransac.h"
+#include "label_index.h"
+#include "inlier_kernel.h"
+#include "extent_kernel.h"
+
+/**
+ * @brief Reusable storage for the preemptive RANSAC of the Houghvoting op.
+ *
+ * Hypotheses live in one flat array with one slot per sampled hypothesis. The hypotheses
+ * of an object are addressed through a contiguous range of slot indices which is sorted
+ * by score and shrunk in place in every round. Inlier buffers are reserved once with a
+ * fixed capacity, so after the first frame the RANSAC loop does not touch the heap.
+ */
+struct HypArena
+{
+  LabelIndex labels; // pixels of the current frame grouped by class
+  PixelSoA pixels; // voting data of the object pixels, shuffled per class
+  CenterTable centers; // centers of one object for the extent estimation
+
+  std::vector<TransHyp> hyps; // hypothesis slots, objID 0 marks an empty slot
+  std::vector<int> order; // slot indices grouped by object, best first after each round
+  std::vector<int> objOffsets; // first entry of each object in order
+  std::vector<int> objCounts; // number of remaining hypotheses of each object
+  std::vector<jp::id_t> objList; // objects with at least one hypothesis
+  std::vector<TransHyp*> workingQueue; // hypotheses still to be processed
+
+  uint32_t frame = 0; // index of the current frame, selects the random streams
+  int numHyps = 0; // number of slots used in the current frame
+  int inlierCapacity = 0; // maximum number of inlier correspondences stored per hypothesis
+
+  /**
+   * @brief Prepares the arena for a new frame. Only allocates if the sizes grow.
+   *
+   * @param numHyps Number of hypotheses to sample.
+   * @param maxInliers Capacity of the inlier buffer of each hypothesis.
+   */
+  void reset(int numHyps, int maxInliers)
+  {
+    if (hyps.size() < numHyps)
+      hyps.resize(numHyps);
+
+    for (int h = 0; h < hyps.size(); h++)
+    {
+      hyps[h].objID = 0;
+      hyps[h].inlierPts2D.reserve(maxInliers);
+    }
+
+    order.reserve(numHyps);
+    workingQueue.reserve(numHyps);
+
+    this->numHyps = numHyps;
+    this->inlierCapacity = maxInliers;
+  }
+
+  /**
+   * @brief Groups the sampled hypotheses by object, keeping the sampling order within each object.
+   */
+  void groupByObject(int num_classes)
+  {
+    objOffsets.assign(num_classes, 0);
+    objCounts.assign(num_classes, 0);
+
+    for (int h = 0; h < numHyps; h++)
+      if (hyps[h].objID > 0)
+        objCounts[hyps[h].objID]++;
+
+    int total = 0;
+    objList.clear();
+    for (int c = 0; c < num_classes; c++)
+    {
+      objOffsets[c] = total;
+      total += objCounts[c];
+      if (objCounts[c] > 0)
+        objList.push_back(c);
+    }
+
+    order.resize(total);
+    for (int c = 0; c < num_classes; c++)
+      objCounts[c] = 0;
+    for (int h = 0; h < numHyps; h++)
+    {
+      jp::id_t objID = hyps[h].objID;
+      if (objID > 0)
+        order[objOffsets[objID] + objCounts[objID]++] = h;
+    }
+  }
+
+  /**
+   * @brief Number of remaining hypotheses of an object.
+   */
+  int count(jp::id_t objID) const { return objCounts[objID]; }
+
+  /**
+   * @brief The k-th remaining hypothesis of an object.
+   */
+  TransHyp& hyp(jp::id_t objID, int k) { return hyps[order[objOffsets[objID] + k]]; }
+
+  /**
+   * @brief Sorts the hypotheses of an object by score and discards the worse half.
+   */
+  void discardWorseHalf(jp::id_t objID)
+  {
+    if (objCounts[objID] <= 1)
+      return;
+
+    int* begin = order.data() + objOffsets[objID];
+    const std::vector<TransHyp>& h = hyps;
+    std::sort(begin, begin + objCounts[objID], [&h](int a, int b)
+    {
+      // break ties by slot index to keep the result deterministic
+      if (h[a].getScore() != h[b].getScore())
+        return h[a].getScore() > h[b].getScore();
+      return a < b;
+    });
+
+    objCounts[objID] /= 2;
+  }
+
+  /**
+   * @brief Collects all hypotheses which still have to be processed (e.g. refined).
+   *
+   * Includes all remaining hypotheses of an object if there is still more than one, or if there is only one remaining but it still needs to be refined.
+   * During training, every hypothesis which has been refined less than maxIt times is included.
+   *
+   * @param maxIt Each hypotheses should be at least this often refined.
+   * @return std::vector< TransHyp* >& List of hypotheses to be processed further.
+   */
+  std::vector<TransHyp*>& getWorkingQueue(int maxIt, int is_train)
+  {
+    workingQueue.clear();
+
+    for (int o = 0; o < objList.size(); o++)
+    {
+      jp::id_t objID = objList[o];
+      for (int k = 0; k < objCounts[objID]; k++)
+      {
+        TransHyp& h = hyp(objID, k);
+        if ((!is_train && objCounts[objID] > 1) || h.refSteps < maxIt)
+          workingQueue.push_back(&h);
+      }
+    }
+
+    return workingQueue;
+  }
+};
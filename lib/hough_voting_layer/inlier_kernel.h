@@ -0,0 +1,180 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <stdint.h>
+
+#include "label_index.h"
+#include "thread_rand.h"
+#include "simd_dispatch.h"
+
+#define INLIER_BLOCK 8
+#define PIXEL_SHUFFLE_STREAM 0x80000000u // first random stream of the pixel shuffle, hypotheses use the streams below
+
+/**
+ * @brief Structure-of-arrays copy of the voting pixels of the detected objects.
+ *
+ * Uses the class offsets of the LabelIndex it was gathered from. Within a class the pixels
+ * are stored in random order, so the first n entries are a uniform random subset of size n.
+ * The order only depends on the frame index, each class is shuffled with its own random stream.
+ */
+
+struct PixelSoA
+{
+  std::vector<float> x; // pixel position
+  std::vector<float> y;
+  std::vector<float> dx; // normalized voting direction towards the object center
+  std::vector<float> dy;
+  std::vector<float> dist; // predicted distance of the object center
+
+  /**
+   * @brief Gathers the pixels of the given classes from the interleaved vertex map.
+   *
+   * @param labels Pixels grouped by class.
+   * @param object_ids Classes to gather, other classes are left untouched.
+   * @param vertmap Vertex map, height x width x (VERTEX_CHANNELS * num_classes).
+   * @param channels Number of channels per class in the vertex map.
+   * @param frame Frame index for the random streams of the shuffle.
+   */
+  void gather(const LabelIndex& labels, const std::vector<int>& object_ids, const float* vertmap, int width, int num_classes, int channels, uint32_t frame)
+  {
+    int n = labels.indices.size();
+    x.resize(n);
+    y.resize(n);
+    dx.resize(n);
+    dy.resize(n);
+    dist.resize(n);
+
+    #pragma omp parallel for
+    for (int o = 0; o < object_ids.size(); o++)
+    {
+      int cls = object_ids[o];
+      int begin = labels.offsets[cls];
+      int count = labels.size(cls);
+      Philox rng(frame, PIXEL_SHUFFLE_STREAM + cls);
+
+      for (int i = 0; i < count; i++)
+      {
+        // inside-out Fisher-Yates shuffle, the new pixel goes to a random slot j <= i
+        int j = begin + rng.irand(0, i + 1);
+        int index = labels.indices[begin + i];
+        int offset = channels * cls + channels * num_classes * index;
+
+        float u = vertmap[offset];
+        float v = vertmap[offset + 1];
+        float norm = sqrt(u * u + v * v);
+        if (norm > 0)
+        {
+          u /= norm;
+          v /= norm;
+        }
+
+        x[begin + i] = x[j];
+        y[begin + i] = y[j];
+        dx[begin + i] = dx[j];
+        dy[begin + i] = dy[j];
+        dist[begin + i] = dist[j];
+
+        x[j] = index % width;
+        y[j] = index / width;
+        dx[j] = u;
+        dy[j] = v;
+        dist[j] = vertmap[offset + 2];
+      }
+    }
+  }
+};
+
+
+#if defined(SIMD_DISPATCH_AVX2)
+/**
+ * @brief AVX2 part of inlierMasks2D, tests whole blocks of INLIER_BLOCK pixels.
+ *
+ * @param count Incremented by the number of inliers.
+ * @return int Number of pixels tested, a multiple of INLIER_BLOCK.
+ */
+SIMD_TARGET_AVX2 inline int inlierMasks2DAVX2(const float* px, const float* py, const float* ux, const float* uy, int n,
+  float cx, float cy, float inlierThreshold, float maxDist2, uint8_t* masks, int& count)
+{
+  int i = 0;
+
+  const __m256 vcx = _mm256_set1_ps(cx);
+  const __m256 vcy = _mm256_set1_ps(cy);
+  const __m256 vthreshold = _mm256_set1_ps(inlierThreshold);
+  const __m256 vmaxDist2 = _mm256_set1_ps(maxDist2);
+  const __m256 vzero = _mm256_setzero_ps();
+  const __m256 vabs = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+  for (; i + INLIER_BLOCK <= n; i += INLIER_BLOCK)
+  {
+    __m256 rx = _mm256_sub_ps(vcx, _mm256_loadu_ps(px + i));
+    __m256 ry = _mm256_sub_ps(vcy, _mm256_loadu_ps(py + i));
+    __m256 vx = _mm256_loadu_ps(ux + i);
+    __m256 vy = _mm256_loadu_ps(uy + i);
+
+    // distance of the center to the voting line
+    __m256 line = _mm256_and_ps(_mm256_sub_ps(_mm256_mul_ps(vx, ry), _mm256_mul_ps(vy, rx)), vabs);
+    // the voting direction has to point towards the center
+    __m256 dot = _mm256_add_ps(_mm256_mul_ps(vx, rx), _mm256_mul_ps(vy, ry));
+    // the center has to lie within the object radius
+    __m256 d2 = _mm256_add_ps(_mm256_mul_ps(rx, rx), _mm256_mul_ps(ry, ry));
+
+    __m256 mask = _mm256_and_ps(_mm256_cmp_ps(line, vthreshold, _CMP_LT_OQ), _mm256_cmp_ps(dot, vzero, _CMP_GT_OQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(d2, vmaxDist2, _CMP_LT_OQ));
+
+    int bits = _mm256_movemask_ps(mask);
+    masks[i / INLIER_BLOCK] = bits;
+    count += __builtin_popcount(bits);
+  }
+
+  return i;
+}
+#endif
+
+/**
+ * @brief Tests the pixels [begin, begin + n) of a PixelSoA against a 2D center hypothesis.
+ *
+ * A pixel is an inlier if the line through it along its voting direction passes the center
+ * closer than inlierThreshold, the direction points towards the center and the center is
+ * closer than maxDist. Bit k of masks[i] is set if pixel begin + INLIER_BLOCK * i + k is an inlier.
+ *
+ * @param masks Output, (n + INLIER_BLOCK - 1) / INLIER_BLOCK entries.
+ * @return int Number of inliers.
+ */
+inline int inlierMasks2D(const PixelSoA& soa, int begin, int n, float cx, float cy, float inlierThreshold, float maxDist, uint8_t* masks)
+{
+  const float* px = soa.x.data() + begin;
+  const float* py = soa.y.data() + begin;
+  const float* ux = soa.dx.data() + begin;
+  const float* uy = soa.dy.data() + begin;
+  const float maxDist2 = maxDist * maxDist;
+
+  int count = 0;
+  int i = 0;
+
+#if defined(SIMD_DISPATCH_AVX2)
+  if (simdHasAVX2())
+    i = inlierMasks2DAVX2(px, py, ux, uy, n, cx, cy, inlierThreshold, maxDist2, masks, count);
+#endif
+
+  // scalar fallback and remainder
+  for (; i < n; i += INLIER_BLOCK)
+  {
+    int bits = 0;
+    for (int k = 0; k < INLIER_BLOCK && i + k < n; k++)
+    {
+      float rx = cx - px[i + k];
+      float ry = cy - py[i + k];
+      float line = fabs(ux[i + k] * ry - uy[i + k] * rx);
+      float dot = ux[i + k] * rx + uy[i + k] * ry;
+      float d2 = rx * rx + ry * ry;
+
+      if (line < inlierThreshold && dot > 0 && d2 < maxDist2)
+        bits |= 1 << k;
+    }
+    masks[i / INLIER_BLOCK] = bits;
+    count += __builtin_popcount(bits);
+  }
+
+  return count;
+}
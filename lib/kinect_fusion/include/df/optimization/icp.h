@@ -8,6 +8,8 @@
 #include <df/optimization/linearSystems.h>
 #include <thrust/device_vector.h>
 
+#include <vector>
+
 typedef unsigned char uchar;
 
 namespace df {
@@ -40,6 +42,33 @@ Sophus::SE3<Scalar> icp_translation(const DeviceTensor2<Eigen::UnalignedVec3<Sca
                              const uint numIterations,
                              DebugArgsT ... debugArgs);
 
+// device buffers of icpBatch, owned by the caller so they are reused across calls and freed with it
+template <typename Scalar>
+struct ICPBatchBuffers {
+    ManagedDeviceTensor1<internal::JacobianAndResidual<Scalar,1,6> > jacobiansAndResiduals;
+    ManagedDeviceTensor1<Sophus::SE3<Scalar> > poses;
+};
+
+// ICP of several pose hypotheses of the same model at once. The predictions of hypothesis k are
+// the rows [k*height, (k+1)*height) of predVertices and predNormals, height being the height of
+// liveVertices. Each iteration handles all hypotheses with a single kernel launch. Returns the
+// update of each hypothesis. If given, residuals (RMS of the weighted point-to-plane errors) and
+// inliers (number of associated pixels) are evaluated at the updated poses.
+template <typename Scalar,
+          typename CameraModelT,
+          int DPred>
+std::vector<Sophus::SE3<Scalar> > icpBatch(const DeviceTensor2<Eigen::UnalignedVec3<Scalar> > & liveVertices,
+                                           const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > & predVertices,
+                                           const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > & predNormals,
+                                           const CameraModelT & cameraModel,
+                                           const uint numHypotheses,
+                                           const Eigen::Matrix<Scalar,2,1> & depthRange,
+                                           const Scalar maxError,
+                                           const uint numIterations,
+                                           ICPBatchBuffers<Scalar> & buffers,
+                                           std::vector<Scalar> * residuals = nullptr,
+                                           std::vector<int> * inliers = nullptr);
+
 namespace internal {
 
 template <typename Scalar,
@@ -58,6 +87,24 @@ LinearSystem<Scalar,6> icpIteration(const DeviceTensor2<Eigen::UnalignedVec3<Sca
                                     const dim3 block,
                                     DebugArgsT ... debugArgs);
 
+// linear system of each hypothesis at its pose, systems and residuals are optional
+template <typename Scalar,
+          typename CameraModelT,
+          int DPred>
+void icpBatchIteration(const DeviceTensor2<Eigen::UnalignedVec3<Scalar> > & liveVertices,
+                       const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > & predVertices,
+                       const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > & predNormals,
+                       const CameraModelT & cameraModel,
+                       const std::vector<Sophus::SE3<Scalar> > & predictionPoses,
+                       const Eigen::Matrix<Scalar,2,1> & depthRange,
+                       const Scalar maxError,
+                       const dim3 grid,
+                       const dim3 block,
+                       ICPBatchBuffers<Scalar> & buffers,
+                       std::vector<LinearSystem<Scalar,6> > * systems,
+                       std::vector<Scalar> * residuals,
+                       std::vector<int> * inliers);
+
 } // namespace internal
 
 } // namespace df
@@ -30,6 +30,13 @@ public:
                 const std::vector<Eigen::Matrix4f> & transforms,
                 const GLenum mode = GL_TRIANGLES);
 
+    // renders the same model once per transform, transform k into the rows [k*tileHeight, (k+1)*tileHeight)
+    void renderTiles(const std::vector<pangolin::GlBuffer *> & vertexAttributeBuffers,
+                     pangolin::GlBuffer & indexBuffer,
+                     const std::vector<Eigen::Matrix4f> & transforms,
+                     const int tileHeight,
+                     const GLenum mode = GL_TRIANGLES);
+
     inline const pangolin::GlTextureCudaArray & texture(const int i) const {
         assert(i < RenderType::numTextures);
         return textures_[i];
@@ -291,5 +298,40 @@ void GLRenderer<RenderType>::render(const std::vector<std::vector<pangolin::GlBu
 
 }
 
+template <typename RenderType>
+void GLRenderer<RenderType>::renderTiles(const std::vector<pangolin::GlBuffer *> & vertexAttributeBuffers,
+                                         pangolin::GlBuffer & indexBuffer,
+                                         const std::vector<Eigen::Matrix4f> & transforms,
+                                         const int tileHeight,
+                                         const GLenum mode) {
+
+    assert(transforms.size() * tileHeight <= renderHeight_);
+
+    renderSetup();
+
+    vertexAttributeSetup(vertexAttributeBuffers);
+
+    indexBuffer.Bind();
+
+    for (int m = 0; m < transforms.size(); ++m) {
+
+        // the projection maps into the viewport, so each tile sees the full camera
+        glViewport(0,m*tileHeight,renderWidth_,tileHeight);
+        glScissor(0,m*tileHeight,renderWidth_,tileHeight);
+
+        setModelViewMatrix(transforms[m]);
+
+        matrixSetup();
+
+        glDrawElements(mode, indexBuffer.num_elements, GL_UNSIGNED_INT, 0);
+
+    }
+
+    indexBuffer.Unbind();
+
+    renderTeardown(vertexAttributeBuffers);
+
+}
+
 
 } // namespace df
@@ -106,6 +106,84 @@ Sophus::SE3<Scalar> icp(const DeviceTensor2<Eigen::UnalignedVec3<Scalar> > & liv
 
 }
 
+template <typename Scalar,
+          typename CameraModelT,
+          int DPred>
+std::vector<Sophus::SE3<Scalar> > icpBatch(const DeviceTensor2<Eigen::UnalignedVec3<Scalar> > & liveVertices,
+                                           const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > & predVertices,
+                                           const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > & predNormals,
+                                           const CameraModelT & cameraModel,
+                                           const uint numHypotheses,
+                                           const Eigen::Matrix<Scalar,2,1> & depthRange,
+                                           const Scalar maxError,
+                                           const uint numIterations,
+                                           ICPBatchBuffers<Scalar> & buffers,
+                                           std::vector<Scalar> * residuals,
+                                           std::vector<int> * inliers) {
+
+    typedef Sophus::SE3<Scalar> SE3;
+
+    const uint width = liveVertices.dimensionSize(0);
+    const uint height = liveVertices.dimensionSize(1);
+
+    assert(predVertices.dimensionSize(0) == width);
+    assert(predVertices.dimensionSize(1) == numHypotheses*height);
+    assert(predNormals.dimensionSize(0) == width);
+    assert(predNormals.dimensionSize(1) == numHypotheses*height);
+
+    const dim3 grid(128,8,1);
+    const dim3 block(intDivideAndCeil(width,grid.x),intDivideAndCeil(height,grid.y));
+
+    std::vector<SE3> accumulatedUpdates(numHypotheses);
+    std::vector<internal::LinearSystem<Scalar,6> > systems(numHypotheses);
+
+    for (uint iter = 0; iter < numIterations; ++iter) {
+
+        internal::icpBatchIteration(liveVertices,
+                                    predVertices,
+                                    predNormals,
+                                    cameraModel,
+                                    accumulatedUpdates,
+                                    depthRange,maxError,
+                                    grid,block,
+                                    buffers,
+                                    &systems,
+                                    (std::vector<Scalar> *)nullptr,
+                                    (std::vector<int> *)nullptr);
+
+        for (uint k = 0; k < numHypotheses; ++k) {
+
+            Eigen::Matrix<Scalar,6,6,Eigen::DontAlign> fullJTJ = internal::SquareMatrixReconstructor<Scalar,6>::reconstruct(systems[k].JTJ);
+
+            Eigen::Matrix<Scalar,6,1> solution = fullJTJ.template selfadjointView<Eigen::Upper>().ldlt().solve(systems[k].JTr);
+
+            accumulatedUpdates[k] = SE3::exp(solution)*accumulatedUpdates[k];
+
+        }
+
+    }
+
+    // score the hypotheses at their final poses
+    if (residuals && inliers) {
+        residuals->resize(numHypotheses);
+        inliers->resize(numHypotheses);
+        internal::icpBatchIteration(liveVertices,
+                                    predVertices,
+                                    predNormals,
+                                    cameraModel,
+                                    accumulatedUpdates,
+                                    depthRange,maxError,
+                                    grid,block,
+                                    buffers,
+                                    (std::vector<internal::LinearSystem<Scalar,6> > *)nullptr,
+                                    residuals,
+                                    inliers);
+    }
+
+    return accumulatedUpdates;
+
+}
+
 template Sophus::SE3f icp(const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
                           const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
                           const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
@@ -145,5 +223,29 @@ template Sophus::SE3f icp(const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
                           const uint,
                           DeviceTensor2<Eigen::UnalignedVec4<uchar> >);
 
+template std::vector<Sophus::SE3f> icpBatch(const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
+                                            const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
+                                            const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
+                                            const Poly3CameraModel<float> &,
+                                            const uint,
+                                            const Eigen::Vector2f &,
+                                            const float,
+                                            const uint,
+                                            ICPBatchBuffers<float> &,
+                                            std::vector<float> *,
+                                            std::vector<int> *);
+
+template std::vector<Sophus::SE3f> icpBatch(const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
+                                            const DeviceTensor2<Eigen::UnalignedVec4<float> > &,
+                                            const DeviceTensor2<Eigen::UnalignedVec4<float> > &,
+                                            const Poly3CameraModel<float> &,
+                                            const uint,
+                                            const Eigen::Vector2f &,
+                                            const float,
+                                            const uint,
+                                            ICPBatchBuffers<float> &,
+                                            std::vector<float> *,
+                                            std::vector<int> *);
+
 
 } // namespace df
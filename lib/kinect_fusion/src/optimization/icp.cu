@@ -14,6 +14,8 @@
 
 #include <Eigen/Core>
 
+#include <limits>
+
 namespace df {
 
 
@@ -21,16 +23,16 @@ template <typename Scalar,
           typename CameraModelT,
           int DPred,
           typename ... DebugArgsT>
-__global__ void icpKernel(internal::JacobianAndResidual<Scalar,1,6> * jacobiansAndResiduals,
-                          const DeviceTensor2<Eigen::UnalignedVec3<Scalar> > liveVertices,
-                          const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > predictedVertices,
-                          const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > predictedNormals,
-                          const CameraModelT cameraModel,
-                          const Sophus::SE3<Scalar> updatedPose,
-                          const Eigen::Matrix<Scalar,6,1> initialPose,
-                          const Eigen::Matrix<Scalar,2,1> depthRange,
-                          const Scalar maxError,
-                          DebugArgsT ... debugArgs) {
+__device__ inline void icpPixel(internal::JacobianAndResidual<Scalar,1,6> & jacobianAndResidual,
+                                const uint x, const uint y,
+                                const DeviceTensor2<Eigen::UnalignedVec3<Scalar> > & liveVertices,
+                                const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > & predictedVertices,
+                                const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > & predictedNormals,
+                                const CameraModelT & cameraModel,
+                                const Sophus::SE3<Scalar> & updatedPose,
+                                const Eigen::Matrix<Scalar,2,1> & depthRange,
+                                const Scalar maxError,
+                                DebugArgsT ... debugArgs) {
 
     typedef Eigen::Matrix<Scalar,DPred,1,Eigen::DontAlign> VecD;
     typedef Eigen::Matrix<Scalar,3,1,Eigen::DontAlign> Vec3;
@@ -39,103 +41,186 @@ __global__ void icpKernel(internal::JacobianAndResidual<Scalar,1,6> * jacobiansA
     static constexpr Scalar border = Scalar(2); // TODO
     static constexpr Scalar rayNormDotThreshold = Scalar(0.1); // TODO
 
-    const uint x = threadIdx.x + blockIdx.x * blockDim.x;
-    const uint y = threadIdx.y + blockIdx.y * blockDim.y;
-
     const uint width = liveVertices.dimensionSize(0);
     const uint height = liveVertices.dimensionSize(1);
 
-    // TODO: template for guaranteed in-bound blocking
-    if (x < width && y < height) {
+    // TODO: take care of this with a memset?
+    jacobianAndResidual.J = Eigen::Matrix<Scalar,1,6>::Zero();
+    jacobianAndResidual.r = 0;
 
-        // TODO: take care of this with a memset?
-        jacobiansAndResiduals[x + width*y].J = Eigen::Matrix<Scalar,1,6>::Zero();
-        jacobiansAndResiduals[x + width*y].r = 0;
+    const VecD & predictedVertex = predictedVertices(x,y);
 
-        const VecD & predictedVertex = predictedVertices(x,y);
+    const Scalar predictedDepth = predictedVertex(2);
 
-        const Scalar predictedDepth = predictedVertex(2);
+    if ((predictedDepth < depthRange(0)) || predictedDepth > depthRange(1)) {
 
-        if ((predictedDepth < depthRange(0)) || predictedDepth > depthRange(1)) {
+        PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(255,255,0,255),debugArgs...);
 
-            PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(255,255,0,255),debugArgs...);
+        return;
+    }
 
-            return;
-        }
+    const Vec3 updatedPredVertex = updatedPose * predictedVertex.template head<3>();
 
-        const Vec3 updatedPredVertex = updatedPose * predictedVertex.template head<3>();
+    const Vec2 projectedPredVertex = cameraModel.project(updatedPredVertex);
 
-        const Vec2 projectedPredVertex = cameraModel.project(updatedPredVertex);
+    //            const Vec2 projectedPredVertex  (updatedPredVertex(0)/updatedPredVertex(2)*cameraModel.params()[0] + cameraModel.params()[2],
+    //                                             updatedPredVertex(1)/updatedPredVertex(2)*cameraModel.params()[1] + cameraModel.params()[3]);
+    //            if ( x > 200 && x < 220 && y > 200 && y < 220) {
+    //                printf("(%d,%d) -> (%f,%f)\n",x,y,projectedPredVertex(0),projectedPredVertex(1));
+    //            }
 
-        //            const Vec2 projectedPredVertex  (updatedPredVertex(0)/updatedPredVertex(2)*cameraModel.params()[0] + cameraModel.params()[2],
-        //                                             updatedPredVertex(1)/updatedPredVertex(2)*cameraModel.params()[1] + cameraModel.params()[3]);
-        //            if ( x > 200 && x < 220 && y > 200 && y < 220) {
-        //                printf("(%d,%d) -> (%f,%f)\n",x,y,projectedPredVertex(0),projectedPredVertex(1));
-        //            }
+    // TODO: interpolate?
+    const int u = projectedPredVertex(0) + Scalar(0.5);
+    const int v = projectedPredVertex(1) + Scalar(0.5);
 
-        // TODO: interpolate?
-        const int u = projectedPredVertex(0) + Scalar(0.5);
-        const int v = projectedPredVertex(1) + Scalar(0.5);
+    if ( (u <= border) || (u >= (width-1-border)) || (v <= border) || (v >= (height-1-border)) ) {
 
-        if ( (u <= border) || (u >= (width-1-border)) || (v <= border) || (v >= (height-1-border)) ) {
+        PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(0,0,255,255),debugArgs...);
+        return;
 
-            PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(0,0,255,255),debugArgs...);
-            return;
+    }
 
-        }
+    const Vec3 & liveVertex = liveVertices(u,v);
 
-        const Vec3 & liveVertex = liveVertices(u,v);
+    const Scalar liveDepth = liveVertex(2);
 
-        const Scalar liveDepth = liveVertex(2);
+    if ((liveDepth < depthRange(0)) || (liveDepth > depthRange(1))) {
 
-        if ((liveDepth < depthRange(0)) || (liveDepth > depthRange(1))) {
+        PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(255,0,255,255),debugArgs...);
+        return;
 
-            PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(255,0,255,255),debugArgs...);
-            return;
+    }
 
-        }
+    // TODO: double-check validity of this method of getting the ray
+    const Vec3 ray = updatedPredVertex.normalized();
 
-        // TODO: double-check validity of this method of getting the ray
-        const Vec3 ray = updatedPredVertex.normalized();
+    const VecD & predictedNormal = predictedNormals(x,y);
 
-        const VecD & predictedNormal = predictedNormals(x,y);
+    if (-ray.dot(predictedNormal.template head<3>()) < rayNormDotThreshold) {
 
-        if (-ray.dot(predictedNormal.template head<3>()) < rayNormDotThreshold) {
+        PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(255,0,0,255),debugArgs...);
+        return;
 
-            PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(255,0,0,255),debugArgs...);
-            return;
+    }
 
-        }
+    const Scalar error = predictedNormal.template head<3>().dot(liveVertex - updatedPredVertex);
 
-        const Scalar error = predictedNormal.template head<3>().dot(liveVertex - updatedPredVertex);
+    const Scalar absError = fabs(error);
 
-        const Scalar absError = fabs(error);
+    if (absError > maxError) {
 
-        if (absError > maxError) {
+        PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(0,255,0,255),debugArgs...);
+        return;
 
-            PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(0,255,0,255),debugArgs...);
-            return;
+    }
 
-        }
+    const Scalar weightSqrt = Scalar(1) / (liveDepth);
 
-        const Scalar weightSqrt = Scalar(1) / (liveDepth);
+    const Eigen::Matrix<Scalar,1,3> dError_dUpdatedPredictedPoint = predictedNormal.template head<3>().transpose();
+    Eigen::Matrix<Scalar,3,6> dUpdatedPredictedPoint_dUpdate;
+    dUpdatedPredictedPoint_dUpdate << 1, 0, 0,                     0,  updatedPredVertex(2), -updatedPredVertex(1),
+                                      0, 1, 0, -updatedPredVertex(2),                     0,  updatedPredVertex(0),
+                                      0, 0, 1,  updatedPredVertex(1), -updatedPredVertex(0),                     0;
 
-        const Eigen::Matrix<Scalar,1,3> dError_dUpdatedPredictedPoint = predictedNormal.template head<3>().transpose();
-        Eigen::Matrix<Scalar,3,6> dUpdatedPredictedPoint_dUpdate;
-        dUpdatedPredictedPoint_dUpdate << 1, 0, 0,                     0,  updatedPredVertex(2), -updatedPredVertex(1),
-                                          0, 1, 0, -updatedPredVertex(2),                     0,  updatedPredVertex(0),
-                                          0, 0, 1,  updatedPredVertex(1), -updatedPredVertex(0),                     0;
+    jacobianAndResidual.J = weightSqrt * dError_dUpdatedPredictedPoint * dUpdatedPredictedPoint_dUpdate;
+    jacobianAndResidual.r = weightSqrt * error;
 
-        jacobiansAndResiduals[x + width*y].J = weightSqrt * dError_dUpdatedPredictedPoint * dUpdatedPredictedPoint_dUpdate;
-        jacobiansAndResiduals[x + width*y].r = weightSqrt * error;
+    const uchar gray = min(Scalar(255),255 * absError / maxError );
+    PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(gray,gray,gray,255),debugArgs...);
 
-        const uchar gray = min(Scalar(255),255 * absError / maxError );
-        PixelDebugger<DebugArgsT...>::debugPixel(Eigen::Vector2i(x,y),Eigen::UnalignedVec4<uchar>(gray,gray,gray,255),debugArgs...);
+}
+
+template <typename Scalar,
+          typename CameraModelT,
+          int DPred,
+          typename ... DebugArgsT>
+__global__ void icpKernel(internal::JacobianAndResidual<Scalar,1,6> * jacobiansAndResiduals,
+                          const DeviceTensor2<Eigen::UnalignedVec3<Scalar> > liveVertices,
+                          const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > predictedVertices,
+                          const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > predictedNormals,
+                          const CameraModelT cameraModel,
+                          const Sophus::SE3<Scalar> updatedPose,
+                          const Eigen::Matrix<Scalar,6,1> initialPose,
+                          const Eigen::Matrix<Scalar,2,1> depthRange,
+                          const Scalar maxError,
+                          DebugArgsT ... debugArgs) {
+
+    const uint x = threadIdx.x + blockIdx.x * blockDim.x;
+    const uint y = threadIdx.y + blockIdx.y * blockDim.y;
+
+    const uint width = liveVertices.dimensionSize(0);
+    const uint height = liveVertices.dimensionSize(1);
+
+    // TODO: template for guaranteed in-bound blocking
+    if (x < width && y < height) {
+
+        icpPixel(jacobiansAndResiduals[x + width*y], x, y,
+                 liveVertices, predictedVertices, predictedNormals,
+                 cameraModel, updatedPose, depthRange, maxError, debugArgs ...);
 
     }
 
 }
 
+// one hypothesis per grid layer, the predictions of hypothesis z are the rows [z*height, (z+1)*height)
+template <typename Scalar,
+          typename CameraModelT,
+          int DPred>
+__global__ void icpBatchKernel(internal::JacobianAndResidual<Scalar,1,6> * jacobiansAndResiduals,
+                               const DeviceTensor2<Eigen::UnalignedVec3<Scalar> > liveVertices,
+                               const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > predictedVertices,
+                               const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > predictedNormals,
+                               const CameraModelT cameraModel,
+                               const Sophus::SE3<Scalar> * updatedPoses,
+                               const Eigen::Matrix<Scalar,2,1> depthRange,
+                               const Scalar maxError) {
+
+    const uint x = threadIdx.x + blockIdx.x * blockDim.x;
+    const uint y = threadIdx.y + blockIdx.y * blockDim.y;
+    const uint z = blockIdx.z;
+
+    const uint width = liveVertices.dimensionSize(0);
+    const uint height = liveVertices.dimensionSize(1);
+
+    if (x < width && y < height) {
+
+        const uint offset = z*width*height;
+        const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > tileVertices(liveVertices.dimensions(),
+            const_cast<Eigen::UnalignedVec<Scalar,DPred> *>(predictedVertices.data()) + offset);
+        const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > tileNormals(liveVertices.dimensions(),
+            const_cast<Eigen::UnalignedVec<Scalar,DPred> *>(predictedNormals.data()) + offset);
+
+        icpPixel(jacobiansAndResiduals[offset + x + width*y], x, y,
+                 liveVertices, tileVertices, tileNormals,
+                 cameraModel, updatedPoses[z], depthRange, maxError);
+
+    }
+
+}
+
+// squared residual and 1 for the pixels that passed all association tests, the kernel zeroes the others
+template <typename Scalar>
+struct ResidualStatisticsFunctor {
+
+    __attribute__((always_inline)) __host__ __device__
+    Eigen::Matrix<Scalar,2,1,Eigen::DontAlign> operator()(const internal::JacobianAndResidual<Scalar,1,6> & jacobianAndResidual) {
+        const Scalar valid = jacobianAndResidual.J.squaredNorm() > Scalar(0) ? Scalar(1) : Scalar(0);
+        return Eigen::Matrix<Scalar,2,1,Eigen::DontAlign>(jacobianAndResidual.r*jacobianAndResidual.r, valid);
+    }
+
+};
+
+template <typename Scalar>
+struct ResidualStatisticsSumFunctor {
+
+    __attribute__((always_inline)) __host__ __device__
+    Eigen::Matrix<Scalar,2,1,Eigen::DontAlign> operator()(const Eigen::Matrix<Scalar,2,1,Eigen::DontAlign> & lhs,
+                                                         const Eigen::Matrix<Scalar,2,1,Eigen::DontAlign> & rhs) {
+        return lhs + rhs;
+    }
+
+};
+
 namespace internal {
 
 template <typename Scalar,
@@ -291,6 +376,106 @@ template LinearSystem<float,6> icpIteration(const DeviceTensor2<Eigen::Unaligned
                                             const dim3, const dim3,                                                                                         \
                                             DeviceTensor2<Eigen::UnalignedVec4<uchar> >);
 
+template <typename Scalar,
+          typename CameraModelT,
+          int DPred>
+void icpBatchIteration(const DeviceTensor2<Eigen::UnalignedVec3<Scalar> > & liveVertices,
+                       const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > & predVertices,
+                       const DeviceTensor2<Eigen::UnalignedVec<Scalar,DPred> > & predNormals,
+                       const CameraModelT & cameraModel,
+                       const std::vector<Sophus::SE3<Scalar> > & predictionPoses,
+                       const Eigen::Matrix<Scalar,2,1> & depthRange,
+                       const Scalar maxError,
+                       const dim3 grid,
+                       const dim3 block,
+                       ICPBatchBuffers<Scalar> & buffers,
+                       std::vector<LinearSystem<Scalar,6> > * systems,
+                       std::vector<Scalar> * residuals,
+                       std::vector<int> * inliers) {
+
+    const uint numHypotheses = predictionPoses.size();
+    const uint count = liveVertices.count();
+
+    // the buffers only grow, so a sequence of batches allocates once
+    if (buffers.jacobiansAndResiduals.count() < numHypotheses*count) {
+        buffers.jacobiansAndResiduals.resize(numHypotheses*count);
+    }
+    if (buffers.poses.count() < numHypotheses) {
+        buffers.poses.resize(numHypotheses);
+    }
+    cudaMemcpy(buffers.poses.data(), predictionPoses.data(), numHypotheses*sizeof(Sophus::SE3<Scalar>), cudaMemcpyHostToDevice);
+
+    thrust::device_ptr<JacobianAndResidual<Scalar,1,6> > jacobiansAndResiduals = thrust::device_pointer_cast(buffers.jacobiansAndResiduals.data());
+
+    GlobalTimer::tick("icpBatchKernel");
+    cudaFuncSetCacheConfig(icpBatchKernel<Scalar,CameraModelT,DPred>, cudaFuncCachePreferL1);
+    icpBatchKernel<Scalar><<<dim3(grid.x,grid.y,numHypotheses),block>>>(buffers.jacobiansAndResiduals.data(),
+                                                                      liveVertices,predVertices,predNormals,
+                                                                      cameraModel,
+                                                                      buffers.poses.data(),
+                                                                      depthRange,
+                                                                      maxError);
+
+    cudaDeviceSynchronize();
+    CheckCudaDieOnError();
+    GlobalTimer::tock("icpBatchKernel");
+
+    GlobalTimer::tick("transform_reduce");
+    for (uint k = 0; k < numHypotheses; ++k) {
+
+        if (systems) {
+            (*systems)[k] = thrust::transform_reduce(jacobiansAndResiduals + k*count,
+                                                     jacobiansAndResiduals + (k+1)*count,
+                                                     LinearSystemCreationFunctor<Scalar,1,6>(),
+                                                     LinearSystem<Scalar,6>::zero(),
+                                                     LinearSystemSumFunctor<Scalar,6>());
+        }
+
+        if (residuals) {
+            const Eigen::Matrix<Scalar,2,1,Eigen::DontAlign> statistics =
+                thrust::transform_reduce(jacobiansAndResiduals + k*count,
+                                         jacobiansAndResiduals + (k+1)*count,
+                                         ResidualStatisticsFunctor<Scalar>(),
+                                         Eigen::Matrix<Scalar,2,1,Eigen::DontAlign>::Zero().eval(),
+                                         ResidualStatisticsSumFunctor<Scalar>());
+            (*inliers)[k] = statistics(1);
+            (*residuals)[k] = statistics(1) > 0 ? std::sqrt(statistics(0) / statistics(1)) : std::numeric_limits<Scalar>::infinity();
+        }
+
+    }
+
+    cudaDeviceSynchronize();
+    CheckCudaDieOnError();
+    GlobalTimer::tock("transform_reduce");
+
+}
+
+template void icpBatchIteration(const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
+                                const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
+                                const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
+                                const Poly3CameraModel<float> &,
+                                const std::vector<Sophus::SE3f> &,
+                                const Eigen::Vector2f &,
+                                const float,
+                                const dim3, const dim3,
+                                ICPBatchBuffers<float> &,
+                                std::vector<LinearSystem<float,6> > *,
+                                std::vector<float> *,
+                                std::vector<int> *);
+
+template void icpBatchIteration(const DeviceTensor2<Eigen::UnalignedVec3<float> > &,
+                                const DeviceTensor2<Eigen::UnalignedVec4<float> > &,
+                                const DeviceTensor2<Eigen::UnalignedVec4<float> > &,
+                                const Poly3CameraModel<float> &,
+                                const std::vector<Sophus::SE3f> &,
+                                const Eigen::Vector2f &,
+                                const float,
+                                const dim3, const dim3,
+                                ICPBatchBuffers<float> &,
+                                std::vector<LinearSystem<float,6> > *,
+                                std::vector<float> *,
+                                std::vector<int> *);
+
 } // namespace internal
 
 
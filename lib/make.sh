@@ -21,21 +21,41 @@ cd hough_voting_gpu_layer
 nvcc -std=c++11 -c -o hough_voting_gpu_op.cu.o hough_voting_gpu_op.cu.cc \
 	-I $TF_INC -I$TF_INC/external/nsync/public -D GOOGLE_CUDA=1 -x cu -Xcompiler -fPIC -arch=sm_50
 
-g++ -std=c++11 -shared -o hough_voting_gpu.so hough_voting_gpu_op.cc \
+g++ -std=c++11 -shared -o hough_voting_gpu.so hough_voting_gpu_op.cc -O3 -fopenmp \
 	hough_voting_gpu_op.cu.o -I $TF_INC -I$TF_INC/external/nsync/public -fPIC -lcudart -lcublas -lopencv_imgproc -lopencv_calib3d -lopencv_core -L $CUDA_PATH/lib64 -L$TF_LIB -ltensorflow_framework
 
+g++ -std=c++11 -o test_hough_voting_cpu test_hough_voting_cpu.cpp -O3 -fopenmp && ./test_hough_voting_cpu
+
 cd ..
 echo 'hough_voting_gpu_layer'
 
-cd hough_voting_layer
+cd pose_core
+
+g++ -std=c++11 -c -o Hypothesis.o src/Hypothesis.cpp -I include -I $TF_INC -fPIC
+
+g++ -std=c++11 -c -o thread_rand.o src/thread_rand.cpp -I include -fopenmp -fPIC
+
+g++ -std=c++11 -c -o pose_library.o src/pose_library.cpp -I include -O3 -fPIC
+
+g++ -std=c++11 -c -o mesh_cache.o src/mesh_cache.cpp -I include -O3 -fPIC
 
-g++ -std=c++11 -c -o Hypothesis.o Hypothesis.cpp -fPIC
+g++ -std=c++11 -c -o cpu_rasterizer.o src/cpu_rasterizer.cpp -I include -O3 -fopenmp -fPIC
 
-g++ -std=c++11 -c -o thread_rand.o thread_rand.cpp -fPIC
+ar rcs libpose_core.a Hypothesis.o thread_rand.o pose_library.o mesh_cache.o cpu_rasterizer.o
+
+g++ -std=c++11 -o convert_poses tools/convert_poses.cpp libpose_core.a -I include -O3
+
+g++ -std=c++11 -o build_mesh_cache tools/build_mesh_cache.cpp libpose_core.a -I include -O3 \
+	-lassimp -lopencv_imgcodecs -lopencv_imgproc -lopencv_core
+
+cd ..
+echo 'pose_core'
+
+cd hough_voting_layer
 
 g++ -std=c++11 -shared -o hough_voting.so hough_voting_op.cc \
-	Hypothesis.o thread_rand.o -I $TF_INC -I$TF_INC/external/nsync/public \
-        -fPIC -lcudart -lopencv_imgproc -lopencv_calib3d -lopencv_core -lgomp -lnlopt -L $CUDA_PATH/lib64 -L$TF_LIB -ltensorflow_framework
+	../pose_core/libpose_core.a -I ../pose_core/include -I $TF_INC -I$TF_INC/external/nsync/public \
+        -O3 -fopenmp -fPIC -lcudart -lopencv_imgproc -lopencv_calib3d -lopencv_core -lgomp -lnlopt -L $CUDA_PATH/lib64 -L$TF_LIB -ltensorflow_framework
 
 cd ..
 echo 'hough_voting_layer'
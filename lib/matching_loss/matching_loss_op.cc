@@ -14,10 +14,9 @@ limitations under the License.
 ==============================================================================*/
 
 // Matching Loss Op
+#include <mutex>
 #include "rendering.hpp"
 
-static Render render_;
-
 #include "third_party/eigen3/Eigen/Core"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op.h"
@@ -133,6 +132,8 @@ class MatchingOp : public OpKernel {
     // rendering to compute the loss
     clock_t start = clock();
 
+    // the render context of this op is current on one thread at a time
+    std::lock_guard<std::mutex> lock(mutex_);
     T loss = render_.render(data, labels, rois, num_rois, gt_size, num_classes, width, height, gt, pose, init, bottom_diff, meta_data, num_meta_data);
 
     clock_t stop = clock(); 
@@ -144,6 +145,10 @@ class MatchingOp : public OpKernel {
  private:
   // file names
   std::string filename_model_;
+
+  // headless renderer of this op, keeps its context and model buffers across steps
+  Render render_;
+  std::mutex mutex_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("Matching").Device(DEVICE_CPU).TypeConstraint<float>("T"), MatchingOp<CPUDevice, float>);
@@ -31,11 +31,54 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <opencv2/highgui/highgui.hpp>
-
-#include "properties.h"
 #include "types.h"
 
 
+/**
+ * @brief Streaming least-squares intersection of 2D lines.
+ * 
+ * Accumulates the 2x2 normal equations of a set of lines, each given by a direction and a point on it.
+ * The residual of a line is the distance of the solution to it (scaled by the length of the direction).
+ * Does not allocate memory.
+ */
+struct LineIntersection2D
+{
+	double a11, a12, a22; // normal matrix
+	double b1, b2; // right hand side
+
+	LineIntersection2D() { clear(); }
+
+	void clear() { a11 = a12 = a22 = b1 = b2 = 0; }
+
+	/**
+	 * @brief Adds a line through pt with direction dir.
+	 * 
+	 * @param weight Weight of the squared residual of this line.
+	 */
+	void add(const cv::Point2d& dir, const cv::Point2d& pt, double weight = 1)
+	{
+		double m = -dir.y;
+		double n = dir.x;
+		double b = m * pt.x + n * pt.y;
+
+		a11 += weight * m * m;
+		a12 += weight * m * n;
+		a22 += weight * n * n;
+		b1 += weight * m * b;
+		b2 += weight * n * b;
+	}
+
+	/**
+	 * @brief Solves the normal equations in closed form.
+	 * 
+	 * Falls back to the minimum norm solution (the SVD solution) if the system is ill-conditioned, e.g. all lines are parallel.
+	 * 
+	 * @param center Output, point closest to all lines.
+	 * @return bool False if no line with non-zero weight has been added.
+	 */
+	bool solve(cv::Point2d& center) const;
+};
+
 /**
  * @brief Class that holds a pose hypothesis. 
  * 
@@ -75,7 +118,7 @@ public:
 	 * 
 	 * @param points Correspondences.
 	 */
-	Hypothesis(std::vector<std::pair<cv::Point3d,cv::Point3d>> points);
+	Hypothesis(const std::vector<std::pair<cv::Point3d,cv::Point3d>>& points);
 
         Hypothesis(std::vector<std::pair<cv::Point2d, cv::Point2d>> points);
 	
@@ -99,7 +142,7 @@ public:
 	 * @param points New set of correspondences.
 	 * @return void
 	 */
-	void refine(std::vector<std::pair<cv::Point3d,cv::Point3d>> points);
+	void refine(const std::vector<std::pair<cv::Point3d,cv::Point3d>>& points);
 	
 	/**
 	 * @brief Recalculate the pose using the covariance matrix and means of point correspondences.
@@ -112,7 +155,15 @@ public:
 	void refine(cv::Mat& coV,cv::Point3d pointsA,cv::Point3d pointsB);
 
 
-        cv::Point2d calcCenter(std::vector<std::pair<cv::Point2d, cv::Point2d>> points);
+	/**
+	 * @brief Calculates the 2D center as the least-squares intersection of voting lines and stores it.
+	 * 
+	 * @param points Correspondences, first is the voting direction and second the pixel position.
+	 * @param huberDelta Optional. If larger than zero, the lines are re-weighted with Huber weights of their distance to the center (IRLS).
+	 * @param iterations Optional. Number of IRLS iterations.
+	 * @return cv::Point2d Center.
+	 */
+	cv::Point2d calcCenter(const std::vector<std::pair<cv::Point2d, cv::Point2d>>& points, double huberDelta = 0, int iterations = 3);
 	
 	/**
 	 * @brief Returns the translation vector.
@@ -247,10 +298,10 @@ private:
 	std::vector<std::pair<cv::Point2d,cv::Point2d>> points2D; // point correspondences used to calculated this pose, stored for refinement later
 	
 	/**
-	 * @brief Calculates a pose from 3D-3D point correspondences using the Kabsch algorithm.
+	 * @brief Calculates a pose from 3D-3D point correspondences using Horn's closed-form solution (see rigid_solve.h).
 	 * 
 	 * @param points Point correspondences.
 	 * @return std::pair< cv::Mat, cv::Point3d > 3x3 double rotation matrix and translation vector.
 	 */
-	static std::pair<cv::Mat,cv::Point3d> calcRigidBodyTransform(std::vector<std::pair<cv::Point3d, cv::Point3d>> points);
+	static std::pair<cv::Mat,cv::Point3d> calcRigidBodyTransform(const std::vector<std::pair<cv::Point3d, cv::Point3d>>& points);
 };
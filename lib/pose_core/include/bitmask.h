@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "simd_dispatch.h"
+
+/**
+ * @brief Binary masks packed into 64 bit words, pixel i is bit i % 64 of word i / 64.
+ *
+ * Intersection and union of two masks are computed with one AND/OR and a popcount per 64 pixels,
+ * instead of per-pixel operations on rendered images.
+ */
+
+/**
+ * @brief Number of words of a mask with the given number of pixels.
+ */
+inline int maskWords(int numPixels)
+{
+  return (numPixels + 63) / 64;
+}
+
+/**
+ * @brief Packs a rendered mask or label image, a pixel is set if its first channel is non-zero.
+ *
+ * @param pixels First channel of the first pixel.
+ * @param stride Elements from one pixel to the next.
+ * @param words Output, maskWords(numPixels) words.
+ */
+template <typename T>
+inline void packMask(const T* pixels, int numPixels, int stride, uint64_t* words)
+{
+  const int numWords = maskWords(numPixels);
+  for(int w = 0; w < numWords; w++)
+  {
+    const int begin = w * 64;
+    const int end = begin + 64 < numPixels ? begin + 64 : numPixels;
+
+    uint64_t word = 0;
+    for(int i = begin; i < end; i++)
+      word |= (uint64_t) (pixels[(size_t) i * stride] != 0) << (i - begin);
+    words[w] = word;
+  }
+}
+
+/**
+ * @brief Intersection and union pixel counts of two masks, with the popcount of the target.
+ */
+inline void maskCounts(const uint64_t* a, const uint64_t* b, int numWords, long long& intersection, long long& area)
+{
+  for(int w = 0; w < numWords; w++)
+  {
+    intersection += __builtin_popcountll(a[w] & b[w]);
+    area += __builtin_popcountll(a[w] | b[w]);
+  }
+}
+
+#if defined(SIMD_DISPATCH_POPCNT)
+/**
+ * @brief maskCounts compiled for POPCNT, one instruction per word instead of a call to __popcountdi2.
+ */
+SIMD_TARGET_POPCNT inline void maskCountsPOPCNT(const uint64_t* a, const uint64_t* b, int numWords, long long& intersection, long long& area)
+{
+  for(int w = 0; w < numWords; w++)
+  {
+    intersection += __builtin_popcountll(a[w] & b[w]);
+    area += __builtin_popcountll(a[w] | b[w]);
+  }
+}
+#endif
+
+/**
+ * @brief Intersection over union of two masks of the same size, 0 if both are empty.
+ */
+inline double maskIoU(const uint64_t* a, const uint64_t* b, int numWords)
+{
+  long long intersection = 0;
+  long long area = 0;
+#if defined(SIMD_DISPATCH_POPCNT)
+  if(simdHasPOPCNT())
+    maskCountsPOPCNT(a, b, numWords, intersection, area);
+  else
+#endif
+    maskCounts(a, b, numWords, intersection, area);
+  return area ? (double) intersection / area : 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "mesh_renderer.h"
+
+#define RASTER_TILE_SIZE 32 // pixels per side of the screen tiles triangles are binned into
+#define RASTER_BLOCK_SIZE 8 // pixels per side of the blocks of the hierarchical depth test
+
+/**
+ * @brief Multi-threaded tile based software rasterizer, needs no graphics driver.
+ *
+ * Triangles are set up and binned into screen tiles in parallel, then the tiles are rasterized in
+ * parallel. Within a tile the edge functions are evaluated for 8 pixels at a time (AVX2 when
+ * the CPU supports it), and a triangle is only rasterized in an 8 x 8 block if its nearest point is in front
+ * of the farthest depth of the block. The rasterizer writes a visibility buffer (depth, triangle,
+ * perspective correct barycentrics), attributes are only interpolated for the visible surface.
+ *
+ * Triangles with a vertex in front of the near plane are dropped instead of clipped, both faces
+ * are rendered. Buffers are kept between calls.
+ */
+class CpuRasterizer : public MeshRenderer
+{
+public:
+  void render(const RasterCamera& camera, const std::vector<RenderItem>& items, RenderBuffers& buffers, bool withAttributes = true);
+
+private:
+  struct Triangle
+  {
+    float A[3], B[3], C[3]; // edge functions A x + B y + C, opposite to each vertex, positive inside
+    float invZ[3]; // inverse camera depth of the vertices
+    float invArea; // inverse of the sum of the edge functions
+    float zmin; // nearest vertex
+    int minX, minY, maxX, maxY; // pixel bounding box, clipped to the image
+    int item;
+    int v[3]; // vertex indices, in the order of the edge functions
+  };
+
+  void setup(const RasterCamera& camera, const std::vector<RenderItem>& items);
+  void rasterizeTile(int tile, const RasterCamera& camera);
+  bool rasterizeBlock(const Triangle& tri, int index, int bx, int by, const RasterCamera& camera);
+  bool rasterizeBlockAVX2(const Triangle& tri, int index, int bx, int by, const RasterCamera& camera);
+  void resolve(const RasterCamera& camera, const std::vector<RenderItem>& items, RenderBuffers& buffers, bool withAttributes);
+
+  int paddedWidth_;
+  int paddedHeight_;
+  int tilesX_;
+  int tilesY_;
+
+  std::vector<float> screen_; // x, y and camera z of the vertices of all items
+  std::vector<int> vertexOffsets_; // first vertex and face of each item
+  std::vector<int> faceOffsets_;
+  std::vector<Triangle> triangles_; // one per face of all items, in submission order
+  std::vector<std::vector<std::vector<int> > > bins_; // per thread, per tile: visible triangles
+
+  // visibility buffer, padded to whole tiles
+  std::vector<float> depth_;
+  std::vector<int> triangleIds_;
+  std::vector<float> bary1_;
+  std::vector<float> bary2_;
+  std::vector<float> blockZmax_; // farthest depth per block, FLT_MAX while the block is not fully covered
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <omp.h>
+
+#include "types.h"
+#include "label_index.h"
+
+/**
+ * @brief Camera coordinates of one depth frame, kept by an estimator so its buffers are reused across frames.
+ *
+ * The depth image is back-projected once per frame into an organized point cloud. Depth holes are
+ * stored as (0, 0, 0). For a pinhole camera the viewing ray of pixel (x, y) is ((x - px) / fx, (y - py) / fy, 1),
+ * so the ray table factors into one entry per column and one per row. The tables are rebuilt only when the
+ * image size or the intrinsics change, all buffers keep their capacity between frames.
+ */
+struct DepthCache
+{
+  int width = 0;
+  int height = 0;
+  float fx = 0, fy = 0, px = 0, py = 0; // intrinsics of the ray tables
+  float depth_factor = 0; // raw depth units per meter
+
+  std::vector<float> rayX; // (x - px) / fx for each column
+  std::vector<float> rayY; // (y - py) / fy for each row
+
+  jp::img_coord_t eye; // organized point cloud, height x width
+
+  LabelIndex labels; // pixels of the last label map grouped by class, built by the owner if needed
+
+  /**
+   * @brief Back-projects a depth frame.
+   *
+   * @param depth Raw depth, width x height, row-major. 0 marks a depth hole.
+   * @param depth_factor Raw depth units per meter.
+   */
+  void update(const unsigned short* depth, int width, int height, float fx, float fy, float px, float py, float depth_factor)
+  {
+    if (width != this->width || height != this->height || fx != this->fx || fy != this->fy || px != this->px || py != this->py)
+    {
+      this->width = width;
+      this->height = height;
+      this->fx = fx;
+      this->fy = fy;
+      this->px = px;
+      this->py = py;
+
+      rayX.resize(width);
+      for (int x = 0; x < width; x++)
+        rayX[x] = (x - px) / fx;
+      rayY.resize(height);
+      for (int y = 0; y < height; y++)
+        rayY[y] = (y - py) / fy;
+    }
+    this->depth_factor = depth_factor;
+
+    eye.create(height, width); // no reallocation for frames of the same size
+    const float scale = 1.f / depth_factor;
+
+    #pragma omp parallel for
+    for (int y = 0; y < height; y++)
+    {
+      const unsigned short* d = depth + y * width;
+      const float* rx = rayX.data();
+      const float ry = rayY[y];
+      float* out = reinterpret_cast<float*>(eye[y]);
+
+      // depth holes give z = 0 and hence (0, 0, 0) without a branch
+      #pragma omp simd
+      for (int x = 0; x < width; x++)
+      {
+        float z = d[x] * scale;
+        out[3 * x] = rx[x] * z;
+        out[3 * x + 1] = ry * z;
+        out[3 * x + 2] = z;
+      }
+    }
+  }
+
+  /**
+   * @brief Camera coordinate of a pixel index (y * width + x), the cloud is continuous.
+   */
+  const jp::coord3_t& point(int index) const { return reinterpret_cast<const jp::coord3_t*>(eye.data)[index]; }
+
+  /**
+   * @brief True if the pixel has a valid depth.
+   */
+  bool valid(int index) const { return point(index)[2] > 0; }
+};
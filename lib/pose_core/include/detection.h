@@ -29,7 +29,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "types.h"
 
-int clamp(int val, int min_val, int max_val)
+/**
+ * @brief Clamps a value to the given range.
+ */
+inline int clamp(int val, int min_val, int max_val)
 {
     return std::max(min_val, std::min(max_val, val));
 }
@@ -73,14 +76,19 @@ inline std::vector<cv::Point3f> getBB3D(const cv::Vec<float, 3>& extent)
  * @param bb3D 3D boudning box of the object.
  * @param camMat Camera matrix 3x3 intrinsic camera parameters.
  * @param trans Object pose.
+ * @param fullImage Optional parameter. Return the full image, e.g. for full scene objects.
  * @return cv::Rect 2D bounding box.
  */
 inline cv::Rect getBB2D(
   int imageWidth, int imageHeight,
   const std::vector<cv::Point3f>& bb3D,
   const cv::Mat& camMat,
-  const jp::cv_trans_t& trans)
-{    
+  const jp::cv_trans_t& trans,
+  bool fullImage = false)
+{
+    if(fullImage) // for scenes the 2D bounding box is always the complete image
+	return cv::Rect(0, 0, imageWidth, imageHeight);
+    
     // project 3D bounding box vertices into the image
     std::vector<cv::Point2f> bb2D;
     cv::projectPoints(bb3D, trans.first, trans.second, camMat, cv::Mat(), bb2D);
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "types.h"
+#include "ransac.h"
+#include "ransac_schedule.h"
+#include "Hypothesis.h"
+
+/**
+ * @brief Scoring of hypotheses in the preemptive RANSAC, shared by all pose estimators.
+ *
+ * countInliers looks at a growing random subset of the candidate pixels of a hypothesis, collects
+ * its inlier correspondences and runs the SPRT of the schedule. What a pixel contributes is defined
+ * by a policy, so the loop is compiled for each case without runtime switches. A policy derives
+ * from one of the inlier tests below and adds the pixel source of the estimator:
+ *
+ *   int size() const; // number of candidate pixels
+ *   bool correspondence(int ptIdx, correspondence_t& c); // false for pixels to skip, e.g. depth holes
+ */
+
+/**
+ * @brief Inlier test of RGB-D pose hypotheses, object coordinates are transformed into the camera and compared with camera coordinates.
+ */
+struct InlierTest3D
+{
+  typedef std::pair<cv::Point3d, cv::Point3d> correspondence_t; // object coordinate - camera coordinate
+
+  InlierTest3D(const TransHyp& hyp, float inlierThreshold) : inlierThreshold(inlierThreshold)
+  {
+    jp::jp_trans_t pose = jp::cv2our(hyp.pose);
+    trans = Hypothesis(pose.first, pose.second);
+  }
+
+  static std::vector<correspondence_t>& inliers(TransHyp& hyp) { return hyp.inlierPts; }
+
+  bool isInlier(const correspondence_t& c)
+  {
+    return cv::norm(c.second - trans.transform(c.first)) < inlierThreshold;
+  }
+
+  Hypothesis trans;
+  float inlierThreshold; // maximal distance in camera space
+};
+
+/**
+ * @brief Inlier test of RGB pose hypotheses, object coordinates are projected into the image and compared with their pixel.
+ */
+struct InlierTestReprojection
+{
+  typedef std::pair<cv::Point3d, cv::Point2d> correspondence_t; // object coordinate - pixel
+
+  InlierTestReprojection(const TransHyp& hyp, const cv::Mat& camMat, float inlierThreshold) : inlierThreshold(inlierThreshold)
+  {
+    // pinhole projection without distortion, as cv::projectPoints with empty coefficients
+    cv::Mat_<double> rot;
+    cv::Rodrigues(hyp.pose.first, rot);
+    cv::Mat_<double> t;
+    hyp.pose.second.convertTo(t, CV_64F);
+    cv::Mat_<double> K;
+    camMat.convertTo(K, CV_64F);
+
+    for(int r = 0; r < 3; r++)
+    {
+      for(int c = 0; c < 3; c++)
+        R[r][c] = rot(r, c);
+      T[r] = t(r, 0);
+    }
+    fx = K(0, 0);
+    fy = K(1, 1);
+    px = K(0, 2);
+    py = K(1, 2);
+    skew = K(0, 1);
+  }
+
+  static std::vector<correspondence_t>& inliers(TransHyp& hyp) { return hyp.inlierPts3D2D; }
+
+  bool isInlier(const correspondence_t& c)
+  {
+    const cv::Point3d& p = c.first;
+    double x = R[0][0] * p.x + R[0][1] * p.y + R[0][2] * p.z + T[0];
+    double y = R[1][0] * p.x + R[1][1] * p.y + R[1][2] * p.z + T[1];
+    double z = R[2][0] * p.x + R[2][1] * p.y + R[2][2] * p.z + T[2];
+    z = (z != 0) ? 1 / z : 1;
+
+    double u = fx * x * z + skew * y * z + px;
+    double v = fy * y * z + py;
+    return cv::norm(c.second - cv::Point2d(u, v)) < inlierThreshold;
+  }
+
+  double R[3][3]; // rotation
+  double T[3]; // translation
+  double fx, fy, px, py, skew; // intrinsics
+  float inlierThreshold; // maximal reprojection error in pixels
+};
+
+/**
+ * @brief Inlier test of 2D center hypotheses, the line through a pixel along its voting direction has to pass the center.
+ */
+struct InlierTestCenter2D
+{
+  typedef std::pair<cv::Point2d, cv::Point2d> correspondence_t; // voting direction - pixel
+
+  InlierTestCenter2D(const TransHyp& hyp, float inlierThreshold) : center(hyp.center), inlierThreshold(inlierThreshold) {}
+
+  static std::vector<correspondence_t>& inliers(TransHyp& hyp) { return hyp.inlierPts2D; }
+
+  bool isInlier(const correspondence_t& c)
+  {
+    // distance of the center to the line through the pixel along the direction
+    float n1 = -c.first.y;
+    float n2 = c.first.x;
+    float d = fabs(n1 * (center.x - c.second.x) + n2 * (center.y - c.second.y)) / sqrt(n1 * n1 + n2 * n2);
+    return d < inlierThreshold;
+  }
+
+  cv::Point2d center;
+  float inlierThreshold; // maximal distance of the center to the voting line in pixels
+};
+
+/**
+ * @brief Look at a certain number of pixels and check for inliers.
+ *
+ * The number of pixels looked at is increased by pixelBatch in each call. Pixels are chosen by
+ * skipping a random number of candidates, so they are spread over the whole candidate list.
+ * The skips are drawn from the random stream of the hypothesis, so the pixels do not depend on
+ * the thread scoring it.
+ *
+ * @param hyp Hypothesis to check. Its inliers are replaced.
+ * @param policy Pixel source and inlier test.
+ * @param pixelBatch Number of pixels that should be ADDITIONALLY looked at.
+ * @param test Sequential probability ratio test, the hypothesis is abandoned if it rejects.
+ * @return long Estimated number of pixels not looked at because the hypothesis was abandoned.
+ */
+template<class Policy>
+long countInliers(TransHyp& hyp, Policy& policy, int pixelBatch, SPRT test)
+{
+  std::vector<typename Policy::correspondence_t>& inlierPts = Policy::inliers(hyp);
+
+  // reset data of last RANSAC iteration
+  inlierPts.clear();
+  hyp.inliers = 0;
+  hyp.rejected = false;
+
+  hyp.effPixels = 0; // num of pixels drawn
+  hyp.maxPixels += pixelBatch; // max num of pixels to be drawn
+
+  int maxPt = policy.size(); // num of candidate pixels
+  float successRate = hyp.maxPixels / (float) maxPt; // probability to accept a pixel
+
+  // the skip until the next accepted pixel is geometrically distributed, it is drawn by inversion
+  double logReject = std::log(1.0 - successRate);
+
+  typename Policy::correspondence_t c;
+  for(unsigned ptIdx = 0; ptIdx < maxPt;)
+  {
+    if(!policy.correspondence(ptIdx, c))
+    {
+      ptIdx++;
+      continue;
+    }
+
+    hyp.effPixels++;
+
+    // inlier check
+    bool inlier = policy.isInlier(c);
+    if(inlier)
+    {
+      inlierPts.push_back(c); // store the correspondence
+      hyp.inliers++; // keep track of the number of inliers (correspondences might be thinned out for speed later)
+    }
+
+    // abandon the hypothesis as soon as it is significantly worse than the best one of its object
+    if(test.reject(inlier))
+    {
+      hyp.rejected = true;
+      return (maxPt - ptIdx) * std::min(1.f, successRate);
+    }
+
+    // advance to the next accepted pixel
+    if(successRate < 1)
+      ptIdx += std::max(1, (int) (std::log(1.0 - hyp.rng.drand(0, 1)) / logReject));
+    else
+      ptIdx++;
+  }
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <omp.h>
+
+/**
+ * @brief Pixel indices of a label map grouped by class (CSR layout).
+ *
+ * The pixels of class c are indices[offsets[c]] ... indices[offsets[c + 1] - 1],
+ * stored in row-major order. Buffers keep their capacity between frames.
+ */
+struct LabelIndex
+{
+  std::vector<int> offsets; // num_classes + 1 entries
+  std::vector<int> indices; // pixel indices (y * width + x), grouped by class
+  std::vector<int> histograms; // per-chunk class counts, num_chunks x num_classes
+
+  int num_classes() const { return offsets.empty() ? 0 : (int) offsets.size() - 1; }
+
+  /**
+   * @brief Number of pixels of the given class.
+   */
+  int size(int cls) const { return offsets[cls + 1] - offsets[cls]; }
+
+  /**
+   * @brief Pointer to the first pixel index of the given class.
+   */
+  const int* data(int cls) const { return indices.data() + offsets[cls]; }
+
+  /**
+   * @brief The i-th pixel index of the given class.
+   */
+  int operator()(int cls, int i) const { return indices[offsets[cls] + i]; }
+
+  /**
+   * @brief Buckets the pixels of a label map by class with a two-pass parallel counting sort.
+   *
+   * The image is split into one contiguous, row-major chunk of pixels per thread. The first
+   * pass builds a class histogram per chunk, a prefix sum turns them into write positions and
+   * the second pass scatters the pixel indices. Pixels of a class stay in row-major order.
+   * Pixels with a label outside [0, num_classes) are ignored.
+   *
+   * @param label_map Label map, width x height, row-major.
+   */
+  void build(const int* label_map, int width, int height, int num_classes)
+  {
+    const int num_pixels = width * height;
+    const int num_chunks = omp_get_max_threads();
+
+    offsets.assign(num_classes + 1, 0);
+    histograms.assign(num_chunks * num_classes, 0);
+
+    // pass 1: per-chunk histograms
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < num_chunks; t++)
+    {
+      int begin = (long long) num_pixels * t / num_chunks;
+      int end = (long long) num_pixels * (t + 1) / num_chunks;
+      int* hist = histograms.data() + t * num_classes;
+
+      for (int i = begin; i < end; i++)
+      {
+        int label = label_map[i];
+        if (label >= 0 && label < num_classes)
+          hist[label]++;
+      }
+    }
+
+    // prefix sum, class-major then chunk, so that each class stays in row-major order
+    int total = 0;
+    for (int c = 0; c < num_classes; c++)
+    {
+      offsets[c] = total;
+      for (int t = 0; t < num_chunks; t++)
+      {
+        int count = histograms[t * num_classes + c];
+        histograms[t * num_classes + c] = total;
+        total += count;
+      }
+    }
+    offsets[num_classes] = total;
+    indices.resize(total);
+
+    // pass 2: scatter pixel indices
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < num_chunks; t++)
+    {
+      int begin = (long long) num_pixels * t / num_chunks;
+      int end = (long long) num_pixels * (t + 1) / num_chunks;
+      int* pos = histograms.data() + t * num_classes;
+
+      for (int i = begin; i < end; i++)
+      {
+        int label = label_map[i];
+        if (label >= 0 && label < num_classes)
+          indices[pos[label]++] = i;
+      }
+    }
+  }
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+#define MESH_CACHE_MAGIC "MESHCCH" // first 8 bytes of a mesh cache, including the terminating zero
+#define MESH_CACHE_VERSION 1
+#define MESH_CACHE_SUFFIX ".cache" // the cache of a model file lives next to it
+
+/**
+ * @brief Triangle mesh with everything the renderers upload, as built from a model file.
+ *
+ * Attributes are stored as separate arrays because the renderers bind one GL buffer per attribute.
+ */
+struct MeshData
+{
+  std::vector<float> positions; // 3 per vertex
+  std::vector<float> normals; // 3 per vertex, empty if the mesh has none
+  std::vector<float> texCoords; // 2 per vertex, v already flipped for OpenGL, empty if the mesh has none
+  std::vector<float> colors; // 3 per vertex, empty if the mesh has no vertex colors
+  std::vector<uint32_t> indices; // 3 per triangle
+  std::vector<uint8_t> texture; // decoded RGB texture, top row first, empty if untextured
+  int textureWidth = 0;
+  int textureHeight = 0;
+  float extentsMin[3] = {0, 0, 0}; // bounding box of the vertices
+  float extentsMax[3] = {0, 0, 0};
+};
+
+/**
+ * @brief Header of a mesh cache file.
+ *
+ * The header is followed by the sections, each aligned to 16 bytes and addressed by its byte
+ * offset from the start of the file, 0 marks an absent section:
+ *
+ *   float positions[numVertices][3];
+ *   float normals[numVertices][3];
+ *   float texCoords[numVertices][2];
+ *   float colors[numVertices][3];
+ *   uint32_t indices[numFaces][3];
+ *   uint8_t texture[textureHeight][textureWidth][3];
+ */
+struct MeshCacheHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t numVertices;
+  uint32_t numFaces;
+  uint32_t textureWidth;
+  uint32_t textureHeight;
+  uint32_t reserved;
+  uint64_t sourceSize; // size and modification time of the model file the cache was built from
+  int64_t sourceTime;
+  float extentsMin[3];
+  float extentsMax[3];
+  uint64_t positions;
+  uint64_t normals;
+  uint64_t texCoords;
+  uint64_t colors;
+  uint64_t indices;
+  uint64_t texture;
+};
+
+/**
+ * @brief Read-only view of a preprocessed mesh.
+ *
+ * A cache file is memory mapped, its arrays go to the GL buffers without any processing and
+ * processes that load the same models share the pages. A mesh that could not be cached is held
+ * in private memory behind the same interface.
+ */
+class MeshCache
+{
+public:
+  MeshCache();
+  ~MeshCache();
+
+  /**
+   * @brief Memory maps a mesh cache.
+   *
+   * @param source Model file the cache was built from. If it exists, the cache is only used if
+   * it was built from the current version of the file.
+   * @return bool False if the cache is missing, stale or corrupt.
+   */
+  bool open(const std::string& filename, const std::string& source = "");
+
+  /**
+   * @brief Takes over a mesh held in memory, the contents of mesh are moved.
+   */
+  void assign(MeshData& mesh);
+
+  /**
+   * @brief Writes a mesh cache, atomically so concurrent processes never see a partial file.
+   *
+   * @param source Model file the mesh was built from, recorded to detect stale caches.
+   */
+  static bool write(const std::string& filename, const MeshData& mesh, const std::string& source);
+
+  void close();
+
+  int numVertices() const { return numVertices_; }
+  int numFaces() const { return numFaces_; }
+
+  const float* positions() const { return positions_; }
+  const float* normals() const { return normals_; } // NULL if absent
+  const float* texCoords() const { return texCoords_; } // NULL if absent
+  const float* colors() const { return colors_; } // NULL if absent
+  const uint32_t* indices() const { return indices_; }
+
+  bool hasTexture() const { return texture_ != NULL; }
+  const uint8_t* texture() const { return texture_; } // RGB, top row first
+  int textureWidth() const { return textureWidth_; }
+  int textureHeight() const { return textureHeight_; }
+
+  const float* extentsMin() const { return extentsMin_; }
+  const float* extentsMax() const { return extentsMax_; }
+
+private:
+  MeshCache(const MeshCache&);
+  MeshCache& operator=(const MeshCache&);
+
+  void point(const MeshData& mesh);
+
+  int numVertices_;
+  int numFaces_;
+  const float* positions_;
+  const float* normals_;
+  const float* texCoords_;
+  const float* colors_;
+  const uint32_t* indices_;
+  const uint8_t* texture_;
+  int textureWidth_;
+  int textureHeight_;
+  float extentsMin_[3];
+  float extentsMax_[3];
+
+  void* mapping_; // memory map of a cache file, NULL for meshes in memory
+  size_t mappingSize_;
+  MeshData owned_; // storage of meshes in memory
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "mesh_cache.h"
+
+/**
+ * @brief Imports a model file with assimp and decodes its diffuse texture.
+ *
+ * The model has to contain a single triangle mesh. Texture coordinates are flipped vertically
+ * for OpenGL, normals are generated if the file has none. Throws std::runtime_error on failure.
+ */
+inline void importMesh(const std::string& filename, MeshData& mesh)
+{
+  const struct aiScene* scene = aiImportFile(filename.c_str(), aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals);
+  if(scene == 0)
+    throw std::runtime_error("error: " + std::string(aiGetErrorString()));
+
+  if(scene->mNumMeshes != 1)
+  {
+    const int nMeshes = scene->mNumMeshes;
+    aiReleaseImport(scene);
+    throw std::runtime_error("there are " + std::to_string(nMeshes) + " meshes in " + filename);
+  }
+
+  // the diffuse texture is stored relative to the model file
+  std::string textureName;
+  for(unsigned int i = 0; i < scene->mNumMaterials; ++i)
+  {
+    aiMaterial* material = scene->mMaterials[i];
+    if(material->GetTextureCount(aiTextureType_DIFFUSE))
+    {
+      aiString path;
+      material->GetTexture(aiTextureType_DIFFUSE, 0, &path);
+      textureName = filename.substr(0, filename.find_last_of('/') + 1) + std::string(path.C_Str());
+    }
+  }
+
+  const aiMesh* assimpMesh = scene->mMeshes[0];
+  const unsigned int numVertices = assimpMesh->mNumVertices;
+  std::cout << filename << ": " << numVertices << " vertices, " << assimpMesh->mNumFaces << " faces" << std::endl;
+
+  mesh = MeshData();
+  mesh.positions.resize(numVertices * 3);
+  for(unsigned int i = 0; i < numVertices; i++)
+  {
+    const aiVector3D& v = assimpMesh->mVertices[i];
+    mesh.positions[3 * i] = v.x;
+    mesh.positions[3 * i + 1] = v.y;
+    mesh.positions[3 * i + 2] = v.z;
+  }
+
+  if(assimpMesh->HasNormals())
+  {
+    mesh.normals.resize(numVertices * 3);
+    for(unsigned int i = 0; i < numVertices; i++)
+    {
+      const aiVector3D& n = assimpMesh->mNormals[i];
+      mesh.normals[3 * i] = n.x;
+      mesh.normals[3 * i + 1] = n.y;
+      mesh.normals[3 * i + 2] = n.z;
+    }
+  }
+
+  if(assimpMesh->HasTextureCoords(0))
+  {
+    mesh.texCoords.resize(numVertices * 2);
+    for(unsigned int i = 0; i < numVertices; i++)
+    {
+      mesh.texCoords[2 * i] = assimpMesh->mTextureCoords[0][i].x;
+      mesh.texCoords[2 * i + 1] = 1.0 - assimpMesh->mTextureCoords[0][i].y;
+    }
+  }
+
+  if(assimpMesh->mColors[0])
+  {
+    mesh.colors.resize(numVertices * 3);
+    for(unsigned int i = 0; i < numVertices; i++)
+    {
+      const aiColor4D& color = assimpMesh->mColors[0][i];
+      mesh.colors[3 * i] = color.r;
+      mesh.colors[3 * i + 1] = color.g;
+      mesh.colors[3 * i + 2] = color.b;
+    }
+  }
+
+  mesh.indices.resize(assimpMesh->mNumFaces * 3);
+  for(unsigned int i = 0; i < assimpMesh->mNumFaces; i++)
+  {
+    const aiFace& face = assimpMesh->mFaces[i];
+    if(face.mNumIndices != 3)
+    {
+      aiReleaseImport(scene);
+      throw std::runtime_error("not a triangle mesh");
+    }
+    for(int j = 0; j < 3; j++)
+      mesh.indices[3 * i + j] = face.mIndices[j];
+  }
+  aiReleaseImport(scene);
+
+  for(int k = 0; k < 3; k++)
+  {
+    mesh.extentsMin[k] = numVertices ? mesh.positions[k] : 0;
+    mesh.extentsMax[k] = mesh.extentsMin[k];
+  }
+  for(unsigned int i = 0; i < numVertices; i++)
+    for(int k = 0; k < 3; k++)
+    {
+      mesh.extentsMin[k] = std::min(mesh.extentsMin[k], mesh.positions[3 * i + k]);
+      mesh.extentsMax[k] = std::max(mesh.extentsMax[k], mesh.positions[3 * i + k]);
+    }
+
+  // textures are only of use with texture coordinates
+  if(!mesh.texCoords.empty() && !textureName.empty())
+  {
+    std::cout << "loading texture from " << textureName << std::endl;
+    cv::Mat image = cv::imread(textureName, cv::IMREAD_COLOR);
+    if(image.empty())
+      throw std::runtime_error("cannot read texture " + textureName);
+
+    cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
+    mesh.textureWidth = image.cols;
+    mesh.textureHeight = image.rows;
+    mesh.texture.resize(image.total() * 3);
+    for(int r = 0; r < image.rows; r++)
+      std::copy(image.ptr<uint8_t>(r), image.ptr<uint8_t>(r) + image.cols * 3, mesh.texture.begin() + (size_t) r * image.cols * 3);
+  }
+}
+
+/**
+ * @brief Loads a mesh from its cache next to the model file, building the cache on a miss.
+ *
+ * Assimp and the image decoder only run when the cache is missing or older than the model file.
+ * If the cache cannot be written (e.g. a read-only model directory), the imported mesh is used
+ * from private memory.
+ */
+inline void loadMesh(const std::string& filename, MeshCache& mesh)
+{
+  const std::string cacheName = filename + MESH_CACHE_SUFFIX;
+  if(mesh.open(cacheName, filename))
+    return;
+
+  MeshData data;
+  importMesh(filename, data);
+
+  if(MeshCache::write(cacheName, data, filename) && mesh.open(cacheName, filename))
+  {
+    std::cout << "Wrote mesh cache " << cacheName << std::endl;
+    return;
+  }
+
+  std::cout << "Cannot write mesh cache " << cacheName << ", using the imported mesh" << std::endl;
+  mesh.assign(data);
+}
+
+/**
+ * @brief Releases meshes returned by loadMeshes.
+ */
+inline void releaseMeshes(std::vector<MeshCache*>& meshes)
+{
+  for(MeshCache* mesh : meshes)
+    delete mesh;
+  meshes.clear();
+}
+
+/**
+ * @brief Loads the meshes of a model list file, one model file per line, empty lines are skipped.
+ *
+ * Each mesh comes from its cache unless the model file changed, see loadMesh. Meshes already in
+ * the list are released first.
+ */
+inline void loadMeshes(const std::string& filename, std::vector<MeshCache*>& meshes)
+{
+  releaseMeshes(meshes);
+
+  std::ifstream stream(filename);
+  std::string name;
+  while(std::getline(stream, name))
+  {
+    if(name.empty()) continue;
+
+    std::cout << name << std::endl;
+    meshes.push_back(new MeshCache());
+    loadMesh(name, *meshes.back());
+  }
+}
+
+#ifdef GL_UNPACK_ALIGNMENT
+/**
+ * @brief Uploads the decoded RGB texture of a mesh into a texture object (e.g. pangolin::GlTexture).
+ *
+ * Rows of RGB texels are not 4 byte aligned in general, so the unpack alignment is lowered for the upload.
+ */
+template <class Texture>
+void uploadTexture(const MeshCache& mesh, Texture& texture)
+{
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  texture.Reinitialise(mesh.textureWidth(), mesh.textureHeight(), GL_RGB8, true, 0, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid*) mesh.texture());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+#endif
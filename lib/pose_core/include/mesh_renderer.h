@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "mesh_cache.h"
+
+/**
+ * @brief Pinhole camera of a renderer. Pixel (u, v) samples the image point (u, v), i.e. the
+ * principal point is given relative to the pixel centers, like the intrinsics of the datasets.
+ */
+struct RasterCamera
+{
+  int width;
+  int height;
+  float fx, fy;
+  float px, py;
+  float znear, zfar;
+};
+
+/**
+ * @brief A mesh to render in a given pose.
+ */
+struct RenderItem
+{
+  const MeshCache* mesh;
+  float pose[12]; // object to camera transformation, 3 x 4 row major
+  int objectId; // written to the object id buffer, has to be > 0
+};
+
+/**
+ * @brief Outputs of a renderer, one entry per pixel in row major order.
+ *
+ * Pixels not covered by any item have depth 0, object id 0 and zero vertices, normals and colors.
+ */
+struct RenderBuffers
+{
+  std::vector<float> depth; // camera z
+  std::vector<int> objectIds;
+  std::vector<float> vertices; // 3 per pixel, canonical (object frame) coordinates
+  std::vector<float> normals; // 3 per pixel, camera frame
+  std::vector<float> colors; // 3 per pixel, RGB in [0, 1] of the texture or the vertex colors, white if the mesh has neither
+};
+
+/**
+ * @brief Renders depth, object ids, canonical vertices and normals of a list of posed meshes.
+ *
+ * Lets the pose refinement and the losses produce masks and vertex maps without depending on a
+ * particular graphics backend.
+ */
+class MeshRenderer
+{
+public:
+  virtual ~MeshRenderer() {}
+
+  /**
+   * @brief Renders the items, the nearest surface wins.
+   *
+   * @param withAttributes Also fill the vertex, normal and color buffers, otherwise only depth and ids.
+   */
+  virtual void render(const RasterCamera& camera, const std::vector<RenderItem>& items, RenderBuffers& buffers, bool withAttributes = true) = 0;
+};
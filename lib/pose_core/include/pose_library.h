@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+#define POSE_LIBRARY_MAGIC "POSELIB" // first 8 bytes of a binary pose library, including the terminating zero
+#define POSE_LIBRARY_VERSION 1
+#define POSE_RECORD_SIZE 7 // floats per pose: quaternion (w, x, y, z), translation (x, y, z)
+
+/**
+ * @brief Header of a binary pose library.
+ *
+ * File layout, little endian:
+ *
+ *   PoseLibraryHeader
+ *   uint64_t offsets[numClasses + 1]; // first pose of each class, in records
+ *   float poses[offsets[numClasses]][POSE_RECORD_SIZE];
+ */
+struct PoseLibraryHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t numClasses;
+};
+
+/**
+ * @brief Pose samples of each object class, used to render synthetic training images.
+ *
+ * A binary library is memory mapped read-only, so the operating system loads pages on demand
+ * and all processes that open the same file share one copy. The text format (a list of pose
+ * files, one per class, with one pose per line) is still read into private memory, convert it
+ * once with convert_poses to get the fast path.
+ */
+class PoseLibrary
+{
+public:
+  PoseLibrary();
+  ~PoseLibrary();
+
+  /**
+   * @brief Loads a binary pose library or a list of text pose files, whichever the file is.
+   *
+   * @return bool False if the library could not be read, the library is empty then.
+   */
+  bool load(const std::string& filename);
+
+  /**
+   * @brief Memory maps a binary pose library.
+   */
+  bool open(const std::string& filename);
+
+  /**
+   * @brief Reads text pose files, one file per class.
+   */
+  bool loadText(const std::vector<std::string>& filenames);
+
+  /**
+   * @brief Writes the library in the binary format.
+   */
+  bool write(const std::string& filename) const;
+
+  /**
+   * @brief True if the file starts with the magic number of a binary pose library.
+   */
+  static bool isBinary(const std::string& filename);
+
+  void close();
+
+  int numClasses() const { return numClasses_; }
+
+  /**
+   * @brief Number of poses of a class.
+   */
+  int size(int cls) const { return offsets_[cls + 1] - offsets_[cls]; }
+
+  /**
+   * @brief Poses of a class, POSE_RECORD_SIZE floats each.
+   */
+  const float* poses(int cls) const { return poses_ + offsets_[cls] * POSE_RECORD_SIZE; }
+
+private:
+  PoseLibrary(const PoseLibrary&);
+  PoseLibrary& operator=(const PoseLibrary&);
+
+  int numClasses_;
+  const uint64_t* offsets_; // numClasses_ + 1 entries
+  const float* poses_;
+
+  void* mapping_; // memory map of a binary library, NULL for text libraries
+  size_t mappingSize_;
+
+  std::vector<uint64_t> textOffsets_; // storage of text libraries
+  std::vector<float> textPoses_;
+};
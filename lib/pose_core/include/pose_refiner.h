@@ -0,0 +1,349 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <sophus/se3.hpp>
+
+#include "types.h"
+#include "ransac.h"
+
+/**
+ * @brief Gauss-Newton / Levenberg-Marquardt refinement of a pose hypothesis on its inlier correspondences.
+ *
+ * The pose is updated on SE(3) by left multiplication with exp(delta), delta = (translation, rotation)
+ * as in Sophus. Residuals are either reprojection errors of object coordinate - pixel correspondences
+ * (RGB case) or point-to-point distances of object coordinate - camera coordinate correspondences
+ * (RGB-D case). Both have analytic Jacobians, outliers are down-weighted by a robust kernel
+ * (iteratively reweighted least squares). A handful of iterations replaces hundreds of energy
+ * evaluations of the derivative-free NLopt search.
+ */
+
+enum RobustKernel
+{
+  KERNEL_L2, // plain least squares
+  KERNEL_HUBER, // quadratic up to the kernel width, linear beyond
+  KERNEL_CAUCHY // logarithmic, far outliers have almost no influence
+};
+
+/**
+ * @brief Settings of the pose refinement.
+ */
+struct RefineSettings
+{
+  int maxIterations; // maximal number of accepted or rejected steps
+  RobustKernel kernel; // kernel applied to the residual norms
+  double kernelWidth2D; // kernel width of reprojection residuals in pixels
+  double kernelWidth3D; // kernel width of point-to-point residuals in meters
+  double lambda; // initial damping, 0 gives plain Gauss-Newton steps
+  double minStep; // converged if the update is shorter than this
+  double minDecrease; // converged if the cost decreases relatively less than this
+
+  RefineSettings() : maxIterations(10), kernel(KERNEL_HUBER), kernelWidth2D(2), kernelWidth3D(0.005), lambda(1e-4), minStep(1e-8), minDecrease(1e-6) {}
+};
+
+/**
+ * @brief Convergence report of one refinement.
+ */
+struct RefineReport
+{
+  int iterations; // number of steps tried
+  int accepted; // number of steps that decreased the cost
+  double initialCost; // robust cost before the refinement
+  double finalCost; // robust cost after the refinement
+  double meanError; // mean residual norm after the refinement, comparable to the NLopt energies
+  bool converged; // stopped by a convergence criterion instead of the iteration limit
+
+  RefineReport() : iterations(0), accepted(0), initialCost(0), finalCost(0), meanError(0), converged(false) {}
+};
+
+/**
+ * @brief Robust kernel evaluated on a residual norm.
+ *
+ * @param r Residual norm.
+ * @param weight Output parameter. IRLS weight of the residual.
+ * @return double Robust cost of the residual.
+ */
+inline double robustCost(RobustKernel kernel, double width, double r, double& weight)
+{
+  switch(kernel)
+  {
+    case KERNEL_HUBER:
+      if(r <= width)
+      {
+        weight = 1;
+        return 0.5 * r * r;
+      }
+      weight = width / r;
+      return width * (r - 0.5 * width);
+
+    case KERNEL_CAUCHY:
+    {
+      double s = r / width;
+      weight = 1 / (1 + s * s);
+      return 0.5 * width * width * std::log(1 + s * s);
+    }
+
+    default:
+      weight = 1;
+      return 0.5 * r * r;
+  }
+}
+
+/**
+ * @brief Reprojection residuals of object coordinate - pixel correspondences with a pinhole camera.
+ */
+struct ReprojectionResiduals
+{
+  typedef Eigen::Matrix<double, 2, 6> jacobian_t;
+
+  ReprojectionResiduals(const std::vector<std::pair<cv::Point3d, cv::Point2d> >& pts, const cv::Mat& camMat)
+  : pts(pts)
+  {
+    cv::Mat_<double> K;
+    camMat.convertTo(K, CV_64F);
+    fx = K(0, 0);
+    fy = K(1, 1);
+    px = K(0, 2);
+    py = K(1, 2);
+  }
+
+  int size() const { return pts.size(); }
+
+  /**
+   * @brief Residual of correspondence i, optionally with its Jacobian w.r.t. a left update of the pose.
+   *
+   * @return bool False if the point lies behind the camera.
+   */
+  bool residual(const Sophus::SE3d& T, int i, Eigen::Vector2d& r, jacobian_t* J) const
+  {
+    const cv::Point3d& obj = pts[i].first;
+    Eigen::Vector3d p = T * Eigen::Vector3d(obj.x, obj.y, obj.z);
+    if(p(2) <= 0) return false;
+
+    double iz = 1 / p(2);
+    r(0) = fx * p(0) * iz + px - pts[i].second.x;
+    r(1) = fy * p(1) * iz + py - pts[i].second.y;
+
+    if(J)
+    {
+      // projection derivative times d(exp(delta) * p) / d(delta) = [I | -p^]
+      Eigen::Matrix<double, 2, 3> Jp;
+      Jp << fx * iz, 0, -fx * p(0) * iz * iz,
+            0, fy * iz, -fy * p(1) * iz * iz;
+      J->leftCols<3>() = Jp;
+      J->rightCols<3>() = -Jp * Sophus::SO3d::hat(p);
+    }
+    return true;
+  }
+
+  const std::vector<std::pair<cv::Point3d, cv::Point2d> >& pts;
+  double fx, fy, px, py;
+};
+
+/**
+ * @brief Point-to-point residuals of object coordinate - camera coordinate correspondences.
+ */
+struct PointToPointResiduals
+{
+  typedef Eigen::Matrix<double, 3, 6> jacobian_t;
+
+  PointToPointResiduals(const std::vector<std::pair<cv::Point3d, cv::Point3d> >& pts) : pts(pts) {}
+
+  int size() const { return pts.size(); }
+
+  bool residual(const Sophus::SE3d& T, int i, Eigen::Vector3d& r, jacobian_t* J) const
+  {
+    const cv::Point3d& obj = pts[i].first;
+    const cv::Point3d& eye = pts[i].second;
+    Eigen::Vector3d p = T * Eigen::Vector3d(obj.x, obj.y, obj.z);
+    r = p - Eigen::Vector3d(eye.x, eye.y, eye.z);
+
+    if(J)
+    {
+      J->leftCols<3>().setIdentity();
+      J->rightCols<3>() = -Sophus::SO3d::hat(p);
+    }
+    return true;
+  }
+
+  const std::vector<std::pair<cv::Point3d, cv::Point3d> >& pts;
+};
+
+/**
+ * @brief Robust cost of all residuals, optionally with the weighted normal equations.
+ *
+ * @param H Output parameter. J^T W J, only filled if g is given.
+ * @param g Output parameter. J^T W r.
+ * @param errorSum Output parameter. Sum of the residual norms.
+ * @param errorCount Output parameter. Number of residuals in the sum, points behind the camera are skipped.
+ * @return double Robust cost.
+ */
+template<class Residuals>
+double linearize(const Residuals& res, const Sophus::SE3d& T, RobustKernel kernel, double width,
+  Eigen::Matrix<double, 6, 6>* H, Eigen::Matrix<double, 6, 1>* g, double* errorSum = NULL, int* errorCount = NULL)
+{
+  typedef typename Residuals::jacobian_t jacobian_t;
+  Eigen::Matrix<double, jacobian_t::RowsAtCompileTime, 1> r;
+  jacobian_t J;
+
+  if(g)
+  {
+    H->setZero();
+    g->setZero();
+  }
+
+  double cost = 0;
+  double errors = 0;
+  int count = 0;
+  for(int i = 0; i < res.size(); i++)
+  {
+    if(!res.residual(T, i, r, g ? &J : NULL)) continue;
+
+    double norm = r.norm();
+    double weight;
+    cost += robustCost(kernel, width, norm, weight);
+    errors += norm;
+    count++;
+
+    if(g)
+    {
+      H->noalias() += weight * J.transpose() * J;
+      g->noalias() += weight * J.transpose() * r;
+    }
+  }
+
+  if(errorSum) *errorSum = errors;
+  if(errorCount) *errorCount = count;
+  return cost;
+}
+
+/**
+ * @brief Levenberg-Marquardt iterations on SE(3).
+ *
+ * @param T Pose to refine, updated in place.
+ * @param width Kernel width in the unit of the residuals.
+ * @return RefineReport Convergence report.
+ */
+template<class Residuals>
+RefineReport levenbergMarquardt(const Residuals& res, Sophus::SE3d& T, const RefineSettings& settings, double width)
+{
+  RefineReport report;
+  int maxIterations = res.size() < 3 ? 0 : settings.maxIterations; // too few correspondences to constrain the pose
+
+  Eigen::Matrix<double, 6, 6> H;
+  Eigen::Matrix<double, 6, 1> g;
+  double cost = linearize(res, T, settings.kernel, width, &H, &g);
+  report.initialCost = cost;
+
+  double lambda = settings.lambda;
+  while(report.iterations < maxIterations)
+  {
+    report.iterations++;
+
+    // damped normal equations, Marquardt scaling of the diagonal
+    Eigen::Matrix<double, 6, 6> A = H;
+    A.diagonal() += lambda * H.diagonal().cwiseMax(1e-12);
+    Eigen::Matrix<double, 6, 1> delta = -A.ldlt().solve(g);
+
+    if(!delta.allFinite())
+      break;
+    if(delta.norm() < settings.minStep)
+    {
+      report.converged = true;
+      break;
+    }
+
+    Sophus::SE3d candidate = Sophus::SE3d::exp(delta) * T;
+    double newCost = linearize<Residuals>(res, candidate, settings.kernel, width, NULL, NULL);
+
+    if(newCost < cost)
+    {
+      double decrease = (cost - newCost) / std::max(cost, 1e-30);
+      T = candidate;
+      report.accepted++;
+      lambda *= 0.1;
+
+      cost = linearize(res, T, settings.kernel, width, &H, &g);
+      if(decrease < settings.minDecrease)
+      {
+        report.converged = true;
+        break;
+      }
+    }
+    else
+    {
+      // step increased the cost, move towards gradient descent
+      lambda = std::max(lambda * 10, 1e-6);
+    }
+  }
+
+  double errors = 0;
+  int count = 0;
+  report.finalCost = linearize<Residuals>(res, T, settings.kernel, width, NULL, NULL, &errors, &count);
+  report.meanError = count > 0 ? errors / count : 0;
+  return report;
+}
+
+/**
+ * @brief Conversion of a pose in OpenCV format (Rodrigues vector, translation vector) to Sophus.
+ */
+inline Sophus::SE3d cv2sophus(const jp::cv_trans_t& trans)
+{
+  cv::Mat_<double> rot;
+  cv::Rodrigues(trans.first, rot);
+  cv::Mat_<double> t;
+  trans.second.convertTo(t, CV_64F);
+
+  Eigen::Matrix3d R;
+  for(int r = 0; r < 3; r++)
+  for(int c = 0; c < 3; c++)
+    R(r, c) = rot(r, c);
+
+  return Sophus::SE3d(Sophus::SO3d(R), Eigen::Vector3d(t(0, 0), t(1, 0), t(2, 0)));
+}
+
+/**
+ * @brief Conversion of a Sophus pose to OpenCV format (Rodrigues vector, translation vector), written into trans.
+ */
+inline void sophus2cv(const Sophus::SE3d& T, jp::cv_trans_t& trans)
+{
+  Eigen::Matrix3d R = T.rotationMatrix();
+  cv::Mat_<double> rot(3, 3);
+  for(int r = 0; r < 3; r++)
+  for(int c = 0; c < 3; c++)
+    rot(r, c) = R(r, c);
+
+  cv::Mat rvec;
+  cv::Rodrigues(rot, rvec);
+  rvec.convertTo(trans.first, CV_64F);
+
+  trans.second.create(3, 1, CV_64F);
+  for(int i = 0; i < 3; i++)
+    trans.second.at<double>(i, 0) = T.translation()(i);
+}
+
+/**
+ * @brief Refines the pose of a hypothesis on its object coordinate - pixel inliers (RGB case).
+ */
+inline RefineReport refinePoseReprojection(TransHyp& hyp, const cv::Mat& camMat, const RefineSettings& settings)
+{
+  Sophus::SE3d T = cv2sophus(hyp.pose);
+  RefineReport report = levenbergMarquardt(ReprojectionResiduals(hyp.inlierPts3D2D, camMat), T, settings, settings.kernelWidth2D);
+  if(report.accepted > 0) sophus2cv(T, hyp.pose);
+  return report;
+}
+
+/**
+ * @brief Refines the pose of a hypothesis on its object coordinate - camera coordinate inliers (RGB-D case).
+ */
+inline RefineReport refinePosePointToPoint(TransHyp& hyp, const RefineSettings& settings)
+{
+  Sophus::SE3d T = cv2sophus(hyp.pose);
+  RefineReport report = levenbergMarquardt(PointToPointResiduals(hyp.inlierPts), T, settings, settings.kernelWidth3D);
+  if(report.accepted > 0) sophus2cv(T, hyp.pose);
+  return report;
+}
@@ -28,20 +28,25 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 #include "types.h"
+#include "thread_rand.h"
 #include <nlopt.hpp>
 #include <omp.h>
 #include <cfloat>
+#include <map>
+#include <vector>
 
+#ifndef VERTEX_CHANNELS
 #define VERTEX_CHANNELS 3
+#endif
 
     /**
      * @brief Struct that bundels data that is held per pose hypothesis during optimization.
      */
     struct TransHyp
     {
-	TransHyp() {}
-	TransHyp(jp::id_t objID, jp::cv_trans_t pose) : pose(pose), objID(objID), inliers(0), maxPixels(0), effPixels(0), refSteps(0), likelihood(0) {}
-        TransHyp(jp::id_t objID, cv::Point2d center) : center(center), objID(objID), inliers(0), maxPixels(0), effPixels(0), refSteps(0), likelihood(0) {}
+	TransHyp() : rejected(false) {}
+	TransHyp(jp::id_t objID, jp::cv_trans_t pose) : pose(pose), objID(objID), inliers(0), maxPixels(0), effPixels(0), refSteps(0), likelihood(0), rejected(false) {}
+        TransHyp(jp::id_t objID, cv::Point2d center) : center(center), objID(objID), inliers(0), maxPixels(0), effPixels(0), refSteps(0), likelihood(0), rejected(false) {}
       
 	jp::id_t objID; // ID of the object this hypothesis belongs to
 	jp::cv_trans_t pose; // the actual transformation
@@ -54,7 +59,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 	cv::Rect bb; // 2D bounding box of the object under this pose hypothesis
 	
 	std::vector<std::pair<cv::Point3d, cv::Point3d> > inlierPts; // list of object coordinate - camera coordinate correspondences that support this hypothesis
-	std::vector<std::pair<cv::Point2d, cv::Point2d> > inlierPts2D; // list of object coordinate - camera coordinate correspondences that support this hypothesis
+	std::vector<std::pair<cv::Point2d, cv::Point2d> > inlierPts2D; // list of voting direction - pixel correspondences that support this center hypothesis
+	std::vector<std::pair<cv::Point3d, cv::Point2d> > inlierPts3D2D; // list of object coordinate - pixel correspondences that support this hypothesis (RGB case)
 	
 	int maxPixels; // how many pixels should be maximally drawn to score this hyp
 	int effPixels; // how many pixels habe effectively drawn (bounded by projection size)
@@ -63,13 +69,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 	float likelihood; // likelihood of this hypothesis (optimization using uncertainty)
 
 	int refSteps; // how many iterations has this hyp been refined?
+	bool rejected; // abandoned during scoring in the current round of preemptive RANSAC
+
+	Philox rng; // random stream of this hypothesis
 	
 	/**
 	 * @brief Returns a score for this hypothesis used to sort in preemptive RANSAC.
 	 * 
 	 * @return float Score.
 	 */
-	float getScore() const 	{ return inliers; }
+	float getScore() const 	{ return rejected ? -1 : inliers; }
 	
 	/**
 	 * @brief Fraction of inlier pixels as determined by RANSAC.
@@ -85,6 +94,42 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 	 */
 	bool operator < (const TransHyp& hyp) const { return (getScore() > hyp.getScore()); }
 
+	/**
+	 * @brief Re-initializes the hypothesis in place. Keeps the capacity of the inlier buffers.
+	 * 
+	 * @param objID ID of the object this hypothesis belongs to.
+	 * @param center Object center.
+	 */
+	void reset(jp::id_t objID, cv::Point2d center)
+	{
+	  this->objID = objID;
+	  this->center = center;
+	  inliers = 0;
+	  maxPixels = 0;
+	  effPixels = 0;
+	  refSteps = 0;
+	  likelihood = 0;
+	  rejected = false;
+	  inlierPts2D.clear();
+	}
+
+        void compute_width_height()
+        {
+          float w = -1;
+          float h = -1;
+          for(int i = 0; i < inliers; i++)
+          {
+            float x = fabs(inlierPts2D[i].second.x - center.x);
+            float y = fabs(inlierPts2D[i].second.y - center.y);
+            if (x > w)
+              w = x;
+            if (y > h)
+              h = y;
+          }
+          width_ = 2 * w;
+          height_ = 2 * h;
+        }
+
         void compute_width_height(cv::Rect bb2D)
         {
           float w = -1;
@@ -104,15 +149,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
         float compute_distance(const float* vertmap, int num_classes, int width)
         {
+          // inlierPts2D holds a subsample when there are more inliers than the buffer capacity
           float distance = 0;
-          for(int i = 0; i < inliers; i++)
+          for(int i = 0; i < inlierPts2D.size(); i++)
           {
             int x = int(inlierPts2D[i].second.x);
             int y = int(inlierPts2D[i].second.y);
             int offset = VERTEX_CHANNELS * objID + VERTEX_CHANNELS * num_classes * (y * width + x);
             distance += vertmap[offset + 2];
           }
-          return distance / inliers;
+          return distance / inlierPts2D.size();
         }
 
         void compute_box()
@@ -140,3 +186,50 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
           y2_ = y2;
         }
     };
+
+/**
+ * @brief Creates a list of pose hypothesis (potentially belonging to multiple objects) which still have to be processed (e.g. refined).
+ * 
+ * The method includes all remaining hypotheses of an object if there is still more than one, or if there is only one remaining but it still needs to be refined.
+ * 
+ * @param hypMap Map of object ID to a list of hypotheses for that object.
+ * @param maxIt Each hypotheses should be at least this often refined.
+ * @return std::vector< TransHyp* > List of hypotheses to be processed further.
+*/
+inline std::vector<TransHyp*> getWorkingQueue(std::map<jp::id_t, std::vector<TransHyp>>& hypMap, int maxIt)
+{
+  std::vector<TransHyp*> workingQueue;
+      
+  for(auto it = hypMap.begin(); it != hypMap.end(); it++)
+  for(int h = 0; h < it->second.size(); h++)
+    if(it->second.size() > 1 || it->second[h].refSteps < maxIt) //exclude a hypothesis if it is the only one remaining for an object and it has been refined enough already
+      workingQueue.push_back(&(it->second[h]));
+
+  return workingQueue;
+}
+
+/**
+ * @brief Moves the sampled hypotheses into one list per object.
+ * 
+ * Slots are visited in order, so the lists do not depend on the number of threads used for sampling.
+ *
+ * @param sampled Hypothesis slots, objID 0 marks an empty slot. Emptied by this method.
+ * @param hypMap Output parameter. List of hypotheses for each object.
+ * @return void
+*/
+inline void groupByObject(std::vector<TransHyp>& sampled, std::map<jp::id_t, std::vector<TransHyp>>& hypMap)
+{
+  std::map<jp::id_t, int> counts;
+  for(unsigned h = 0; h < sampled.size(); h++)
+    if(sampled[h].objID > 0)
+      counts[sampled[h].objID]++;
+
+  for(std::pair<jp::id_t, int> count : counts)
+    hypMap[count.first].reserve(count.second);
+
+  for(unsigned h = 0; h < sampled.size(); h++)
+    if(sampled[h].objID > 0)
+      hypMap[sampled[h].objID].push_back(std::move(sampled[h]));
+
+  sampled.clear();
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Schedule of the preemptive RANSAC with early termination.
+ *
+ * Two rules are added to the plain halving of the hypotheses in each round:
+ * - A hypothesis is abandoned in the middle of its pixel batch once a sequential probability
+ *   ratio test (Wald's SPRT, as in randomized RANSAC) decides that its inlier rate is below the
+ *   best inlier rate of its object in the previous round.
+ * - If the best hypothesis of an object has clearly more inliers than all others, the others are
+ *   dropped at once instead of halving them round by round.
+ * The schedule also counts the pixel evaluations it saved compared to full batches.
+ */
+struct RansacSchedule
+{
+  bool sprt; // test hypotheses while scoring them
+  float sprtRatio; // inlier rate of a bad hypothesis relative to the best rate of its object
+  float sprtAlpha; // accepted probability to abandon a good hypothesis
+  int sprtMinPixels; // number of pixels a hypothesis is scored on before it can be abandoned
+  float dominance; // keep only the best hypothesis if all others have fewer inliers than this fraction of it, 0 disables
+
+  long evaluated; // pixel evaluations during the last estimation
+  long saved; // estimated pixel evaluations saved during the last estimation
+
+  RansacSchedule() : sprt(true), sprtRatio(0.5f), sprtAlpha(0.01f), sprtMinPixels(50), dominance(0), evaluated(0), saved(0) {}
+
+  void reset()
+  {
+    evaluated = 0;
+    saved = 0;
+  }
+};
+
+/**
+ * @brief Sequential probability ratio test of one hypothesis against the best inlier rate of its object.
+ *
+ * H0: the hypothesis has the best inlier rate e, H1: it has the rate d = sprtRatio * e. The log likelihood
+ * ratio of H1 over H0 is accumulated per pixel and the hypothesis is abandoned when it exceeds log(1 / sprtAlpha).
+ */
+class SPRT
+{
+public:
+  /**
+   * @param schedule Parameters of the test.
+   * @param bestRate Best inlier rate of the object so far, the test is disabled if it is 0.
+   */
+  SPRT(const RansacSchedule& schedule, float bestRate) : llr(0), pixels(0), minPixels(schedule.sprtMinPixels)
+  {
+    enabled = schedule.sprt && bestRate > 0;
+    if(!enabled) return;
+
+    double e = std::min(std::max((double) bestRate, 1e-3), 1 - 1e-3);
+    double d = schedule.sprtRatio * e;
+    llrInlier = std::log(d / e);
+    llrOutlier = std::log((1 - d) / (1 - e));
+    threshold = std::log(1.0 / schedule.sprtAlpha);
+  }
+
+  /**
+   * @brief Adds one scored pixel.
+   *
+   * @return bool True if the hypothesis should be abandoned.
+   */
+  bool reject(bool inlier)
+  {
+    if(!enabled) return false;
+
+    llr += inlier ? llrInlier : llrOutlier;
+    pixels++;
+    return pixels >= minPixels && llr > threshold;
+  }
+
+private:
+  bool enabled;
+  double llr; // accumulated log likelihood ratio
+  double llrInlier; // log likelihood ratio of an inlier
+  double llrOutlier; // log likelihood ratio of an outlier
+  double threshold; // decision threshold of the log likelihood ratio
+  int pixels; // number of pixels added
+  int minPixels;
+};
+
+/**
+ * @brief Returns the hypothesis with the best partial inlier rate if all hypotheses of an object were abandoned.
+ *
+ * The test compares against the best rate of the previous round, so it can abandon every hypothesis of an
+ * object. The returned hypothesis should then be scored on its full batch with the test disabled.
+ *
+ * @param hyps Hypotheses of one object.
+ * @return Hyp* Hypothesis to score again, NULL if at least one hypothesis was not abandoned.
+ */
+template<class Hyp>
+Hyp* abandonedBest(std::vector<Hyp>& hyps)
+{
+  Hyp* best = NULL;
+  for(Hyp& hyp : hyps)
+  {
+    if(!hyp.rejected) return NULL;
+    if(!best || hyp.inliers * (long) best->effPixels > best->inliers * (long) hyp.effPixels)
+      best = &hyp;
+  }
+  return best;
+}
+
+/**
+ * @brief Sorts the hypotheses of one object by score and keeps the better half.
+ *
+ * Abandoned hypotheses are dropped as well, and all but the best one if it dominates the others.
+ * At least one hypothesis is kept.
+ *
+ * @param hyps Hypotheses of one object. Abandoned hypotheses have to score lower than all others.
+ * @param schedule Parameters of the schedule.
+ * @param nextPixels Pixels each kept hypothesis would be scored on in the next round.
+ * @return long Estimated pixel evaluations saved by dropping hypotheses early.
+ */
+template<class Hyp>
+long discardHypotheses(std::vector<Hyp>& hyps, const RansacSchedule& schedule, int nextPixels)
+{
+  if(hyps.size() <= 1) return 0;
+
+  std::sort(hyps.begin(), hyps.end());
+
+  int keep = hyps.size() / 2;
+  while(keep > 1 && hyps[keep - 1].rejected)
+    keep--;
+
+  if(schedule.dominance > 0 && hyps[0].inliers > 0 && hyps[1].inliers < schedule.dominance * hyps[0].inliers)
+    keep = 1;
+
+  long saved = (long) (hyps.size() / 2 - keep) * nextPixels;
+  hyps.erase(hyps.begin() + keep, hyps.end());
+  return saved;
+}
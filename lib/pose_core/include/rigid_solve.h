@@ -0,0 +1,225 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <opencv2/opencv.hpp>
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+
+/**
+ * @brief Closed-form rigid body transformations from 3D-3D point correspondences.
+ *
+ * Uses Horn's quaternion method on fixed-size Eigen types: the rotation is the eigenvector of
+ * the largest eigenvalue of a symmetric 4x4 matrix built from the 3x3 covariance of the
+ * correspondences. The result is always a proper rotation, and nothing is allocated on the heap.
+ */
+#define RIGID_DIRECT_CONDITION 1e-4 // smallest ratio of the second to the largest squared singular value solved in closed form
+
+namespace rigid
+{
+  typedef std::pair<cv::Point3d, cv::Point3d> correspondence_t;
+
+  /**
+   * @brief Rotation and translation that map the first point of each correspondence onto the second: b = R * a + t.
+   */
+  struct Transform
+  {
+    Eigen::Matrix3d R;
+    Eigen::Vector3d t;
+
+    /**
+     * @brief Inverse rotation, R is orthonormal.
+     */
+    Eigen::Matrix3d invR() const { return R.transpose(); }
+  };
+
+  /**
+   * @brief Non-owning view of contiguous correspondences.
+   */
+  struct Span
+  {
+    const correspondence_t* data;
+    size_t size;
+
+    Span(const correspondence_t* data, size_t size) : data(data), size(size) {}
+    Span(const std::vector<correspondence_t>& points) : data(points.data()), size(points.size()) {}
+
+    const correspondence_t& operator[](size_t i) const { return data[i]; }
+  };
+
+  /**
+   * @brief Calculates the transformation from the covariance and the means of correspondences.
+   *
+   * @param S Covariance, sum over all correspondences of (a - cA) * (b - cB)^T.
+   * @param cA Mean of the first points.
+   * @param cB Mean of the second points.
+   * @param T Output transformation.
+   */
+  inline void fromCovariance(const Eigen::Matrix3d& S, const Eigen::Vector3d& cA, const Eigen::Vector3d& cB, Transform& T)
+  {
+    Eigen::Matrix4d N;
+    N(0, 0) = S(0, 0) + S(1, 1) + S(2, 2);
+    N(1, 1) = S(0, 0) - S(1, 1) - S(2, 2);
+    N(2, 2) = -S(0, 0) + S(1, 1) - S(2, 2);
+    N(3, 3) = -S(0, 0) - S(1, 1) + S(2, 2);
+    N(0, 1) = N(1, 0) = S(1, 2) - S(2, 1);
+    N(0, 2) = N(2, 0) = S(2, 0) - S(0, 2);
+    N(0, 3) = N(3, 0) = S(0, 1) - S(1, 0);
+    N(1, 2) = N(2, 1) = S(0, 1) + S(1, 0);
+    N(1, 3) = N(3, 1) = S(2, 0) + S(0, 2);
+    N(2, 3) = N(3, 2) = S(1, 2) + S(2, 1);
+
+    // eigenvalues are sorted in increasing order
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> solver(N);
+    Eigen::Vector4d q = solver.eigenvectors().col(3);
+
+    double w = q(0), x = q(1), y = q(2), z = q(3);
+    T.R << w*w + x*x - y*y - z*z, 2 * (x*y - w*z), 2 * (x*z + w*y),
+           2 * (x*y + w*z), w*w - x*x + y*y - z*z, 2 * (y*z - w*x),
+           2 * (x*z - w*y), 2 * (y*z + w*x), w*w - x*x - y*y + z*z;
+    T.t = cB - T.R * cA;
+  }
+
+  /**
+   * @brief Calculates the transformation that minimizes the squared distances of correspondences.
+   *
+   * @param points Correspondences, at least three for a unique solution.
+   * @param T Output transformation.
+   * @return bool False if there are no correspondences.
+   */
+  inline bool solve(Span points, Transform& T)
+  {
+    if(points.size == 0) return false;
+
+    Eigen::Vector3d cA = Eigen::Vector3d::Zero();
+    Eigen::Vector3d cB = Eigen::Vector3d::Zero();
+    for(size_t i = 0; i < points.size; i++)
+    {
+      cA += Eigen::Vector3d(points[i].first.x, points[i].first.y, points[i].first.z);
+      cB += Eigen::Vector3d(points[i].second.x, points[i].second.y, points[i].second.z);
+    }
+    cA /= (double) points.size;
+    cB /= (double) points.size;
+
+    Eigen::Matrix3d S = Eigen::Matrix3d::Zero();
+    for(size_t i = 0; i < points.size; i++)
+    {
+      Eigen::Vector3d a = Eigen::Vector3d(points[i].first.x, points[i].first.y, points[i].first.z) - cA;
+      Eigen::Vector3d b = Eigen::Vector3d(points[i].second.x, points[i].second.y, points[i].second.z) - cB;
+      S.noalias() += a * b.transpose();
+    }
+
+    fromCovariance(S, cA, cB, T);
+    return true;
+  }
+
+  /**
+   * @brief Closed-form transformation from a covariance of rank two or three.
+   *
+   * Kabsch on S = U * diag(s) * V^T: the right singular vectors are the eigenvectors of S^T * S,
+   * which the 3x3 closed-form eigensolver gives, and u = S * v / s. The third singular vectors are
+   * replaced by the cross products of the first two, so R = V * U^T is a proper rotation even for
+   * the coplanar points of minimal samples.
+   *
+   * @return bool False if the covariance is close to rank one (nearly collinear points), where squaring
+   * the covariance costs too much precision, T is then unchanged.
+   */
+  inline bool fromCovarianceDirect(const Eigen::Matrix3d& S, const Eigen::Vector3d& cA, const Eigen::Vector3d& cB, Transform& T)
+  {
+    // eigenvalues are sorted in increasing order
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+    solver.computeDirect(S.transpose() * S);
+    const Eigen::Vector3d& s2 = solver.eigenvalues();
+    if(!(s2(1) > RIGID_DIRECT_CONDITION * s2(2)) || !(s2(2) > 0))
+      return false;
+
+    Eigen::Vector3d v1 = solver.eigenvectors().col(2);
+    Eigen::Vector3d v2 = solver.eigenvectors().col(1);
+    Eigen::Vector3d u1 = (S * v1).normalized();
+    Eigen::Vector3d u2 = S * v2;
+    u2 = (u2 - u1.dot(u2) * u1).normalized();
+    v2 = (v2 - v1.dot(v2) * v1).normalized();
+
+    T.R = v1 * u1.transpose() + v2 * u2.transpose() + v1.cross(v2) * u1.cross(u2).transpose();
+    T.t = cB - T.R * cA;
+    return true;
+  }
+
+  /**
+   * @brief Solves many samples of correspondences at once, e.g. the minimal 3-point samples of RANSAC.
+   *
+   * Each sample is accumulated in a single pass (sums of the points and of their outer products),
+   * and solved with the closed-form 3x3 eigensolver of fromCovarianceDirect. Nearly collinear samples
+   * fall back to the quaternion method.
+   *
+   * @param samples Samples stored one after the other, sampleSize correspondences each.
+   * @param sampleSize Number of correspondences per sample.
+   * @param T Output, one transformation per sample.
+   */
+  inline void solveBatch(Span samples, int sampleSize, Transform* T)
+  {
+    const int numSamples = samples.size / sampleSize;
+    const double n = sampleSize;
+
+    for(int s = 0; s < numSamples; s++)
+    {
+      const correspondence_t* points = samples.data + (size_t) s * sampleSize;
+
+      Eigen::Vector3d sumA = Eigen::Vector3d::Zero();
+      Eigen::Vector3d sumB = Eigen::Vector3d::Zero();
+      Eigen::Matrix3d sumAB = Eigen::Matrix3d::Zero();
+      for(int i = 0; i < sampleSize; i++)
+      {
+        Eigen::Vector3d a(points[i].first.x, points[i].first.y, points[i].first.z);
+        Eigen::Vector3d b(points[i].second.x, points[i].second.y, points[i].second.z);
+        sumA += a;
+        sumB += b;
+        sumAB.noalias() += a * b.transpose();
+      }
+
+      const Eigen::Vector3d cA = sumA / n;
+      const Eigen::Vector3d cB = sumB / n;
+      const Eigen::Matrix3d S = sumAB - n * cA * cB.transpose();
+
+      if(!fromCovarianceDirect(S, cA, cB, T[s]))
+        fromCovariance(S, cA, cB, T[s]);
+    }
+  }
+
+  /**
+   * @brief Whether a transformation maps the first point of each correspondence onto the second.
+   *
+   * @param threshold Largest allowed distance between b and R * a + t.
+   */
+  inline bool reconstructs(Span points, const Transform& T, double threshold)
+  {
+    for(size_t i = 0; i < points.size; i++)
+    {
+      Eigen::Vector3d a(points[i].first.x, points[i].first.y, points[i].first.z);
+      Eigen::Vector3d b(points[i].second.x, points[i].second.y, points[i].second.z);
+      if((T.R * a + T.t - b).norm() >= threshold)
+        return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Converts an Eigen matrix to a 3x3 double cv::Mat.
+   */
+  inline cv::Mat toMat(const Eigen::Matrix3d& m)
+  {
+    cv::Mat result(3, 3, CV_64F);
+    for(int r = 0; r < 3; r++)
+    for(int c = 0; c < 3; c++)
+      result.at<double>(r, c) = m(r, c);
+    return result;
+  }
+
+  /**
+   * @brief Converts a transformation to a rotation matrix and a translation, the pose format of Hypothesis.
+   */
+  inline std::pair<cv::Mat, cv::Point3d> toPose(const Transform& T)
+  {
+    return std::pair<cv::Mat, cv::Point3d>(toMat(T.R), cv::Point3d(T.t(0), T.t(1), T.t(2)));
+  }
+}
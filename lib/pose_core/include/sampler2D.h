@@ -0,0 +1,319 @@
+/*
+Copyright (c) 2016, TU Dresden
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the TU Dresden nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL TU DRESDEN BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include "types.h"
+#include "thread_rand.h"
+#include <array>
+#include <vector>
+#include <algorithm>
+
+#define DRAW_CHUNK 64 // number of random numbers generated at once in batch draws
+
+
+/**
+ * @brief Class for drawing pixel positions according to weights given per pixel.
+ * 
+ * Draws from the whole image use a Walker alias table and cost O(1) per sample. Draws within
+ * a window search the column CDF of the window for the row and then the row CDF for the
+ * column, both read from an integral image. A sampler can be rebuilt for new weights without
+ * reallocating, so one set of samplers is reused for all hypotheses and frames.
+ */
+class Sampler2D
+{
+public:
+    Sampler2D() : width(0), height(0) {}
+
+    /**
+     * @brief Constructor.
+     * 
+     * @param probs Map of probabilities or weights per pixel according to which pixel positions should be sampled.
+     */
+    Sampler2D(const jp::img_stat_t& probs)
+    {
+	CV_Assert(probs.isContinuous());
+	build(jp::view_stat_t(probs[0], probs.rows, probs.cols, 1));
+    }
+
+    /**
+     * @brief Constructor.
+     * 
+     * @param probs View of probabilities or weights per pixel according to which pixel positions should be sampled.
+     */
+    Sampler2D(const jp::view_stat_t& probs)
+    {
+	build(probs);
+    }
+
+    /**
+     * @brief Builds the integral image and the alias table for the given weights. Memory of earlier builds is reused.
+     * 
+     * @param probs View of probabilities or weights per pixel.
+     */
+    void build(const jp::view_stat_t& probs)
+    {
+	width = probs.cols;
+	height = probs.rows;
+
+	// row CDFs, then accumulate the rows
+	integral.create(height + 1, width + 1);
+	for(int x = 0; x <= width; x++)
+	    integral(0, x) = 0;
+
+	for(int y = 0; y < height; y++)
+	{
+	    double rowSum = 0;
+	    integral(y + 1, 0) = 0;
+	    for(int x = 0; x < width; x++)
+	    {
+		rowSum += probs(y, x);
+		integral(y + 1, x + 1) = integral(y, x + 1) + rowSum;
+	    }
+	}
+
+	buildAlias(probs);
+    }
+
+    /**
+     * @brief Samples a random pixel position in the whole image.
+     * 
+     * @param rng Random number generator to use.
+     * @return cv::Point2f Random pixel position.
+     */
+    cv::Point2f draw(Philox& rng)
+    {
+	int i = rng.irand(0, prob.size());
+	if(rng.drand(0, 1) >= prob[i]) i = alias[i];
+	return cv::Point2f(i % width, i / width);
+    }
+
+    /**
+     * @brief Samples n random pixel positions in the whole image.
+     * 
+     * @param rng Random number generator to use.
+     * @param out Output, n pixel positions.
+     * @param n Number of samples.
+     */
+    void draw(Philox& rng, cv::Point2f* out, int n)
+    {
+	int idx[DRAW_CHUNK];
+	float u[DRAW_CHUNK];
+
+	for(int i = 0; i < n; i += DRAW_CHUNK)
+	{
+	    int m = std::min(DRAW_CHUNK, n - i);
+	    rng.irand(0, prob.size(), idx, m);
+	    rng.drand(0.f, 1.f, u, m);
+
+	    for(int k = 0; k < m; k++)
+	    {
+		int j = (u[k] < prob[idx[k]]) ? idx[k] : alias[idx[k]];
+		out[i + k] = cv::Point2f(j % width, j / width);
+	    }
+	}
+    }
+
+    /**
+     * @brief Samples a random pixel position in the given 2D window.
+     * 
+     * @param bb2D 2D window the sample should lie in.
+     * @param pt Output, random pixel position.
+     * @return bool False if the window has no weight, pt is not set then.
+     */
+    bool drawInRect(const cv::Rect& bb2D, cv::Point2f& pt)
+    {
+	return drawInRect(bb2D, drand(0, 1), pt);
+    }
+
+    /**
+     * @brief Samples a random pixel position in the given 2D window.
+     * 
+     * @param bb2D 2D window the sample should lie in.
+     * @param rng Random number generator to use.
+     * @param pt Output, random pixel position.
+     * @return bool False if the window has no weight, pt is not set then.
+     */
+    bool drawInRect(const cv::Rect& bb2D, Philox& rng, cv::Point2f& pt)
+    {
+	return drawInRect(bb2D, rng.drand(0, 1), pt);
+    }
+
+    /**
+     * @brief Samples n random pixel positions in the given 2D window.
+     * 
+     * @param bb2D 2D window the samples should lie in.
+     * @param rng Random number generator to use.
+     * @param out Output, n pixel positions.
+     * @param n Number of samples.
+     * @return int Number of samples drawn, 0 if the window has no weight.
+     */
+    int drawInRect(const cv::Rect& bb2D, Philox& rng, cv::Point2f* out, int n)
+    {
+	if(!(getSum(bb2D.x, bb2D.y, bb2D.br().x - 1, bb2D.br().y - 1) > 0))
+	    return 0;
+
+	float u[DRAW_CHUNK];
+
+	for(int i = 0; i < n; i += DRAW_CHUNK)
+	{
+	    int m = std::min(DRAW_CHUNK, n - i);
+	    rng.drand(0.f, 1.f, u, m);
+
+	    for(int k = 0; k < m; k++)
+		drawInRect(bb2D, u[k], out[i + k]);
+	}
+	return n;
+    }
+    
+public:
+  
+    /**
+     * @brief Calclate the accumulated weights within the given bound.
+     * 
+     * @param minX Minimum X value of the search window.
+     * @param maxX Maximum X value of the search window.
+     * @param minY Minimum Y value of the search window.
+     * @param maxY Maximum Y value of the search window.
+     * @return double Sum of weights.
+     */
+    inline double getSum(int minX, int minY, int maxX, int maxY)
+    {
+	return integral(maxY + 1, maxX + 1) - integral(maxY + 1, minX) - integral(minY, maxX + 1) + integral(minY, minX);
+    }
+    
+    /**
+     * @brief Search for the pixel position in the given window which has the given fraction of accumulated weight.
+     * 
+     * The first row of the window whose accumulated weight exceeds the target is found by binary
+     * search over the column CDF of the window, the column by binary search over the row CDF.
+     * 
+     * @param bb2D 2D window the sample should lie in.
+     * @param u Fraction of the accumulated weight of the window, in [0, 1).
+     * @param pt Output, pixel position with the given accumulated weight.
+     * @return bool False if the window has no weight, pt is not set then.
+     */
+    bool drawInRect(const cv::Rect& bb2D, double u, cv::Point2f& pt)
+    {
+	int minX = bb2D.tl().x;
+	int maxX = bb2D.br().x; // exclusive
+	int minY = bb2D.tl().y;
+	int maxY = bb2D.br().y; // exclusive
+
+	double rowsBefore = integral(minY, maxX) - integral(minY, minX);
+	double total = integral(maxY, maxX) - integral(maxY, minX) - rowsBefore;
+	if(!(total > 0))
+	    return false; // every pixel of the window has zero weight
+	double target = u * total;
+
+	// column CDF, weight of the window rows [minY, y]
+	int lo = minY, hi = maxY - 1;
+	while(lo < hi)
+	{
+	    int mid = (lo + hi) / 2;
+	    if(integral(mid + 1, maxX) - integral(mid + 1, minX) - rowsBefore > target)
+		hi = mid;
+	    else
+		lo = mid + 1;
+	}
+	int y = lo;
+	target -= integral(y, maxX) - integral(y, minX) - rowsBefore;
+
+	// row CDF of row y, weight of the window columns [minX, x]
+	double colsBefore = integral(y + 1, minX) - integral(y, minX);
+	lo = minX;
+	hi = maxX - 1;
+	while(lo < hi)
+	{
+	    int mid = (lo + hi) / 2;
+	    if(integral(y + 1, mid + 1) - integral(y, mid + 1) - colsBefore > target)
+		hi = mid;
+	    else
+		lo = mid + 1;
+	}
+
+	pt = cv::Point2f(lo, y);
+	return true;
+    }
+
+    cv::Mat_<double> integral; // integral image (map of accumulated weights) used in binary search
+
+private:
+
+    /**
+     * @brief Builds the alias table with Vose's method. Uniform if all weights are zero.
+     */
+    void buildAlias(const jp::view_stat_t& probs)
+    {
+	int n = width * height;
+	prob.resize(n);
+	alias.resize(n);
+	small.clear();
+	large.clear();
+
+	double total = integral(height, width);
+	double scale = (total > 0) ? n / total : 0;
+
+	for(int i = 0; i < n; i++)
+	{
+	    prob[i] = (total > 0) ? probs(i / width, i % width) * scale : 1;
+	    alias[i] = i;
+	    if(prob[i] < 1)
+		small.push_back(i);
+	    else
+		large.push_back(i);
+	}
+
+	// pair each under-full entry with an over-full one
+	while(!small.empty() && !large.empty())
+	{
+	    int s = small.back();
+	    int l = large.back();
+	    small.pop_back();
+
+	    alias[s] = l;
+	    prob[l] -= 1 - prob[s];
+	    if(prob[l] < 1)
+	    {
+		large.pop_back();
+		small.push_back(l);
+	    }
+	}
+
+	// left overs are full up to rounding errors
+	for(int i : small) prob[i] = 1;
+	for(int i : large) prob[i] = 1;
+    }
+
+    int width;
+    int height;
+    std::vector<float> prob; // alias table, probability to keep entry i
+    std::vector<int> alias; // alias table, entry drawn instead of i
+    std::vector<int> small; // work lists of the alias table construction
+    std::vector<int> large;
+};
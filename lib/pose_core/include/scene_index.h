@@ -0,0 +1,186 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <stdint.h>
+
+#include "types.h"
+
+#define SCENE_EMPTY_KEY (~0ull) // free slot of the hash table
+
+/**
+ * @brief Spatial hash of the points of one depth frame on a regular grid.
+ *
+ * Points are bucketed by grid cell, the cells are found through an open addressing hash table.
+ * With the cell size equal to the search radius a radius query only visits the 27 cells around
+ * the query point. Each point keeps the id it was inserted with, e.g. its pixel index, so queries
+ * can be restricted to a subset of the scene with a mask over the ids. Built once per frame and
+ * only read afterwards, so any number of threads can query it. Buffers keep their capacity.
+ */
+struct SceneIndex
+{
+  float cellSize = 0.01f; // edge length of a grid cell
+  int numCells = 0; // number of occupied cells
+
+  std::vector<uint64_t> tableKeys; // hash table, cell key per slot, SCENE_EMPTY_KEY for free slots
+  std::vector<int> tableCells; // hash table, cell index per slot
+  std::vector<int> cellOffsets; // first point of each cell, numCells + 1 entries
+  std::vector<cv::Point3f> points; // points grouped by cell
+  std::vector<int> ids; // id of each point
+
+  std::vector<uint64_t> pointKeys; // cell key of each inserted point, build only
+  std::vector<int> pointCells; // cell index of each inserted point, build only
+
+  /**
+   * @brief Indexes the valid points of an organized point cloud, the pixel index (y * width + x) is the id.
+   *
+   * @param eye Organized point cloud, points with z = 0 are depth holes and skipped.
+   * @param cellSize Edge length of a grid cell, use the radius of the later queries.
+   */
+  void build(const jp::img_coord_t& eye, float cellSize)
+  {
+    this->cellSize = cellSize;
+    int num_pixels = eye.rows * eye.cols;
+    const jp::coord3_t* cloud = reinterpret_cast<const jp::coord3_t*>(eye.data);
+
+    // collect the valid points and their cell keys
+    ids.clear();
+    pointKeys.clear();
+    for (int i = 0; i < num_pixels; i++)
+    {
+      if (cloud[i][2] <= 0) continue;
+      ids.push_back(i);
+      pointKeys.push_back(key(cloud[i][0], cloud[i][1], cloud[i][2]));
+    }
+    int n = ids.size();
+
+    // hash table with at least twice as many slots as points, so probing stays short
+    int capacity = 1;
+    while (capacity < 2 * n) capacity <<= 1;
+    tableKeys.assign(capacity, SCENE_EMPTY_KEY);
+    tableCells.resize(capacity);
+
+    // assign a cell index to each occupied cell and count its points
+    numCells = 0;
+    cellOffsets.clear();
+    pointCells.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+      uint64_t k = pointKeys[i];
+      int slot = hash(k) & (capacity - 1);
+      while (tableKeys[slot] != SCENE_EMPTY_KEY && tableKeys[slot] != k)
+        slot = (slot + 1) & (capacity - 1);
+
+      if (tableKeys[slot] == SCENE_EMPTY_KEY)
+      {
+        tableKeys[slot] = k;
+        tableCells[slot] = numCells++;
+        cellOffsets.push_back(0);
+      }
+      pointCells[i] = tableCells[slot];
+      cellOffsets[pointCells[i]]++;
+    }
+
+    // prefix sum, then scatter the points into their cells
+    cellOffsets.push_back(0);
+    int total = 0;
+    for (int c = 0; c <= numCells; c++)
+    {
+      int count = cellOffsets[c];
+      cellOffsets[c] = total;
+      total += count;
+    }
+
+    std::vector<int> order(n);
+    std::vector<int> pos(cellOffsets.begin(), cellOffsets.end() - 1);
+    for (int i = 0; i < n; i++)
+      order[pos[pointCells[i]]++] = i;
+
+    std::vector<int> sortedIds(n);
+    points.resize(n);
+    for (int j = 0; j < n; j++)
+    {
+      int id = ids[order[j]];
+      sortedIds[j] = id;
+      points[j] = cv::Point3f(cloud[id][0], cloud[id][1], cloud[id][2]);
+    }
+    ids.swap(sortedIds);
+  }
+
+  /**
+   * @brief Nearest point within a radius of at most the cell size.
+   *
+   * @param mask Optional, only points with mask[id] != 0 are considered.
+   * @return int Id of the nearest point, -1 if there is none within the radius.
+   */
+  int nearest(float x, float y, float z, float radius, const uint8_t* mask = NULL) const
+  {
+    if (numCells == 0) return -1;
+
+    int cx = (int) std::floor(x / cellSize);
+    int cy = (int) std::floor(y / cellSize);
+    int cz = (int) std::floor(z / cellSize);
+
+    int best = -1;
+    float bestDist = radius * radius;
+    for (int dz = -1; dz <= 1; dz++)
+    for (int dy = -1; dy <= 1; dy++)
+    for (int dx = -1; dx <= 1; dx++)
+    {
+      int c = find(pack(cx + dx, cy + dy, cz + dz));
+      if (c < 0) continue;
+
+      for (int j = cellOffsets[c]; j < cellOffsets[c + 1]; j++)
+      {
+        if (mask && !mask[ids[j]]) continue;
+
+        float ex = points[j].x - x;
+        float ey = points[j].y - y;
+        float ez = points[j].z - z;
+        float d = ex * ex + ey * ey + ez * ez;
+        if (d <= bestDist)
+        {
+          bestDist = d;
+          best = ids[j];
+        }
+      }
+    }
+    return best;
+  }
+
+private:
+  uint64_t key(float x, float y, float z) const
+  {
+    return pack((int) std::floor(x / cellSize), (int) std::floor(y / cellSize), (int) std::floor(z / cellSize));
+  }
+
+  // 21 bits per axis, enough for +-10 km at 1 cm cells
+  static uint64_t pack(int x, int y, int z)
+  {
+    const uint64_t m = (1ull << 21) - 1;
+    return ((uint64_t) (x & m)) | ((uint64_t) (y & m) << 21) | ((uint64_t) (z & m) << 42);
+  }
+
+  static uint64_t hash(uint64_t k)
+  {
+    // 64 bit finalizer of MurmurHash3
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+  }
+
+  int find(uint64_t k) const
+  {
+    int mask = tableKeys.size() - 1;
+    int slot = hash(k) & mask;
+    while (tableKeys[slot] != SCENE_EMPTY_KEY)
+    {
+      if (tableKeys[slot] == k) return tableCells[slot];
+      slot = (slot + 1) & mask;
+    }
+    return -1;
+  }
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+/**
+ * @brief Runtime selection of the AVX2 and POPCNT kernels.
+ *
+ * The libraries are built for the baseline instruction set of the target, so that they run on
+ * any CPU of the architecture. Kernels with an AVX2 variant compile it with SIMD_TARGET_AVX2 and
+ * call it only when simdHasAVX2() reports support, otherwise they use their scalar code. The same
+ * holds for POPCNT with SIMD_TARGET_POPCNT and simdHasPOPCNT(), without it __builtin_popcountll
+ * is a library call.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_DISPATCH_AVX2
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#define SIMD_DISPATCH_POPCNT
+#define SIMD_TARGET_POPCNT __attribute__((target("popcnt")))
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Whether the AVX2 kernels can be used on this CPU.
+ */
+inline bool simdHasAVX2()
+{
+#if defined(SIMD_DISPATCH_AVX2)
+  static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief Whether the POPCNT kernels can be used on this CPU.
+ */
+inline bool simdHasPOPCNT()
+{
+#if defined(SIMD_DISPATCH_POPCNT)
+  static const bool popcnt = (__builtin_cpu_init(), __builtin_cpu_supports("popcnt"));
+  return popcnt;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,376 @@
+/*
+Copyright (c) 2016, TU Dresden
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the TU Dresden nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL TU DRESDEN BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <cmath>
+
+#include "simd_dispatch.h"
+
+/** Classes and methods for generating random numbers in multi-threaded programs. */
+
+/**
+ * @brief Counter-based random number generator (Philox4x32-10).
+ * 
+ * The i-th draw is a pure function of (seed, frame, stream, i). Giving each unit of work its
+ * own stream, e.g. one stream per RANSAC hypothesis of a frame, makes the results independent
+ * of the number of threads and of the thread scheduling. Generators are cheap to create and
+ * do not share state.
+ */
+class Philox
+{
+public:
+  /**
+   * @brief Creates a generator positioned at the first draw of a stream.
+   * 
+   * @param frame Frame (or call) index.
+   * @param stream Stream index within the frame.
+   * @param seed Optional parameter. Global seed.
+   */
+  Philox(uint32_t frame = 0, uint32_t stream = 0, uint32_t seed = 1305)
+  : frame(frame), stream(stream), seed(seed), counter(0), pos(4) {}
+
+  /**
+   * @brief Computes the block of four random words for the given counter.
+   */
+  static void block(uint32_t seed, uint32_t frame, uint32_t stream, uint64_t counter, uint32_t out[4])
+  {
+    uint32_t c0 = (uint32_t) counter, c1 = (uint32_t) (counter >> 32), c2 = stream, c3 = frame;
+    uint32_t k0 = seed, k1 = seed ^ 0x5bd1e995;
+
+    for(int r = 0; r < 10; r++)
+    {
+      uint64_t p0 = (uint64_t) 0xD2511F53 * c0;
+      uint64_t p1 = (uint64_t) 0xCD9E8D57 * c2;
+      uint32_t n0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+      uint32_t n2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+      c1 = (uint32_t) p1;
+      c3 = (uint32_t) p0;
+      c0 = n0;
+      c2 = n2;
+      k0 += 0x9E3779B9;
+      k1 += 0xBB67AE85;
+    }
+
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+  }
+
+  /**
+   * @brief Returns the next random 32 bit word of the stream.
+   */
+  uint32_t next()
+  {
+    if(pos == 4)
+    {
+      block(seed, frame, stream, counter++, buffer);
+      pos = 0;
+    }
+    return buffer[pos++];
+  }
+
+  /**
+   * @brief Moves to the given draw index of the stream.
+   */
+  void seek(uint64_t draw)
+  {
+    counter = draw / 4;
+    pos = 4;
+    if(draw % 4)
+    {
+      block(seed, frame, stream, counter++, buffer);
+      pos = draw % 4;
+    }
+  }
+
+  /**
+   * @brief Returns a random integer (uniform distribution, multiply-shift mapping).
+   * 
+   * @param min Minimum value of the random integer (inclusive).
+   * @param max Maximum value of the random integer (exclusive).
+   */
+  int irand(int min, int max)
+  {
+    return min + (int) (((uint64_t) next() * (uint32_t) (max - min)) >> 32);
+  }
+
+  /**
+   * @brief Returns a random double value in [min, max) (uniform distribution).
+   */
+  double drand(double min, double max)
+  {
+    uint64_t bits = ((uint64_t) next() << 21) ^ (next() >> 11); // 53 bits
+    return min + (max - min) * (bits * (1.0 / 9007199254740992.0));
+  }
+
+  /**
+   * @brief Returns a random double value (Gauss distribution, Box-Muller).
+   */
+  double dgauss(double mean, double stdDev)
+  {
+    double u1 = drand(0, 1);
+    double u2 = drand(0, 1);
+    return mean + stdDev * sqrt(-2 * log(1 - u1)) * cos(6.283185307179586 * u2);
+  }
+
+  /**
+   * @brief Fills out with n random integers in [min, max), consuming whole blocks of the stream.
+   */
+  void irand(int min, int max, int* out, int n)
+  {
+    uint32_t range = max - min;
+    uint32_t words[BULK_BLOCKS * 4];
+    for(int i = 0; i < n; i += BULK_BLOCKS * 4)
+    {
+      int m = std::min(n - i, BULK_BLOCKS * 4);
+      int count = (m + 3) / 4;
+      blocks(seed, frame, stream, counter, count, words);
+      counter += count;
+      for(int k = 0; k < m; k++)
+        out[i + k] = min + (int) (((uint64_t) words[k] * range) >> 32);
+    }
+    pos = 4;
+  }
+
+  /**
+   * @brief Fills out with n random floats in [min, max), consuming whole blocks of the stream.
+   */
+  void drand(float min, float max, float* out, int n)
+  {
+    uint32_t words[BULK_BLOCKS * 4];
+    for(int i = 0; i < n; i += BULK_BLOCKS * 4)
+    {
+      int m = std::min(n - i, BULK_BLOCKS * 4);
+      int count = (m + 3) / 4;
+      blocks(seed, frame, stream, counter, count, words);
+      counter += count;
+      for(int k = 0; k < m; k++)
+        out[i + k] = min + (max - min) * ((words[k] >> 8) * (1.0f / 16777216.0f));
+    }
+    pos = 4;
+  }
+
+  /**
+   * @brief Computes count consecutive blocks starting at the given counter, the words of block i go to out[4i..4i+3].
+   * 
+   * Eight blocks at a time are computed in the lanes of AVX2 registers when the CPU supports it.
+   */
+  static void blocks(uint32_t seed, uint32_t frame, uint32_t stream, uint64_t counter, int count, uint32_t* out)
+  {
+    int i = 0;
+#if defined(SIMD_DISPATCH_AVX2)
+    if(simdHasAVX2())
+      for(; i + 8 <= count; i += 8)
+        blocks8AVX2(seed, frame, stream, counter + i, out + 4 * i);
+#endif
+    for(; i < count; i++)
+      block(seed, frame, stream, counter + i, out + 4 * i);
+  }
+
+private:
+  static const int BULK_BLOCKS = 16; // blocks generated per chunk of a bulk fill
+
+#if defined(SIMD_DISPATCH_AVX2)
+  /**
+   * @brief Lane-wise 32x32 bit multiplication of a with m, returning the high and low words.
+   */
+  SIMD_TARGET_AVX2 static inline void mulhilo8(__m256i a, uint32_t m, __m256i& hi, __m256i& lo)
+  {
+    __m256i vm = _mm256_set1_epi32(m);
+    __m256i even = _mm256_mul_epu32(a, vm); // products of lanes 0, 2, 4, 6
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), vm); // products of lanes 1, 3, 5, 7
+    lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+    hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+  }
+
+  /**
+   * @brief Same as block() for the eight counters starting at counter, one per lane.
+   */
+  SIMD_TARGET_AVX2 static void blocks8AVX2(uint32_t seed, uint32_t frame, uint32_t stream, uint64_t counter, uint32_t* out)
+  {
+    uint32_t lo[8], hi[8];
+    for(int l = 0; l < 8; l++)
+    {
+      lo[l] = (uint32_t) (counter + l);
+      hi[l] = (uint32_t) ((counter + l) >> 32);
+    }
+
+    __m256i c0 = _mm256_loadu_si256((const __m256i*) lo);
+    __m256i c1 = _mm256_loadu_si256((const __m256i*) hi);
+    __m256i c2 = _mm256_set1_epi32(stream);
+    __m256i c3 = _mm256_set1_epi32(frame);
+    uint32_t k0 = seed, k1 = seed ^ 0x5bd1e995;
+
+    for(int r = 0; r < 10; r++)
+    {
+      __m256i hi0, lo0, hi1, lo1;
+      mulhilo8(c0, 0xD2511F53, hi0, lo0);
+      mulhilo8(c2, 0xCD9E8D57, hi1, lo1);
+      c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(k0));
+      c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(k1));
+      c1 = lo1;
+      c3 = lo0;
+      k0 += 0x9E3779B9;
+      k1 += 0xBB67AE85;
+    }
+
+    // transpose the four word vectors into eight consecutive blocks
+    __m256i t0 = _mm256_unpacklo_epi32(c0, c1); // w0 w1 of lanes 0, 1 | 4, 5
+    __m256i t1 = _mm256_unpackhi_epi32(c0, c1); // lanes 2, 3 | 6, 7
+    __m256i t2 = _mm256_unpacklo_epi32(c2, c3);
+    __m256i t3 = _mm256_unpackhi_epi32(c2, c3);
+    __m256i b0 = _mm256_unpacklo_epi64(t0, t2); // blocks 0 | 4
+    __m256i b1 = _mm256_unpackhi_epi64(t0, t2); // blocks 1 | 5
+    __m256i b2 = _mm256_unpacklo_epi64(t1, t3); // blocks 2 | 6
+    __m256i b3 = _mm256_unpackhi_epi64(t1, t3); // blocks 3 | 7
+    __m256i* dst = (__m256i*) out;
+    _mm256_storeu_si256(dst + 0, _mm256_permute2x128_si256(b0, b1, 0x20));
+    _mm256_storeu_si256(dst + 1, _mm256_permute2x128_si256(b2, b3, 0x20));
+    _mm256_storeu_si256(dst + 2, _mm256_permute2x128_si256(b0, b1, 0x31));
+    _mm256_storeu_si256(dst + 3, _mm256_permute2x128_si256(b2, b3, 0x31));
+  }
+#endif
+
+  uint32_t frame;
+  uint32_t stream;
+  uint32_t seed;
+  uint64_t counter; // next block to generate
+  uint32_t buffer[4]; // current block
+  int pos; // next word of the current block
+};
+
+/**
+ * @brief Provides random numbers for multiple threads.
+ * 
+ * Singelton class. Gives random numbers from thread-local Philox generators.
+ * Calls with a thread ID draw from the stream of that ID, calls without one draw from a stream that is
+ * assigned to the calling thread at its first draw, so threads of any origin get distinct streams.
+ * Results depend on the thread scheduling, use Philox streams directly where reproducibility matters.
+ */
+class ThreadRand
+{
+public:
+  /**
+   * @brief Returns a random integer (uniform distribution).
+   * 
+   * @param min Minimum value of the random integer (inclusive).
+   * @param max Maximum value of the random integer (exclusive).
+   * @param tid Optional parameter. ID of the thread to use. If not given, the method will obtain the thread ID itself.
+   * @return int Random integer value.
+   */
+  static int irand(int min, int max, int tid = -1);
+  
+  /**
+   * @brief Returns a random double value (uniform distribution).
+   * 
+   * @param min Minimum value of the random double (inclusive).
+   * @param max Maximum value of the random double (inclusive).
+   * @param tid Optional parameter. ID of the thread to use. If not given, the method will obtain the thread ID itself.
+   * @return double Random double value.
+   */
+  static double drand(double min, double max, int tid = -1);
+  
+  /**
+   * @brief Returns a random double value (Gauss distribution).
+   * 
+   * @param mean Mean of the Gauss distribution to sample from.
+   * @param stdDev Standard deviation of the Gauss distribution to sample from.
+   * @param tid Optional parameter. ID of the thread to use. If not given, the method will obtain the thread ID itself.
+   * @return double Random double value.
+   */
+  static double dgauss(double mean, double stdDev, int tid = -1);
+    
+  /**
+   * @brief Re-Initialize the object with the given seed.
+   * 
+   * @param seed Seed of the generators (the stream of each generator is its thread ID).
+   * @return void
+   */
+  static void forceInit(unsigned seed);
+  
+private:  
+  /**
+   * @brief Returns the generator for the given thread ID, (re-)creating it if the seed changed.
+   * 
+   * @param tid ID of the thread, used as stream. If negative, the stream of the calling thread.
+   * @return Philox& Generator of the stream.
+   */
+  static Philox& generator(int tid);
+};
+
+/**
+  * @brief Returns a random integer (uniform distribution).
+  * 
+  * This method used the ThreadRand class.
+  * 
+  * @param min Minimum value of the random integer (inclusive).
+  * @param max Maximum value of the random integer (exclusive).
+  * @param tid Optional parameter. ID of the thread to use. If not given, the method will obtain the thread ID itself.
+  * @return int Random integer value.
+  */
+int irand(int incMin, int excMax, int tid = -1);
+/**
+  * @brief Returns a random double value (uniform distribution).
+  * 
+  * This method used the ThreadRand class.
+  * 
+  * @param min Minimum value of the random double (inclusive).
+  * @param max Maximum value of the random double (inclusive).
+  * @param tid Optional parameter. ID of the thread to use. If not given, the method will obtain the thread ID itself.
+  * @return double Random double value.
+  */
+double drand(double incMin, double incMax, int tid = -1);
+
+  /**
+   * @brief Returns a random integer value (Gauss distribution).
+   * 
+   * This method used the ThreadRand class.
+   * 
+   * @param mean Mean of the Gauss distribution to sample from.
+   * @param stdDev Standard deviation of the Gauss distribution to sample from.
+   * @param tid Optional parameter. ID of the thread to use. If not given, the method will obtain the thread ID itself.
+   * @return double Random integer value.
+   */
+int igauss(int mean, int stdDev, int tid = -1);
+
+  /**
+   * @brief Returns a random double value (Gauss distribution).
+   * 
+   * This method used the ThreadRand class.
+   * 
+   * @param mean Mean of the Gauss distribution to sample from.
+   * @param stdDev Standard deviation of the Gauss distribution to sample from.
+   * @param tid Optional parameter. ID of the thread to use. If not given, the method will obtain the thread ID itself.
+   * @return double Random double value.
+   */
+double dgauss(double mean, double stdDev, int tid = -1);
\ No newline at end of file
@@ -92,6 +92,32 @@ namespace jp
     
     typedef cv::Mat_<size_t> img_leaf_t; // image of leaf indices per pixel
     typedef cv::Mat_<float> img_stat_t; // image containing some statistic per pixel, e.g. an object probability
+
+    /**
+     * @brief Read-only image view of one class in an interleaved per-pixel buffer, e.g. a network output.
+     *
+     * Pixel (y, x) starts at data[stride * (y * cols + x)]. Nothing is copied, the buffer has to outlive the view.
+     */
+    template<class T>
+    struct img_view_t
+    {
+	img_view_t() : data(NULL), rows(0), cols(0), stride(0) {}
+	img_view_t(const float* data, int rows, int cols, int stride) : data(data), rows(rows), cols(cols), stride(stride) {}
+
+	const T& operator()(int y, int x) const
+	{
+	    return *reinterpret_cast<const T*>(data + stride * (y * cols + x));
+	}
+
+	const float* data; // first element of the class at pixel (0, 0)
+	int rows;
+	int cols;
+	int stride; // number of floats between two neighbouring pixels
+    };
+
+    typedef img_view_t<coord1_t> view_stat_t; // view of a per pixel statistic, e.g. an object probability
+    typedef img_view_t<coord3_t> view_coord_t; // view of object coordinates
+    typedef img_view_t<coord2_t> view_center_t; // view of center coordinates
     
 
     /**
@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "Hypothesis.h"
+#include "rigid_solve.h"
 
 Hypothesis::Hypothesis() 
 {
@@ -78,7 +79,7 @@ Hypothesis::Hypothesis(cv::Mat transform)
     this->invRotation = this->rotation.inv();
 }
 
-Hypothesis::Hypothesis(std::vector<std::pair<cv::Point3d, cv::Point3d>> points) 
+Hypothesis::Hypothesis(const std::vector<std::pair<cv::Point3d, cv::Point3d>>& points) 
 {
     refine(points);
 }
@@ -93,28 +94,60 @@ Hypothesis::Hypothesis(std::vector<std::pair<cv::Point2d, cv::Point2d>> points)
 
 
 
-cv::Point2d Hypothesis::calcCenter(std::vector<std::pair<cv::Point2d, cv::Point2d>> points) 
+bool LineIntersection2D::solve(cv::Point2d& center) const
 {
-    cv::Mat pointsA(points.size(), 2, CV_64F);
-    cv::Mat pointsB(points.size(), 1, CV_64F);
-    cv::Mat output(2, 1, CV_64F);
+    double trace = a11 + a22;
+    if(trace <= 0) return false;
 
-    int i = 0;
+    double det = a11 * a22 - a12 * a12;
+    if(det > 1e-10 * trace * trace)
+    {
+        center.x = (a22 * b1 - a12 * b2) / det;
+        center.y = (a11 * b2 - a12 * b1) / det;
+        return true;
+    }
+
+    // ill-conditioned, project onto the eigenvector of the largest eigenvalue (pseudo-inverse)
+    double half = (a11 - a22) / 2;
+    double lambda = trace / 2 + sqrt(half * half + a12 * a12);
+    cv::Point2d v1(a12, lambda - a11);
+    cv::Point2d v2(lambda - a22, a12);
+    cv::Point2d v = (v1.dot(v1) > v2.dot(v2)) ? v1 : v2;
+    double norm = v.dot(v);
+    if(norm <= 0) v = (a11 >= a22) ? cv::Point2d(1, 0) : cv::Point2d(0, 1);
+    else v *= 1.0 / sqrt(norm);
+
+    center = v * ((v.x * b1 + v.y * b2) / lambda);
+    return true;
+}
+
+cv::Point2d Hypothesis::calcCenter(const std::vector<std::pair<cv::Point2d, cv::Point2d>>& points, double huberDelta, int iterations) 
+{
+    LineIntersection2D lines;
     for(auto it = points.begin(); it != points.end(); ++it) 
+        lines.add(it->first, it->second);
+
+    cv::Point2d result = this->center;
+    if(!lines.solve(result))
+        return result;
+
+    // iteratively reweighted least squares with Huber weights
+    for(int i = 0; huberDelta > 0 && i < iterations; i++)
     {
-        double m1 = -it->first.y;
-        double n1 = it->first.x;
-        double a1 = it->second.x;
-        double b1 = it->second.y;
-
-        pointsA.at<double>(i, 0) = m1;
-        pointsA.at<double>(i, 1) = n1;
-        pointsB.at<double>(i, 0) = m1 * a1 + n1 * b1;
-        i++;
+        lines.clear();
+        for(auto it = points.begin(); it != points.end(); ++it) 
+        {
+            double len = sqrt(it->first.dot(it->first));
+            if(len <= 0) continue;
+
+            double r = fabs(-it->first.y * (result.x - it->second.x) + it->first.x * (result.y - it->second.y)) / len;
+            lines.add(it->first, it->second, (r <= huberDelta) ? 1 : huberDelta / r);
+        }
+        lines.solve(result);
     }
-    cv::solve(pointsA, pointsB, output, cv::DECOMP_SVD);
 
-    return cv::Point2d(output.at<double>(0, 0), output.at<double>(1, 0));
+    this->center = result;
+    return result;
 }
 
 
@@ -183,70 +216,35 @@ double Hypothesis::calcAngularDistance(Hypothesis h)
     return 180 * acos((trace - 1.0) / 2.0) / CV_PI;
 }
 
-std::pair<cv::Mat, cv::Point3d> Hypothesis::calcRigidBodyTransform(std::vector<std::pair<cv::Point3d, cv::Point3d>> points) 
+std::pair<cv::Mat, cv::Point3d> Hypothesis::calcRigidBodyTransform(const std::vector<std::pair<cv::Point3d, cv::Point3d>>& points) 
 {
-    cv::Point3d cA(0, 0, 0);
-    cv::Point3d cB(0, 0, 0);
-    cv::Mat pointsA(3, points.size(), CV_64F);
-    cv::Mat pointsB(3, points.size(), CV_64F);
-
-    for(auto it = points.begin(); it != points.end(); ++it) 
-    {
-        cA += (it->first);
-        cB += (it->second);
-    }
-    cA *= (1.0 / (double) points.size());
-    cB *= (1.0 / (double) points.size());
-
-    int i = 0;
-    for(auto it = points.begin(); it != points.end(); ++it) 
-    {
-        pointsA.at<double>(0, i) = it->first.x - cA.x;
-        pointsB.at<double>(0, i) = it->second.x - cB.x;
-        pointsA.at<double>(1, i) = it->first.y - cA.y;
-        pointsB.at<double>(1, i) = it->second.y - cB.y;
-        pointsA.at<double>(2, i) = it->first.z - cA.z;
-        pointsB.at<double>(2, i) = it->second.z - cB.z;
-        i++;
-    }
-    cv::Mat a = pointsA * (pointsB.t());
+    rigid::Transform result;
+    if(!rigid::solve(points, result))
+        return std::pair<cv::Mat, cv::Point3d>(cv::Mat::eye(3, 3, CV_64F), cv::Point3d(0, 0, 0));
 
-    return calcRigidBodyTransform(a, cA, cB);
+    return rigid::toPose(result);
 }
 
 std::pair<cv::Mat, cv::Point3d> Hypothesis::calcRigidBodyTransform(cv::Mat& coV, cv::Point3d cA, cv::Point3d cB)
 {
-    cv::SVD svd(coV);
-    cv::Mat u = svd.u;
-    cv::Mat vt = svd.vt;
-    cv::Mat v = vt.t();
-
-    // need to flip rotation?
-    double sign = 1;
-    if(cv::determinant((v*u.t())) < 0)
-        sign = -1;
-    
-    cv::Mat dm(3, 3, CV_64F, 0.0);
-    dm.at<double>(0, 0) = 1;
-    dm.at<double>(1, 1) = 1;
-    dm.at<double>(2, 2) = sign;
-    
-    cv::Mat resultRot = v * dm * u.t();
-    cv::Mat temp = ((-resultRot) * cv::Mat(cA)) + cv::Mat(cB);
-    cv::Point3d resultTrans(temp.at<double>(0, 0),
-                            temp.at<double>(1, 0),
-                            temp.at<double>(2, 0));
-    
-    return std::pair<cv::Mat, cv::Point3d>(resultRot, resultTrans);
+    Eigen::Matrix3d S;
+    for(int r = 0; r < 3; r++)
+    for(int c = 0; c < 3; c++)
+        S(r, c) = coV.at<double>(r, c);
+
+    rigid::Transform result;
+    rigid::fromCovariance(S, Eigen::Vector3d(cA.x, cA.y, cA.z), Eigen::Vector3d(cB.x, cB.y, cB.z), result);
+
+    return rigid::toPose(result);
 }
 
-void Hypothesis::refine(std::vector<std::pair<cv::Point3d, cv::Point3d>> points) 
+void Hypothesis::refine(const std::vector<std::pair<cv::Point3d, cv::Point3d>>& points) 
 {
     this->points.insert(this->points.end(), points.begin(), points.end());
     std::pair<cv::Mat, cv::Point3d> estimates = calcRigidBodyTransform(points);
     this->rotation = estimates.first;
     this->translation = estimates.second;
-    this->invRotation = this->rotation.inv();
+    this->invRotation = this->rotation.t(); // orthonormal
 }
 
 void Hypothesis::refine(cv::Mat& coV, cv::Point3d pointsA, cv::Point3d pointsB)
@@ -254,7 +252,7 @@ void Hypothesis::refine(cv::Mat& coV, cv::Point3d pointsA, cv::Point3d pointsB)
     std::pair<cv::Mat,cv::Point3d> estimates = calcRigidBodyTransform(coV, pointsA, pointsB);
     this->rotation = estimates.first;
     this->translation = estimates.second;
-    this->invRotation = this->rotation.inv();
+    this->invRotation = this->rotation.t(); // orthonormal
 }
 
 cv::Point2d Hypothesis::getCenter() const 
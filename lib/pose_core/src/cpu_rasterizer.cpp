@@ -0,0 +1,392 @@
+#include "cpu_rasterizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <omp.h>
+
+#include "simd_dispatch.h"
+
+void CpuRasterizer::render(const RasterCamera& camera, const std::vector<RenderItem>& items, RenderBuffers& buffers, bool withAttributes)
+{
+  tilesX_ = (camera.width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+  tilesY_ = (camera.height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+  paddedWidth_ = tilesX_ * RASTER_TILE_SIZE;
+  paddedHeight_ = tilesY_ * RASTER_TILE_SIZE;
+
+  const size_t numPixels = (size_t) paddedWidth_ * paddedHeight_;
+  depth_.assign(numPixels, FLT_MAX);
+  triangleIds_.assign(numPixels, -1);
+  bary1_.resize(numPixels);
+  bary2_.resize(numPixels);
+  blockZmax_.assign(numPixels / (RASTER_BLOCK_SIZE * RASTER_BLOCK_SIZE), FLT_MAX);
+
+  setup(camera, items);
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int tile = 0; tile < tilesX_ * tilesY_; tile++)
+    rasterizeTile(tile, camera);
+
+  resolve(camera, items, buffers, withAttributes);
+}
+
+void CpuRasterizer::setup(const RasterCamera& camera, const std::vector<RenderItem>& items)
+{
+  const int numItems = items.size();
+  vertexOffsets_.assign(numItems + 1, 0);
+  faceOffsets_.assign(numItems + 1, 0);
+  for(int i = 0; i < numItems; i++)
+  {
+    vertexOffsets_[i + 1] = vertexOffsets_[i] + items[i].mesh->numVertices();
+    faceOffsets_[i + 1] = faceOffsets_[i] + items[i].mesh->numFaces();
+  }
+  screen_.resize((size_t) vertexOffsets_[numItems] * 3);
+  triangles_.resize(faceOffsets_[numItems]);
+
+  #pragma omp parallel
+  {
+    // one set of bins per thread of the team, the team has a single thread when called from a parallel loop
+    #pragma omp single
+    {
+      const int numThreads = omp_get_num_threads();
+      bins_.resize(numThreads);
+      for(int t = 0; t < numThreads; t++)
+      {
+        bins_[t].resize(tilesX_ * tilesY_);
+        for(size_t b = 0; b < bins_[t].size(); b++)
+          bins_[t][b].clear();
+      }
+    }
+
+    // project the vertices into the image
+    for(int i = 0; i < numItems; i++)
+    {
+      const float* T = items[i].pose;
+      const float* positions = items[i].mesh->positions();
+      float* screen = &screen_[(size_t) vertexOffsets_[i] * 3];
+
+      #pragma omp for
+      for(int v = 0; v < items[i].mesh->numVertices(); v++)
+      {
+        const float* p = positions + 3 * v;
+        float x = T[0] * p[0] + T[1] * p[1] + T[2] * p[2] + T[3];
+        float y = T[4] * p[0] + T[5] * p[1] + T[6] * p[2] + T[7];
+        float z = T[8] * p[0] + T[9] * p[1] + T[10] * p[2] + T[11];
+
+        screen[3 * v] = camera.fx * x / z + camera.px;
+        screen[3 * v + 1] = camera.fy * y / z + camera.py;
+        screen[3 * v + 2] = z;
+      }
+    }
+
+    // set up the triangles and bin them, threads take contiguous ranges so the bins of the
+    // threads in order keep the submission order
+    std::vector<std::vector<int> >& bins = bins_[omp_get_thread_num()];
+
+    #pragma omp for schedule(static)
+    for(int f = 0; f < faceOffsets_[numItems]; f++)
+    {
+      Triangle& tri = triangles_[f];
+      tri.item = std::upper_bound(faceOffsets_.begin(), faceOffsets_.end(), f) - faceOffsets_.begin() - 1;
+      const uint32_t* face = items[tri.item].mesh->indices() + 3 * (f - faceOffsets_[tri.item]);
+
+      int v[3];
+      const float* s[3];
+      for(int k = 0; k < 3; k++)
+      {
+        v[k] = face[k];
+        s[k] = &screen_[(size_t) (vertexOffsets_[tri.item] + v[k]) * 3];
+      }
+
+      // no clipping, triangles reaching in front of the near plane or entirely behind the far plane are dropped
+      float zmin = std::min(s[0][2], std::min(s[1][2], s[2][2]));
+      if(zmin < camera.znear || zmin > camera.zfar)
+        continue;
+
+      float area = (s[1][0] - s[0][0]) * (s[2][1] - s[0][1]) - (s[2][0] - s[0][0]) * (s[1][1] - s[0][1]);
+      if(area == 0 || !std::isfinite(area))
+        continue;
+
+      // both faces are rendered, back faces are turned around
+      if(area < 0)
+      {
+        std::swap(v[1], v[2]);
+        std::swap(s[1], s[2]);
+        area = -area;
+      }
+
+      float minX = std::min(s[0][0], std::min(s[1][0], s[2][0]));
+      float maxX = std::max(s[0][0], std::max(s[1][0], s[2][0]));
+      float minY = std::min(s[0][1], std::min(s[1][1], s[2][1]));
+      float maxY = std::max(s[0][1], std::max(s[1][1], s[2][1]));
+      tri.minX = std::max(0, (int) std::ceil(minX));
+      tri.maxX = std::min(camera.width - 1, (int) std::floor(maxX));
+      tri.minY = std::max(0, (int) std::ceil(minY));
+      tri.maxY = std::min(camera.height - 1, (int) std::floor(maxY));
+      if(tri.minX > tri.maxX || tri.minY > tri.maxY)
+        continue;
+
+      for(int k = 0; k < 3; k++)
+      {
+        const float* a = s[(k + 1) % 3];
+        const float* b = s[(k + 2) % 3];
+        tri.A[k] = a[1] - b[1];
+        tri.B[k] = b[0] - a[0];
+        tri.C[k] = -(tri.A[k] * a[0] + tri.B[k] * a[1]);
+        tri.invZ[k] = 1.f / s[k][2];
+        tri.v[k] = v[k];
+      }
+      tri.invArea = 1.f / area;
+      tri.zmin = zmin;
+
+      for(int ty = tri.minY / RASTER_TILE_SIZE; ty <= tri.maxY / RASTER_TILE_SIZE; ty++)
+        for(int tx = tri.minX / RASTER_TILE_SIZE; tx <= tri.maxX / RASTER_TILE_SIZE; tx++)
+          bins[ty * tilesX_ + tx].push_back(f);
+    }
+  }
+}
+
+void CpuRasterizer::rasterizeTile(int tile, const RasterCamera& camera)
+{
+  const int x0 = (tile % tilesX_) * RASTER_TILE_SIZE;
+  const int y0 = (tile / tilesX_) * RASTER_TILE_SIZE;
+  const bool avx2 = simdHasAVX2();
+
+  for(size_t t = 0; t < bins_.size(); t++)
+  {
+    const std::vector<int>& bin = bins_[t][tile];
+    for(size_t i = 0; i < bin.size(); i++)
+    {
+      const Triangle& tri = triangles_[bin[i]];
+
+      // blocks of the tile covered by the bounding box of the triangle
+      int bx0 = std::max(x0, tri.minX) / RASTER_BLOCK_SIZE;
+      int bx1 = std::min(x0 + RASTER_TILE_SIZE - 1, tri.maxX) / RASTER_BLOCK_SIZE;
+      int by0 = std::max(y0, tri.minY) / RASTER_BLOCK_SIZE;
+      int by1 = std::min(y0 + RASTER_TILE_SIZE - 1, tri.maxY) / RASTER_BLOCK_SIZE;
+
+      for(int by = by0; by <= by1; by++)
+        for(int bx = bx0; bx <= bx1; bx++)
+        {
+          // hierarchical depth test, the block is fully covered by nearer surfaces
+          float& zmax = blockZmax_[by * (paddedWidth_ / RASTER_BLOCK_SIZE) + bx];
+          if(tri.zmin >= zmax)
+            continue;
+
+          bool written = avx2 ? rasterizeBlockAVX2(tri, bin[i], bx, by, camera) : rasterizeBlock(tri, bin[i], bx, by, camera);
+          if(written)
+          {
+            float farthest = 0;
+            for(int y = by * RASTER_BLOCK_SIZE; y < (by + 1) * RASTER_BLOCK_SIZE; y++)
+              for(int x = bx * RASTER_BLOCK_SIZE; x < (bx + 1) * RASTER_BLOCK_SIZE; x++)
+                farthest = std::max(farthest, depth_[(size_t) y * paddedWidth_ + x]);
+            zmax = farthest;
+          }
+        }
+    }
+  }
+}
+
+bool CpuRasterizer::rasterizeBlock(const Triangle& tri, int index, int bx, int by, const RasterCamera& camera)
+{
+  const int x0 = bx * RASTER_BLOCK_SIZE;
+  const int ymin = std::max(by * RASTER_BLOCK_SIZE, tri.minY);
+  const int ymax = std::min((by + 1) * RASTER_BLOCK_SIZE - 1, tri.maxY);
+  bool written = false;
+
+  for(int y = ymin; y <= ymax; y++)
+  {
+    const size_t offset = (size_t) y * paddedWidth_ + x0;
+    for(int i = 0; i < RASTER_BLOCK_SIZE; i++)
+    {
+      const float x = x0 + i;
+      float w[3];
+      bool inside = true;
+      for(int k = 0; k < 3; k++)
+      {
+        float e = tri.A[k] * x + tri.B[k] * y + tri.C[k];
+        inside = inside && e >= 0;
+        w[k] = e * tri.invArea * tri.invZ[k];
+      }
+      if(!inside)
+        continue;
+
+      float z = 1.f / (w[0] + w[1] + w[2]);
+      if(z < depth_[offset + i] && z >= camera.znear && z <= camera.zfar)
+      {
+        depth_[offset + i] = z;
+        triangleIds_[offset + i] = index;
+        bary1_[offset + i] = w[1] * z;
+        bary2_[offset + i] = w[2] * z;
+        written = true;
+      }
+    }
+  }
+
+  return written;
+}
+
+#if defined(SIMD_DISPATCH_AVX2)
+// same as rasterizeBlock, 8 pixels of a row at a time
+SIMD_TARGET_AVX2 bool CpuRasterizer::rasterizeBlockAVX2(const Triangle& tri, int index, int bx, int by, const RasterCamera& camera)
+{
+  const int x0 = bx * RASTER_BLOCK_SIZE;
+  const int ymin = std::max(by * RASTER_BLOCK_SIZE, tri.minY);
+  const int ymax = std::min((by + 1) * RASTER_BLOCK_SIZE - 1, tri.maxY);
+  bool written = false;
+
+  const __m256 vx = _mm256_add_ps(_mm256_set1_ps(x0), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+  const __m256 vzero = _mm256_setzero_ps();
+  const __m256 vone = _mm256_set1_ps(1.f);
+  const __m256 vinvArea = _mm256_set1_ps(tri.invArea);
+  const __m256 vznear = _mm256_set1_ps(camera.znear);
+  const __m256 vzfar = _mm256_set1_ps(camera.zfar);
+  const __m256 vid = _mm256_castsi256_ps(_mm256_set1_epi32(index));
+
+  for(int y = ymin; y <= ymax; y++)
+  {
+    const size_t offset = (size_t) y * paddedWidth_ + x0;
+
+    // edge functions of 8 pixels, scaled to barycentrics
+    __m256 l[3];
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for(int k = 0; k < 3; k++)
+    {
+      __m256 e = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(tri.A[k]), vx), _mm256_set1_ps(tri.B[k] * y + tri.C[k]));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(e, vzero, _CMP_GE_OQ));
+      l[k] = _mm256_mul_ps(e, vinvArea);
+    }
+    if(!_mm256_movemask_ps(inside))
+      continue;
+
+    // depth is interpolated linearly in 1 / z
+    __m256 w0 = _mm256_mul_ps(l[0], _mm256_set1_ps(tri.invZ[0]));
+    __m256 w1 = _mm256_mul_ps(l[1], _mm256_set1_ps(tri.invZ[1]));
+    __m256 w2 = _mm256_mul_ps(l[2], _mm256_set1_ps(tri.invZ[2]));
+    __m256 z = _mm256_div_ps(vone, _mm256_add_ps(w0, _mm256_add_ps(w1, w2)));
+
+    __m256 depth = _mm256_loadu_ps(&depth_[offset]);
+    __m256 pass = _mm256_and_ps(inside, _mm256_cmp_ps(z, depth, _CMP_LT_OQ));
+    pass = _mm256_and_ps(pass, _mm256_cmp_ps(z, vznear, _CMP_GE_OQ));
+    pass = _mm256_and_ps(pass, _mm256_cmp_ps(z, vzfar, _CMP_LE_OQ));
+    if(!_mm256_movemask_ps(pass))
+      continue;
+
+    _mm256_storeu_ps(&depth_[offset], _mm256_blendv_ps(depth, z, pass));
+    float* ids = reinterpret_cast<float*>(&triangleIds_[offset]);
+    _mm256_storeu_ps(ids, _mm256_blendv_ps(_mm256_loadu_ps(ids), vid, pass));
+    _mm256_storeu_ps(&bary1_[offset], _mm256_blendv_ps(_mm256_loadu_ps(&bary1_[offset]), _mm256_mul_ps(w1, z), pass));
+    _mm256_storeu_ps(&bary2_[offset], _mm256_blendv_ps(_mm256_loadu_ps(&bary2_[offset]), _mm256_mul_ps(w2, z), pass));
+    written = true;
+  }
+
+  return written;
+}
+#else
+bool CpuRasterizer::rasterizeBlockAVX2(const Triangle& tri, int index, int bx, int by, const RasterCamera& camera)
+{
+  return rasterizeBlock(tri, index, bx, by, camera);
+}
+#endif
+
+void CpuRasterizer::resolve(const RasterCamera& camera, const std::vector<RenderItem>& items, RenderBuffers& buffers, bool withAttributes)
+{
+  const int numPixels = camera.width * camera.height;
+  buffers.depth.assign(numPixels, 0);
+  buffers.objectIds.assign(numPixels, 0);
+  if(withAttributes)
+  {
+    buffers.vertices.assign(numPixels * 3, 0);
+    buffers.normals.assign(numPixels * 3, 0);
+    buffers.colors.assign(numPixels * 3, 0);
+  }
+
+  #pragma omp parallel for
+  for(int y = 0; y < camera.height; y++)
+    for(int x = 0; x < camera.width; x++)
+    {
+      const size_t src = (size_t) y * paddedWidth_ + x;
+      const int index = triangleIds_[src];
+      if(index < 0)
+        continue;
+
+      const int dst = y * camera.width + x;
+      const Triangle& tri = triangles_[index];
+      const RenderItem& item = items[tri.item];
+      buffers.depth[dst] = depth_[src];
+      buffers.objectIds[dst] = item.objectId;
+
+      if(!withAttributes)
+        continue;
+
+      const float b[3] = {1.f - bary1_[src] - bary2_[src], bary1_[src], bary2_[src]};
+      const float* positions = item.mesh->positions();
+      const float* normals = item.mesh->normals();
+      float n[3] = {0, 0, 0};
+
+      for(int k = 0; k < 3; k++)
+        for(int c = 0; c < 3; c++)
+        {
+          buffers.vertices[3 * dst + c] += b[k] * positions[3 * tri.v[k] + c];
+          if(normals)
+            n[c] += b[k] * normals[3 * tri.v[k] + c];
+        }
+
+      // meshes without normals get the face normal, facing the camera
+      if(!normals)
+      {
+        const float* p0 = positions + 3 * tri.v[0];
+        const float* p1 = positions + 3 * tri.v[1];
+        const float* p2 = positions + 3 * tri.v[2];
+        float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+      }
+
+      // rotate into the camera frame
+      const float* T = item.pose;
+      float nc[3];
+      for(int r = 0; r < 3; r++)
+        nc[r] = T[4 * r] * n[0] + T[4 * r + 1] * n[1] + T[4 * r + 2] * n[2];
+
+      float length = std::sqrt(nc[0] * nc[0] + nc[1] * nc[1] + nc[2] * nc[2]);
+      if(length > 0)
+      {
+        if(!normals && nc[2] > 0)
+          length = -length;
+        for(int c = 0; c < 3; c++)
+          buffers.normals[3 * dst + c] = nc[c] / length;
+      }
+
+      // nearest texel, texture coordinates repeat like the GL default
+      float* color = &buffers.colors[3 * dst];
+      const float* texCoords = item.mesh->texCoords();
+      const float* colors = item.mesh->colors();
+      if(item.mesh->hasTexture() && texCoords)
+      {
+        float uv[2] = {0, 0};
+        for(int k = 0; k < 3; k++)
+          for(int c = 0; c < 2; c++)
+            uv[c] += b[k] * texCoords[2 * tri.v[k] + c];
+
+        const int w = item.mesh->textureWidth();
+        const int h = item.mesh->textureHeight();
+        const int tx = std::min(w - 1, (int) ((uv[0] - std::floor(uv[0])) * w));
+        const int ty = std::min(h - 1, (int) ((uv[1] - std::floor(uv[1])) * h));
+        const uint8_t* texel = item.mesh->texture() + 3 * ((size_t) ty * w + tx);
+        for(int c = 0; c < 3; c++)
+          color[c] = texel[c] / 255.f;
+      }
+      else if(colors)
+      {
+        for(int k = 0; k < 3; k++)
+          for(int c = 0; c < 3; c++)
+            color[c] += b[k] * colors[3 * tri.v[k] + c];
+      }
+      else
+        std::fill(color, color + 3, 1.f);
+    }
+}
@@ -0,0 +1,243 @@
+#include "mesh_cache.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MESH_CACHE_ALIGNMENT 16 // alignment of the sections
+
+namespace
+{
+  // size and modification time of a file, false if it does not exist
+  bool fileStamp(const std::string& filename, uint64_t& size, int64_t& time)
+  {
+    struct stat st;
+    if(filename.empty() || stat(filename.c_str(), &st) != 0)
+      return false;
+    size = st.st_size;
+    time = st.st_mtime;
+    return true;
+  }
+
+  uint64_t align(uint64_t offset)
+  {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+  }
+
+  // reserves a section of the given size, returns its offset or 0 if it is empty
+  uint64_t section(uint64_t& end, size_t bytes)
+  {
+    if(bytes == 0) return 0;
+    uint64_t offset = align(end);
+    end = offset + bytes;
+    return offset;
+  }
+}
+
+MeshCache::MeshCache()
+: mapping_(NULL), mappingSize_(0)
+{
+  close();
+}
+
+MeshCache::~MeshCache()
+{
+  close();
+}
+
+void MeshCache::close()
+{
+  if(mapping_)
+    munmap(mapping_, mappingSize_);
+  mapping_ = NULL;
+  mappingSize_ = 0;
+  owned_ = MeshData();
+
+  numVertices_ = 0;
+  numFaces_ = 0;
+  positions_ = normals_ = texCoords_ = colors_ = NULL;
+  indices_ = NULL;
+  texture_ = NULL;
+  textureWidth_ = textureHeight_ = 0;
+  for(int i = 0; i < 3; i++)
+    extentsMin_[i] = extentsMax_[i] = 0;
+}
+
+bool MeshCache::open(const std::string& filename, const std::string& source)
+{
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(MeshCacheHeader))
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(mapping == MAP_FAILED)
+    return false;
+  mapping_ = mapping;
+  mappingSize_ = st.st_size;
+
+  const char* data = static_cast<const char*>(mapping_);
+  const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(data);
+
+  if(memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != MESH_CACHE_VERSION)
+  {
+    std::cout << "Mesh cache " << filename << " is corrupt or of an unknown version" << std::endl;
+    close();
+    return false;
+  }
+
+  // a cache is rebuilt when its model file changed, caches without model file are used as they are
+  uint64_t sourceSize;
+  int64_t sourceTime;
+  if(fileStamp(source, sourceSize, sourceTime) && (sourceSize != header->sourceSize || sourceTime != header->sourceTime))
+  {
+    std::cout << "Mesh cache " << filename << " is older than " << source << std::endl;
+    close();
+    return false;
+  }
+
+  // every section has to lie within the file
+  uint64_t nV = header->numVertices;
+  uint64_t nF = header->numFaces;
+  uint64_t texels = (uint64_t) header->textureWidth * header->textureHeight * 3;
+  struct { uint64_t offset; uint64_t bytes; bool required; } sections[] = {
+    {header->positions, nV * 3 * sizeof(float), true},
+    {header->normals, nV * 3 * sizeof(float), false},
+    {header->texCoords, nV * 2 * sizeof(float), false},
+    {header->colors, nV * 3 * sizeof(float), false},
+    {header->indices, nF * 3 * sizeof(uint32_t), true},
+    {header->texture, texels, false}};
+
+  for(int s = 0; s < 6; s++)
+  {
+    bool empty = sections[s].bytes == 0;
+    bool valid = sections[s].offset == 0 ? (!sections[s].required || empty)
+      : (sections[s].offset % MESH_CACHE_ALIGNMENT == 0 && sections[s].offset + sections[s].bytes <= mappingSize_);
+    if(!valid)
+    {
+      std::cout << "Mesh cache " << filename << " is truncated" << std::endl;
+      close();
+      return false;
+    }
+  }
+
+  // every face has to index existing vertices, checked once here instead of on every draw
+  const uint32_t* indices = header->indices ? reinterpret_cast<const uint32_t*>(data + header->indices) : NULL;
+  for(uint64_t i = 0; i < nF * 3; i++)
+  {
+    if(indices[i] >= nV)
+    {
+      std::cout << "Mesh cache " << filename << " has a vertex index out of range" << std::endl;
+      close();
+      return false;
+    }
+  }
+
+  numVertices_ = nV;
+  numFaces_ = nF;
+  positions_ = header->positions ? reinterpret_cast<const float*>(data + header->positions) : NULL;
+  normals_ = header->normals ? reinterpret_cast<const float*>(data + header->normals) : NULL;
+  texCoords_ = header->texCoords ? reinterpret_cast<const float*>(data + header->texCoords) : NULL;
+  colors_ = header->colors ? reinterpret_cast<const float*>(data + header->colors) : NULL;
+  indices_ = header->indices ? reinterpret_cast<const uint32_t*>(data + header->indices) : NULL;
+  texture_ = header->texture ? reinterpret_cast<const uint8_t*>(data + header->texture) : NULL;
+  textureWidth_ = texture_ ? header->textureWidth : 0;
+  textureHeight_ = texture_ ? header->textureHeight : 0;
+  for(int i = 0; i < 3; i++)
+  {
+    extentsMin_[i] = header->extentsMin[i];
+    extentsMax_[i] = header->extentsMax[i];
+  }
+  return true;
+}
+
+void MeshCache::assign(MeshData& mesh)
+{
+  close();
+  std::swap(owned_, mesh);
+  point(owned_);
+}
+
+void MeshCache::point(const MeshData& mesh)
+{
+  numVertices_ = mesh.positions.size() / 3;
+  numFaces_ = mesh.indices.size() / 3;
+  positions_ = mesh.positions.empty() ? NULL : mesh.positions.data();
+  normals_ = mesh.normals.empty() ? NULL : mesh.normals.data();
+  texCoords_ = mesh.texCoords.empty() ? NULL : mesh.texCoords.data();
+  colors_ = mesh.colors.empty() ? NULL : mesh.colors.data();
+  indices_ = mesh.indices.empty() ? NULL : mesh.indices.data();
+  texture_ = mesh.texture.empty() ? NULL : mesh.texture.data();
+  textureWidth_ = texture_ ? mesh.textureWidth : 0;
+  textureHeight_ = texture_ ? mesh.textureHeight : 0;
+  for(int i = 0; i < 3; i++)
+  {
+    extentsMin_[i] = mesh.extentsMin[i];
+    extentsMax_[i] = mesh.extentsMax[i];
+  }
+}
+
+bool MeshCache::write(const std::string& filename, const MeshData& mesh, const std::string& source)
+{
+  MeshCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+  header.version = MESH_CACHE_VERSION;
+  header.numVertices = mesh.positions.size() / 3;
+  header.numFaces = mesh.indices.size() / 3;
+  if(!mesh.texture.empty())
+  {
+    header.textureWidth = mesh.textureWidth;
+    header.textureHeight = mesh.textureHeight;
+  }
+  fileStamp(source, header.sourceSize, header.sourceTime);
+  for(int i = 0; i < 3; i++)
+  {
+    header.extentsMin[i] = mesh.extentsMin[i];
+    header.extentsMax[i] = mesh.extentsMax[i];
+  }
+
+  uint64_t end = sizeof(header);
+  header.positions = section(end, mesh.positions.size() * sizeof(float));
+  header.normals = section(end, mesh.normals.size() * sizeof(float));
+  header.texCoords = section(end, mesh.texCoords.size() * sizeof(float));
+  header.colors = section(end, mesh.colors.size() * sizeof(float));
+  header.indices = section(end, mesh.indices.size() * sizeof(uint32_t));
+  header.texture = section(end, mesh.texture.size());
+
+  // write to a private file and rename it, so readers see either no cache or a complete one
+  std::string tmpName = filename + ".tmp" + std::to_string(getpid());
+  FILE* fp = fopen(tmpName.c_str(), "wb");
+  if(!fp)
+    return false;
+
+  std::vector<char> buffer(end, 0);
+  memcpy(buffer.data(), &header, sizeof(header));
+  if(header.positions) memcpy(buffer.data() + header.positions, mesh.positions.data(), mesh.positions.size() * sizeof(float));
+  if(header.normals) memcpy(buffer.data() + header.normals, mesh.normals.data(), mesh.normals.size() * sizeof(float));
+  if(header.texCoords) memcpy(buffer.data() + header.texCoords, mesh.texCoords.data(), mesh.texCoords.size() * sizeof(float));
+  if(header.colors) memcpy(buffer.data() + header.colors, mesh.colors.data(), mesh.colors.size() * sizeof(float));
+  if(header.indices) memcpy(buffer.data() + header.indices, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+  if(header.texture) memcpy(buffer.data() + header.texture, mesh.texture.data(), mesh.texture.size());
+
+  bool ok = fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size();
+  ok = (fclose(fp) == 0) && ok;
+  ok = ok && rename(tmpName.c_str(), filename.c_str()) == 0;
+  if(!ok)
+    remove(tmpName.c_str());
+  return ok;
+}
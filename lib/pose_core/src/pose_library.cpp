@@ -0,0 +1,210 @@
+#include "pose_library.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PoseLibrary::PoseLibrary()
+: numClasses_(0), offsets_(NULL), poses_(NULL), mapping_(NULL), mappingSize_(0)
+{
+  textOffsets_.assign(1, 0);
+  offsets_ = textOffsets_.data();
+}
+
+PoseLibrary::~PoseLibrary()
+{
+  close();
+}
+
+void PoseLibrary::close()
+{
+  if(mapping_)
+    munmap(mapping_, mappingSize_);
+  mapping_ = NULL;
+  mappingSize_ = 0;
+
+  textOffsets_.assign(1, 0);
+  textPoses_.clear();
+
+  numClasses_ = 0;
+  offsets_ = textOffsets_.data();
+  poses_ = NULL;
+}
+
+bool PoseLibrary::isBinary(const std::string& filename)
+{
+  char magic[8] = {0};
+  FILE* fp = fopen(filename.c_str(), "rb");
+  if(!fp) return false;
+  size_t n = fread(magic, 1, sizeof(magic), fp);
+  fclose(fp);
+  return n == sizeof(magic) && memcmp(magic, POSE_LIBRARY_MAGIC, sizeof(magic)) == 0;
+}
+
+bool PoseLibrary::load(const std::string& filename)
+{
+  if(isBinary(filename))
+    return open(filename);
+
+  // list of text pose files, one per class
+  std::ifstream stream(filename);
+  if(!stream)
+  {
+    std::cout << "Cannot open pose list " << filename << std::endl;
+    return false;
+  }
+
+  std::vector<std::string> filenames;
+  std::string name;
+  while(std::getline(stream, name))
+  {
+    if(name.empty()) continue;
+    std::cout << name << std::endl;
+    filenames.push_back(name);
+  }
+
+  std::cout << "Text pose files are loaded into private memory, convert them with convert_poses to share them" << std::endl;
+  return loadText(filenames);
+}
+
+bool PoseLibrary::open(const std::string& filename)
+{
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if(fd < 0)
+  {
+    std::cout << "Cannot open pose library " << filename << std::endl;
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(PoseLibraryHeader))
+  {
+    std::cout << "Pose library " << filename << " is truncated" << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  // shared read-only mapping, the page cache holds a single copy for all processes
+  void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(mapping == MAP_FAILED)
+  {
+    std::cout << "Cannot map pose library " << filename << std::endl;
+    return false;
+  }
+  mapping_ = mapping;
+  mappingSize_ = st.st_size;
+
+  const char* data = static_cast<const char*>(mapping_);
+  const PoseLibraryHeader* header = reinterpret_cast<const PoseLibraryHeader*>(data);
+  size_t posesBegin = sizeof(PoseLibraryHeader) + sizeof(uint64_t) * ((size_t) header->numClasses + 1);
+
+  bool valid = memcmp(header->magic, POSE_LIBRARY_MAGIC, sizeof(header->magic)) == 0
+    && header->version == POSE_LIBRARY_VERSION
+    && posesBegin <= mappingSize_;
+
+  if(valid)
+  {
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(data + sizeof(PoseLibraryHeader));
+    valid = offsets[0] == 0;
+    for(uint32_t c = 0; valid && c < header->numClasses; c++)
+      valid = offsets[c] <= offsets[c + 1];
+    valid = valid && posesBegin + offsets[header->numClasses] * POSE_RECORD_SIZE * sizeof(float) == mappingSize_;
+
+    if(valid)
+    {
+      numClasses_ = header->numClasses;
+      offsets_ = offsets;
+      poses_ = reinterpret_cast<const float*>(data + posesBegin);
+    }
+  }
+
+  if(!valid)
+  {
+    std::cout << "Pose library " << filename << " is corrupt or of an unknown version" << std::endl;
+    close();
+    return false;
+  }
+
+  std::cout << "Mapped pose library " << filename << ": " << numClasses_ << " classes, " << offsets_[numClasses_] << " poses" << std::endl;
+  return true;
+}
+
+bool PoseLibrary::loadText(const std::vector<std::string>& filenames)
+{
+  close();
+
+  textOffsets_.assign(1, 0);
+  for(size_t m = 0; m < filenames.size(); m++)
+  {
+    // read the whole file and parse it in one pass
+    std::ifstream stream(filenames[m], std::ios::binary);
+    if(!stream)
+    {
+      std::cout << "Cannot open pose file " << filenames[m] << std::endl;
+      close();
+      return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+    size_t begin = textPoses_.size();
+    const char* p = text.c_str();
+    char* end;
+    for(float value = strtof(p, &end); end != p; value = strtof(p, &end))
+    {
+      textPoses_.push_back(value);
+      p = end;
+    }
+
+    size_t count = textPoses_.size() - begin;
+    if(count % POSE_RECORD_SIZE != 0)
+    {
+      std::cout << "Pose file " << filenames[m] << " does not contain " << POSE_RECORD_SIZE << " values per pose, skipping the incomplete pose" << std::endl;
+      textPoses_.resize(textPoses_.size() - count % POSE_RECORD_SIZE);
+    }
+    textOffsets_.push_back(textPoses_.size() / POSE_RECORD_SIZE);
+
+    std::cout << filenames[m] << ": " << textOffsets_[m + 1] - textOffsets_[m] << " poses" << std::endl;
+  }
+
+  numClasses_ = filenames.size();
+  offsets_ = textOffsets_.data();
+  poses_ = textPoses_.data();
+  return true;
+}
+
+bool PoseLibrary::write(const std::string& filename) const
+{
+  FILE* fp = fopen(filename.c_str(), "wb");
+  if(!fp)
+  {
+    std::cout << "Cannot write pose library " << filename << std::endl;
+    return false;
+  }
+
+  PoseLibraryHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, POSE_LIBRARY_MAGIC, sizeof(header.magic));
+  header.version = POSE_LIBRARY_VERSION;
+  header.numClasses = numClasses_;
+
+  size_t numPoses = offsets_[numClasses_];
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+    && fwrite(offsets_, sizeof(uint64_t), numClasses_ + 1, fp) == (size_t) numClasses_ + 1
+    && fwrite(poses_, sizeof(float) * POSE_RECORD_SIZE, numPoses, fp) == numPoses;
+  ok = (fclose(fp) == 0) && ok;
+
+  if(!ok)
+    std::cout << "Cannot write pose library " << filename << std::endl;
+  return ok;
+}
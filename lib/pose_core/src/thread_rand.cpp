@@ -26,70 +26,66 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "thread_rand.h"
-#include <omp.h>
+#include <atomic>
 
-std::vector<std::mt19937> ThreadRand::generators;
-bool ThreadRand::initialised = false;
+static std::atomic<unsigned> randSeed(1305); // seed of the generators
+static std::atomic<unsigned> randEpoch(0); // incremented by forceInit, generators created before are re-created
+static std::atomic<unsigned> randThreads(0); // number of threads that were assigned a stream
+
+// streams of calls without thread ID, above the range of explicit thread IDs
+#define THREAD_STREAM_OFFSET 0x80000000u
 
 void ThreadRand::forceInit(unsigned seed)
 {
-    initialised = false;
-    init(seed);
+    randSeed = seed;
+    randEpoch++;
 }
 
-void ThreadRand::init(unsigned seed)
+Philox& ThreadRand::generator(int tid)
 {
-    #pragma omp critical
+    static thread_local std::vector<Philox> gens; // generators of explicit thread IDs, indexed by ID
+    static thread_local std::vector<unsigned> gensEpoch;
+    static thread_local Philox gen; // generator of the calling thread
+    static thread_local unsigned genEpoch = (unsigned) -1;
+    static thread_local unsigned threadStream = THREAD_STREAM_OFFSET + randThreads++;
+
+    unsigned epoch = randEpoch;
+    if(tid < 0)
     {
-	if(!initialised)
+	if(genEpoch != epoch)
 	{
-	    unsigned nThreads = omp_get_max_threads();
-	    
-	    for(unsigned i = 0; i < nThreads; i++)
-	    {    
-		generators.push_back(std::mt19937());
-		generators[i].seed(i+seed);
-	    }
-
-	    initialised = true;
-	}    
+	    gen = Philox(0, threadStream, randSeed);
+	    genEpoch = epoch;
+	}
+	return gen;
+    }
+
+    if((int) gens.size() <= tid)
+    {
+	gens.resize(tid + 1);
+	gensEpoch.resize(tid + 1, (unsigned) -1);
+    }
+    if(gensEpoch[tid] != epoch)
+    {
+	gens[tid] = Philox(0, tid, randSeed);
+	gensEpoch[tid] = epoch;
     }
+    return gens[tid];
 }
 
 int ThreadRand::irand(int min, int max, int tid)
 {
-    std::uniform_int_distribution<int> dist(min, max);
-
-    unsigned threadID = omp_get_thread_num();
-    if(tid >= 0) threadID = tid;
-    
-    if(!initialised) init();
-  
-    return dist(ThreadRand::generators[threadID]);
+    return generator(tid).irand(min, max + 1);
 }
 
 double ThreadRand::drand(double min, double max, int tid)
 {
-    std::uniform_real_distribution<double> dist(min, max);
-    
-    unsigned threadID = omp_get_thread_num();
-    if(tid >= 0) threadID = tid;
-
-    if(!initialised) init();
-
-    return dist(ThreadRand::generators[threadID]);
+    return generator(tid).drand(min, max);
 }
 
 double ThreadRand::dgauss(double mean, double stdDev, int tid)
 {
-    std::normal_distribution<double> dist(mean, stdDev);
-    
-    unsigned threadID = omp_get_thread_num();
-    if(tid >= 0) threadID = tid;
-
-    if(!initialised) init();
-
-    return dist(ThreadRand::generators[threadID]);
+    return generator(tid).dgauss(mean, stdDev);
 }
 
 int irand(int incMin, int excMax, int tid)
@@ -0,0 +1,61 @@
+/**
+ * Builds the mesh caches of the models in a model list (one model file per line, as read by the
+ * Synthesizer and the Refiner), so that no process has to run assimp at start-up.
+ *
+ * Usage: build_mesh_cache <model list>
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include "mesh_import.h"
+
+int main(int argc, char** argv)
+{
+  if(argc != 2)
+  {
+    std::cout << "Usage: " << argv[0] << " <model list>" << std::endl;
+    return 1;
+  }
+
+  std::ifstream stream(argv[1]);
+  if(!stream)
+  {
+    std::cout << "Cannot open model list " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::string name;
+  while(std::getline(stream, name))
+  {
+    if(name.empty()) continue;
+
+    MeshData mesh;
+    importMesh(name, mesh);
+
+    const std::string cacheName = name + MESH_CACHE_SUFFIX;
+    if(!MeshCache::write(cacheName, mesh, name))
+    {
+      std::cout << "Cannot write mesh cache " << cacheName << std::endl;
+      return 1;
+    }
+
+    // read the cache back and compare it with the imported mesh
+    MeshCache cache;
+    bool ok = cache.open(cacheName, name)
+      && cache.numVertices() * 3 == (int) mesh.positions.size()
+      && cache.numFaces() * 3 == (int) mesh.indices.size()
+      && memcmp(cache.positions(), mesh.positions.data(), mesh.positions.size() * sizeof(float)) == 0
+      && memcmp(cache.indices(), mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t)) == 0
+      && cache.hasTexture() == !mesh.texture.empty();
+    if(!ok)
+    {
+      std::cout << "Mesh cache " << cacheName << " does not match " << name << std::endl;
+      return 1;
+    }
+
+    std::cout << "Wrote " << cacheName << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,54 @@
+/**
+ * Converts a list of text pose files (one file per class, one pose "qw qx qy qz tx ty tz" per line)
+ * into a binary pose library that the Synthesizer memory maps.
+ *
+ * Usage: convert_poses <pose list> <output library>
+ */
+
+#include <iostream>
+#include <cmath>
+
+#include "pose_library.h"
+
+int main(int argc, char** argv)
+{
+  if(argc != 3)
+  {
+    std::cout << "Usage: " << argv[0] << " <pose list> <output library>" << std::endl;
+    return 1;
+  }
+
+  PoseLibrary text;
+  if(PoseLibrary::isBinary(argv[1]) || !text.load(argv[1]))
+  {
+    std::cout << argv[1] << " is not a list of text pose files" << std::endl;
+    return 1;
+  }
+
+  if(!text.write(argv[2]))
+    return 1;
+
+  // read the result back and compare it with the text files
+  PoseLibrary binary;
+  if(!binary.open(argv[2]) || binary.numClasses() != text.numClasses())
+    return 1;
+
+  for(int c = 0; c < text.numClasses(); c++)
+  {
+    if(binary.size(c) != text.size(c))
+    {
+      std::cout << "Class " << c << ": pose count mismatch" << std::endl;
+      return 1;
+    }
+
+    for(int i = 0; i < text.size(c) * POSE_RECORD_SIZE; i++)
+      if(binary.poses(c)[i] != text.poses(c)[i] && !(std::isnan(binary.poses(c)[i]) && std::isnan(text.poses(c)[i])))
+      {
+        std::cout << "Class " << c << ": pose mismatch" << std::endl;
+        return 1;
+      }
+  }
+
+  std::cout << "Wrote " << argv[2] << std::endl;
+  return 0;
+}
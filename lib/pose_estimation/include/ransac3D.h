@@ -29,10 +29,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "types.h"
 #include "util.h"
-#include "sampler2D.h"
+#include "properties.h"
+#include "ransac.h"
+#include "inlier_scoring.h"
+#include "depth_cache.h"
 #include "detection.h"
 #include "stop_watch.h"
+#include "ransac_schedule.h"
 #include "Hypothesis.h"
+#include "rigid_solve.h"
 
 #include <nlopt.hpp>
 #include <omp.h>
@@ -41,75 +46,6 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace jp {
 
 
-    /**
-     * @brief Struct that bundels data that is held per pose hypothesis during optimization.
-     */
-    struct TransHyp
-    {
-	TransHyp() {}
-	TransHyp(jp::id_t objID, jp::cv_trans_t pose) : pose(pose), objID(objID), inliers(0), maxPixels(0), effPixels(0), refSteps(0), likelihood(0) {}
-        TransHyp(jp::id_t objID, cv::Point2d center) : center(center), objID(objID), inliers(0), maxPixels(0), effPixels(0), refSteps(0), likelihood(0) {}
-      
-	jp::id_t objID; // ID of the object this hypothesis belongs to
-	jp::cv_trans_t pose; // the actual transformation
-
-        cv::Point2d center; // object center
-        float width_;
-        float height_;
-	
-	cv::Rect bb; // 2D bounding box of the object under this pose hypothesis
-	
-	std::vector<std::pair<cv::Point3d, cv::Point3d> > inlierPts; // list of object coordinate - camera coordinate correspondences that support this hypothesis
-	std::vector<std::pair<cv::Point2d, cv::Point2d> > inlierPts2D; // list of object coordinate - camera coordinate correspondences that support this hypothesis
-	
-	int maxPixels; // how many pixels should be maximally drawn to score this hyp
-	int effPixels; // how many pixels habe effectively drawn (bounded by projection size)
-	
-	int inliers; // how many of them were inliers
-	float likelihood; // likelihood of this hypothesis (optimization using uncertainty)
-
-	int refSteps; // how many iterations has this hyp been refined?
-	
-	/**
-	 * @brief Returns a score for this hypothesis used to sort in preemptive RANSAC.
-	 * 
-	 * @return float Score.
-	 */
-	float getScore() const 	{ return inliers; }
-	
-	/**
-	 * @brief Fraction of inlier pixels as determined by RANSAC.
-	 * 
-	 * @return float Fraction of inliers.
-	 */	
-	float getInlierRate() const { return inliers / (float) effPixels; }
-	
-	/**
-	 * @brief Operator used in sorting hypothesis. Compares scores.
-	 * 
-	 * @return bool True if this hypothesis' score is bigger.
-	 */
-	bool operator < (const TransHyp& hyp) const { return (getScore() > hyp.getScore()); }
-
-        void compute_width_height()
-        {
-          float w = -1;
-          float h = -1;
-          for(int i = 0; i < inliers; i++)
-          {
-            float x = fabs(inlierPts2D[i].second.x - center.x);
-            float y = fabs(inlierPts2D[i].second.y - center.y);
-            if (x > w)
-              w = x;
-            if (y > h)
-              h = y;
-          }
-          width_ = 2 * w;
-          height_ = 2 * h;
-        }
-    };
-
-
 /**
  * @brief RANSAC class of finding poses based on object coordinate predictions in the RGB-D case.
  */
@@ -126,12 +62,8 @@ public:
 
     inline void updateHyp2D(TransHyp& hyp, int maxPixels);
     
-    void createSamplers(std::vector<Sampler2D>& samplers, const std::vector<jp::img_stat_t>& probs, int imageWidth, int imageHeight);
-    
-    inline jp::id_t drawObjID(const cv::Point2f& pt, const std::vector<jp::img_stat_t>& probs);
-    
-    std::vector<TransHyp*> getWorkingQueue(std::map<jp::id_t, std::vector<TransHyp>>& hypMap, int maxIt);
-    
+    inline jp::id_t drawObjID(const cv::Point2f& pt, const std::vector<jp::view_stat_t>& probs, Philox& rng);
+
     float estimatePose(
 	unsigned char* rawdepth,
         float* probability, float* vertmap, float* extents,
@@ -141,46 +73,45 @@ public:
         float* probability, float* vertmap,
         int width, int height, int num_classes, float* output);
 
-    void getEye(unsigned char* rawdepth, jp::img_coord_t& img, jp::img_depth_t& img_depth, int width, int height, float fx, float fy, float px, float py, float depth_factor);
-    jp::coord3_t pxToEye(int x, int y, jp::depth_t depth, float fx, float fy, float px, float py, float depth_factor);
-
-    void getProbs(float* probability, std::vector<jp::img_stat_t>& probs, int width, int height, int num_classes);
+    void getProbs(float* probability, std::vector<jp::view_stat_t>& probs, int width, int height, int num_classes);
 
     void getLabels(float* probability, std::vector<std::vector<int>>& labels, std::vector<int>& object_ids, int width, int height, int num_classes, int minArea);
 
-    void getVertexs(float* vertmap, std::vector<jp::img_coord_t>& vertexs, int width, int height, int num_classes);
+    void getVertexs(float* vertmap, std::vector<jp::view_coord_t>& vertexs, int width, int height, int num_classes);
 
-    void getCenters(float* vertmap, std::vector<jp::img_center_t>& vertexs, int width, int height, int num_classes);
+    void getCenters(float* vertmap, std::vector<jp::view_center_t>& vertexs, int width, int height, int num_classes);
 
     void getBb3Ds(float* extents, std::vector<std::vector<cv::Point3f>>& bb3Ds, int num_classes);
     
 private:
  
-    inline void countInliers3D(
+    inline long countInliers3D(
       TransHyp& hyp,
-      const std::vector<jp::img_coord_t>& vertexs,
+      const std::vector<jp::view_coord_t>& vertexs,
       const jp::img_coord_t& eyeData,
       float inlierThreshold,
       int minArea,
-      int pixelBatch);
+      int pixelBatch,
+      SPRT test);
 
-    inline void countInliers2D(
+    inline long countInliers2D(
       TransHyp& hyp,
-      const std::vector<jp::img_center_t>& vertexs,
+      const std::vector<jp::view_center_t>& vertexs,
       const std::vector<std::vector<int>>& labels,
       float inlierThreshold,
       int width,
-      int pixelBatch);
+      int pixelBatch,
+      SPRT test);
   
     inline cv::Point3f getMode(
 	jp::id_t objID,
 	const cv::Point2f& pt, 
-	const std::vector<jp::img_coord_t>& vertexs);
+	const std::vector<jp::view_coord_t>& vertexs);
 
     inline cv::Point2f getMode2D(
 	jp::id_t objID,
 	const cv::Point2f& pt, 
-	const std::vector<jp::img_center_t>& vertexs);
+	const std::vector<jp::view_center_t>& vertexs);
 
     template<class T>
     inline double getMinDist(const std::vector<T>& pointSet, const T& point);
@@ -193,14 +124,12 @@ private:
 	const cv::Point3f& pt2, 
 	const cv::Point3f& pt3);
 
-    inline float point2line(cv::Point2d p, cv::Point2f n, cv::Point2f x);
-    
     inline bool samplePoint(
 	jp::id_t objID,
 	std::vector<cv::Point3f>& eyePts, 
 	std::vector<cv::Point3f>& objPts, 
 	const cv::Point2f& pt2D,
-	const std::vector<jp::img_coord_t>& vertexs,
+	const std::vector<jp::view_coord_t>& vertexs,
 	const jp::img_coord_t& eyeData,
 	float minDist3D);
 
@@ -209,10 +138,13 @@ private:
         std::vector<cv::Point2f>& eyePts, 
         std::vector<cv::Point2f>& objPts, 
         const cv::Point2f& pt2D,
-        const std::vector<jp::img_center_t>& vertexs);
+        const std::vector<jp::view_center_t>& vertexs);
     
 public:
     std::map<jp::id_t, TransHyp> poses; // Poses that have been estimated. At most one per object. Run estimatePose to fill this member.
+    RansacSchedule schedule; // schedule of the preemptive RANSAC, also holds the statistics of the last estimation
+    uint32_t frame; // number of estimations so far, selects the random streams of the hypothesis sampling
+    DepthCache depth; // camera coordinates of the last depth frame
 };
 
     /**
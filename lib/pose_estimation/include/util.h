@@ -89,16 +89,6 @@ std::string intToString(int number, int minLength = 0);
 */
 std::string floatToString(float number);
  
-/**
- * @brief Clamps a value at the given min and max values.
- * 
- * @param val Value to clamp.
- * @param min_val Minimal allowed value.
- * @param max_val Maximal allowed value.
- * @return int Clamped value.
- */
-int clamp(int val, int min_val, int max_val);
-
 /**
  * @brief Returns a list of directories contained under the given path. The directories are full paths, i.e. they contain the base path.
  * 
@@ -29,14 +29,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using namespace jp;
 
-Ransac3D::Ransac3D()
+Ransac3D::Ransac3D() : frame(0)
 {
 }
 
 /**
  * @brief Thin out the inlier correspondences of the given hypothesis if there are too many. For runtime speed.
  * 
- * @param hyp Output parameter. Inlier correspondences stored in this hypothesis will the filtered.
+ * @param hyp Output parameter. Inlier correspondences stored in this hypothesis will the filtered. Draws from the random stream of the hypothesis.
  * @param maxInliers Maximal number of inlier correspondences to keep. Method does nothing if correspondences are fewer to begin with.
  * @return void
 */
@@ -49,7 +49,7 @@ inline void Ransac3D::filterInliers(TransHyp& hyp, int maxInliers)
   // select random correspondences to keep
   for(unsigned i = 0; i < maxInliers; i++)
   {
-    int idx = irand(0, hyp.inlierPts.size());
+    int idx = hyp.rng.irand(0, hyp.inlierPts.size());
 	    
     inlierPts.push_back(hyp.inlierPts[idx]);
   }
@@ -67,7 +67,7 @@ inline void Ransac3D::filterInliers2D(TransHyp& hyp, int maxInliers)
   // select random correspondences to keep
   for(unsigned i = 0; i < maxInliers; i++)
   {
-    int idx = irand(0, hyp.inlierPts2D.size());
+    int idx = hyp.rng.irand(0, hyp.inlierPts2D.size());
 	    
     inlierPts.push_back(hyp.inlierPts2D[idx]);
   }
@@ -102,7 +102,7 @@ inline void Ransac3D::updateHyp3D(TransHyp& hyp, const cv::Mat& camMat, int imgW
   hyp.pose = jp::our2cv(jp::jp_trans_t(trans.getRotation(), trans.getTranslation()));
 	
   // update 2D bounding box
-  hyp.bb = getBB2D(imgWidth, imgHeight, bb3D, camMat, hyp.pose);
+  hyp.bb = getBB2D(imgWidth, imgHeight, bb3D, camMat, hyp.pose, GlobalProperties::getInstance()->fP.fullScreenObject);
 }
 
 
@@ -121,46 +121,15 @@ inline void Ransac3D::updateHyp2D(TransHyp& hyp, int maxPixels)
 }
 
     
-/**
- * @brief Creates a list of samplers that return pixel positions according to probability maps.
- * 
- * This method generates numberOfObjects+1 samplers. The first sampler is a sampler 
- * for accumulated object probabilities. It samples pixel positions according to the 
- * probability of the pixel being any object (1-backgroundProbability). The 
- * following samplers correspond to the probabilities for individual objects.
- * 
- * @param samplers Output parameter. List of samplers.
- * @param probs Probability maps according to which should be sampled. One per object. The accumulated probability will be calculated in this method.
- * @param imageWidth Width of input images.
- * @param imageHeight Height of input images.
- * @return void
-*/
-void Ransac3D::createSamplers(std::vector<Sampler2D>& samplers, const std::vector<jp::img_stat_t>& probs, int imageWidth, int imageHeight)
-{	
-  samplers.clear();
-  jp::img_stat_t objProb = jp::img_stat_t::zeros(imageHeight, imageWidth);
-	
-  // calculate accumulated probability (any object vs background)
-  #pragma omp parallel for
-  for(unsigned x = 0; x < objProb.cols; x++)
-  for(unsigned y = 0; y < objProb.rows; y++)
-  for(auto prob : probs)
-    objProb(y, x) += prob(y, x);
-	
-  // create samplers
-  samplers.push_back(Sampler2D(objProb));
-  for(auto prob : probs)
-    samplers.push_back(Sampler2D(prob));
-}
-    
 /**
  * @brief Given a pixel position draw an object ID given the object probability distribution of that pixel.
  * 
  * @param pt Query pixel position.
  * @param probs Probability maps. One per object.
+ * @param rng Random stream of the hypothesis slot.
  * @return jp::id_t Chosen object ID.
 */
-inline jp::id_t Ransac3D::drawObjID(const cv::Point2f& pt, const std::vector<jp::img_stat_t>& probs)
+inline jp::id_t Ransac3D::drawObjID(const cv::Point2f& pt, const std::vector<jp::view_stat_t>& probs, Philox& rng)
 {
   // create a map of accumulated object probabilities at the given pixel
   std::map<float, jp::id_t> cumProb; //map of accumulated probability -> object ID
@@ -178,141 +147,33 @@ inline jp::id_t Ransac3D::drawObjID(const cv::Point2f& pt, const std::vector<jp:
   }
 	
   // choose an object based on the accumulated probability
-  return cumProb.upper_bound(drand(0, probSum))->second;
+  return cumProb.upper_bound(rng.drand(0, probSum))->second;
 }
     
-/**
- * @brief Creates a list of pose hypothesis (potentially belonging to multiple objects) which still have to be processed (e.g. refined).
- * 
- * The method includes all remaining hypotheses of an object if there is still more than one, or if there is only one remaining but it still needs to be refined.
- * 
- * @param hypMap Map of object ID to a list of hypotheses for that object.
- * @param maxIt Each hypotheses should be at least this often refined.
- * @return std::vector< Ransac3D::TransHyp*, std::allocator< void > > List of hypotheses to be processed further.
-*/
-std::vector<TransHyp*> Ransac3D::getWorkingQueue(std::map<jp::id_t, std::vector<TransHyp>>& hypMap, int maxIt)
-{
-  std::vector<TransHyp*> workingQueue;
-      
-  for(auto it = hypMap.begin(); it != hypMap.end(); it++)
-  for(int h = 0; h < it->second.size(); h++)
-    if(it->second.size() > 1 || it->second[h].refSteps < maxIt) //exclude a hypothesis if it is the only one remaining for an object and it has been refined enough already
-      workingQueue.push_back(&(it->second[h]));
-
-  return workingQueue;
-}
-
-
-// get 3D points from depth
-void Ransac3D::getEye(unsigned char* rawdepth, jp::img_coord_t& img, jp::img_depth_t& img_depth, int width, int height, float fx, float fy, float px, float py, float depth_factor)
-{
-  ushort* depth = reinterpret_cast<ushort *>(rawdepth);
-
-  img = jp::img_coord_t(height, width);
-  img_depth = jp::img_depth_t(height, width);
-	    
-  #pragma omp parallel for
-  for(int x = 0; x < width; x++)
-  for(int y = 0; y < height; y++)
-  {
-    img(y, x) = pxToEye(x, y, depth[y * width + x], fx, fy, px, py, depth_factor);
-    img_depth(y, x) = depth[y * width + x];
-  }
-}
-
-jp::coord3_t Ransac3D::pxToEye(int x, int y, jp::depth_t depth, float fx, float fy, float px, float py, float depth_factor)
-{
-  jp::coord3_t eye;
-
-  if(depth == 0) // depth hole -> no camera coordinate
-  {
-    eye(0) = 0;
-    eye(1) = 0;
-    eye(2) = 0;
-    return eye;
-  }
-	
-  eye(0) = (x - px) * depth / fx / depth_factor;
-  eye(1) = (y - py) * depth / fy / depth_factor;
-  eye(2) = depth / depth_factor;
-	
-  return eye;
-}
-
-
-// get probs
-void Ransac3D::getProbs(float* probability, std::vector<jp::img_stat_t>& probs, int width, int height, int num_classes)
+// get probs, views into the network output, nothing is copied
+void Ransac3D::getProbs(float* probability, std::vector<jp::view_stat_t>& probs, int width, int height, int num_classes)
 {
   // for each object
   for (int i = 1; i < num_classes; i++)
-  {
-    jp::img_stat_t img(height, width);
-
-    #pragma omp parallel for
-    for(int x = 0; x < width; x++)
-    for(int y = 0; y < height; y++)
-    {
-      int offset = i + num_classes * (y * width + x);
-      img(y, x) = probability[offset];
-    }
-
-    probs.push_back(img);
-  }
+    probs.push_back(jp::view_stat_t(probability + i, height, width, num_classes));
 }
 
 
-// get vertexs
-void Ransac3D::getVertexs(float* vertmap, std::vector<jp::img_coord_t>& vertexs, int width, int height, int num_classes)
+// get vertexs, views into the vertex map
+void Ransac3D::getVertexs(float* vertmap, std::vector<jp::view_coord_t>& vertexs, int width, int height, int num_classes)
 {
   // for each object
   for (int i = 1; i < num_classes; i++)
-  {
-    jp::img_coord_t img(height, width);
-
-    #pragma omp parallel for
-    for(int x = 0; x < width; x++)
-    for(int y = 0; y < height; y++)
-    {
-      int channel = 3 * i;
-      int offset = channel + 3 * num_classes * (y * width + x);
-
-      jp::coord3_t obj;
-      obj(0) = vertmap[offset];
-      obj(1) = vertmap[offset + 1];
-      obj(2) = vertmap[offset + 2];
-
-      img(y, x) = obj;
-    }
-
-    vertexs.push_back(img);
-  }
+    vertexs.push_back(jp::view_coord_t(vertmap + 3 * i, height, width, 3 * num_classes));
 }
 
 
-// get centers
-void Ransac3D::getCenters(float* vertmap, std::vector<jp::img_center_t>& vertexs, int width, int height, int num_classes)
+// get centers, views into the center map
+void Ransac3D::getCenters(float* vertmap, std::vector<jp::view_center_t>& vertexs, int width, int height, int num_classes)
 {
   // for each object
   for (int i = 1; i < num_classes; i++)
-  {
-    jp::img_center_t img(height, width);
-
-    #pragma omp parallel for
-    for(int x = 0; x < width; x++)
-    for(int y = 0; y < height; y++)
-    {
-      int channel = 2 * i;
-      int offset = channel + 2 * num_classes * (y * width + x);
-
-      jp::coord2_t obj;
-      obj(0) = vertmap[offset];
-      obj(1) = vertmap[offset + 1];
-
-      img(y, x) = obj;
-    }
-
-    vertexs.push_back(img);
-  }
+    vertexs.push_back(jp::view_center_t(vertmap + 2 * i, height, width, 2 * num_classes));
 }
 
 
@@ -394,18 +255,17 @@ float Ransac3D::estimatePose(
   std::cout << "factor: " << depth_factor << std::endl;
 
   // extract camera coordinate image (point cloud) from depth channel
-  jp::img_coord_t eyeData;
-  jp::img_depth_t img_depth;
-  getEye(rawdepth, eyeData, img_depth, width, height, fx, fy, px, py, depth_factor);
+  depth.update(reinterpret_cast<const ushort*>(rawdepth), width, height, fx, fy, px, py, depth_factor);
+  const jp::img_coord_t& eyeData = depth.eye;
   std::cout << "read depth done" << std::endl;
 
   // probs
-  std::vector<jp::img_stat_t> probs;
+  std::vector<jp::view_stat_t> probs;
   getProbs(probability, probs, width, height, num_classes);
   std::cout << "read probability done" << std::endl;
 
   // vertexs
-  std::vector<jp::img_coord_t> vertexs;
+  std::vector<jp::view_coord_t> vertexs;
   getVertexs(vertmap, vertexs, width, height, num_classes);
   std::cout << "read vertmap done" << std::endl;
 
@@ -444,111 +304,137 @@ float Ransac3D::estimatePose(
   camMat.at<float>(1, 2) = py;
   std::cout << "read camera matrix:\n" << camMat << std::endl;
 
-  // create samplers for choosing pixel positions according to probability maps
-  std::vector<Sampler2D> samplers;
-  createSamplers(samplers, probs, imageWidth, imageHeight);
-  std::cout << "created samplers: " << samplers.size() << std::endl;
-		
   // hold for each object a list of pose hypothesis, these are optimized until only one remains per object
   std::map<jp::id_t, std::vector<TransHyp>> hypMap;
 	
   float ransacTime = 0;
   StopWatch stopWatch;
 	
-  // sample initial pose hypotheses
-  // #pragma omp parallel for
-  for(unsigned h = 0; h < ransacIterations; h++)
-  for(unsigned i = 0; i < maxIterations; i++)
+  // sample initial pose hypotheses, each hypothesis has its own slot and random stream
+  uint32_t frame = this->frame++;
+  std::vector<TransHyp> sampled(ransacIterations);
+  std::vector<Philox> rngs(ransacIterations);
+  for(int h = 0; h < ransacIterations; h++)
   {
-    // camera coordinate - object coordinate correspondences
-    std::vector<cv::Point3f> eyePts;
-    std::vector<cv::Point3f> objPts;
+    rngs[h] = Philox(frame, h);
+    sampled[h].objID = 0; // stays 0 if no valid hypothesis is found
+  }
+
+  // in each round every slot without a hypothesis draws a minimal sample, and all samples of
+  // the round are solved in one batch
+  std::vector<int> pending(ransacIterations);
+  for(int h = 0; h < ransacIterations; h++)
+    pending[h] = h;
+
+  std::vector<rigid::correspondence_t> samples(ransacIterations * 3);
+  std::vector<rigid::correspondence_t> batch(ransacIterations * 3);
+  std::vector<rigid::Transform> transforms(ransacIterations);
+  std::vector<jp::id_t> sampleIDs(ransacIterations);
+  std::vector<int> drawn(ransacIterations);
+
+  for(int i = 0; i < maxIterations && !pending.empty(); i++)
+  {
+    #pragma omp parallel for schedule(dynamic)
+    for(int p = 0; p < pending.size(); p++)
+    {
+      Philox& rng = rngs[pending[p]];
+      sampleIDs[p] = 0;
+
+      // camera coordinate - object coordinate correspondences
+      std::vector<cv::Point3f> eyePts;
+      std::vector<cv::Point3f> objPts;
 	  
-    cv::Rect bb2D(0, 0, imageWidth, imageHeight); // initialize 2D bounding box to be the full image
+      cv::Rect bb2D(0, 0, imageWidth, imageHeight); // initialize 2D bounding box to be the full image
 	    
-    // sample first point and choose object ID
-    // cv::Point2f pt1 = samplers[0].drawInRect(bb2D);
-    // jp::id_t objID = drawObjID(pt1, probs);
-    jp::id_t objID = object_ids[irand(0, object_ids.size())];
-    int pindex = irand(0, labels[objID].size());
-    int index = labels[objID][pindex];
-    cv::Point2f pt1(index % width, index / width);
-
-    if(objID == 0) continue;
+      // sample first point and choose object ID
+      jp::id_t objID = object_ids[rng.irand(0, object_ids.size())];
+      int pindex = rng.irand(0, labels[objID].size());
+      int index = labels[objID][pindex];
+      cv::Point2f pt1(index % width, index / width);
+
+      if(objID == 0) continue;
     
-    // sample first correspondence
-    if(!samplePoint(objID, eyePts, objPts, pt1, vertexs, eyeData, minDist3D))
-      continue;
+      // sample first correspondence
+      if(!samplePoint(objID, eyePts, objPts, pt1, vertexs, eyeData, minDist3D))
+        continue;
     
-    // set a sensible search radius for other correspondences and update 2D bounding box accordingly
-    float searchRadius = (fx * getMaxDist(bb3Ds[objID-1], objPts[0]) / eyePts[0].z) / 2;
-
-    int minX = clamp(pt1.x - searchRadius, 0, imageWidth - 1);
-    int maxX = clamp(pt1.x + searchRadius, 0, imageWidth - 1);
-    int minY = clamp(pt1.y - searchRadius, 0, imageHeight - 1);
-    int maxY = clamp(pt1.y + searchRadius, 0, imageHeight - 1);
-
-    bb2D = cv::Rect(minX, minY, (maxX - minX + 1), (maxY - minY + 1));
-
-    // sample other points in search radius, discard hypothesis if minimum distance constrains are violated
-    pindex = irand(0, labels[objID].size());
-    index = labels[objID][pindex];
-    cv::Point2f pt2(index % width, index / width);
-    // samplers[objID].drawInRect(bb2D)
-    if(!samplePoint(objID, eyePts, objPts, pt2, vertexs, eyeData, minDist3D))
-      continue;
+      // set a sensible search radius for other correspondences and update 2D bounding box accordingly
+      float searchRadius = (fx * getMaxDist(bb3Ds[objID-1], objPts[0]) / eyePts[0].z) / 2;
+
+      int minX = clamp(pt1.x - searchRadius, 0, imageWidth - 1);
+      int maxX = clamp(pt1.x + searchRadius, 0, imageWidth - 1);
+      int minY = clamp(pt1.y - searchRadius, 0, imageHeight - 1);
+      int maxY = clamp(pt1.y + searchRadius, 0, imageHeight - 1);
+
+      bb2D = cv::Rect(minX, minY, (maxX - minX + 1), (maxY - minY + 1));
+
+      // sample other points in search radius, discard hypothesis if minimum distance constrains are violated
+      pindex = rng.irand(0, labels[objID].size());
+      index = labels[objID][pindex];
+      cv::Point2f pt2(index % width, index / width);
+      if(!samplePoint(objID, eyePts, objPts, pt2, vertexs, eyeData, minDist3D))
+        continue;
     
-    pindex = irand(0, labels[objID].size());
-    index = labels[objID][pindex];
-    cv::Point2f pt3(index % width, index / width);
-    if(!samplePoint(objID, eyePts, objPts, pt3, vertexs, eyeData, minDist3D))
-      continue;
+      pindex = rng.irand(0, labels[objID].size());
+      index = labels[objID][pindex];
+      cv::Point2f pt3(index % width, index / width);
+      if(!samplePoint(objID, eyePts, objPts, pt3, vertexs, eyeData, minDist3D))
+        continue;
 
-    // reconstruct camera
-    std::vector<std::pair<cv::Point3d, cv::Point3d>> pts3D;
-    for(unsigned j = 0; j < eyePts.size(); j++)
-    {
-      pts3D.push_back(std::pair<cv::Point3d, cv::Point3d>(
-      cv::Point3d(objPts[j].x, objPts[j].y, objPts[j].z),
-      cv::Point3d(eyePts[j].x, eyePts[j].y, eyePts[j].z)
-      ));
+      for(unsigned j = 0; j < 3; j++)
+      {
+        samples[p * 3 + j] = rigid::correspondence_t(
+          cv::Point3d(objPts[j].x, objPts[j].y, objPts[j].z),
+          cv::Point3d(eyePts[j].x, eyePts[j].y, eyePts[j].z));
+      }
+      sampleIDs[p] = objID;
     }
 
-    Hypothesis trans(pts3D);
-
-    // check reconstruction, sampled points should be reconstructed perfectly
-    bool foundOutlier = false;
-    for(unsigned j = 0; j < pts3D.size(); j++)
+    // reconstruct camera for all complete samples
+    int numDrawn = 0;
+    for(int p = 0; p < pending.size(); p++)
     {
-      if(cv::norm(pts3D[j].second - trans.transform(pts3D[j].first)) < inlierThreshold3D) continue;
-      foundOutlier = true;
-      break;
+      if(!sampleIDs[p]) continue;
+      std::copy(&samples[p * 3], &samples[p * 3] + 3, &batch[numDrawn * 3]);
+      drawn[numDrawn++] = p;
     }
-    if(foundOutlier) continue;
+    rigid::solveBatch(rigid::Span(batch.data(), numDrawn * 3), 3, transforms.data());
 
+    #pragma omp parallel for schedule(dynamic)
+    for(int d = 0; d < numDrawn; d++)
+    {
+      int p = drawn[d];
+      jp::id_t objID = sampleIDs[p];
 
-    // pose conversion
-    jp::jp_trans_t pose;
-    pose.first = trans.getRotation();
-    pose.second = trans.getTranslation();
-    
-    // create a hypothesis object to store meta data
-    TransHyp hyp(objID, jp::our2cv(pose));
+      // check reconstruction, sampled points should be reconstructed perfectly
+      if(!rigid::reconstructs(rigid::Span(&batch[d * 3], 3), transforms[d], inlierThreshold3D))
+        continue;
+
+      // create a hypothesis object to store meta data
+      TransHyp hyp(objID, jp::our2cv(rigid::toPose(transforms[d])));
+      hyp.rng = rngs[pending[p]]; // refinement continues the stream of the slot
     
-    // update 2D bounding box
-    hyp.bb = getBB2D(imageWidth, imageHeight, bb3Ds[objID-1], camMat, hyp.pose);
+      // update 2D bounding box
+      hyp.bb = getBB2D(imageWidth, imageHeight, bb3Ds[objID-1], camMat, hyp.pose, gp->fP.fullScreenObject);
 
-    //check if bounding box collapses
-    if(hyp.bb.area() < minArea)
-      continue;	    
+      //check if bounding box collapses
+      if(hyp.bb.area() < minArea)
+        continue;	    
     
-    #pragma omp critical
-    {
-      hypMap[objID].push_back(hyp);
+      sampled[pending[p]] = hyp;
     }
 
-    break;
+    // slots without a hypothesis draw again in the next round
+    int numPending = 0;
+    for(int p = 0; p < pending.size(); p++)
+    {
+      if(!sampled[pending[p]].objID)
+        pending[numPending++] = pending[p];
+    }
+    pending.resize(numPending);
   }
+
+  groupByObject(sampled, hypMap);
 	
   ransacTime += stopWatch.stop();
   std::cout << "Time after drawing hypothesis: " << ransacTime << "ms." << std::endl;
@@ -566,24 +452,44 @@ float Ransac3D::estimatePose(
   // create a working queue of all hypotheses to process
   std::vector<TransHyp*> workingQueue = getWorkingQueue(hypMap, refIt);
 	
+  std::vector<float> bestRates(num_classes, 0); // best inlier rate of each object in the last round, 0 disables the SPRT
+  long evaluated = 0, saved = 0;
+
   // main preemptive RANSAC loop, it will stop if there is max one hypothesis per object remaining which has been refined a minimal number of times
   while(!workingQueue.empty())
   {
     // draw a batch of pixels and check for inliers, the number of pixels looked at is increased in each iteration
-    #pragma omp parallel for
+    // hypotheses which are significantly worse than the best one of their object are abandoned early
+    #pragma omp parallel for reduction(+:evaluated, saved)
     for(int h = 0; h < workingQueue.size(); h++)
-      countInliers3D(*(workingQueue[h]), vertexs, eyeData, inlierThreshold3D, minArea, preemptiveBatch);
+    {
+      TransHyp& hyp = *(workingQueue[h]);
+      saved += countInliers3D(hyp, vertexs, eyeData, inlierThreshold3D, minArea, preemptiveBatch, SPRT(schedule, bestRates[hyp.objID]));
+      evaluated += hyp.effPixels;
+    }
 	    	    
-    // sort hypothesis according to inlier count and discard bad half
-    #pragma omp parallel for 
+    // if every hypothesis of an object was abandoned, score the most promising one on its full batch
+    #pragma omp parallel for reduction(+:evaluated, saved)
+    for(unsigned o = 0; o < objList.size(); o++)
+    {
+      TransHyp* hyp = abandonedBest(hypMap[objList[o]]);
+      if(!hyp) continue;
+
+      int partial = hyp->effPixels;
+      hyp->maxPixels -= preemptiveBatch;
+      countInliers3D(*hyp, vertexs, eyeData, inlierThreshold3D, minArea, preemptiveBatch, SPRT(schedule, 0));
+      evaluated += hyp->effPixels - partial;
+      saved -= hyp->effPixels - partial;
+    }
+
+    // sort hypothesis according to inlier count and discard bad half, or all but the best if it dominates
+    #pragma omp parallel for reduction(+:saved)
     for(unsigned o = 0; o < objList.size(); o++)
     {
       jp::id_t objID = objList[o];
-      if(hypMap[objID].size() > 1)
-      {
-	std::sort(hypMap[objID].begin(), hypMap[objID].end());
-	hypMap[objID].erase(hypMap[objID].begin() + hypMap[objID].size() / 2, hypMap[objID].end());
-      }
+      std::vector<TransHyp>& hyps = hypMap[objID];
+      saved += discardHypotheses(hyps, schedule, hyps[0].maxPixels + preemptiveBatch);
+      bestRates[objID] = (hyps.size() > 1 && hyps[0].effPixels > 0) ? hyps[0].getInlierRate() : 0;
     }
     workingQueue = getWorkingQueue(hypMap, refIt);
 	    
@@ -601,6 +507,10 @@ float Ransac3D::estimatePose(
   ransacTime += stopWatch.stop();
   std::cout << "Time after preemptive RANSAC: " << ransacTime << "ms." << std::endl;
 
+  schedule.evaluated = evaluated;
+  schedule.saved = saved;
+  std::cout << "Pixel evaluations: " << evaluated << ", saved by early termination: " << saved << std::endl;
+
   poses.clear();	
 
   std::cout << std::endl << "---------------------------------------------------" << std::endl;
@@ -643,143 +553,123 @@ float Ransac3D::estimatePose(
   return ransacTime;
 }
  
+/**
+ * @brief Pixel source of the RGB-D case, all pixels within the 2D bounding box of the hypothesis with a valid depth.
+ */
+struct BoxPixels3D : InlierTest3D
+{
+  BoxPixels3D(const TransHyp& hyp, const jp::view_coord_t& vertex, const jp::img_coord_t& eyeData, float inlierThreshold)
+  : InlierTest3D(hyp, inlierThreshold), bb(hyp.bb), vertex(vertex), eyeData(eyeData) {}
+
+  int size() const { return bb.area(); }
+
+  bool correspondence(int ptIdx, correspondence_t& c) const
+  {
+    // convert pixel index back to x,y position
+    int x = bb.x + ptIdx % bb.width;
+    int y = bb.y + ptIdx / bb.width;
+
+    // skip depth holes
+    const jp::coord3_t& eye = eyeData(y, x);
+    if(eye[2] == 0) return false;
+
+    const jp::coord3_t& obj = vertex(y, x);
+    c.first = cv::Point3d(obj(0), obj(1), obj(2)); // object coordinate
+    c.second = cv::Point3d(eye[0], eye[1], eye[2]); // camera coordinate
+    return true;
+  }
+
+  cv::Rect bb;
+  const jp::view_coord_t& vertex; // vertex map of the object
+  const jp::img_coord_t& eyeData; // camera coordinates of the frame
+};
+
+/**
+ * @brief Pixel source of center voting, all pixels labeled as the object of the hypothesis.
+ */
+struct LabelPixels2D : InlierTestCenter2D
+{
+  LabelPixels2D(const TransHyp& hyp, const jp::view_center_t& vertex, const std::vector<int>& labels, int width, float inlierThreshold)
+  : InlierTestCenter2D(hyp, inlierThreshold), vertex(vertex), labels(labels), width(width) {}
+
+  int size() const { return labels.size(); }
+
+  bool correspondence(int ptIdx, correspondence_t& c) const
+  {
+    int index = labels[ptIdx];
+    int x = index % width;
+    int y = index / width;
+
+    const jp::coord2_t& dir = vertex(y, x);
+    c.first = cv::Point2d(dir(0), dir(1)); // voting direction
+    c.second = cv::Point2d(x, y); // pixel
+    return true;
+  }
+
+  const jp::view_center_t& vertex; // center voting map of the object
+  const std::vector<int>& labels; // pixels of the object
+  int width;
+};
+
 /**
  * @brief Look at a certain number of pixels and check for inliers.
  * 
- * Inliers are determined by comparing the object coordinate prediction of the random forest with the camera coordinates.
+ * Inliers are determined by comparing the object coordinate prediction of the network with the camera coordinates.
  * 
  * @param hyp Hypothesis to check.
- * @param forest Random forest that made the object coordinate prediction
- * @param leafImgs Prediction of the forest. One leaf image per tree in the forest. Each pixel stores the leaf index where the corresponding patch arrived at.
+ * @param vertexs Vertex maps of the objects.
  * @param eyeData Camera coordinates of the input frame (point cloud generated from the depth channel).
  * @param inlierThreshold Allowed distance between object coordinate predictions and camera coordinates (in mm).
  * @param minArea Abort if the 2D bounding box area of the hypothesis became too small (collapses).
  * @param pixelBatch Number of pixels that should be ADDITIONALLY looked at. Number of pixels increased in each iteration by this amount.
- * @return void
+ * @param test Sequential probability ratio test, the hypothesis is abandoned if it rejects.
+ * @return long Estimated number of pixels not looked at because the hypothesis was abandoned.
 */
-inline void Ransac3D::countInliers3D(
+inline long Ransac3D::countInliers3D(
       TransHyp& hyp,
-      const std::vector<jp::img_coord_t>& vertexs,
+      const std::vector<jp::view_coord_t>& vertexs,
       const jp::img_coord_t& eyeData,
       float inlierThreshold,
       int minArea,
-      int pixelBatch)
+      int pixelBatch,
+      SPRT test)
 {
-  // reset data of last RANSAC iteration
-  hyp.inlierPts.clear();
-  hyp.inliers = 0;
-
   // abort if 2D bounding box collapses
-  if(hyp.bb.area() < minArea) return;
-
-  // data conversion
-  jp::jp_trans_t pose = jp::cv2our(hyp.pose);
-  Hypothesis trans(pose.first, pose.second);
-
-  hyp.effPixels = 0; // num of pixels drawn
-  hyp.maxPixels += pixelBatch; // max num of pixels to be drawn	
-
-  int maxPt = hyp.bb.area(); // num of pixels within bounding box
-  float successRate = hyp.maxPixels / (float) maxPt; // probability to accept a pixel
-
-  std::mt19937 generator;
-  std::negative_binomial_distribution<int> distribution(1, successRate); // lets you skip a number of pixels until you encounter the next pixel to accept
-
-  for(unsigned ptIdx = 0; ptIdx < maxPt;)
+  if(hyp.bb.area() < minArea)
   {
-    // convert pixel index back to x,y position
-    cv::Point2f pt2D(
-      hyp.bb.x + ptIdx % hyp.bb.width, 
-      hyp.bb.y + ptIdx / hyp.bb.width);
-    
-    // skip depth holes
-    if(eyeData(pt2D.y, pt2D.x)[2] == 0)
-    {
-      ptIdx++;
-      continue;
-    }
-  
-    // read out camera coordinate
-    cv::Point3d eye(eyeData(pt2D.y, pt2D.x)[0], eyeData(pt2D.y, pt2D.x)[1], eyeData(pt2D.y, pt2D.x)[2]);
-  
-    hyp.effPixels++;
-  
-    // read out object coordinate
-    cv::Point3d obj = getMode(hyp.objID, pt2D, vertexs);
-
-    // inlier check
-    if(cv::norm(eye - trans.transform(obj)) < inlierThreshold)
-    {
-      hyp.inlierPts.push_back(std::pair<cv::Point3d, cv::Point3d>(obj, eye)); // store object coordinate - camera coordinate correspondence
-      hyp.inliers++; // keep track of the number of inliers (correspondences might be thinned out for speed later)
-    }
-
-    // advance to the next accepted pixel
-    if(successRate < 1)
-      ptIdx += std::max(1, distribution(generator));
-    else
-      ptIdx++;
+    hyp.inlierPts.clear();
+    hyp.inliers = 0;
+    hyp.rejected = false;
+    return 0;
   }
-}
 
+  BoxPixels3D policy(hyp, vertexs[hyp.objID-1], eyeData, inlierThreshold);
+  return countInliers(hyp, policy, pixelBatch, test);
+}
 
-inline void Ransac3D::countInliers2D(
+/**
+ * @brief Look at a certain number of pixels and check for inliers of a center hypothesis.
+ * 
+ * @param hyp Hypothesis to check.
+ * @param vertexs Center voting maps of the objects.
+ * @param labels Pixels of each class.
+ * @param inlierThreshold Allowed distance between the center and the voting line of a pixel (in pixels).
+ * @param width Width of the image.
+ * @param pixelBatch Number of pixels that should be ADDITIONALLY looked at. Number of pixels increased in each iteration by this amount.
+ * @param test Sequential probability ratio test, the hypothesis is abandoned if it rejects.
+ * @return long Estimated number of pixels not looked at because the hypothesis was abandoned.
+*/
+inline long Ransac3D::countInliers2D(
       TransHyp& hyp,
-      const std::vector<jp::img_center_t>& vertexs,
+      const std::vector<jp::view_center_t>& vertexs,
       const std::vector<std::vector<int>>& labels,
       float inlierThreshold,
       int width,
-      int pixelBatch)
-{
-  // reset data of last RANSAC iteration
-  hyp.inlierPts2D.clear();
-  hyp.inliers = 0;
-
-  hyp.effPixels = 0; // num of pixels drawn
-  hyp.maxPixels += pixelBatch; // max num of pixels to be drawn	
-
-  int maxPt = labels[hyp.objID].size(); // num of pixels of this class
-  float successRate = hyp.maxPixels / (float) maxPt; // probability to accept a pixel
-
-  std::mt19937 generator;
-  std::negative_binomial_distribution<int> distribution(1, successRate); // lets you skip a number of pixels until you encounter the next pixel to accept
-
-  for(unsigned ptIdx = 0; ptIdx < maxPt;)
-  {
-    int index = labels[hyp.objID][ptIdx];
-    cv::Point2d pt2D(index % width, index / width);
-  
-    hyp.effPixels++;
-  
-    // read out object coordinate
-    cv::Point2d obj = getMode2D(hyp.objID, pt2D, vertexs);
-
-    // inlier check
-    if(point2line(hyp.center, obj, pt2D) < inlierThreshold)
-    {
-      hyp.inlierPts2D.push_back(std::pair<cv::Point2d, cv::Point2d>(obj, pt2D)); // store object coordinate - camera coordinate correspondence
-      hyp.inliers++; // keep track of the number of inliers (correspondences might be thinned out for speed later)
-    }
-
-    // advance to the next accepted pixel
-    if(successRate < 1)
-      ptIdx += std::max(1, distribution(generator));
-    else
-      ptIdx++;
-  }
-}
-
-
-inline float Ransac3D::point2line(cv::Point2d x, cv::Point2f n, cv::Point2f p)
+      int pixelBatch,
+      SPRT test)
 {
-  float n1 = -n.y;
-  float n2 = n.x;
-  float p1 = p.x;
-  float p2 = p.y;
-  float x1 = x.x;
-  float x2 = x.y;
-
-  return fabs(n1 * (x1 - p1) + n2 * (x2 - p2)) / sqrt(n1 * n1 + n2 * n2);
+  LabelPixels2D policy(hyp, vertexs[hyp.objID-1], labels[hyp.objID], width, inlierThreshold);
+  return countInliers(hyp, policy, pixelBatch, test);
 }
   
   
@@ -794,7 +684,7 @@ inline float Ransac3D::point2line(cv::Point2d x, cv::Point2f n, cv::Point2f p)
 inline cv::Point3f Ransac3D::getMode(
 	jp::id_t objID,
 	const cv::Point2f& pt, 
-	const std::vector<jp::img_coord_t>& vertexs)
+	const std::vector<jp::view_coord_t>& vertexs)
 {
 
   jp::coord3_t mode = vertexs[objID-1](pt.y, pt.x);
@@ -804,7 +694,7 @@ inline cv::Point3f Ransac3D::getMode(
 inline cv::Point2f Ransac3D::getMode2D(
 	jp::id_t objID,
 	const cv::Point2f& pt, 
-	const std::vector<jp::img_center_t>& vertexs)
+	const std::vector<jp::view_center_t>& vertexs)
 {
 
   jp::coord2_t mode = vertexs[objID-1](pt.y, pt.x);
@@ -897,7 +787,7 @@ inline bool Ransac3D::samplePoint(
   std::vector<cv::Point3f>& eyePts, 
   std::vector<cv::Point3f>& objPts, 
   const cv::Point2f& pt2D,
-  const std::vector<jp::img_coord_t>& vertexs,
+  const std::vector<jp::view_coord_t>& vertexs,
   const jp::img_coord_t& eyeData,
   float minDist3D)
 {
@@ -923,7 +813,7 @@ inline bool Ransac3D::samplePoint2D(
   std::vector<cv::Point2f>& eyePts, 
   std::vector<cv::Point2f>& objPts, 
   const cv::Point2f& pt2D,
-  const std::vector<jp::img_center_t>& vertexs)
+  const std::vector<jp::view_center_t>& vertexs)
 {
   cv::Point2f obj = getMode2D(objID, pt2D, vertexs); // read out object coordinate
 
@@ -947,12 +837,12 @@ float Ransac3D::estimateCenter(
   std::cout << "num classes: " << num_classes << std::endl;
 
   // probs
-  std::vector<jp::img_stat_t> probs;
+  std::vector<jp::view_stat_t> probs;
   getProbs(probability, probs, width, height, num_classes);
   std::cout << "read probability done" << std::endl;
 
   // vertexs
-  std::vector<jp::img_center_t> vertexs;
+  std::vector<jp::view_center_t> vertexs;
   getCenters(vertmap, vertexs, width, height, num_classes);
   std::cout << "read centermap done" << std::endl;
 
@@ -979,72 +869,74 @@ float Ransac3D::estimateCenter(
   int imageWidth = width;
   int imageHeight = height;
 
-  // create samplers for choosing pixel positions according to probability maps
-  std::vector<Sampler2D> samplers;
-  createSamplers(samplers, probs, imageWidth, imageHeight);
-  std::cout << "created samplers: " << samplers.size() << std::endl;
-		
   // hold for each object a list of pose hypothesis, these are optimized until only one remains per object
   std::map<jp::id_t, std::vector<TransHyp>> hypMap;
 	
   float ransacTime = 0;
   StopWatch stopWatch;
 	
-  // sample initial pose hypotheses
-  // #pragma omp parallel for
-  for(unsigned h = 0; h < ransacIterations; h++)
-  for(unsigned i = 0; i < maxIterations; i++)
+  // sample initial pose hypotheses, each hypothesis has its own slot and random stream
+  uint32_t frame = this->frame++;
+  std::vector<TransHyp> sampled(ransacIterations);
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int h = 0; h < ransacIterations; h++)
   {
-    // camera coordinate - object coordinate correspondences
-    std::vector<cv::Point2f> eyePts;
-    std::vector<cv::Point2f> objPts;
+    Philox rng(frame, h);
+    sampled[h].objID = 0; // stays 0 if no valid hypothesis is found
+
+    for(unsigned i = 0; i < maxIterations; i++)
+    {
+      // camera coordinate - object coordinate correspondences
+      std::vector<cv::Point2f> eyePts;
+      std::vector<cv::Point2f> objPts;
 	    
-    // sample first point and choose object ID
-    jp::id_t objID = object_ids[irand(0, object_ids.size())];
+      // sample first point and choose object ID
+      jp::id_t objID = object_ids[rng.irand(0, object_ids.size())];
 
-    if(objID == 0) continue;
+      if(objID == 0) continue;
 
-    int pindex = irand(0, labels[objID].size());
-    int index = labels[objID][pindex];
-    cv::Point2f pt1(index % width, index / width);
+      int pindex = rng.irand(0, labels[objID].size());
+      int index = labels[objID][pindex];
+      cv::Point2f pt1(index % width, index / width);
     
-    // sample first correspondence
-    if(!samplePoint2D(objID, eyePts, objPts, pt1, vertexs))
-      continue;
+      // sample first correspondence
+      if(!samplePoint2D(objID, eyePts, objPts, pt1, vertexs))
+        continue;
 
-    // sample other points in search radius, discard hypothesis if minimum distance constrains are violated
-    pindex = irand(0, labels[objID].size());
-    index = labels[objID][pindex];
-    cv::Point2f pt2(index % width, index / width);
+      // sample other points in search radius, discard hypothesis if minimum distance constrains are violated
+      pindex = rng.irand(0, labels[objID].size());
+      index = labels[objID][pindex];
+      cv::Point2f pt2(index % width, index / width);
 
-    if(!samplePoint2D(objID, eyePts, objPts, pt2, vertexs))
-      continue;
+      if(!samplePoint2D(objID, eyePts, objPts, pt2, vertexs))
+        continue;
 
-    // reconstruct camera
-    std::vector<std::pair<cv::Point2d, cv::Point2d>> pts2D;
-    for(unsigned j = 0; j < eyePts.size(); j++)
-    {
-      pts2D.push_back(std::pair<cv::Point2d, cv::Point2d>(
-      cv::Point2d(objPts[j].x, objPts[j].y),
-      cv::Point2d(eyePts[j].x, eyePts[j].y)
-      ));
-    }
+      // reconstruct camera
+      std::vector<std::pair<cv::Point2d, cv::Point2d>> pts2D;
+      for(unsigned j = 0; j < eyePts.size(); j++)
+      {
+        pts2D.push_back(std::pair<cv::Point2d, cv::Point2d>(
+        cv::Point2d(objPts[j].x, objPts[j].y),
+        cv::Point2d(eyePts[j].x, eyePts[j].y)
+        ));
+      }
 
-    Hypothesis trans(pts2D);
+      Hypothesis trans(pts2D);
 
-    // center
-    cv::Point2d center = trans.getCenter();
+      // center
+      cv::Point2d center = trans.getCenter();
     
-    // create a hypothesis object to store meta data
-    TransHyp hyp(objID, center);
+      // create a hypothesis object to store meta data
+      TransHyp hyp(objID, center);
+      hyp.rng = rng; // refinement continues the stream of the slot
     
-    #pragma omp critical
-    {
-      hypMap[objID].push_back(hyp);
+      sampled[h] = hyp;
+      break;
     }
-
-    break;
   }
+
+  groupByObject(sampled, hypMap);
 	
   ransacTime += stopWatch.stop();
   std::cout << "Time after drawing hypothesis: " << ransacTime << "ms." << std::endl;
@@ -1062,24 +954,44 @@ float Ransac3D::estimateCenter(
   // create a working queue of all hypotheses to process
   std::vector<TransHyp*> workingQueue = getWorkingQueue(hypMap, refIt);
 	
+  std::vector<float> bestRates(num_classes, 0); // best inlier rate of each object in the last round, 0 disables the SPRT
+  long evaluated = 0, saved = 0;
+
   // main preemptive RANSAC loop, it will stop if there is max one hypothesis per object remaining which has been refined a minimal number of times
   while(!workingQueue.empty())
   {
     // draw a batch of pixels and check for inliers, the number of pixels looked at is increased in each iteration
-    #pragma omp parallel for
+    // hypotheses which are significantly worse than the best one of their object are abandoned early
+    #pragma omp parallel for reduction(+:evaluated, saved)
     for(int h = 0; h < workingQueue.size(); h++)
-      countInliers2D(*(workingQueue[h]), vertexs, labels, inlierThreshold3D, width, preemptiveBatch);
+    {
+      TransHyp& hyp = *(workingQueue[h]);
+      saved += countInliers2D(hyp, vertexs, labels, inlierThreshold3D, width, preemptiveBatch, SPRT(schedule, bestRates[hyp.objID]));
+      evaluated += hyp.effPixels;
+    }
 	    	    
-    // sort hypothesis according to inlier count and discard bad half
-    #pragma omp parallel for 
+    // if every hypothesis of an object was abandoned, score the most promising one on its full batch
+    #pragma omp parallel for reduction(+:evaluated, saved)
+    for(unsigned o = 0; o < objList.size(); o++)
+    {
+      TransHyp* hyp = abandonedBest(hypMap[objList[o]]);
+      if(!hyp) continue;
+
+      int partial = hyp->effPixels;
+      hyp->maxPixels -= preemptiveBatch;
+      countInliers2D(*hyp, vertexs, labels, inlierThreshold3D, width, preemptiveBatch, SPRT(schedule, 0));
+      evaluated += hyp->effPixels - partial;
+      saved -= hyp->effPixels - partial;
+    }
+
+    // sort hypothesis according to inlier count and discard bad half, or all but the best if it dominates
+    #pragma omp parallel for reduction(+:saved)
     for(unsigned o = 0; o < objList.size(); o++)
     {
       jp::id_t objID = objList[o];
-      if(hypMap[objID].size() > 1)
-      {
-	std::sort(hypMap[objID].begin(), hypMap[objID].end());
-	hypMap[objID].erase(hypMap[objID].begin() + hypMap[objID].size() / 2, hypMap[objID].end());
-      }
+      std::vector<TransHyp>& hyps = hypMap[objID];
+      saved += discardHypotheses(hyps, schedule, hyps[0].maxPixels + preemptiveBatch);
+      bestRates[objID] = (hyps.size() > 1 && hyps[0].effPixels > 0) ? hyps[0].getInlierRate() : 0;
     }
     workingQueue = getWorkingQueue(hypMap, refIt);
 	    
@@ -1097,6 +1009,10 @@ float Ransac3D::estimateCenter(
   ransacTime += stopWatch.stop();
   std::cout << "Time after preemptive RANSAC: " << ransacTime << "ms." << std::endl;
 
+  schedule.evaluated = evaluated;
+  schedule.saved = saved;
+  std::cout << "Pixel evaluations: " << evaluated << ", saved by early termination: " << saved << std::endl;
+
   std::cout << std::endl << "---------------------------------------------------" << std::endl;
   for(auto it = hypMap.begin(); it != hypMap.end(); it++)
   for(int h = 0; h < it->second.size(); h++)
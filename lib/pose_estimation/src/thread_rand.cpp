@@ -1,113 +0,0 @@
-/*
-Copyright (c) 2016, TU Dresden
-All rights reserved.
-
-Redistribution and use in source and binary forms, with or without
-modification, are permitted provided that the following conditions are met:
-    * Redistributions of source code must retain the above copyright
-      notice, this list of conditions and the following disclaimer.
-    * Redistributions in binary form must reproduce the above copyright
-      notice, this list of conditions and the following disclaimer in the
-      documentation and/or other materials provided with the distribution.
-    * Neither the name of the TU Dresden nor the
-      names of its contributors may be used to endorse or promote products
-      derived from this software without specific prior written permission.
-
-THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
-ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
-WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-DISCLAIMED. IN NO EVENT SHALL TU DRESDEN BE LIABLE FOR ANY
-DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
-(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
-LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
-ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
-SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-*/
-
-#include "thread_rand.h"
-#include <omp.h>
-
-std::vector<std::mt19937> ThreadRand::generators;
-bool ThreadRand::initialised = false;
-
-void ThreadRand::forceInit(unsigned seed)
-{
-    initialised = false;
-    init(seed);
-}
-
-void ThreadRand::init(unsigned seed)
-{
-    #pragma omp critical
-    {
-	if(!initialised)
-	{
-	    unsigned nThreads = omp_get_max_threads();
-	    
-	    for(unsigned i = 0; i < nThreads; i++)
-	    {    
-		generators.push_back(std::mt19937());
-		generators[i].seed(i+seed);
-	    }
-
-	    initialised = true;
-	}    
-    }
-}
-
-int ThreadRand::irand(int min, int max, int tid)
-{
-    std::uniform_int_distribution<int> dist(min, max);
-
-    unsigned threadID = omp_get_thread_num();
-    if(tid >= 0) threadID = tid;
-    
-    if(!initialised) init();
-  
-    return dist(ThreadRand::generators[threadID]);
-}
-
-double ThreadRand::drand(double min, double max, int tid)
-{
-    std::uniform_real_distribution<double> dist(min, max);
-    
-    unsigned threadID = omp_get_thread_num();
-    if(tid >= 0) threadID = tid;
-
-    if(!initialised) init();
-
-    return dist(ThreadRand::generators[threadID]);
-}
-
-double ThreadRand::dgauss(double mean, double stdDev, int tid)
-{
-    std::normal_distribution<double> dist(mean, stdDev);
-    
-    unsigned threadID = omp_get_thread_num();
-    if(tid >= 0) threadID = tid;
-
-    if(!initialised) init();
-
-    return dist(ThreadRand::generators[threadID]);
-}
-
-int irand(int incMin, int excMax, int tid)
-{
-    return ThreadRand::irand(incMin, excMax - 1, tid);
-}
-
-double drand(double incMin, double incMax,int tid)
-{
-    return ThreadRand::drand(incMin, incMax, tid);
-}
-
-int igauss(int mean, int stdDev, int tid)
-{
-    return (int) ThreadRand::dgauss(mean, stdDev, tid);
-}
-
-double dgauss(double mean, double stdDev, int tid)
-{
-    return ThreadRand::dgauss(mean, stdDev, tid);
-}
\ No newline at end of file
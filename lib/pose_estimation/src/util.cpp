@@ -106,11 +106,6 @@ std::string floatToString(float number)
    return ss.str(); //return a string with the contents of the stream
 }
 
-int clamp(int val, int min_val, int max_val)
-{
-    return std::max(min_val, std::min(max_val, val));
-}
-
 std::vector<std::string> getSubPaths(std::string path)
 {
     std::vector<std::string> subPaths;  
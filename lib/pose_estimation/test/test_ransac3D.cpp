@@ -0,0 +1,118 @@
+// Checks that the pose and center estimation do not depend on the number of threads, returns nonzero on failure.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <omp.h>
+
+#include "ransac3D.h"
+
+#define CHECK(condition) \
+  if (!(condition)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); return 1; }
+
+const int width = 160;
+const int height = 120;
+const int num_classes = 2;
+const float fx = 200, fy = 200, px = 80, py = 60;
+const float depth_factor = 1000;
+
+// deterministic pseudo random value in [0, 1) for a pixel, marks outliers of the predictions
+static float hash(int x, int y)
+{
+  unsigned h = x * 73856093u ^ y * 19349663u;
+  h ^= h >> 13;
+  h *= 0x5bd1e995u;
+  h ^= h >> 15;
+  return (h & 0xffff) / 65536.f;
+}
+
+// a tilted plane of class 1 in the middle of the image, a quarter of its predictions are outliers
+static void makeScene(std::vector<unsigned short>& depth, std::vector<float>& probability,
+  std::vector<float>& vertmap, std::vector<float>& centermap, std::vector<float>& extents)
+{
+  depth.assign(width * height, 0);
+  probability.assign(width * height * num_classes, 0);
+  vertmap.assign(width * height * 3 * num_classes, 0);
+  centermap.assign(width * height * 2 * num_classes, 0);
+  extents.assign(3 * num_classes, 0.2f);
+
+  const float cx = 70, cy = 55;
+  for (int y = 0; y < height; y++)
+  for (int x = 0; x < width; x++)
+  {
+    int index = y * width + x;
+    bool object = x >= 40 && x < 110 && y >= 30 && y < 85;
+    probability[index * num_classes + (object ? 1 : 0)] = 1;
+    if (!object) continue;
+
+    depth[index] = 800 + x / 2;
+    float d = depth[index] / depth_factor;
+    float* obj = &vertmap[3 * num_classes * index + 3];
+    float* dir = &centermap[2 * num_classes * index + 2];
+    if (hash(x, y) < 0.25f)
+    {
+      obj[0] = hash(y, x) - 0.5f;
+      obj[1] = hash(x + 7, y) - 0.5f;
+      obj[2] = hash(x, y + 7) - 0.5f;
+      dir[0] = hash(y, x) - 0.5f;
+      dir[1] = hash(x + 7, y) - 0.5f;
+    }
+    else
+    {
+      // object coordinates are camera coordinates shifted by the object position
+      obj[0] = (x - px) / fx * d - 0.05f;
+      obj[1] = (y - py) / fy * d + 0.02f;
+      obj[2] = d - 0.8f;
+      dir[0] = cx - x;
+      dir[1] = cy - y;
+    }
+  }
+}
+
+// estimates pose and center of the scene with a new estimator, so every run uses the random streams of the first frame,
+// returns whether the refinement had to thin out the inliers of the pose
+static bool run(int threads, const std::vector<unsigned short>& depth, const std::vector<float>& probability,
+  const std::vector<float>& vertmap, const std::vector<float>& centermap, const std::vector<float>& extents,
+  std::vector<float>& pose, std::vector<float>& center)
+{
+  omp_set_num_threads(threads);
+
+  jp::Ransac3D ransac;
+  pose.assign(12 * num_classes, 0);
+  ransac.estimatePose(reinterpret_cast<unsigned char*>(const_cast<unsigned short*>(depth.data())),
+    const_cast<float*>(probability.data()), const_cast<float*>(vertmap.data()), const_cast<float*>(extents.data()),
+    width, height, num_classes, fx, fy, px, py, depth_factor, pose.data());
+
+  jp::Ransac3D centerRansac;
+  center.assign(4 * num_classes, 0);
+  centerRansac.estimateCenter(const_cast<float*>(probability.data()), const_cast<float*>(centermap.data()),
+    width, height, num_classes, center.data());
+
+  // inliers are counted before the refinement thins them out to the maximum
+  GlobalProperties* gp = GlobalProperties::getInstance();
+  return ransac.poses.count(1) && ransac.poses[1].inliers > gp->tP.ransacMaxInliers;
+}
+
+int main()
+{
+  std::vector<unsigned short> depth;
+  std::vector<float> probability, vertmap, centermap, extents;
+  makeScene(depth, probability, vertmap, centermap, extents);
+
+  // the object is found, and both thread counts give bit-identical results
+  std::vector<float> poses[3], centers[3];
+  CHECK(run(1, depth, probability, vertmap, centermap, extents, poses[0], centers[0]));
+  CHECK(run(4, depth, probability, vertmap, centermap, extents, poses[1], centers[1]));
+  CHECK(poses[0][1 + num_classes * 11] > 0);
+  CHECK(std::memcmp(poses[0].data(), poses[1].data(), poses[0].size() * sizeof(float)) == 0);
+  CHECK(centers[0][4] > 0);
+  CHECK(std::memcmp(centers[0].data(), centers[1].data(), centers[0].size() * sizeof(float)) == 0);
+
+  // repeating a run, including the thinning of the inliers during refinement, gives the same result
+  CHECK(run(4, depth, probability, vertmap, centermap, extents, poses[2], centers[2]));
+  CHECK(std::memcmp(poses[1].data(), poses[2].data(), poses[1].size() * sizeof(float)) == 0);
+  CHECK(std::memcmp(centers[1].data(), centers[2].data(), centers[1].size() * sizeof(float)) == 0);
+
+  printf("test_ransac3D passed\n");
+  return 0;
+}
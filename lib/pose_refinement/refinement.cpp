@@ -2,9 +2,20 @@
 
 using namespace df;
 
+// without a window the poses are refined with the CPU rasterizer, render() needs a window
+Refiner::Refiner()
+{
+  counter_ = 0;
+  renderer_ = NULL;
+  cropWidth_ = 0;
+  cropHeight_ = 0;
+}
+
 Refiner::Refiner(std::string model_file)
 {
   counter_ = 0;
+  cropWidth_ = 0;
+  cropHeight_ = 0;
   create_window(640.0, 480.0);
 
   loadModels(model_file);
@@ -20,7 +31,10 @@ void Refiner::setup(std::string model_file)
 
 Refiner::~Refiner()
 {
-  destroy_window();
+  if (renderer_)
+    destroy_window();
+
+  releaseMeshes(meshes_);
 }
 
 // create window
@@ -49,33 +63,17 @@ void Refiner::create_window(int width, int height)
 
 void Refiner::destroy_window()
 {
-  pangolin::DestroyWindow("Refiner");
+  // the renderers need the context of the window
+  cropRenderer_.reset();
   delete renderer_;
+  pangolin::DestroyWindow("Refiner");
 }
 
 // read the 3D models
 void Refiner::loadModels(const std::string filename)
 {
-  std::ifstream stream(filename);
-  std::vector<std::string> model_names;
-  std::string name;
-
-  while ( std::getline (stream, name) )
-  {
-    std::cout << name << std::endl;
-    model_names.push_back(name);
-  }
-
-  // load meshes
-  const int num_models = model_names.size();
-  assimpMeshes_.resize(num_models);
-  texture_names_.resize(num_models);
-
-  for (int m = 0; m < num_models; ++m)
-  {
-    assimpMeshes_[m] = loadTexturedMesh(model_names[m], texture_names_[m]);
-    std::cout << texture_names_[m] << std::endl;
-  }
+  loadMeshes(filename, meshes_);
+  const int num_models = meshes_.size();
 
   // buffers
   texturedVertices_.resize(num_models);
@@ -84,93 +82,31 @@ void Refiner::loadModels(const std::string filename)
   texturedTextures_.resize(num_models);
 
   for (int m = 0; m < num_models; m++)
-    initializeBuffers(assimpMeshes_[m], texture_names_[m], texturedVertices_[m], texturedIndices_[m], texturedCoords_[m], texturedTextures_[m], true);
-}
-
-aiMesh* Refiner::loadTexturedMesh(const std::string filename, std::string & texture_name)
-{
-    const struct aiScene * scene = aiImportFile(filename.c_str(),0); //aiProcess_JoinIdenticalVertices);
-    if (scene == 0) {
-        throw std::runtime_error("error: " + std::string(aiGetErrorString()));
-    }
-
-    if (scene->mNumMeshes != 1) {
-        const int nMeshes = scene->mNumMeshes;
-        aiReleaseImport(scene);
-        throw std::runtime_error("there are " + std::to_string(nMeshes) + " meshes in " + filename);
-    }
-
-    if (!scene->HasMaterials()) {
-        throw std::runtime_error(filename + " has no materials");
-    }
-
-    std::cout << scene->mNumMaterials << " materials" << std::endl;
-
-    std::string textureName = filename.substr(0,filename.find_last_of('/')+1);
-    for (int i = 0; i < scene->mNumMaterials; ++i) {
-        aiMaterial * material = scene->mMaterials[i];
-        std::cout << "diffuse: " << material->GetTextureCount(aiTextureType_DIFFUSE) << std::endl;
-        std::cout << "specular: " << material->GetTextureCount(aiTextureType_SPECULAR) << std::endl;
-        std::cout << "ambient: " << material->GetTextureCount(aiTextureType_AMBIENT) << std::endl;
-        std::cout << "shininess: " << material->GetTextureCount(aiTextureType_SHININESS) << std::endl;
-
-        if (material->GetTextureCount(aiTextureType_DIFFUSE)) {
-
-            aiString path;
-            material->GetTexture(aiTextureType_DIFFUSE,0,&path);
-
-            textureName = textureName + std::string(path.C_Str());
-
-        }
-
-    }
-
-    aiMesh * assimpMesh = scene->mMeshes[0];
-
-    if (!assimpMesh->HasTextureCoords(0)) {
-        throw std::runtime_error("mesh does not have texture coordinates");
-    }
+  {
+    // the GL buffers need the context of the window
+    if (!renderer_)
+      continue;
 
-    texture_name = textureName;
-    return assimpMesh;
+    if (!meshes_[m]->hasTexture())
+      throw std::runtime_error("model " + std::to_string(m) + " does not have a texture");
+    initializeBuffers(*meshes_[m], texturedVertices_[m], texturedIndices_[m], texturedCoords_[m], texturedTextures_[m]);
+  }
 }
 
 
-void Refiner::initializeBuffers(aiMesh* assimpMesh, std::string textureName, 
-  pangolin::GlBuffer & vertices, pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture, bool is_textured)
+void Refiner::initializeBuffers(const MeshCache & mesh,
+  pangolin::GlBuffer & vertices, pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture)
 {
-    // std::cout << "loading vertices..." << std::endl;
-    // std::cout << assimpMesh->mNumVertices << std::endl;
-    vertices.Reinitialise(pangolin::GlArrayBuffer, assimpMesh->mNumVertices, GL_FLOAT, 3, GL_STATIC_DRAW);
-    vertices.Upload(assimpMesh->mVertices, assimpMesh->mNumVertices*sizeof(float)*3);
-
-    // std::cout << "loading normals..." << std::endl;
-    std::vector<uint3> faces3(assimpMesh->mNumFaces);
-    for (std::size_t i = 0; i < assimpMesh->mNumFaces; ++i) {
-        aiFace & face = assimpMesh->mFaces[i];
-        if (face.mNumIndices != 3) {
-            throw std::runtime_error("not a triangle mesh");
-        }
-        faces3[i] = make_uint3(face.mIndices[0],face.mIndices[1],face.mIndices[2]);
-    }
-
-    indices.Reinitialise(pangolin::GlElementArrayBuffer,assimpMesh->mNumFaces*3,GL_UNSIGNED_INT,3,GL_STATIC_DRAW);
-    indices.Upload(faces3.data(),assimpMesh->mNumFaces*sizeof(int)*3);
+    vertices.Reinitialise(pangolin::GlArrayBuffer, mesh.numVertices(), GL_FLOAT, 3, GL_STATIC_DRAW);
+    vertices.Upload(mesh.positions(), mesh.numVertices()*sizeof(float)*3);
 
-    if (is_textured)
-    {
-      std::cout << "loading texture from " << textureName << std::endl;
-      texture.LoadFromFile(textureName);
+    indices.Reinitialise(pangolin::GlElementArrayBuffer,mesh.numFaces()*3,GL_UNSIGNED_INT,3,GL_STATIC_DRAW);
+    indices.Upload(mesh.indices(),mesh.numFaces()*sizeof(int)*3);
 
-      std::cout << "loading tex coords..." << std::endl;
-      texCoords.Reinitialise(pangolin::GlArrayBuffer,assimpMesh->mNumVertices,GL_FLOAT,2,GL_STATIC_DRAW);
+    uploadTexture(mesh, texture);
 
-      std::vector<float2> texCoords2(assimpMesh->mNumVertices);
-      for (std::size_t i = 0; i < assimpMesh->mNumVertices; ++i) {
-          texCoords2[i] = make_float2(assimpMesh->mTextureCoords[0][i].x,1.0 - assimpMesh->mTextureCoords[0][i].y);
-      }
-      texCoords.Upload(texCoords2.data(),assimpMesh->mNumVertices*sizeof(float)*2);
-    }
+    texCoords.Reinitialise(pangolin::GlArrayBuffer,mesh.numVertices(),GL_FLOAT,2,GL_STATIC_DRAW);
+    texCoords.Upload(mesh.texCoords(),mesh.numVertices()*sizeof(float)*2);
 }
 
 
@@ -446,7 +382,7 @@ void Refiner::getBb3Ds(float* extents, std::vector<std::vector<cv::Point3f>>& bb
 
 
 void Refiner::refine(unsigned char* labels, float* rois, int num_rois, int width, int height, int num_classes,
-                    float* poses_pred, float fx, float fy, float px, float py, float* extents, float* poses_new)
+                    float* poses_pred, float fx, float fy, float px, float py, float* extents, float* poses_new, double time_budget)
 {
   int poseIterations = 100;
 
@@ -476,9 +412,12 @@ void Refiner::refine(unsigned char* labels, float* rois, int num_rois, int width
     }
   }
 
-  pangolin::OpenGlMatrixSpec projectionMatrix = pangolin::ProjectionMatrixRDF_TopLeft(width, height, fx, -fy, px+0.5, height-(py+0.5), 0.25, 6.0);
+  // one rasterizer per worker, the GL renderers need the context of the window and thus this thread
+  rasterizers_.resize(omp_get_max_threads());
+  rasterBuffers_.resize(omp_get_max_threads());
 
-  // for each roi
+  // set up the data of each roi
+  std::vector<DataForOpt> data(num_rois);
   for (int i = 0; i < num_rois; i++)
   {
     int class_id = int(rois[i * 6 + 1]);
@@ -486,56 +425,105 @@ void Refiner::refine(unsigned char* labels, float* rois, int num_rois, int width
     // 2D bounding box
     cv::Rect bb2D(rois[i * 6 + 2], rois[i * 6 + 3], rois[i * 6 + 4] - rois[i * 6 + 2], rois[i * 6 + 5] - rois[i * 6 + 3]);
 
-    // 3D bounding box
-    std::vector<cv::Point3f> bb3D = bb3Ds[class_id-1];
+    // crop of the roi, padded so that the model can move within the bounds of the optimization
+    int pad = std::max(bb2D.width, bb2D.height) * REFINE_CROP_PADDING;
+    cv::Rect crop = cv::Rect(bb2D.x - pad, bb2D.y - pad, bb2D.width + 2 * pad, bb2D.height + 2 * pad) & cv::Rect(0, 0, width, height);
+    if (crop.area() == 0)
+      crop = cv::Rect(0, 0, width, height);
 
     // construct the data
-    DataForOpt data;
-    data.width = width;
-    data.height = height;
-    data.bb2D = bb2D;
-    data.bb3D = bb3D;
-    data.camMat = camMat;
-    data.projectionMatrix = projectionMatrix;
-    data.texturedVertices = &texturedVertices_[class_id-1];
-    data.texturedIndices = &texturedIndices_[class_id-1];
-    data.gt_mask = masks[class_id];
-    data.view = maskView_;
-    data.renderer = renderer_;
+    data[i].width = width;
+    data[i].height = height;
+    data[i].bb2D = bb2D;
+    data[i].bb3D = bb3Ds[class_id-1];
+    data[i].camMat = camMat;
+    data[i].texturedVertices = &texturedVertices_[class_id-1];
+    data[i].texturedIndices = &texturedIndices_[class_id-1];
+
+    // the camera of the crop has the principal point shifted by the crop origin
+    data[i].crop = crop;
+    RasterCamera camera = {crop.width, crop.height, fx, fy, px - crop.x, py - crop.y, 0.25, 6.0};
+    data[i].camera = camera;
+
+    // the gt mask of the crop is packed once for all evaluations
+    const int num_pixels = crop.area();
+    cv::Mat gt_crop = (*masks[class_id])(crop).clone();
+    data[i].gtBits.resize(maskWords(num_pixels));
+    packMask(gt_crop.data, num_pixels, 3, data[i].gtBits.data());
+    data[i].bits.resize(maskWords(num_pixels));
+
+    data[i].renderer = NULL;
+    data[i].pixels = NULL;
+    data[i].mesh = meshes_[class_id-1];
+  }
 
-    // initialize pose
-    std::vector<double> vec(7);
-    vec[0] = poses_pred[i * 7 + 0];
-    vec[1] = poses_pred[i * 7 + 1];
-    vec[2] = poses_pred[i * 7 + 2];
-    vec[3] = poses_pred[i * 7 + 3];
-    vec[4] = poses_pred[i * 7 + 4];
-    vec[5] = poses_pred[i * 7 + 5];
-    vec[6] = poses_pred[i * 7 + 6];
-
-    printf("before\n");
-    for (int j = 0; j < 7; j++)
-      printf("%.2f ", vec[j]);
-    printf("\n");
+  // with GL all crops are rendered into the top left corner of one target, which is only
+  // recreated when a crop does not fit
+  if (renderer_ && num_rois > 0)
+  {
+    int crop_width = cropWidth_, crop_height = cropHeight_;
+    for (int i = 0; i < num_rois; i++)
+    {
+      crop_width = std::max(crop_width, data[i].crop.width);
+      crop_height = std::max(crop_height, data[i].crop.height);
+    }
+    if (crop_width > cropWidth_ || crop_height > cropHeight_)
+    {
+      cropRenderer_.reset(new df::GLRenderer<ForegroundRenderType>(crop_width, crop_height));
+      cropWidth_ = crop_width;
+      cropHeight_ = crop_height;
+      cropPixels_.resize(crop_width * crop_height);
+    }
 
-    // optimization
-    poseWithOpt(vec, data, poseIterations);
+    for (int i = 0; i < num_rois; i++)
+    {
+      const cv::Rect& crop = data[i].crop;
+      data[i].renderer = cropRenderer_.get();
+      data[i].renderWidth = cropWidth_;
+      data[i].renderHeight = cropHeight_;
+      data[i].pixels = &cropPixels_;
+      data[i].projectionMatrix = pangolin::ProjectionMatrixRDF_TopLeft(cropWidth_, cropHeight_, fx, -fy,
+        px - crop.x + 0.5, cropHeight_ - (py - crop.y + 0.5), 0.25, 6.0);
+    }
+  }
 
-    printf("after\n");
-    for (int j = 0; j < 7; j++)
-      printf("%.2f ", vec[j]);
-    printf("\n");
+  // refine the rois concurrently on the CPU, one after the other with GL, and with a time budget
+  // stop all optimizations at the deadline with the best poses found so far
+  const double deadline = time_budget > 0 ? omp_get_wtime() + time_budget : std::numeric_limits<double>::infinity();
 
-    poses_new[i * 7 + 0] = vec[0];
-    poses_new[i * 7 + 1] = vec[1];
-    poses_new[i * 7 + 2] = vec[2];
-    poses_new[i * 7 + 3] = vec[3];
-    poses_new[i * 7 + 4] = vec[4];
-    poses_new[i * 7 + 5] = vec[5];
-    poses_new[i * 7 + 6] = vec[6];
+  #pragma omp parallel for schedule(dynamic) if(!renderer_)
+  for (int i = 0; i < num_rois; i++)
+  {
+    data[i].rasterizer = &rasterizers_[omp_get_thread_num()];
+    data[i].rasterBuffers = &rasterBuffers_[omp_get_thread_num()];
+
+    // initialize pose
+    std::vector<double> vec(poses_pred + i * 7, poses_pred + i * 7 + 7);
+
+    // optimization, the initial pose is kept once the budget is used up
+    if (omp_get_wtime() < deadline)
+      poseWithOpt(vec, data[i], poseIterations, deadline);
+    else
+    {
+      #pragma omp critical
+      printf("roi %d not refined, time budget of %.3f s used up\n", i, time_budget);
+    }
+
+    #pragma omp critical
+    {
+      printf("roi %d before\n", i);
+      for (int j = 0; j < 7; j++)
+        printf("%.2f ", poses_pred[i * 7 + j]);
+      printf("\nafter\n");
+      for (int j = 0; j < 7; j++)
+        printf("%.2f ", vec[j]);
+      printf("\n");
+    }
 
+    for (int j = 0; j < 7; j++)
+      poses_new[i * 7 + j] = vec[j];
   }
-  
+
   // release the masks
   for (int i = 0; i < num_classes; i++)
     delete masks[i];
@@ -621,23 +609,41 @@ static double optEnergy(const std::vector<double> &pose, std::vector<double> &gr
   // compute IoU between boxes
   float IoU_box = getIoU(bb2D, dataForOpt->bb2D);
 
-  // project the 3D model
-  dataForOpt->renderer->setProjectionMatrix(dataForOpt->projectionMatrix);
-  dataForOpt->renderer->setModelViewMatrix(T_co.cast<float>().matrix());
-  dataForOpt->renderer->render( { dataForOpt->texturedVertices }, *(dataForOpt->texturedIndices) );
-  glColor3ub(255,255,255);
-  dataForOpt->view->ActivateScissorAndClear();
-  dataForOpt->renderer->texture(0).RenderToViewportFlipY();
-        
-  // download the mask
-  cv::Mat mask(dataForOpt->height, dataForOpt->width, CV_8UC3);
-  dataForOpt->renderer->texture(0).Download(mask.data, GL_RGB, GL_UNSIGNED_BYTE);
+  // render the mask of the 3D model into the crop and pack it
+  const int num_pixels = dataForOpt->crop.area();
+  if (dataForOpt->renderer)
+  {
+    // offscreen, nothing is drawn to the window
+    dataForOpt->renderer->setProjectionMatrix(dataForOpt->projectionMatrix);
+    dataForOpt->renderer->setModelViewMatrix(T_co.cast<float>().matrix());
+    dataForOpt->renderer->render( { dataForOpt->texturedVertices }, *(dataForOpt->texturedIndices) );
+
+    unsigned char* pixels = dataForOpt->pixels->data();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    dataForOpt->renderer->texture(0).Download(pixels, GL_RED, GL_UNSIGNED_BYTE);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    // make the rows of the crop contiguous, row y moves to the front and never overlaps a later row
+    const cv::Rect& crop = dataForOpt->crop;
+    if (crop.width != dataForOpt->renderWidth)
+      for (int y = 1; y < crop.height; y++)
+        std::memmove(pixels + y * crop.width, pixels + y * dataForOpt->renderWidth, crop.width);
+    packMask(pixels, num_pixels, 1, dataForOpt->bits.data());
+  }
+  else
+  {
+    // rasterize the silhouette on the CPU
+    std::vector<RenderItem> items(1);
+    items[0].mesh = dataForOpt->mesh;
+    for (int i = 0; i < 12; i++)
+      items[0].pose[i] = RT(i / 4, i % 4);
+    items[0].objectId = 1;
+    dataForOpt->rasterizer->render(dataForOpt->camera, items, *(dataForOpt->rasterBuffers), false);
+    packMask(dataForOpt->rasterBuffers->objectIds.data(), num_pixels, 1, dataForOpt->bits.data());
+  }
 
   // compute the overlap between masks
-  cv::Mat dst1, dst2;
-  cv::bitwise_and(mask, *(dataForOpt->gt_mask), dst1);
-  cv::bitwise_or(mask, *(dataForOpt->gt_mask), dst2);
-  float IoU_seg = cv::sum(dst1)[0] / cv::sum(dst2)[0];
+  float IoU_seg = maskIoU(dataForOpt->bits.data(), dataForOpt->gtBits.data(), dataForOpt->bits.size());
 
   // compute IoU between boxes
   float energy = -1 * (0.5 * IoU_box + IoU_seg);
@@ -646,8 +652,13 @@ static double optEnergy(const std::vector<double> &pose, std::vector<double> &gr
 }
 
 
-double poseWithOpt(std::vector<double> & vec, DataForOpt data, int iterations) 
+double poseWithOpt(std::vector<double> & vec, DataForOpt data, int iterations, double deadline)
 {
+  // no time left, keep the initial pose
+  const double remaining = deadline - omp_get_wtime();
+  if (remaining <= 0)
+    return 0;
+
   // set up optimization algorithm (gradient free)
   nlopt::opt opt(nlopt::LN_NELDERMEAD, 7); 
 
@@ -679,8 +690,10 @@ double poseWithOpt(std::vector<double> & vec, DataForOpt data, int iterations)
   // configure NLopt
   opt.set_min_objective(optEnergy, &data);
   opt.set_maxeval(iterations);
+  if (deadline < std::numeric_limits<double>::infinity())
+    opt.set_maxtime(remaining);
 
-  // run optimization
+  // run optimization, stops at a deadline with the best pose so far
   double energy;
   nlopt::result result = opt.optimize(vec, energy);
 
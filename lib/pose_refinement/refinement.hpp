@@ -2,6 +2,9 @@
 #include <cfloat>
 #include <math.h> 
 #include <vector>
+#include <memory>
+#include <cstring>
+#include <limits>
 #include <ctime>
 #include <cstdlib>
 #include <unistd.h>
@@ -10,6 +13,7 @@
 #include <string>
 #include <cstddef> 
 #include <nlopt.hpp>
+#include <omp.h>
 #include <pangolin/pangolin.h>
 #include "opencv2/opencv.hpp"
 
@@ -27,8 +31,11 @@
 #include <df/util/pangolinHelpers.h>
 #include <df/util/tensor.h>
 
-#include <assimp/cimport.h>
-#include <assimp/scene.h>
+#include "mesh_import.h"
+#include "cpu_rasterizer.h"
+#include "bitmask.h"
+
+#define REFINE_CROP_PADDING 0.5 // padding of the roi on each side, relative to its larger side
 
 template <typename Derived>
 inline void operator >>(std::istream & stream, Eigen::MatrixBase<Derived> & M)
@@ -53,7 +60,7 @@ struct ForegroundRenderType {
     }
     static constexpr int numTextures = 1;
     static const GLenum * textureFormats() {
-        static const GLenum formats[numTextures] = { GL_RGBA32F};
+        static const GLenum formats[numTextures] = { GL_R8 };
         return formats;
     }
     static constexpr int numVertexAttributes = 1;
@@ -78,16 +85,27 @@ struct DataForOpt
   cv::Rect bb2D;
   std::vector<cv::Point3f> bb3D;
   cv::Mat_<float> camMat;
-  pangolin::OpenGlMatrixSpec projectionMatrix;
   pangolin::GlBuffer* texturedVertices;
   pangolin::GlBuffer* texturedIndices;
-  cv::Mat* gt_mask;
-  pangolin::View* view;
-  df::GLRenderer<ForegroundRenderType>* renderer;
+
+  // the masks are only rendered and compared in the padded roi
+  cv::Rect crop;
+  pangolin::OpenGlMatrixSpec projectionMatrix; // maps the crop to the top left corner of the render target
+  std::vector<uint64_t> gtBits; // bit-packed gt mask of the crop
+  std::vector<uint64_t> bits; // bit-packed rendered mask of the crop
+  std::vector<unsigned char>* pixels; // downloaded render target
+  df::GLRenderer<ForegroundRenderType>* renderer; // offscreen, at least of the size of the crop
+  int renderWidth, renderHeight; // size of the render target
+
+  // used instead of the GL renderer when there is no window
+  MeshRenderer* rasterizer;
+  RenderBuffers* rasterBuffers;
+  const MeshCache* mesh;
+  RasterCamera camera; // of the crop
 };
 
 static double optEnergy(const std::vector<double> &pose, std::vector<double> &grad, void *data);
-double poseWithOpt(std::vector<double> & vec, DataForOpt data, int iterations);
+double poseWithOpt(std::vector<double> & vec, DataForOpt data, int iterations, double deadline);
 inline float getIoU(const cv::Rect& bb1, const cv::Rect bb2);
 int clamp(int val, int min_val, int max_val);
 inline cv::Rect getBB2D(int imageWidth, int imageHeight, const std::vector<cv::Point3f>& bb3D, const cv::Mat& camMat, const cv::Mat& RT);
@@ -96,7 +114,7 @@ class Refiner
 {
  public:
 
-  Refiner() {};
+  Refiner();
   Refiner(std::string model_file);
   ~Refiner();
 
@@ -106,13 +124,13 @@ class Refiner
   void render(unsigned char* data, unsigned char* labels, float* rois, int num_rois, int num_gt, int width, int height, int num_classes,
                     float* poses_gt, float* poses_pred, float fx, float fy, float px, float py, float* extents, float* poses_new, int is_save);
   void loadModels(std::string filename);
-  aiMesh* loadTexturedMesh(const std::string filename, std::string & texture_name);
-  void initializeBuffers(aiMesh* assimpMesh, std::string textureName, 
-    pangolin::GlBuffer & vertices, pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture, bool is_textured);
+  void initializeBuffers(const MeshCache & mesh,
+    pangolin::GlBuffer & vertices, pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture);
   void feed_data(int width, int height, unsigned char* data, unsigned char* labels, pangolin::GlTexture & colorTex, pangolin::GlTexture & labelTex);
 
+  // time_budget: seconds per call after which the best poses so far are returned, 0 for no limit
   void refine(unsigned char* labels, float* rois, int num_rois, int width, int height, int num_classes,
-                    float* poses_pred, float fx, float fy, float px, float py, float* extents, float* poses_new);
+                    float* poses_pred, float fx, float fy, float px, float py, float* extents, float* poses_new, double time_budget = 0);
 
   void getBb3Ds(float* extents, std::vector<std::vector<cv::Point3f>>& bb3Ds, int num_classes);
   inline std::vector<cv::Point3f> getBB3D(const cv::Vec<float, 3>& extent);
@@ -120,10 +138,6 @@ class Refiner
  private:
   int counter_;
 
-  // 3D models
-  std::vector<aiMesh*> assimpMeshes_;
-  std::vector<std::string> texture_names_;
-
   // pangoline views
   pangolin::View* gtView_;
   pangolin::View* poseView_;
@@ -139,4 +153,16 @@ class Refiner
   std::vector<pangolin::GlTexture> texturedTextures_;
 
   df::GLRenderer<ForegroundRenderType>* renderer_;
+
+  // offscreen target of the refinement with GL, grown to the largest crop so far
+  std::unique_ptr<df::GLRenderer<ForegroundRenderType> > cropRenderer_;
+  int cropWidth_, cropHeight_;
+  std::vector<unsigned char> cropPixels_;
+
+  // meshes of all models, rendered by the CPU rasterizers when no window was created
+  std::vector<MeshCache*> meshes_;
+
+  // render targets of the refinement threads
+  std::vector<CpuRasterizer> rasterizers_;
+  std::vector<RenderBuffers> rasterBuffers_;
 };
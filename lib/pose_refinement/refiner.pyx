@@ -12,15 +12,22 @@ import ctypes
 
 cdef extern from "refiner.hpp":
     cdef cppclass Refiner:
+        Refiner() except +
         Refiner(string) except +
-        void setup(string)
+        void setup(string) except +
         void render(unsigned char*, unsigned char*, float*, int, int, int, int, int, float*, float*, float, float, float, float, float*, float*, int)
+        void refine(unsigned char*, float*, int, int, int, int, float*, float, float, float, float, float*, float*, double)
 
 cdef class PyRefiner:
     cdef Refiner *refiner     # hold a C++ instance which we're wrapping
 
-    def __cinit__(self, string model_file):
-        self.refiner = new Refiner(model_file)
+    # without a window the poses are refined on the CPU in parallel, render needs a window
+    def __cinit__(self, string model_file, bint window=True):
+        if window:
+            self.refiner = new Refiner(model_file)
+        else:
+            self.refiner = new Refiner()
+            self.refiner.setup(model_file)
 
     def __dealloc__(self):
         del self.refiner
@@ -41,3 +48,16 @@ cdef class PyRefiner:
 
         return self.refiner.render(color_buff, label_buff, &rois[0, 0], num_rois, num_gt, width, height, num_classes, \
                                    &poses_gt[0, 0], &poses_pred[0, 0], fx, fy, px, py, &extents[0, 0], &poses_new[0, 0], is_save)
+
+    # time_budget: seconds after which the best poses so far are returned, 0 for no limit
+    def refine(self, np.ndarray[np.uint8_t, ndim=2] label, np.ndarray[np.float32_t, ndim=2] rois, np.ndarray[np.float32_t, ndim=2] poses_pred, \
+               np.float32_t fx, np.float32_t fy, np.float32_t px, np.float32_t py, int num_classes, np.ndarray[np.float32_t, ndim=2] extents, \
+               np.ndarray[np.float32_t, ndim=2] poses_new, double time_budget=0):
+
+        cdef unsigned char* label_buff = <unsigned char*> label.data
+        cdef int height = label.shape[0]
+        cdef int width = label.shape[1]
+        cdef int num_rois = rois.shape[0]
+
+        self.refiner.refine(label_buff, &rois[0, 0], num_rois, width, height, num_classes, \
+                            &poses_pred[0, 0], fx, fy, px, py, &extents[0, 0], &poses_new[0, 0], time_budget)
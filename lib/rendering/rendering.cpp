@@ -1,20 +1,34 @@
 #include "rendering.hpp"
 
+Render::Render()
+{
+  counter_ = 0;
+#ifndef RENDER_CPU
+  context_ = NULL;
+  buffers_initialized_ = false;
+#endif
+}
+
 Render::Render(std::string model_file)
 {
   counter_ = 0;
+#ifndef RENDER_CPU
+  context_ = NULL;
+  buffers_initialized_ = false;
+#endif
   loadModels(model_file);
 }
 
 
 Render::~Render()
 {
-  for(int i = 0; i < models_.size(); i++)
-  {
-    free(models_[i]->vertices);
-    free(models_[i]->faces);
-    free(models_[i]);
-  }
+#ifndef RENDER_CPU
+  // the buffers of the models go with the context
+  if (context_)
+    OSMesaDestroyContext(context_);
+#endif
+
+  releaseMeshes(models_);
 }
 
 void Render::setup(std::string model_file)
@@ -26,106 +40,185 @@ void Render::setup(std::string model_file)
 // read the 3D models
 void Render::loadModels(const std::string filename)
 {
-  std::ifstream stream(filename);
-  std::vector<std::string> model_names;
-  std::string name;
+  loadMeshes(filename, models_);
+#ifndef RENDER_CPU
+  buffers_initialized_ = false;
+#endif
 
-  while ( std::getline (stream, name) )
+  for (int m = 0; m < models_.size(); ++m)
   {
-    std::cout << name << std::endl;
-    model_names.push_back(name);
+    if (!models_[m]->texCoords())
+      throw std::runtime_error("mesh does not have texture coordinates");
   }
+}
 
-  // load meshes
-  const int num_models = model_names.size();
-  models_.resize(num_models);
-  texture_names_.resize(num_models);
 
-  for (int m = 0; m < num_models; ++m)
+#ifndef RENDER_CPU
+// make the context of this instance current on the calling thread, with a framebuffer of the image size,
+// renderTiles releases it again before returning
+bool Render::makeCurrent(int width, int height)
+{
+  if (!context_)
   {
-    models_[m] = new MyModel();
-    loadTexturedMesh(model_names[m], texture_names_[m], models_[m]);
-    std::cout << texture_names_[m] << std::endl;
+    context_ = OSMesaCreateContextExt( OSMESA_RGB, 16, 0, 0, NULL );
+    if (!context_)
+    {
+      printf("OSMesaCreateContext failed!\n");
+      return false;
+    }
   }
+
+  framebuffer_.resize(width * height * 3);
+  if (!OSMesaMakeCurrent( context_, framebuffer_.data(), GL_UNSIGNED_BYTE, width, height ))
+  {
+    printf("OSMesaMakeCurrent failed!\n");
+    return false;
+  }
+  glViewport(0, 0, width, height);
+
+  if (!buffers_initialized_)
+    initializeBuffers();
+  return true;
 }
 
-void Render::loadTexturedMesh(const std::string filename, std::string & texture_name, MyModel* model)
+
+// upload all models once, the context has to be current
+void Render::initializeBuffers()
 {
-    const struct aiScene * scene = aiImportFile(filename.c_str(),0); //aiProcess_JoinIdenticalVertices);
-    if (scene == 0) {
-        throw std::runtime_error("error: " + std::string(aiGetErrorString()));
-    }
+  if (!vertexbuffers_.empty())
+  {
+    glDeleteBuffers(vertexbuffers_.size(), vertexbuffers_.data());
+    glDeleteBuffers(indexbuffers_.size(), indexbuffers_.data());
+  }
 
-    if (scene->mNumMeshes != 1) {
-        const int nMeshes = scene->mNumMeshes;
-        aiReleaseImport(scene);
-        throw std::runtime_error("there are " + std::to_string(nMeshes) + " meshes in " + filename);
-    }
+  const int num_models = models_.size();
+  vertexbuffers_.resize(num_models);
+  indexbuffers_.resize(num_models);
+  glGenBuffers(num_models, vertexbuffers_.data());
+  glGenBuffers(num_models, indexbuffers_.data());
 
-    if (!scene->HasMaterials()) {
-        throw std::runtime_error(filename + " has no materials");
-    }
+  for (int m = 0; m < num_models; m++)
+  {
+    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffers_[m]);
+    glBufferData(GL_ARRAY_BUFFER, models_[m]->numVertices()*sizeof(float)*3, models_[m]->positions(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    std::cout << scene->mNumMaterials << " materials" << std::endl;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffers_[m]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, models_[m]->numFaces()*sizeof(int)*3, models_[m]->indices(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  }
 
-    std::string textureName = filename.substr(0,filename.find_last_of('/')+1);
-    for (int i = 0; i < scene->mNumMaterials; ++i) {
-        aiMaterial * material = scene->mMaterials[i];
-        std::cout << "diffuse: " << material->GetTextureCount(aiTextureType_DIFFUSE) << std::endl;
-        std::cout << "specular: " << material->GetTextureCount(aiTextureType_SPECULAR) << std::endl;
-        std::cout << "ambient: " << material->GetTextureCount(aiTextureType_AMBIENT) << std::endl;
-        std::cout << "shininess: " << material->GetTextureCount(aiTextureType_SHININESS) << std::endl;
+  buffers_initialized_ = true;
+}
 
-        if (material->GetTextureCount(aiTextureType_DIFFUSE)) {
 
-            aiString path;
-            material->GetTexture(aiTextureType_DIFFUSE,0,&path);
+// render the mask of a model into the current viewport
+void Render::drawModel(const RenderTile & tile)
+{
+  glColor3ub(255,255,255);
+
+  glMatrixMode(GL_PROJECTION);
+  glLoadMatrixf(tile.projectionMatrix);
+
+  glMatrixMode(GL_MODELVIEW);
+  glLoadMatrixf(tile.mvMatrix);
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexbuffers_[tile.model_index]);
+  glVertexPointer(3, GL_FLOAT, 0, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffers_[tile.model_index]);
+  glDrawElements(GL_TRIANGLES, models_[tile.model_index]->numFaces() * 3, GL_UNSIGNED_INT, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
 
-            textureName = textureName + std::string(path.C_Str());
 
-        }
+// render the masks of all tiles and keep them bit-packed in masks_, the tiles are stacked
+// vertically in the framebuffer and as many as fit are rendered in one pass
+bool Render::renderTiles(const std::vector<RenderTile> & tiles, int width, int height)
+{
+  const int num_tiles = tiles.size();
+  const int num_words = maskWords(width * height);
+  masks_.resize((size_t)num_tiles * num_words);
+  if (num_tiles == 0)
+    return true;
+
+  const int tiles_per_pass = std::max(1, std::min(num_tiles, RENDER_MAX_FRAMEBUFFER_HEIGHT / height));
+  if (!makeCurrent(width, height * tiles_per_pass))
+    return false;
+  const GLubyte* buffer = framebuffer_.data();
+
+  for (int first = 0; first < num_tiles; first += tiles_per_pass)
+  {
+    const int count = std::min(tiles_per_pass, num_tiles - first);
 
+    glDisable(GL_SCISSOR_TEST);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glEnable(GL_SCISSOR_TEST);
+    for (int t = 0; t < count; t++)
+    {
+      glViewport(0, t * height, width, height);
+      glScissor(0, t * height, width, height);
+      drawModel(tiles[first + t]);
     }
+    glFinish();
 
-    aiMesh * assimpMesh = scene->mMeshes[0];
+    // tile t is the block of rows [t * height, (t + 1) * height) of the framebuffer
+    for (int t = 0; t < count; t++)
+      packMask(buffer + (size_t)t * width * height * 3, width * height, 3, &masks_[(size_t)(first + t) * num_words]);
+  }
+  glDisable(GL_SCISSOR_TEST);
 
-    if (!assimpMesh->HasTextureCoords(0)) {
-        throw std::runtime_error("mesh does not have texture coordinates");
-    }
+  // release the context, the next call may come from another thread of the caller's pool
+  OSMesaMakeCurrent(NULL, NULL, 0, 0, 0);
+  return true;
+}
 
-    texture_name = textureName;
+#else
 
-    // constrcut the model
-    model->num_vertices = assimpMesh->mNumVertices;
-    model->num_faces = assimpMesh->mNumFaces;
-    model->vertices = malloc( assimpMesh->mNumVertices*sizeof(float)*3 );
-    memcpy(model->vertices, assimpMesh->mVertices, assimpMesh->mNumVertices*sizeof(float)*3);
+// render the masks of all tiles with the CPU rasterizer and keep them bit-packed in masks_
+bool Render::renderTiles(const std::vector<RenderTile> & tiles, int width, int height)
+{
+  const int num_tiles = tiles.size();
+  const int num_words = maskWords(width * height);
+  masks_.resize((size_t)num_tiles * num_words);
 
-    std::vector<uint3> faces3(assimpMesh->mNumFaces);
-    for (std::size_t i = 0; i < assimpMesh->mNumFaces; ++i) {
-        aiFace & face = assimpMesh->mFaces[i];
-        if (face.mNumIndices != 3) {
-            throw std::runtime_error("not a triangle mesh");
-        }
-        faces3[i] = make_uint3(face.mIndices[0],face.mIndices[1],face.mIndices[2]);
-    }
+  std::vector<RenderItem> items(1);
+  for (int t = 0; t < num_tiles; t++)
+  {
+    items[0].mesh = models_[tiles[t].model_index];
+    std::copy(tiles[t].pose, tiles[t].pose + 12, items[0].pose);
+    items[0].objectId = 1;
 
-    model->faces = malloc( assimpMesh->mNumFaces*sizeof(int)*3 );
-    memcpy(model->faces, faces3.data(), assimpMesh->mNumFaces*sizeof(int)*3);
+    rasterizer_.render(tiles[t].camera, items, raster_buffers_, false);
+    packMask(raster_buffers_.objectIds.data(), width * height, 1, &masks_[(size_t)t * num_words]);
+  }
 
-    aiReleaseImport(scene);
+  return true;
 }
+#endif
 
 
-void Render::initializeBuffers(MyModel* model, std::string textureName, GLuint vertexbuffer, GLuint indexbuffer)
+// fill a tile with the model, the camera and the object to camera transformation
+void Render::setupTile(RenderTile & tile, int model_index, const Sophus::SE3d & T_co, int width, int height, float fx, float fy, float px, float py)
 {
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glBufferData(GL_ARRAY_BUFFER, model->num_vertices*sizeof(float)*3, model->vertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  const float znear = 0.25;
+  const float zfar = 6.0;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, model->num_faces*sizeof(int)*3, model->faces, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  tile.model_index = model_index;
+  ProjectionMatrixRDF_TopLeft(tile.projectionMatrix, width, height, fx, -fy, px+0.5, height-(py+0.5), znear, zfar);
+  Eigen::Matrix4f mv = T_co.cast<float>().matrix();
+  OpenGlMatrix(mv, tile.mvMatrix);
+
+  RasterCamera camera = {width, height, fx, fy, px, py, znear, zfar};
+  tile.camera = camera;
+  for (int r = 0; r < 3; r++)
+  {
+    for (int c = 0; c < 4; c++)
+      tile.pose[r * 4 + c] = mv(r, c);
+  }
 }
 
 
@@ -170,39 +263,12 @@ void Render::print_matrix(float *m)
 float Render::render(const float* data, const int* labels, const float* rois, int num_rois, int num_gt, int num_classes, int width, int height,
                     const float* poses_gt, const float* poses_pred, const float* poses_init, float* bottom_diff, const float* meta_data, int num_meta_data)
 {
-  void *buffer;
-  float projectionMatrix[16], mvMatrix[16];
-
-  // build context
-  OSMesaContext ctx = OSMesaCreateContextExt( OSMESA_RGB, 16, 0, 0, NULL );
+  // the gradient of each roi comes from forward differences of the IoU in the quaternion
+  const int num = 5;
+  const double delta = 0.001;
 
-  if (!ctx) 
-  {
-    printf("OSMesaCreateContext failed!\n");
-    return 0;
-  }
-
-   /* Allocate the image buffer */
-   buffer = malloc( width * height * 3 * sizeof(GLubyte) );
-   if (!buffer) {
-      printf("Alloc image buffer failed!\n");
-      return 0;
-   }
-
-   /* Bind the buffer to the context and make it current */
-   if (!OSMesaMakeCurrent( ctx, buffer, GL_UNSIGNED_BYTE, width, height )) {
-      printf("OSMesaMakeCurrent failed!\n");
-      return 0;
-   }
-
-  // initialize buffers
-  GLuint vertexbuffer, indexbuffer;
-  // Generate 1 buffer, put the resulting identifier in vertexbuffer
-  glGenBuffers(1, &vertexbuffer);
-  glGenBuffers(1, &indexbuffer);
-
-  // show gt pose
-  std::vector<cv::Mat*> gt_masks(num_gt);
+  // tiles 0 to num_gt - 1 hold the gt masks
+  std::vector<RenderTile> tiles(num_gt);
   for (int n = 0; n < num_gt; n++)
   {
     int batch_id = int(poses_gt[n * 13 + 0]);
@@ -211,51 +277,18 @@ float Render::render(const float* data, const int* labels, const float* rois, in
     float px = meta_data[batch_id * num_meta_data + 2];
     float py = meta_data[batch_id * num_meta_data + 5];
 
-    ProjectionMatrixRDF_TopLeft(projectionMatrix, width, height, fx, -fy, px+0.5, height-(py+0.5), 0.25, 6.0);
-
     int class_id = int(poses_gt[n * 13 + 1]);
 
-    initializeBuffers(models_[class_id-1], texture_names_[class_id-1], vertexbuffer, indexbuffer);
     Eigen::Quaterniond quaternion(poses_gt[n * 13 + 6], poses_gt[n * 13 + 7], poses_gt[n * 13 + 8], poses_gt[n * 13 + 9]);
     Sophus::SE3d::Point translation(poses_gt[n * 13 + 10], poses_gt[n * 13 + 11], poses_gt[n * 13 + 12]);
     const Sophus::SE3d T_co(quaternion, translation);
 
-    // OpenGL rendering
-    glColor3ub(255,255,255);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    glMatrixMode(GL_PROJECTION);
-    glLoadMatrixf(projectionMatrix);
-
-    glMatrixMode(GL_MODELVIEW);
-    Eigen::Matrix4f mv = T_co.cast<float>().matrix();
-    OpenGlMatrix(mv, mvMatrix);
-    glLoadMatrixf(mvMatrix);
-
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glVertexPointer(3, GL_FLOAT, 0, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer);
-    glDrawElements(GL_TRIANGLES, models_[class_id-1]->num_faces * 3, GL_UNSIGNED_INT, 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glDisableClientState(GL_VERTEX_ARRAY);
-
-    glFinish();
-
-    gt_masks[n] = new cv::Mat(height, width, CV_8UC3);
-    memcpy( gt_masks[n]->data, buffer, width * height * 3 * sizeof(GLubyte) );
-
-    // std::string filename = std::to_string(counter_++) + "_gt.ppm";
-    // cv::imwrite(filename.c_str(), *(gt_masks[n]) );
-    // write_ppm(filename.c_str(), (GLubyte*)buffer, width, height);
+    setupTile(tiles[n], class_id - 1, T_co, width, height, fx, fy, px, py);
   }
 
-  // show predicted pose
-  cv::Mat dst1;
-  cv::Mat dst2;
-  double delta = 0.001;
-  float loss = 0;
+  // followed by the predicted pose and its perturbations for each roi that matches a gt
+  std::vector<int> roi_tiles(num_rois, -1);
+  std::vector<int> roi_gts(num_rois, -1);
   for (int n = 0; n < num_rois; n++)
   {
     int batch_id = int(rois[n * 6 + 0]);
@@ -264,8 +297,6 @@ float Render::render(const float* data, const int* labels, const float* rois, in
     float px = meta_data[batch_id * num_meta_data + 2];
     float py = meta_data[batch_id * num_meta_data + 5];
 
-    ProjectionMatrixRDF_TopLeft(projectionMatrix, width, height, fx, -fy, px+0.5, height-(py+0.5), 0.25, 6.0);
-
     int class_id = int(rois[n * 6 + 1]);
 
     // find the gt index
@@ -287,90 +318,48 @@ float Render::render(const float* data, const int* labels, const float* rois, in
       continue;
     }
 
-    initializeBuffers(models_[class_id-1], texture_names_[class_id-1], vertexbuffer, indexbuffer);
+    roi_tiles[n] = tiles.size();
+    roi_gts[n] = gt_ind;
 
-    // render mulitple times
-    int num = 5;
-    std::vector<double> IoUs(num);
+    // pose i > 0 perturbs quaternion component i - 1 (w, x, y, z)
     for (int i = 0; i < num; i++)
     {
-      double w, x, y, z;
-      if (i == 0)
-      {
-        w = poses_pred[n * 4 * num_classes + 4 * class_id + 0];
-        x = poses_pred[n * 4 * num_classes + 4 * class_id + 1];
-        y = poses_pred[n * 4 * num_classes + 4 * class_id + 2];
-        z = poses_pred[n * 4 * num_classes + 4 * class_id + 3];
-      }
-      else if(i == 1)
-      {
-        w = poses_pred[n * 4 * num_classes + 4 * class_id + 0] + delta;
-        x = poses_pred[n * 4 * num_classes + 4 * class_id + 1];
-        y = poses_pred[n * 4 * num_classes + 4 * class_id + 2];
-        z = poses_pred[n * 4 * num_classes + 4 * class_id + 3];
-      }
-      else if(i == 2)
-      {
-        w = poses_pred[n * 4 * num_classes + 4 * class_id + 0];
-        x = poses_pred[n * 4 * num_classes + 4 * class_id + 1] + delta;
-        y = poses_pred[n * 4 * num_classes + 4 * class_id + 2];
-        z = poses_pred[n * 4 * num_classes + 4 * class_id + 3];
-      }
-      else if(i == 3)
-      {
-        w = poses_pred[n * 4 * num_classes + 4 * class_id + 0];
-        x = poses_pred[n * 4 * num_classes + 4 * class_id + 1];
-        y = poses_pred[n * 4 * num_classes + 4 * class_id + 2] + delta;
-        z = poses_pred[n * 4 * num_classes + 4 * class_id + 3];
-      }
-      else
-      {
-        w = poses_pred[n * 4 * num_classes + 4 * class_id + 0];
-        x = poses_pred[n * 4 * num_classes + 4 * class_id + 1];
-        y = poses_pred[n * 4 * num_classes + 4 * class_id + 2];
-        z = poses_pred[n * 4 * num_classes + 4 * class_id + 3] + delta;
-      }
+      double q[4];
+      for (int k = 0; k < 4; k++)
+        q[k] = poses_pred[n * 4 * num_classes + 4 * class_id + k];
+      if (i > 0)
+        q[i - 1] += delta;
 
-      Eigen::Quaterniond quaternion_pred(w, x, y, z);
+      Eigen::Quaterniond quaternion_pred(q[0], q[1], q[2], q[3]);
       Sophus::SE3d::Point translation_pred(poses_init[n * 7 + 4], poses_init[n * 7 + 5], poses_init[n * 7 + 6]);
       const Sophus::SE3d T_co_pred(quaternion_pred, translation_pred);
 
-      glColor3ub(255,255,255);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-      glMatrixMode(GL_PROJECTION);
-      glLoadMatrixf(projectionMatrix);
-      glMatrixMode(GL_MODELVIEW);
-
-      Eigen::Matrix4f mv = T_co_pred.cast<float>().matrix();
-      OpenGlMatrix(mv, mvMatrix);
-      glLoadMatrixf(mvMatrix);
-
-      glEnableClientState(GL_VERTEX_ARRAY);
-      glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-      glVertexPointer(3, GL_FLOAT, 0, 0);
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer);
-      glDrawElements(GL_TRIANGLES, models_[class_id-1]->num_faces * 3, GL_UNSIGNED_INT, 0);
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-      glDisableClientState(GL_VERTEX_ARRAY);
-
-      glFinish();
+      RenderTile tile;
+      setupTile(tile, class_id - 1, T_co_pred, width, height, fx, fy, px, py);
+      tiles.push_back(tile);
+    }
+  }
 
-      cv::Mat mask(height, width, CV_8UC3);
-      memcpy( mask.data, buffer, width * height * 3 * sizeof(GLubyte) );
+  // render everything in as few passes as possible, the context and the model buffers persist across calls,
+  // or with the CPU rasterizer when built with RENDER_CPU
+  if (!renderTiles(tiles, width, height))
+    return 0;
 
-      // compute the overlap between masks
-      cv::bitwise_and(mask, *gt_masks[gt_ind], dst1);
-      cv::bitwise_or(mask, *gt_masks[gt_ind], dst2);
-      IoUs[i] = cv::sum(dst1)[0] / cv::sum(dst2)[0];
+  // compute loss and gradient from the overlap between the packed masks
+  const int num_words = maskWords(width * height);
+  float loss = 0;
+  for (int n = 0; n < num_rois; n++)
+  {
+    if (roi_tiles[n] < 0)
+      continue;
 
-      // std::string filename = std::to_string(counter_++) + "_pose.ppm";
-      // cv::imwrite(filename.c_str(), mask );
+    int class_id = int(rois[n * 6 + 1]);
+    const uint64_t* gt_mask = &masks_[(size_t)roi_gts[n] * num_words];
 
-    }  // end rendering
+    double IoUs[num];
+    for (int i = 0; i < num; i++)
+      IoUs[i] = maskIoU(&masks_[(size_t)(roi_tiles[n] + i) * num_words], gt_mask, num_words);
 
-    // compute loss and gradient
     loss += (1.0 - IoUs[0]) / num_rois;
 
     bottom_diff[n * 4 * num_classes + 4 * class_id + 0] = (IoUs[0] - IoUs[1]) / delta / num_rois;
@@ -379,14 +368,6 @@ float Render::render(const float* data, const int* labels, const float* rois, in
     bottom_diff[n * 4 * num_classes + 4 * class_id + 3] = (IoUs[0] - IoUs[4]) / delta / num_rois;
   }
 
-  for (int n = 0; n < num_gt; n++)
-    delete gt_masks[n];
-
-  OSMesaDestroyContext( ctx );
-
-  /* free the image buffer */
-  free( buffer );
-
   return loss;
 }
 
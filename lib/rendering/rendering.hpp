@@ -15,15 +15,20 @@
 #define GL_GLEXT_PROTOTYPES
 #include "GL/gl.h"
 #include "GL/glext.h"
+#ifndef RENDER_CPU
 #include "GL/osmesa.h"
+#endif
 
 #include <cuda_runtime.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <sophus/se3.hpp>
 
-#include <assimp/cimport.h>
-#include <assimp/scene.h>
+#include "mesh_import.h"
+#include "bitmask.h"
+#include "cpu_rasterizer.h"
+
+#define RENDER_MAX_FRAMEBUFFER_HEIGHT 16384 // largest framebuffer OSMesa accepts
 
 template <typename Derived>
 inline void operator >>(std::istream & stream, Eigen::MatrixBase<Derived> & M)
@@ -53,19 +58,21 @@ unsigned char class_colors[22][3] = {{255, 255, 255}, {255, 0, 0}, {0, 255, 0},
                               {192, 0, 0}, {0, 192, 0}, {0, 0, 192}};
 
 
+// a mask to render: model, camera and pose in OpenGL layout, and the same for the CPU rasterizer
 typedef struct
 {
-  int num_vertices;
-  int num_faces;
-  void* vertices;
-  void* faces; 
-}MyModel;
+  int model_index;
+  float projectionMatrix[16];
+  float mvMatrix[16];
+  RasterCamera camera;
+  float pose[12];
+}RenderTile;
 
 class Render
 {
  public:
 
-  Render() {};
+  Render();
   Render(std::string model_file);
   ~Render();
 
@@ -73,8 +80,13 @@ class Render
   float render(const float* data, const int* labels, const float* rois, int num_rois, int num_gt, int num_classes, int width, int height,
                const float* poses_gt, const float* poses_pred, const float* poses_init, float* bottom_diff, const float* meta_data, int num_meta_data);
   void loadModels(const std::string filename);
-  void loadTexturedMesh(const std::string filename, std::string & texture_name, MyModel* model);
-  void initializeBuffers(MyModel* model, std::string textureName, GLuint vertexbuffer, GLuint indexbuffer);
+#ifndef RENDER_CPU
+  bool makeCurrent(int width, int height);
+  void initializeBuffers();
+  void drawModel(const RenderTile & tile);
+#endif
+  bool renderTiles(const std::vector<RenderTile> & tiles, int width, int height);
+  void setupTile(RenderTile & tile, int model_index, const Sophus::SE3d & T_co, int width, int height, float fx, float fy, float px, float py);
   void ProjectionMatrixRDF_TopLeft(float* m, int w, int h, float fu, float fv, float u0, float v0, float zNear, float zFar );
   void write_ppm(const char *filename, const GLubyte *buffer, int width, int height);
   void print_matrix(float *m);
@@ -83,6 +95,23 @@ class Render
   int counter_;
 
   // 3D models
-  std::vector<MyModel*> models_;
-  std::vector<std::string> texture_names_;
+  std::vector<MeshCache*> models_;
+
+#ifdef RENDER_CPU
+  // software rasterizer, needs no GL driver, keeps its buffers between calls
+  CpuRasterizer rasterizer_;
+  RenderBuffers raster_buffers_;
+#else
+  // headless context of this instance, created on the first render and kept with its framebuffer
+  OSMesaContext context_;
+  std::vector<GLubyte> framebuffer_;
+
+  // vertex and index buffers of all models, resident in the context
+  std::vector<GLuint> vertexbuffers_;
+  std::vector<GLuint> indexbuffers_;
+  bool buffers_initialized_;
+#endif
+
+  // bit-packed masks of the last rendered tiles, reused across calls
+  std::vector<uint64_t> masks_;
 };
@@ -31,11 +31,16 @@ Synthesizer::Synthesizer(std::string model_file, std::string pose_file)
   pose_file_ = pose_file;
   counter_ = 0;
   setup_ = 0;
+  use_nlopt_ = false;
+  renderer_ = NULL;
+  frame_ = 0;
 }
 
-void Synthesizer::setup(int width, int height)
+// without a window render and render_one use the CPU rasterizer, solveICP needs a window
+void Synthesizer::setup(int width, int height, bool window)
 {
-  create_window(width, height);
+  if (window)
+    create_window(width, height);
 
   loadModels(model_file_);
   std::cout << "loaded models" << std::endl;
@@ -43,14 +48,18 @@ void Synthesizer::setup(int width, int height)
   loadPoses(pose_file_);
   std::cout << "loaded poses" << std::endl;
 
+  if (!window)
+  {
+    setup_ = 1;
+    return;
+  }
+
   // create tensors
 
   // labels
   labels_device_ = new df::ManagedDeviceTensor2<int>({width, height});
 
   // depth map
-  depth_map_ = new ManagedTensor<2, float>({width, height});
-  depth_map_device_ = new ManagedTensor<2, float, DeviceResident>(depth_map_->dimensions());
   depth_factor_ = 1000.0;
   depth_cutoff_ = 20.0;
 
@@ -61,13 +70,18 @@ void Synthesizer::setup(int width, int height)
   predicted_normals_device_ = new ManagedDeviceTensor2<Eigen::UnalignedVec4<float> > ({width, height});
   predicted_verts_ = new ManagedHostTensor2<Eigen::UnalignedVec4<float> >({width, height});
   predicted_normals_ = new ManagedHostTensor2<Eigen::UnalignedVec4<float> >({width, height});
+  predicted_verts_batch_device_ = new ManagedDeviceTensor2<Eigen::UnalignedVec4<float> > ({width, height * ICP_BATCH_SIZE});
+  predicted_normals_batch_device_ = new ManagedDeviceTensor2<Eigen::UnalignedVec4<float> > ({width, height * ICP_BATCH_SIZE});
 
   setup_ = 1;
 }
 
 Synthesizer::~Synthesizer()
 {
-  destroy_window();
+  if (renderer_)
+    destroy_window();
+
+  releaseMeshes(meshes_);
 }
 
 // create window
@@ -80,6 +94,7 @@ void Synthesizer::create_window(int width, int height)
   // create render
   renderer_ = new df::GLRenderer<df::CanonicalVertRenderType>(width, height);
   renderer_vn_ = new df::GLRenderer<df::VertAndNormalRenderType>(width, height);
+  renderer_vn_batch_ = new df::GLRenderer<df::VertAndNormalRenderType>(width, height * ICP_BATCH_SIZE);
 }
 
 
@@ -88,79 +103,25 @@ void Synthesizer::destroy_window()
   pangolin::DestroyWindow("Synthesizer");
   delete renderer_;
   delete renderer_vn_;
+  delete renderer_vn_batch_;
 }
 
-// read the poses
+// read the poses, a binary pose library or a list of text pose files
 void Synthesizer::loadPoses(const std::string filename)
 {
-  std::ifstream stream(filename);
-  std::vector<std::string> model_names;
-  std::string name;
-
-  while ( std::getline (stream, name) )
-  {
-    std::cout << name << std::endl;
-    model_names.push_back(name);
-  }
-  stream.close();
-
-  // load poses
-  const int num_models = model_names.size();
-  poses_.resize(num_models);
-  pose_nums_.resize(num_models);
-
-  for (int m = 0; m < num_models; ++m)
-  {
-    // cout lines
-    int num_lines = 0;
-    std::ifstream stream1(model_names[m]);
-    std::string name;
-
-    while ( std::getline (stream1, name) )
-      num_lines++;
-    stream1.close();
-    pose_nums_[m] = num_lines;
-
-    // allocate memory
-    float* pose = (float*)malloc(sizeof(float) * num_lines * 7);
-
-    // load data
-    FILE* fp = fopen(model_names[m].c_str(), "r");
-    for (int i = 0; i < num_lines * 7; i++)
-      fscanf(fp, "%f", pose + i);
-    fclose(fp);
-
-    poses_[m] = pose;
-
-    std::cout << model_names[m] << std::endl;
-  }
+  if (!pose_library_.load(filename))
+    std::cout << "failed to load poses from " << filename << std::endl;
 }
 
 // read the 3D models
 void Synthesizer::loadModels(const std::string filename)
 {
-  std::ifstream stream(filename);
-  std::vector<std::string> model_names;
-  std::vector<std::string> texture_names;
-  std::string name;
-
-  while ( std::getline (stream, name) )
-  {
-    std::cout << name << std::endl;
-    model_names.push_back(name);
-  }
-  stream.close();
+  loadMeshes(filename, meshes_);
+  const int num_models = meshes_.size();
 
-  // load meshes
-  const int num_models = model_names.size();
-  assimpMeshes_.resize(num_models);
-  texture_names.resize(num_models);
-
-  for (int m = 0; m < num_models; ++m)
-  {
-    assimpMeshes_[m] = loadTexturedMesh(model_names[m], texture_names[m]);
-    std::cout << texture_names[m] << std::endl;
-  }
+  // without a window the rasterizer renders the meshes themselves
+  if (!renderer_)
+    return;
 
   // buffers
   texturedVertices_.resize(num_models);
@@ -174,141 +135,196 @@ void Synthesizer::loadModels(const std::string filename)
 
   for (int m = 0; m < num_models; m++)
   {
-    bool is_textured;
-    if (texture_names[m] == "")
-      is_textured = false;
-    else
-      is_textured = true;
-    is_textured_[m] = is_textured;
+    const MeshCache & mesh = *meshes_[m];
+    is_textured_[m] = mesh.hasTexture();
 
-    initializeBuffers(m, assimpMeshes_[m], texture_names[m], texturedVertices_[m], canonicalVertices_[m], vertexColors_[m], vertexNormals_[m],
-                      texturedIndices_[m], texturedCoords_[m], texturedTextures_[m], is_textured);
+    initializeBuffers(m, mesh, texturedVertices_[m], canonicalVertices_[m], vertexColors_[m], vertexNormals_[m],
+                      texturedIndices_[m], texturedCoords_[m], texturedTextures_[m]);
   }
+
+  // the meshes are only needed until they are uploaded
+  releaseMeshes(meshes_);
 }
 
-aiMesh* Synthesizer::loadTexturedMesh(const std::string filename, std::string & texture_name)
-{
-    const struct aiScene * scene = aiImportFile(filename.c_str(), aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals);
-    if (scene == 0) {
-        throw std::runtime_error("error: " + std::string(aiGetErrorString()));
-    }
 
-    if (scene->mNumMeshes != 1) {
-        const int nMeshes = scene->mNumMeshes;
-        aiReleaseImport(scene);
-        throw std::runtime_error("there are " + std::to_string(nMeshes) + " meshes in " + filename);
-    }
+void Synthesizer::initializeBuffers(int model_index, const MeshCache & mesh,
+  pangolin::GlBuffer & vertices, pangolin::GlBuffer & canonicalVertices, pangolin::GlBuffer & colors, pangolin::GlBuffer & normals,
+  pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture)
+{
+    const int num_vertices = mesh.numVertices();
+    std::cout << "number of vertices: " << num_vertices << std::endl;
+    std::cout << "number of faces: " << mesh.numFaces() << std::endl;
+    vertices.Reinitialise(pangolin::GlArrayBuffer, num_vertices, GL_FLOAT, 3, GL_STATIC_DRAW);
+    vertices.Upload(mesh.positions(), num_vertices*sizeof(float)*3);
 
-    if (!scene->HasMaterials()) {
-        throw std::runtime_error(filename + " has no materials");
+    // normals
+    if (mesh.normals())
+    {
+      normals.Reinitialise(pangolin::GlArrayBuffer, num_vertices, GL_FLOAT, 3, GL_STATIC_DRAW);
+      normals.Upload(mesh.normals(), num_vertices*sizeof(float)*3);
     }
-
-    std::cout << scene->mNumMaterials << " materials" << std::endl;
-
-    std::string textureName = filename.substr(0,filename.find_last_of('/')+1);
-    for (int i = 0; i < scene->mNumMaterials; ++i) 
+    else
     {
-        aiMaterial * material = scene->mMaterials[i];
-        std::cout << "diffuse: " << material->GetTextureCount(aiTextureType_DIFFUSE) << std::endl;
-        std::cout << "specular: " << material->GetTextureCount(aiTextureType_SPECULAR) << std::endl;
-        std::cout << "ambient: " << material->GetTextureCount(aiTextureType_AMBIENT) << std::endl;
-        std::cout << "shininess: " << material->GetTextureCount(aiTextureType_SHININESS) << std::endl;
-
-        if (material->GetTextureCount(aiTextureType_DIFFUSE)) 
-        {
-            aiString path;
-            material->GetTexture(aiTextureType_DIFFUSE,0,&path);
-            textureName = textureName + std::string(path.C_Str());
-        }
+      throw std::runtime_error("no normals in the mesh");
     }
 
-    aiMesh * assimpMesh = scene->mMeshes[0];
-    std::cout << "number of vertices: " << assimpMesh->mNumVertices << std::endl;
-    std::cout << "number of faces: " << assimpMesh->mNumFaces << std::endl;
-
-    if (!assimpMesh->HasTextureCoords(0))
-      texture_name = "";
-    else
-      texture_name = textureName;
+    // canonical vertices
+    std::vector<float3> canonicalVerts(num_vertices);
+    std::memcpy(canonicalVerts.data(), mesh.positions(), num_vertices*sizeof(float3));
 
-    return assimpMesh;
-}
+    for (int i = 0; i < num_vertices; i++)
+      canonicalVerts[i].x += model_index;
 
+    canonicalVertices.Reinitialise(pangolin::GlArrayBuffer, num_vertices, GL_FLOAT, 3, GL_STATIC_DRAW);
+    canonicalVertices.Upload(canonicalVerts.data(), num_vertices*sizeof(float3));
 
-void Synthesizer::initializeBuffers(int model_index, aiMesh* assimpMesh, std::string textureName,
-  pangolin::GlBuffer & vertices, pangolin::GlBuffer & canonicalVertices, pangolin::GlBuffer & colors, pangolin::GlBuffer & normals,
-  pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture, bool is_textured)
-{
-    std::cout << "number of vertices: " << assimpMesh->mNumVertices << std::endl;
-    std::cout << "number of faces: " << assimpMesh->mNumFaces << std::endl;
-    vertices.Reinitialise(pangolin::GlArrayBuffer, assimpMesh->mNumVertices, GL_FLOAT, 3, GL_STATIC_DRAW);
-    vertices.Upload(assimpMesh->mVertices, assimpMesh->mNumVertices*sizeof(float)*3);
+    indices.Reinitialise(pangolin::GlElementArrayBuffer,mesh.numFaces()*3,GL_UNSIGNED_INT,3,GL_STATIC_DRAW);
+    indices.Upload(mesh.indices(),mesh.numFaces()*sizeof(int)*3);
 
-    // normals
-    if (assimpMesh->HasNormals())
+    if (mesh.hasTexture())
     {
-      normals.Reinitialise(pangolin::GlArrayBuffer, assimpMesh->mNumVertices, GL_FLOAT, 3, GL_STATIC_DRAW);
-      normals.Upload(assimpMesh->mNormals, assimpMesh->mNumVertices*sizeof(float)*3);
+      uploadTexture(mesh, texture);
+
+      texCoords.Reinitialise(pangolin::GlArrayBuffer,num_vertices,GL_FLOAT,2,GL_STATIC_DRAW);
+      texCoords.Upload(mesh.texCoords(),num_vertices*sizeof(float)*2);
     }
     else
     {
-      throw std::runtime_error("no normals in the mesh");
+      // vertex colors
+      colors.Reinitialise(pangolin::GlArrayBuffer, num_vertices, GL_FLOAT, 3, GL_STATIC_DRAW);
+      if (mesh.colors())
+        colors.Upload(mesh.colors(), num_vertices*sizeof(float)*3);
+      else
+      {
+        std::vector<float3> colors3(num_vertices, make_float3(255, 0, 0));
+        colors.Upload(colors3.data(), num_vertices*sizeof(float)*3);
+      }
     }
+}
 
-    // canonical vertices
-    std::vector<float3> canonicalVerts(assimpMesh->mNumVertices);
-    std::memcpy(canonicalVerts.data(), assimpMesh->mVertices, assimpMesh->mNumVertices*sizeof(float3));
 
-    for (std::size_t i = 0; i < assimpMesh->mNumVertices; i++)
-      canonicalVerts[i].x += model_index;
+// render the scene with the CPU rasterizer into raster_buffers_ and fill the vertmap like the GL renderer:
+// top row first, the x coordinate offset by the class and NaN in the background
+void Synthesizer::rasterizeScene(const std::vector<int>& class_ids, const std::vector<Sophus::SE3d>& poses,
+  int width, int height, float fx, float fy, float px, float py, float znear, float zfar, float* vertmap)
+{
+  const int num = class_ids.size();
+  std::vector<RenderItem> items(num);
+  for (int i = 0; i < num; i++)
+  {
+    const Eigen::Matrix<double, 3, 4> RT = poses[i].matrix3x4();
+    items[i].mesh = meshes_[class_ids[i]];
+    for (int r = 0; r < 3; r++)
+    {
+      for (int c = 0; c < 4; c++)
+        items[i].pose[r * 4 + c] = RT(r, c);
+    }
+    items[i].objectId = class_ids[i] + 1;
+  }
 
-    canonicalVertices.Reinitialise(pangolin::GlArrayBuffer, assimpMesh->mNumVertices, GL_FLOAT, 3, GL_STATIC_DRAW);
-    canonicalVertices.Upload(canonicalVerts.data(), assimpMesh->mNumVertices*sizeof(float3));
+  RasterCamera camera = {width, height, fx, fy, px, py, znear, zfar};
+  rasterizer_.render(camera, items, raster_buffers_);
 
-    std::vector<uint3> faces3(assimpMesh->mNumFaces);
-    for (std::size_t i = 0; i < assimpMesh->mNumFaces; i++) {
-        aiFace & face = assimpMesh->mFaces[i];
-        if (face.mNumIndices != 3) {
-            throw std::runtime_error("not a triangle mesh");
-        }
-        faces3[i] = make_uint3(face.mIndices[0],face.mIndices[1],face.mIndices[2]);
+  if (vertmap)
+  {
+    for (int i = 0; i < width * height; i++)
+    {
+      const int id = raster_buffers_.objectIds[i];
+      for (int c = 0; c < 3; c++)
+        vertmap[3 * i + c] = id ? raster_buffers_.vertices[3 * i + c] : std::nanf("");
+      if (id)
+        vertmap[3 * i] += id - 1;
     }
+  }
+}
 
-    indices.Reinitialise(pangolin::GlElementArrayBuffer,assimpMesh->mNumFaces*3,GL_UNSIGNED_INT,3,GL_STATIC_DRAW);
-    indices.Upload(faces3.data(),assimpMesh->mNumFaces*sizeof(int)*3);
 
-    if (is_textured)
+// shade the rasterized scene and read color and depth like glReadPixels: bottom row first, BGRA and the
+// window depth. Follows the fixed function lighting of the window, one point light at lightpos in the camera
+// frame with linear attenuation and one-sided diffuse term. Textures modulate the default material, ambient
+// 0.2 of the light model times 0.2 and diffuse 0.8, GL_COLOR_MATERIAL takes both from the vertex color
+void Synthesizer::shadeScene(int width, int height, float fx, float fy, float px, float py, float znear, float zfar,
+  const float* lightpos, float attenuation, unsigned char* color, float* depth)
+{
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
     {
-      std::cout << "loading texture from " << textureName << std::endl;
-      texture.LoadFromFile(textureName);
+      const int src = y * width + x;
+      const int dst = (height - 1 - y) * width + x;
+      const int id = raster_buffers_.objectIds[src];
+      const float z = raster_buffers_.depth[src];
+
+      if (depth)
+        depth[dst] = id ? 0.5 * ((zfar + znear) / (zfar - znear) - 2 * zfar * znear / ((zfar - znear) * z)) + 0.5 : 1;
 
-      std::cout << "loading tex coords..." << std::endl;
-      texCoords.Reinitialise(pangolin::GlArrayBuffer,assimpMesh->mNumVertices,GL_FLOAT,2,GL_STATIC_DRAW);
+      if (!color)
+        continue;
 
-      std::vector<float2> texCoords2(assimpMesh->mNumVertices);
-      for (std::size_t i = 0; i < assimpMesh->mNumVertices; ++i) {
-          texCoords2[i] = make_float2(assimpMesh->mTextureCoords[0][i].x,1.0 - assimpMesh->mTextureCoords[0][i].y);
+      unsigned char* bgra = color + 4 * dst;
+      if (!id)
+      {
+        std::fill(bgra, bgra + 4, 0);
+        continue;
       }
-      texCoords.Upload(texCoords2.data(),assimpMesh->mNumVertices*sizeof(float)*2);
+
+      // meshes without texture and vertex colors are red like their GL color buffer
+      const MeshCache* mesh = meshes_[id - 1];
+      const float* rgb = &raster_buffers_.colors[3 * src];
+      const float red[3] = {1, 0, 0};
+      if (!mesh->hasTexture() && !mesh->colors())
+        rgb = red;
+
+      const float ambient = mesh->hasTexture() ? 0.2 * 0.2 : 0.2;
+      const float diffuseMaterial = mesh->hasTexture() ? 0.8 : 1;
+
+      const float* n = &raster_buffers_.normals[3 * src];
+      float l[3] = {lightpos[0] - (x - px) * z / fx, lightpos[1] - (y - py) * z / fy, lightpos[2] - z};
+      const float d = std::sqrt(l[0] * l[0] + l[1] * l[1] + l[2] * l[2]) + 1e-10;
+      const float diffuse = std::max(0.0f, n[0] * l[0] + n[1] * l[1] + n[2] * l[2]) / d;
+      const float intensity = ambient + diffuseMaterial * diffuse / (attenuation * d);
+
+      for (int c = 0; c < 3; c++)
+        bgra[2 - c] = (unsigned char) (255 * std::min(1.0f, rgb[c] * intensity));
+      bgra[3] = 255;
     }
-    else
-    {
-      // vertex colors
-      std::vector<float3> colors3(assimpMesh->mNumVertices);
+  }
+}
+
 
-      for (std::size_t i = 0; i < assimpMesh->mNumVertices; i++) 
+// write color and depth read like glReadPixels to <counter>_color.png and <counter>_depth.png, depth in 0.1 mm
+void Synthesizer::saveImages(int width, int height, float znear, float zfar, unsigned char* color, float* depth)
+{
+  if (color)
+  {
+    cv::Mat C = cv::Mat(height, width, CV_8UC4, color);
+    cv::Mat output;
+    cv::flip(C, output, 0);
+    std::string filename = std::to_string(counter_) + "_color.png";
+    cv::imwrite(filename.c_str(), output);
+  }
+
+  if (depth)
+  {
+    // write depth
+    cv::Mat D = cv::Mat(height, width, CV_32FC1, depth);
+    cv::Mat DD = cv::Mat(height, width, CV_16UC1);
+    for (int x = 0; x < width; x++)
+    { 
+      for (int y = 0; y < height; y++)
       {
-          if (assimpMesh->mColors[0])
-          {
-            aiColor4D & color = assimpMesh->mColors[0][i];
-            colors3[i] = make_float3(color.r, color.g, color.b);
-          }
-          else
-            colors3[i] = make_float3(255, 0, 0);
+        if (D.at<float>(y, x) == 1)
+          DD.at<short>(y, x) = 0;
+        else
+          DD.at<short>(y, x) = short(10000 * 2 * zfar * znear / (zfar + znear - (zfar - znear) * (2 * D.at<float>(y, x) - 1)));
       }
-      colors.Reinitialise(pangolin::GlArrayBuffer, assimpMesh->mNumVertices, GL_FLOAT, 3, GL_STATIC_DRAW);
-      colors.Upload(colors3.data(), assimpMesh->mNumVertices*sizeof(float)*3);
     }
+
+    std::string filename = std::to_string(counter_) + "_depth.png";
+    cv::Mat output;
+    cv::flip(DD, output, 0);
+    cv::imwrite(filename.c_str(), output);
+  }
 }
 
 
@@ -323,13 +339,9 @@ void Synthesizer::render(int width, int height, float fx, float fy, float px, fl
   pangolin::OpenGlMatrixSpec projectionMatrix = pangolin::ProjectionMatrixRDF_TopLeft(width, height, fx, fy, px+0.5, py+0.5, znear, zfar);
   pangolin::OpenGlMatrixSpec projectionMatrix_reverse = pangolin::ProjectionMatrixRDF_TopLeft(width, height, fx, -fy, px+0.5, height-(py+0.5), znear, zfar);
 
-  // show gt pose
-  glEnable(GL_DEPTH_TEST);
-  glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
-
   // sample the number of objects in the scene
   int num;
-  int num_classes = pose_nums_.size();
+  int num_classes = pose_library_.numClasses();
   std::vector<int> class_ids;
 
   if (is_sampling)
@@ -378,8 +390,8 @@ void Synthesizer::render(int width, int height, float fx, float fy, float px, fl
     while(1)
     {
       // sample a pose
-      int seed = irand(0, pose_nums_[class_id]);
-      float* pose = poses_[class_id] + seed * 7;
+      int seed = irand(0, pose_library_.size(class_id));
+      const float* pose = pose_library_.poses(class_id) + seed * 7;
 
       Eigen::Quaterniond quaternion(pose[0] + drand(-0.2, 0.2), pose[1] + drand(-0.2, 0.2), pose[2] + drand(-0.2, 0.2), pose[3] + drand(-0.2, 0.2));
       Sophus::SE3d::Point translation(pose[4] + drand(-0.2, 0.2), pose[5] + drand(-0.2, 0.2), pose[6] + drand(-0.3, 0.3));
@@ -416,31 +428,42 @@ void Synthesizer::render(int width, int height, float fx, float fy, float px, fl
     }
   }
 
-  // render vertmap
-  std::vector<Eigen::Matrix4f> transforms(num);
-  std::vector<std::vector<pangolin::GlBuffer *> > attributeBuffers(num);
-  std::vector<pangolin::GlBuffer*> modelIndexBuffers(num);
-
-  for (int i = 0; i < num; i++)
+  // render vertmap, without a window with the CPU rasterizer
+  if (renderer_)
   {
-    int class_id = class_ids[i];
-    transforms[i] = poses[i].matrix().cast<float>();
-    attributeBuffers[i].push_back(&texturedVertices_[class_id]);
-    attributeBuffers[i].push_back(&canonicalVertices_[class_id]);
-    modelIndexBuffers[i] = &texturedIndices_[class_id];
-  }
+    // show gt pose
+    glEnable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
 
-  glClearColor(std::nanf(""), std::nanf(""), std::nanf(""), std::nanf(""));
-  renderer_->setProjectionMatrix(projectionMatrix_reverse);
-  renderer_->render(attributeBuffers, modelIndexBuffers, transforms);
+    std::vector<Eigen::Matrix4f> transforms(num);
+    std::vector<std::vector<pangolin::GlBuffer *> > attributeBuffers(num);
+    std::vector<pangolin::GlBuffer*> modelIndexBuffers(num);
 
-  glColor3f(1, 1, 1);
-  gtView_->ActivateScissorAndClear();
-  renderer_->texture(0).RenderToViewportFlipY();
+    for (int i = 0; i < num; i++)
+    {
+      int class_id = class_ids[i];
+      transforms[i] = poses[i].matrix().cast<float>();
+      attributeBuffers[i].push_back(&texturedVertices_[class_id]);
+      attributeBuffers[i].push_back(&canonicalVertices_[class_id]);
+      modelIndexBuffers[i] = &texturedIndices_[class_id];
+    }
+
+    glClearColor(std::nanf(""), std::nanf(""), std::nanf(""), std::nanf(""));
+    renderer_->setProjectionMatrix(projectionMatrix_reverse);
+    renderer_->render(attributeBuffers, modelIndexBuffers, transforms);
+
+    glColor3f(1, 1, 1);
+    gtView_->ActivateScissorAndClear();
+    renderer_->texture(0).RenderToViewportFlipY();
+
+    if (vertmap)
+      renderer_->texture(0).Download(vertmap, GL_RGB, GL_FLOAT);
+  }
+  else
+    rasterizeScene(class_ids, poses, width, height, fx, fy, px, py, znear, zfar, vertmap);
 
   if (vertmap)
   {
-    renderer_->texture(0).Download(vertmap, GL_RGB, GL_FLOAT);
     if (is_save)
     {
       std::string filename = std::to_string(counter_) + ".vertmap";
@@ -500,6 +523,15 @@ void Synthesizer::render(int width, int height, float fx, float fy, float px, fl
 
   GLfloat lightpos0[] = {drand(-1, 1), drand(-1, 1), drand(0.2, 5), 1.};
 
+  if (!renderer_)
+  {
+    shadeScene(width, height, fx, fy, px, py, znear, zfar, lightpos0, 0.1, color, depth);
+    if (is_save)
+      saveImages(width, height, znear, zfar, color, depth);
+    counter_++;
+    return;
+  }
+
   // render color image
   glColor3ub(255,255,255);
   gtView_->ActivateScissorAndClear();
@@ -566,48 +598,15 @@ void Synthesizer::render(int width, int height, float fx, float fy, float px, fl
 
   // read color image
   if (color)
-  {
     glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, color);
-    if (is_save)
-    {
-      cv::Mat C = cv::Mat(height, width, CV_8UC4, color);
-      cv::Mat output;
-      cv::flip(C, output, 0);
-      std::string filename = std::to_string(counter_) + "_color.png";
-      cv::imwrite(filename.c_str(), output);
-    }
-  }
   
   // read depth image
   if (depth)
-  {
     glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, depth);
 
-    if (is_save)
-    {
-      // write depth
-      cv::Mat D = cv::Mat(height, width, CV_32FC1, depth);
-      cv::Mat DD = cv::Mat(height, width, CV_16UC1);
-      for (int x = 0; x < width; x++)
-      { 
-        for (int y = 0; y < height; y++)
-        {
-          if (D.at<float>(y, x) == 1)
-            DD.at<short>(y, x) = 0;
-          else
-            DD.at<short>(y, x) = short(10000 * 2 * zfar * znear / (zfar + znear - (zfar - znear) * (2 * D.at<float>(y, x) - 1)));
-        }
-      }
-
-      std::string filename = std::to_string(counter_) + "_depth.png";
-      cv::Mat output;
-      cv::flip(DD, output, 0);
-      cv::imwrite(filename.c_str(), output);
-    }
-  }
-
   if (is_save)
   {
+    saveImages(width, height, znear, zfar, color, depth);
     std::string filename = std::to_string(counter_++);
     pangolin::SaveWindowOnRender(filename);
   }
@@ -651,11 +650,7 @@ void Synthesizer::render_one(int which_class, int width, int height, float fx, f
   pangolin::OpenGlMatrixSpec projectionMatrix = pangolin::ProjectionMatrixRDF_TopLeft(width, height, fx, fy, px+0.5, py+0.5, znear, zfar);
   pangolin::OpenGlMatrixSpec projectionMatrix_reverse = pangolin::ProjectionMatrixRDF_TopLeft(width, height, fx, -fy, px+0.5, height-(py+0.5), znear, zfar);
 
-  // show gt pose
-  glEnable(GL_DEPTH_TEST);
-  glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
-
-  int num_classes = pose_nums_.size();
+  int num_classes = pose_library_.numClasses();
   // sample the number of objects in the scene
   int num;
   if (irand(0, 5) == 0)
@@ -684,8 +679,8 @@ void Synthesizer::render_one(int which_class, int width, int height, float fx, f
 
   // sample the target object
   int class_id = class_ids[0];
-  int seed = irand(0, pose_nums_[class_id]);
-  float* pose = poses_[class_id] + seed * 7;
+  int seed = irand(0, pose_library_.size(class_id));
+  const float* pose = pose_library_.poses(class_id) + seed * 7;
 
   // Eigen::Quaterniond quaternion_first(pose[0] + drand(-0.2, 0.2), pose[1]  + drand(-0.2, 0.2), pose[2]  + drand(-0.2, 0.2), pose[3] + drand(-0.2, 0.2));
   Eigen::Quaterniond quaternion_first(drand(-1, 1), drand(-1, 1), drand(-1, 1), drand(-1, 1));
@@ -708,8 +703,8 @@ void Synthesizer::render_one(int which_class, int width, int height, float fx, f
   {
     // sample the second object
     class_id = class_ids[1];
-    seed = irand(0, pose_nums_[class_id]);
-    pose = poses_[class_id] + seed * 7;
+    seed = irand(0, pose_library_.size(class_id));
+    pose = pose_library_.poses(class_id) + seed * 7;
     Eigen::Quaterniond quaternion_second(drand(-1, 1), drand(-1, 1), drand(-1, 1), drand(-1, 1));
     Sophus::SE3d::Point translation_second;
     float extent = (extents[3 * (class_id + 1)] + extents[3 * (class_id + 1) + 1] + extents[3 * (class_id + 1) + 2]) / 3;
@@ -730,31 +725,42 @@ void Synthesizer::render_one(int which_class, int width, int height, float fx, f
     poses[1] = T_co_second;
   }
 
-  // render vertmap
-  std::vector<Eigen::Matrix4f> transforms(num);
-  std::vector<std::vector<pangolin::GlBuffer *> > attributeBuffers(num);
-  std::vector<pangolin::GlBuffer*> modelIndexBuffers(num);
-
-  for (int i = 0; i < num; i++)
+  // render vertmap, without a window with the CPU rasterizer
+  if (renderer_)
   {
-    int class_id = class_ids[i];
-    transforms[i] = poses[i].matrix().cast<float>();
-    attributeBuffers[i].push_back(&texturedVertices_[class_id]);
-    attributeBuffers[i].push_back(&canonicalVertices_[class_id]);
-    modelIndexBuffers[i] = &texturedIndices_[class_id];
-  }
+    // show gt pose
+    glEnable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
 
-  glClearColor(std::nanf(""), std::nanf(""), std::nanf(""), std::nanf(""));
-  renderer_->setProjectionMatrix(projectionMatrix_reverse);
-  renderer_->render(attributeBuffers, modelIndexBuffers, transforms);
+    std::vector<Eigen::Matrix4f> transforms(num);
+    std::vector<std::vector<pangolin::GlBuffer *> > attributeBuffers(num);
+    std::vector<pangolin::GlBuffer*> modelIndexBuffers(num);
 
-  glColor3f(1, 1, 1);
-  gtView_->ActivateScissorAndClear();
-  renderer_->texture(0).RenderToViewportFlipY();
+    for (int i = 0; i < num; i++)
+    {
+      int class_id = class_ids[i];
+      transforms[i] = poses[i].matrix().cast<float>();
+      attributeBuffers[i].push_back(&texturedVertices_[class_id]);
+      attributeBuffers[i].push_back(&canonicalVertices_[class_id]);
+      modelIndexBuffers[i] = &texturedIndices_[class_id];
+    }
+
+    glClearColor(std::nanf(""), std::nanf(""), std::nanf(""), std::nanf(""));
+    renderer_->setProjectionMatrix(projectionMatrix_reverse);
+    renderer_->render(attributeBuffers, modelIndexBuffers, transforms);
+
+    glColor3f(1, 1, 1);
+    gtView_->ActivateScissorAndClear();
+    renderer_->texture(0).RenderToViewportFlipY();
+
+    if (vertmap)
+      renderer_->texture(0).Download(vertmap, GL_RGB, GL_FLOAT);
+  }
+  else
+    rasterizeScene(class_ids, poses, width, height, fx, fy, px, py, znear, zfar, vertmap);
 
   if (vertmap)
   {
-    renderer_->texture(0).Download(vertmap, GL_RGB, GL_FLOAT);
     if (is_save)
     {
       std::string filename = std::to_string(counter_) + ".vertmap";
@@ -774,6 +780,15 @@ void Synthesizer::render_one(int which_class, int width, int height, float fx, f
 
   GLfloat lightpos0[] = {drand(-1, 1), drand(-1, 1), drand(0.2, 5), 1.};
 
+  if (!renderer_)
+  {
+    shadeScene(width, height, fx, fy, px, py, znear, zfar, lightpos0, 0.4, color, depth);
+    if (is_save)
+      saveImages(width, height, znear, zfar, color, depth);
+    counter_++;
+    return;
+  }
+
   // render color image
   glColor3ub(255,255,255);
   gtView_->ActivateScissorAndClear();
@@ -840,48 +855,15 @@ void Synthesizer::render_one(int which_class, int width, int height, float fx, f
 
   // read color image
   if (color)
-  {
     glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, color);
-    if (is_save)
-    {
-      cv::Mat C = cv::Mat(height, width, CV_8UC4, color);
-      cv::Mat output;
-      cv::flip(C, output, 0);
-      std::string filename = std::to_string(counter_) + "_color.png";
-      cv::imwrite(filename.c_str(), output);
-    }
-  }
   
   // read depth image
   if (depth)
-  {
     glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, depth);
 
-    if (is_save)
-    {
-      // write depth
-      cv::Mat D = cv::Mat(height, width, CV_32FC1, depth);
-      cv::Mat DD = cv::Mat(height, width, CV_16UC1);
-      for (int x = 0; x < width; x++)
-      { 
-        for (int y = 0; y < height; y++)
-        {
-          if (D.at<float>(y, x) == 1)
-            DD.at<short>(y, x) = 0;
-          else
-            DD.at<short>(y, x) = short(10000 * 2 * zfar * znear / (zfar + znear - (zfar - znear) * (2 * D.at<float>(y, x) - 1)));
-        }
-      }
-
-      std::string filename = std::to_string(counter_) + "_depth.png";
-      cv::Mat output;
-      cv::flip(DD, output, 0);
-      cv::imwrite(filename.c_str(), output);
-    }
-  }
-
   if (is_save)
   {
+    saveImages(width, height, znear, zfar, color, depth);
     std::string filename = std::to_string(counter_++);
     pangolin::SaveWindowOnRender(filename);
   }
@@ -1019,41 +1001,71 @@ inline bool Synthesizer::samplePoint3D(
 }
 
 /**
- * @brief Creates a list of pose hypothesis (potentially belonging to multiple objects) which still have to be processed (e.g. refined).
- * 
- * The method includes all remaining hypotheses of an object if there is still more than one, or if there is only one remaining but it still needs to be refined.
- * 
- * @param hypMap Map of object ID to a list of hypotheses for that object.
- * @param maxIt Each hypotheses should be at least this often refined.
- * @return std::vector< Ransac3D::TransHyp*, std::allocator< void > > List of hypotheses to be processed further.
-*/
-std::vector<TransHyp*> Synthesizer::getWorkingQueue(std::map<jp::id_t, std::vector<TransHyp>>& hypMap, int maxIt)
+ * @brief Pixel source of the RGB case, all pixels labeled as the object of the hypothesis.
+ */
+struct LabelPixelsReprojection : InlierTestReprojection
 {
-  std::vector<TransHyp*> workingQueue;
-      
-  for(auto it = hypMap.begin(); it != hypMap.end(); it++)
-  for(int h = 0; h < it->second.size(); h++)
-    if(it->second.size() > 1 || it->second[h].refSteps < maxIt) //exclude a hypothesis if it is the only one remaining for an object and it has been refined enough already
-      workingQueue.push_back(&(it->second[h]));
+  LabelPixelsReprojection(Synthesizer* synth, const TransHyp& hyp, const cv::Mat& camMat, const std::vector<int>& labels,
+    const float* vertmap, const float* extents, float inlierThreshold, int width, int num_classes)
+  : InlierTestReprojection(hyp, camMat, inlierThreshold), synth(synth), objID(hyp.objID), labels(labels),
+    vertmap(vertmap), extents(extents), width(width), num_classes(num_classes) {}
 
-  return workingQueue;
-}
+  int size() const { return labels.size(); }
 
+  bool correspondence(int ptIdx, correspondence_t& c) const
+  {
+    int index = labels[ptIdx];
+    c.second = cv::Point2d(index % width, index / width); // pixel
+    c.first = synth->getMode3D(objID, c.second, vertmap, extents, width, num_classes); // object coordinate
+    return true;
+  }
 
-inline float Synthesizer::point2line(cv::Point2d x, cv::Point2f n, cv::Point2f p)
+  Synthesizer* synth;
+  jp::id_t objID;
+  const std::vector<int>& labels; // pixels of the object
+  const float* vertmap;
+  const float* extents;
+  int width, num_classes;
+};
+
+/**
+ * @brief Pixel source of the RGB-D case, all pixels labeled as the object of the hypothesis with a valid depth.
+ */
+struct LabelPixels3D : InlierTest3D
 {
-  float n1 = -n.y;
-  float n2 = n.x;
-  float p1 = p.x;
-  float p2 = p.y;
-  float x1 = x.x;
-  float x2 = x.y;
-
-  return fabs(n1 * (x1 - p1) + n2 * (x2 - p2)) / sqrt(n1 * n1 + n2 * n2);
-}
+  LabelPixels3D(Synthesizer* synth, const TransHyp& hyp, const std::vector<int>& labels, const jp::img_coord_t& eyeData,
+    const float* vertmap, const float* extents, float inlierThreshold, int width, int num_classes)
+  : InlierTest3D(hyp, inlierThreshold), synth(synth), objID(hyp.objID), labels(labels), eyeData(eyeData),
+    vertmap(vertmap), extents(extents), width(width), num_classes(num_classes) {}
 
+  int size() const { return labels.size(); }
+
+  bool correspondence(int ptIdx, correspondence_t& c) const
+  {
+    int index = labels[ptIdx];
+    int x = index % width;
+    int y = index / width;
+
+    // skip depth holes
+    const jp::coord3_t& eye = eyeData(y, x);
+    if(eye[2] == 0) return false;
+
+    c.first = synth->getMode3D(objID, cv::Point2f(x, y), vertmap, extents, width, num_classes); // object coordinate
+    c.second = cv::Point3d(eye[0], eye[1], eye[2]); // camera coordinate
+    return true;
+  }
 
-inline void Synthesizer::countInliers2D(
+  Synthesizer* synth;
+  jp::id_t objID;
+  const std::vector<int>& labels; // pixels of the object
+  const jp::img_coord_t& eyeData; // camera coordinates of the frame
+  const float* vertmap;
+  const float* extents;
+  int width, num_classes;
+};
+
+
+inline long Synthesizer::countInliers2D(
       TransHyp& hyp,
       const cv::Mat& camMat,
       const std::vector<std::vector<int>>& labels,
@@ -1062,54 +1074,15 @@ inline void Synthesizer::countInliers2D(
       float inlierThreshold,
       int width,
       int num_classes,
-      int pixelBatch)
+      int pixelBatch,
+      SPRT test)
 {
-  // reset data of last RANSAC iteration
-  hyp.inlierPts2D.clear();
-  hyp.inliers = 0;
-
-  hyp.effPixels = 0; // num of pixels drawn
-  hyp.maxPixels += pixelBatch; // max num of pixels to be drawn	
-
-  int maxPt = labels[hyp.objID].size(); // num of pixels of this class
-  float successRate = hyp.maxPixels / (float) maxPt; // probability to accept a pixel
-
-  std::mt19937 generator;
-  std::negative_binomial_distribution<int> distribution(1, successRate); // lets you skip a number of pixels until you encounter the next pixel to accept
-
-  for(unsigned ptIdx = 0; ptIdx < maxPt;)
-  {
-    int index = labels[hyp.objID][ptIdx];
-    cv::Point2d pt2D(index % width, index / width);
-  
-    hyp.effPixels++;
-  
-    // read out object coordinate
-    cv::Point3d obj = getMode3D(hyp.objID, pt2D, vertmap, extents, width, num_classes);
-
-    // reproject collected object coordinates
-    std::vector<cv::Point3d> points3D;
-    std::vector<cv::Point2d> projections;
-    points3D.push_back(obj);
-    cv::projectPoints(points3D, hyp.pose.first, hyp.pose.second, camMat, cv::Mat(), projections);
-
-    // inlier check
-    if(cv::norm(pt2D - projections[0]) < inlierThreshold)
-    {
-      hyp.inlierPts2D.push_back(std::pair<cv::Point3d, cv::Point2d>(obj, pt2D)); // store object coordinate - camera coordinate correspondence
-      hyp.inliers++; // keep track of the number of inliers (correspondences might be thinned out for speed later)
-    }
-
-    // advance to the next accepted pixel
-    if(successRate < 1)
-      ptIdx += std::max(1, distribution(generator));
-    else
-      ptIdx++;
-  }
+  LabelPixelsReprojection policy(this, hyp, camMat, labels[hyp.objID], vertmap, extents, inlierThreshold, width, num_classes);
+  return countInliers(hyp, policy, pixelBatch, test);
 }
 
 
-inline void Synthesizer::countInliers3D(
+inline long Synthesizer::countInliers3D(
       TransHyp& hyp,
       const std::vector<std::vector<int>>& labels,
       const float* vertmap,
@@ -1118,75 +1091,28 @@ inline void Synthesizer::countInliers3D(
       float inlierThreshold,
       int width,
       int num_classes,
-      int pixelBatch)
+      int pixelBatch,
+      SPRT test)
 {
-  // reset data of last RANSAC iteration
-  hyp.inlierPts.clear();
-  hyp.inliers = 0;
-
-  // data conversion
-  jp::jp_trans_t pose = jp::cv2our(hyp.pose);
-  Hypothesis trans(pose.first, pose.second);
-
-  hyp.effPixels = 0; // num of pixels drawn
-  hyp.maxPixels += pixelBatch; // max num of pixels to be drawn	
-
-  int maxPt = labels[hyp.objID].size();
-  float successRate = hyp.maxPixels / (float) maxPt; // probability to accept a pixel
-
-  std::mt19937 generator;
-  std::negative_binomial_distribution<int> distribution(1, successRate); // lets you skip a number of pixels until you encounter the next pixel to accept
-
-  for(unsigned ptIdx = 0; ptIdx < maxPt;)
-  {
-    int index = labels[hyp.objID][ptIdx];
-    cv::Point2d pt2D(index % width, index / width);
-    
-    // skip depth holes
-    if(eyeData(pt2D.y, pt2D.x)[2] == 0)
-    {
-      ptIdx++;
-      continue;
-    }
-  
-    // read out camera coordinate
-    cv::Point3d eye(eyeData(pt2D.y, pt2D.x)[0], eyeData(pt2D.y, pt2D.x)[1], eyeData(pt2D.y, pt2D.x)[2]);
-  
-    hyp.effPixels++;
-  
-    // read out object coordinate
-    cv::Point3d obj = getMode3D(hyp.objID, pt2D, vertmap, extents, width, num_classes);
-
-    // inlier check
-    if(cv::norm(eye - trans.transform(obj)) < inlierThreshold)
-    {
-      hyp.inlierPts.push_back(std::pair<cv::Point3d, cv::Point3d>(obj, eye)); // store object coordinate - camera coordinate correspondence
-      hyp.inliers++; // keep track of the number of inliers (correspondences might be thinned out for speed later)
-    }
-
-    // advance to the next accepted pixel
-    if(successRate < 1)
-      ptIdx += std::max(1, distribution(generator));
-    else
-      ptIdx++;
-  }
+  LabelPixels3D policy(this, hyp, labels[hyp.objID], eyeData, vertmap, extents, inlierThreshold, width, num_classes);
+  return countInliers(hyp, policy, pixelBatch, test);
 }
 
 
 inline void Synthesizer::filterInliers2D(TransHyp& hyp, int maxInliers)
 {
-  if(hyp.inlierPts2D.size() < maxInliers) return; // maximum number not reached, do nothing
+  if(hyp.inlierPts3D2D.size() < maxInliers) return; // maximum number not reached, do nothing
       		
   std::vector<std::pair<cv::Point3d, cv::Point2d>> inlierPts; // filtered list of inlier correspondences
 	
   // select random correspondences to keep
   for(unsigned i = 0; i < maxInliers; i++)
   {
-    int idx = irand(0, hyp.inlierPts2D.size());
-    inlierPts.push_back(hyp.inlierPts2D[idx]);
+    int idx = hyp.rng.irand(0, hyp.inlierPts3D2D.size());
+    inlierPts.push_back(hyp.inlierPts3D2D[idx]);
   }
 	
-  hyp.inlierPts2D = inlierPts;
+  hyp.inlierPts3D2D = inlierPts;
 }
 
 
@@ -1199,7 +1125,7 @@ inline void Synthesizer::filterInliers3D(TransHyp& hyp, int maxInliers)
   // select random correspondences to keep
   for(unsigned i = 0; i < maxInliers; i++)
   {
-    int idx = irand(0, hyp.inlierPts.size());
+    int idx = hyp.rng.irand(0, hyp.inlierPts.size());
     inlierPts.push_back(hyp.inlierPts[idx]);
   }
 	
@@ -1210,15 +1136,15 @@ inline void Synthesizer::filterInliers3D(TransHyp& hyp, int maxInliers)
 inline void Synthesizer::updateHyp2D(TransHyp& hyp, const cv::Mat& camMat, int imgWidth, int imgHeight, 
   const std::vector<cv::Point3f>& bb3D, int maxPixels)
 {
-  if(hyp.inlierPts2D.size() < 4) return;
+  if(hyp.inlierPts3D2D.size() < 4) return;
   filterInliers2D(hyp, maxPixels); // limit the number of correspondences
 
   std::vector<cv::Point2f> points2D;
   std::vector<cv::Point3f> points3D;
-  for (int i = 0; i < hyp.inlierPts2D.size(); i++)
+  for (int i = 0; i < hyp.inlierPts3D2D.size(); i++)
   {
-    points2D.push_back(hyp.inlierPts2D[i].second);
-    points3D.push_back(hyp.inlierPts2D[i].first);
+    points2D.push_back(hyp.inlierPts3D2D[i].second);
+    points3D.push_back(hyp.inlierPts3D2D[i].first);
   }
       
   // recalculate pose
@@ -1254,44 +1180,6 @@ pose estimation using object coordinate regression and depth
 ***********************************************************/
 
 
-jp::coord3_t Synthesizer::pxToEye(int x, int y, jp::depth_t depth, float fx, float fy, float px, float py, float depth_factor)
-{
-  jp::coord3_t eye;
-
-  if(depth == 0) // depth hole -> no camera coordinate
-  {
-    eye(0) = 0;
-    eye(1) = 0;
-    eye(2) = 0;
-    return eye;
-  }
-	
-  eye(0) = (x - px) * depth / fx / depth_factor;
-  eye(1) = (y - py) * depth / fy / depth_factor;
-  eye(2) = depth / depth_factor;
-	
-  return eye;
-}
-
-
-// get 3D points from depth
-void Synthesizer::getEye(unsigned char* rawdepth, jp::img_coord_t& img, jp::img_depth_t& img_depth, int width, int height, float fx, float fy, float px, float py, float depth_factor)
-{
-  ushort* depth = reinterpret_cast<ushort *>(rawdepth);
-
-  img = jp::img_coord_t(height, width);
-  img_depth = jp::img_depth_t(height, width);
-	    
-  #pragma omp parallel for
-  for(int x = 0; x < width; x++)
-  for(int y = 0; y < height; y++)
-  {
-    img(y, x) = pxToEye(x, y, depth[y * width + x], fx, fy, px, py, depth_factor);
-    img_depth(y, x) = depth[y * width + x];
-  }
-}
-
-
 template<class T>
 inline double Synthesizer::getMinDist(const std::vector<T>& pointSet, const T& point)
 {
@@ -1328,20 +1216,20 @@ static double optEnergy2D(const std::vector<double> &pose, std::vector<double> &
 
   std::vector<cv::Point3d> points3D;
   std::vector<cv::Point2d> projections;
-  for (int i = 0; i < dataForOpt->hyp->inlierPts2D.size(); i++)
-    points3D.push_back(dataForOpt->hyp->inlierPts2D[i].first);
+  for (int i = 0; i < dataForOpt->hyp->inlierPts3D2D.size(); i++)
+    points3D.push_back(dataForOpt->hyp->inlierPts3D2D[i].first);
   cv::projectPoints(points3D, trans.first, trans.second, *(dataForOpt->camMat), cv::Mat(), projections);
 	
   float distance = 0;
-  for(int pt = 0; pt < dataForOpt->hyp->inlierPts2D.size(); pt++) // iterate over correspondences
+  for(int pt = 0; pt < dataForOpt->hyp->inlierPts3D2D.size(); pt++) // iterate over correspondences
   {
     // read out pixel point
     cv::Mat_<float> obj(3, 1);
-    cv::Point2d pt2D = dataForOpt->hyp->inlierPts2D.at(pt).second;
+    cv::Point2d pt2D = dataForOpt->hyp->inlierPts3D2D.at(pt).second;
     distance += cv::norm(pt2D - projections[pt]);
   }
       
-  float energy = distance / dataForOpt->hyp->inlierPts.size();	
+  float energy = distance / dataForOpt->hyp->inlierPts3D2D.size();	
   return energy;
 }
 
@@ -1392,7 +1280,36 @@ static double optEnergy3D(const std::vector<double> &pose, std::vector<double> &
 }
 
 
-double Synthesizer::refineWithOpt(TransHyp& hyp, cv::Mat& camMat, int iterations, int is_3D) 
+/**
+ * @brief Refines the pose of a hypothesis on its inlier correspondences.
+ * 
+ * Uses Levenberg-Marquardt with analytic Jacobians of the reprojection (RGB) or point-to-point (RGB-D) residuals,
+ * or the derivative-free NLopt search if selected via useNLopt().
+ * 
+ * @param hyp Hypothesis to refine, the pose is updated in place.
+ * @param camMat Camera matrix.
+ * @param iterations Maximal number of energy evaluations of the NLopt search.
+ * @param is_3D Use the object coordinate - camera coordinate correspondences instead of the object coordinate - pixel correspondences.
+ * @param report Optional output parameter. Convergence report.
+ * @return double Mean residual norm of the refined pose.
+*/
+double Synthesizer::refineWithOpt(TransHyp& hyp, cv::Mat& camMat, int iterations, int is_3D, RefineReport* report) 
+{
+  if(use_nlopt_)
+    return refineWithNLopt(hyp, camMat, iterations, is_3D, report);
+
+  RefineReport result;
+  if (is_3D)
+    result = refinePosePointToPoint(hyp, refine_settings_);
+  else
+    result = refinePoseReprojection(hyp, camMat, refine_settings_);
+
+  if(report) *report = result;
+  return result.meanError;
+}
+
+
+double Synthesizer::refineWithNLopt(TransHyp& hyp, cv::Mat& camMat, int iterations, int is_3D, RefineReport* report) 
 {
   // set up optimization algorithm (gradient free)
   nlopt::opt opt(nlopt::LN_NELDERMEAD, 6); 
@@ -1439,6 +1356,13 @@ double Synthesizer::refineWithOpt(TransHyp& hyp, cv::Mat& camMat, int iterations
   double energy;
   nlopt::result result = opt.optimize(vec, energy);
 
+  if(report)
+  {
+    report->iterations = iterations;
+    report->converged = result != nlopt::MAXEVAL_REACHED;
+    report->meanError = energy;
+  }
+
   // read back optimized pose
   for(int i = 0; i < 6; i++)
   {
@@ -1494,87 +1418,94 @@ void Synthesizer::estimatePose2D(
   // hold for each object a list of pose hypothesis, these are optimized until only one remains per object
   std::map<jp::id_t, std::vector<TransHyp>> hypMap;
 	
-  // sample initial pose hypotheses
-  #pragma omp parallel for
-  for(unsigned h = 0; h < ransacIterations; h++)
-  for(unsigned i = 0; i < maxIterations; i++)
-  {
-    // 2D pixel - 3D object coordinate correspondences
-    std::vector<cv::Point2f> points2D;
-    std::vector<cv::Point3f> points3D;
-	    
-    // sample first point and choose object ID
-    jp::id_t objID = object_ids[irand(0, object_ids.size())];
-    if(objID == 0)
-      continue;
+  // sample initial pose hypotheses, each hypothesis has its own slot and random stream
+  uint32_t frame = frame_++;
+  std::vector<TransHyp> sampled(ransacIterations);
 
-    // sample first correspondence
-    int pindex = irand(0, labels[objID].size());
-    int index = labels[objID][pindex];
-    cv::Point2f pt1(index % width, index / width);
-    if(!samplePoint2D(objID, width, num_classes, points2D, points3D, pt1, vertmap, extents, minDist2D, minDist3D))
-      continue;
+  #pragma omp parallel for schedule(dynamic)
+  for(int h = 0; h < ransacIterations; h++)
+  {
+    Philox rng(frame, h);
+    sampled[h].objID = 0; // stays 0 if no valid hypothesis is found
 
-    // sample other points in search radius, discard hypothesis if minimum distance constrains are violated
-    pindex = irand(0, labels[objID].size());
-    index = labels[objID][pindex];
-    cv::Point2f pt2(index % width, index / width);
-    if(!samplePoint2D(objID, width, num_classes, points2D, points3D, pt2, vertmap, extents, minDist2D, minDist3D))
-      continue;
+    for(unsigned i = 0; i < maxIterations; i++)
+    {
+      // 2D pixel - 3D object coordinate correspondences
+      std::vector<cv::Point2f> points2D;
+      std::vector<cv::Point3f> points3D;
+	    
+      // sample first point and choose object ID
+      jp::id_t objID = object_ids[rng.irand(0, object_ids.size())];
+      if(objID == 0)
+        continue;
+
+      // sample first correspondence
+      int pindex = rng.irand(0, labels[objID].size());
+      int index = labels[objID][pindex];
+      cv::Point2f pt1(index % width, index / width);
+      if(!samplePoint2D(objID, width, num_classes, points2D, points3D, pt1, vertmap, extents, minDist2D, minDist3D))
+        continue;
+
+      // sample other points in search radius, discard hypothesis if minimum distance constrains are violated
+      pindex = rng.irand(0, labels[objID].size());
+      index = labels[objID][pindex];
+      cv::Point2f pt2(index % width, index / width);
+      if(!samplePoint2D(objID, width, num_classes, points2D, points3D, pt2, vertmap, extents, minDist2D, minDist3D))
+        continue;
     
-    pindex = irand(0, labels[objID].size());
-    index = labels[objID][pindex];
-    cv::Point2f pt3(index % width, index / width);
-    if(!samplePoint2D(objID, width, num_classes, points2D, points3D, pt3, vertmap, extents, minDist2D, minDist3D))
-      continue;
-
-    pindex = irand(0, labels[objID].size());
-    index = labels[objID][pindex];
-    cv::Point2f pt4(index % width, index / width);
-    if(!samplePoint2D(objID, width, num_classes, points2D, points3D, pt4, vertmap, extents, minDist2D, minDist3D))
-      continue;
-
-    // check for degenerated configurations
-    if(pointLineDistance(points3D[0], points3D[1], points3D[2]) < minDist3D) continue;
-    if(pointLineDistance(points3D[0], points3D[1], points3D[3]) < minDist3D) continue;
-    if(pointLineDistance(points3D[0], points3D[2], points3D[3]) < minDist3D) continue;
-    if(pointLineDistance(points3D[1], points3D[2], points3D[3]) < minDist3D) continue;
-
-    // reconstruct camera
-    jp::cv_trans_t trans;
-    cv::solvePnP(points3D, points2D, camMat, cv::Mat(), trans.first, trans.second, false, pnpMethod);
+      pindex = rng.irand(0, labels[objID].size());
+      index = labels[objID][pindex];
+      cv::Point2f pt3(index % width, index / width);
+      if(!samplePoint2D(objID, width, num_classes, points2D, points3D, pt3, vertmap, extents, minDist2D, minDist3D))
+        continue;
+
+      pindex = rng.irand(0, labels[objID].size());
+      index = labels[objID][pindex];
+      cv::Point2f pt4(index % width, index / width);
+      if(!samplePoint2D(objID, width, num_classes, points2D, points3D, pt4, vertmap, extents, minDist2D, minDist3D))
+        continue;
+
+      // check for degenerated configurations
+      if(pointLineDistance(points3D[0], points3D[1], points3D[2]) < minDist3D) continue;
+      if(pointLineDistance(points3D[0], points3D[1], points3D[3]) < minDist3D) continue;
+      if(pointLineDistance(points3D[0], points3D[2], points3D[3]) < minDist3D) continue;
+      if(pointLineDistance(points3D[1], points3D[2], points3D[3]) < minDist3D) continue;
+
+      // reconstruct camera
+      jp::cv_trans_t trans;
+      cv::solvePnP(points3D, points2D, camMat, cv::Mat(), trans.first, trans.second, false, pnpMethod);
 		
-    std::vector<cv::Point2f> projections;
-    cv::projectPoints(points3D, trans.first, trans.second, camMat, cv::Mat(), projections);
+      std::vector<cv::Point2f> projections;
+      cv::projectPoints(points3D, trans.first, trans.second, camMat, cv::Mat(), projections);
 		
-    // check reconstruction, 4 sampled points should be reconstructed perfectly
-    bool foundOutlier = false;
-    for(unsigned j = 0; j < points2D.size(); j++)
-    {
-      if(cv::norm(points2D[j] - projections[j]) < inlierThreshold2D) continue;
-      foundOutlier = true;
-      break;
-    }
-    if(foundOutlier) continue;	    
+      // check reconstruction, 4 sampled points should be reconstructed perfectly
+      bool foundOutlier = false;
+      for(unsigned j = 0; j < points2D.size(); j++)
+      {
+        if(cv::norm(points2D[j] - projections[j]) < inlierThreshold2D) continue;
+        foundOutlier = true;
+        break;
+      }
+      if(foundOutlier) continue;	    
 		
-    // create a hypothesis object to store meta data
-    TransHyp hyp(objID, trans);
+      // create a hypothesis object to store meta data
+      TransHyp hyp(objID, trans);
+      hyp.rng = rng; // refinement continues the stream of the slot
 		
-    // update 2D bounding box
-    hyp.bb = getBB2D(width, height, bb3Ds[objID-1], camMat, hyp.pose);
+      // update 2D bounding box
+      hyp.bb = getBB2D(width, height, bb3Ds[objID-1], camMat, hyp.pose);
 
-    //check if bounding box collapses
-    if(hyp.bb.area() < minArea)
-      continue;	   
+      //check if bounding box collapses
+      if(hyp.bb.area() < minArea)
+        continue;	   
         
-    #pragma omp critical
-    {
-      hypMap[objID].push_back(hyp);
+      sampled[h] = hyp;
+      break;
     }
-
-    break;
   }
 
+  groupByObject(sampled, hypMap);
+
   // create a list of all objects where hypptheses have been found
   std::vector<jp::id_t> objList;
   std::cout << std::endl;
@@ -1587,24 +1518,44 @@ void Synthesizer::estimatePose2D(
   // create a working queue of all hypotheses to process
   std::vector<TransHyp*> workingQueue = getWorkingQueue(hypMap, refIt);
 	
+  std::vector<float> bestRates(num_classes, 0); // best inlier rate of each object in the last round, 0 disables the SPRT
+  long evaluated = 0, saved = 0;
+
   // main preemptive RANSAC loop, it will stop if there is max one hypothesis per object remaining which has been refined a minimal number of times
   while(!workingQueue.empty())
   {
     // draw a batch of pixels and check for inliers, the number of pixels looked at is increased in each iteration
-    #pragma omp parallel for
+    // hypotheses which are significantly worse than the best one of their object are abandoned early
+    #pragma omp parallel for reduction(+:evaluated, saved)
     for(int h = 0; h < workingQueue.size(); h++)
-      countInliers2D(*(workingQueue[h]), camMat, labels, vertmap, extents, inlierThreshold2D, width, num_classes, preemptiveBatch);
+    {
+      TransHyp& hyp = *(workingQueue[h]);
+      saved += countInliers2D(hyp, camMat, labels, vertmap, extents, inlierThreshold2D, width, num_classes, preemptiveBatch, SPRT(schedule_, bestRates[hyp.objID]));
+      evaluated += hyp.effPixels;
+    }
 	    	    
-    // sort hypothesis according to inlier count and discard bad half
-    #pragma omp parallel for 
+    // if every hypothesis of an object was abandoned, score the most promising one on its full batch
+    #pragma omp parallel for reduction(+:evaluated, saved)
+    for(unsigned o = 0; o < objList.size(); o++)
+    {
+      TransHyp* hyp = abandonedBest(hypMap[objList[o]]);
+      if(!hyp) continue;
+
+      int partial = hyp->effPixels;
+      hyp->maxPixels -= preemptiveBatch;
+      countInliers2D(*hyp, camMat, labels, vertmap, extents, inlierThreshold2D, width, num_classes, preemptiveBatch, SPRT(schedule_, 0));
+      evaluated += hyp->effPixels - partial;
+      saved -= hyp->effPixels - partial;
+    }
+
+    // sort hypothesis according to inlier count and discard bad half, or all but the best if it dominates
+    #pragma omp parallel for reduction(+:saved)
     for(unsigned o = 0; o < objList.size(); o++)
     {
       jp::id_t objID = objList[o];
-      if(hypMap[objID].size() > 1)
-      {
-	std::sort(hypMap[objID].begin(), hypMap[objID].end());
-	hypMap[objID].erase(hypMap[objID].begin() + hypMap[objID].size() / 2, hypMap[objID].end());
-      }
+      std::vector<TransHyp>& hyps = hypMap[objID];
+      saved += discardHypotheses(hyps, schedule_, hyps[0].maxPixels + preemptiveBatch);
+      bestRates[objID] = (hyps.size() > 1 && hyps[0].effPixels > 0) ? hyps[0].getInlierRate() : 0;
     }
     workingQueue = getWorkingQueue(hypMap, refIt);
 	    
@@ -1619,6 +1570,9 @@ void Synthesizer::estimatePose2D(
     workingQueue = getWorkingQueue(hypMap, refIt);
   }
 
+  schedule_.evaluated = evaluated;
+  schedule_.saved = saved;
+
   for(auto it = hypMap.begin(); it != hypMap.end(); it++)
   for(int h = 0; h < it->second.size(); h++)
   {
@@ -1656,9 +1610,8 @@ void Synthesizer::estimatePose3D(
         int width, int height, int num_classes, float fx, float fy, float px, float py, float depth_factor, float* output)
 {
   // extract camera coordinate image (point cloud) from depth channel
-  jp::img_coord_t eyeData;
-  jp::img_depth_t img_depth;
-  getEye(rawdepth, eyeData, img_depth, width, height, fx, fy, px, py, depth_factor);
+  depth_cache_.update(reinterpret_cast<const ushort*>(rawdepth), width, height, fx, fy, px, py, depth_factor);
+  const jp::img_coord_t& eyeData = depth_cache_.eye;
 
   // bb3Ds
   std::vector<std::vector<cv::Point3f>> bb3Ds;
@@ -1694,86 +1647,121 @@ void Synthesizer::estimatePose3D(
   // hold for each object a list of pose hypothesis, these are optimized until only one remains per object
   std::map<jp::id_t, std::vector<TransHyp>> hypMap;
 	
-  // sample initial pose hypotheses
-  #pragma omp parallel for
-  for(unsigned h = 0; h < ransacIterations; h++)
-  for(unsigned i = 0; i < maxIterations; i++)
-  {
-    // camera coordinate - object coordinate correspondences
-    std::vector<cv::Point3f> eyePts;
-    std::vector<cv::Point3f> objPts;
-	    
-    // sample first point and choose object ID
-    jp::id_t objID = object_ids[irand(0, object_ids.size())];
-    if(objID == 0)
-      continue;
-
-    int pindex = irand(0, labels[objID].size());
-    int index = labels[objID][pindex];
-    cv::Point2f pt1(index % width, index / width);
+  // sample initial pose hypotheses, each hypothesis has its own slot and random stream
+  uint32_t frame = frame_++;
+  std::vector<TransHyp> sampled(ransacIterations);
+  std::vector<Philox> rngs(ransacIterations);
+  for(int h = 0; h < ransacIterations; h++)
+  {
+    rngs[h] = Philox(frame, h);
+    sampled[h].objID = 0; // stays 0 if no valid hypothesis is found
+  }
 
-    // sample first correspondence
-    if(!samplePoint3D(objID, width, num_classes, eyePts, objPts, pt1, vertmap, extents, eyeData, minDist3D))
-      continue;
+  // in each round every slot without a hypothesis draws a minimal sample, and all samples of
+  // the round are solved in one batch
+  std::vector<int> pending(ransacIterations);
+  for(int h = 0; h < ransacIterations; h++)
+    pending[h] = h;
 
-    // sample other points in search radius, discard hypothesis if minimum distance constrains are violated
-    pindex = irand(0, labels[objID].size());
-    index = labels[objID][pindex];
-    cv::Point2f pt2(index % width, index / width);
-    if(!samplePoint3D(objID, width, num_classes, eyePts, objPts, pt2, vertmap, extents, eyeData, minDist3D))
-      continue;
-    
-    pindex = irand(0, labels[objID].size());
-    index = labels[objID][pindex];
-    cv::Point2f pt3(index % width, index / width);
-    if(!samplePoint3D(objID, width, num_classes, eyePts, objPts, pt3, vertmap, extents, eyeData, minDist3D))
-      continue;
+  std::vector<rigid::correspondence_t> samples(ransacIterations * 3);
+  std::vector<rigid::correspondence_t> batch(ransacIterations * 3);
+  std::vector<rigid::Transform> transforms(ransacIterations);
+  std::vector<jp::id_t> sampleIDs(ransacIterations);
+  std::vector<int> drawn(ransacIterations);
 
-    // reconstruct camera
-    std::vector<std::pair<cv::Point3d, cv::Point3d>> pts3D;
-    for(unsigned j = 0; j < eyePts.size(); j++)
+  for(int i = 0; i < maxIterations && !pending.empty(); i++)
+  {
+    #pragma omp parallel for schedule(dynamic)
+    for(int p = 0; p < pending.size(); p++)
     {
-      pts3D.push_back(std::pair<cv::Point3d, cv::Point3d>(
-      cv::Point3d(objPts[j].x, objPts[j].y, objPts[j].z),
-      cv::Point3d(eyePts[j].x, eyePts[j].y, eyePts[j].z)
-      ));
+      Philox& rng = rngs[pending[p]];
+      sampleIDs[p] = 0;
+
+      // camera coordinate - object coordinate correspondences
+      std::vector<cv::Point3f> eyePts;
+      std::vector<cv::Point3f> objPts;
+
+      // sample first point and choose object ID
+      jp::id_t objID = object_ids[rng.irand(0, object_ids.size())];
+      if(objID == 0)
+        continue;
+
+      int pindex = rng.irand(0, labels[objID].size());
+      int index = labels[objID][pindex];
+      cv::Point2f pt1(index % width, index / width);
+
+      // sample first correspondence
+      if(!samplePoint3D(objID, width, num_classes, eyePts, objPts, pt1, vertmap, extents, eyeData, minDist3D))
+        continue;
+
+      // sample other points in search radius, discard hypothesis if minimum distance constrains are violated
+      pindex = rng.irand(0, labels[objID].size());
+      index = labels[objID][pindex];
+      cv::Point2f pt2(index % width, index / width);
+      if(!samplePoint3D(objID, width, num_classes, eyePts, objPts, pt2, vertmap, extents, eyeData, minDist3D))
+        continue;
+
+      pindex = rng.irand(0, labels[objID].size());
+      index = labels[objID][pindex];
+      cv::Point2f pt3(index % width, index / width);
+      if(!samplePoint3D(objID, width, num_classes, eyePts, objPts, pt3, vertmap, extents, eyeData, minDist3D))
+        continue;
+
+      for(unsigned j = 0; j < 3; j++)
+      {
+        samples[p * 3 + j] = rigid::correspondence_t(
+          cv::Point3d(objPts[j].x, objPts[j].y, objPts[j].z),
+          cv::Point3d(eyePts[j].x, eyePts[j].y, eyePts[j].z));
+      }
+      sampleIDs[p] = objID;
     }
 
-    Hypothesis trans(pts3D);
-
-    // check reconstruction, sampled points should be reconstructed perfectly
-    bool foundOutlier = false;
-    for(unsigned j = 0; j < pts3D.size(); j++)
+    // reconstruct camera for all complete samples
+    int numDrawn = 0;
+    for(int p = 0; p < pending.size(); p++)
     {
-      if(cv::norm(pts3D[j].second - trans.transform(pts3D[j].first)) < inlierThreshold3D) continue;
-      foundOutlier = true;
-      break;
+      if(!sampleIDs[p]) continue;
+      std::copy(&samples[p * 3], &samples[p * 3] + 3, &batch[numDrawn * 3]);
+      drawn[numDrawn++] = p;
     }
-    if(foundOutlier) continue;
+    rigid::solveBatch(rigid::Span(batch.data(), numDrawn * 3), 3, transforms.data());
 
-    // pose conversion
-    jp::jp_trans_t pose;
-    pose.first = trans.getRotation();
-    pose.second = trans.getTranslation();
-    
-    // create a hypothesis object to store meta data
-    TransHyp hyp(objID, jp::our2cv(pose));
-    
-    // update 2D bounding box
-    hyp.bb = getBB2D(width, height, bb3Ds[objID-1], camMat, hyp.pose);
-
-    //check if bounding box collapses
-    if(hyp.bb.area() < minArea)
-      continue;	    
-    
-    #pragma omp critical
+    #pragma omp parallel for schedule(dynamic)
+    for(int d = 0; d < numDrawn; d++)
     {
-      hypMap[objID].push_back(hyp);
+      int p = drawn[d];
+      jp::id_t objID = sampleIDs[p];
+
+      // check reconstruction, sampled points should be reconstructed perfectly
+      if(!rigid::reconstructs(rigid::Span(&batch[d * 3], 3), transforms[d], inlierThreshold3D))
+        continue;
+
+      // create a hypothesis object to store meta data
+      TransHyp hyp(objID, jp::our2cv(rigid::toPose(transforms[d])));
+      hyp.rng = rngs[pending[p]]; // refinement continues the stream of the slot
+
+      // update 2D bounding box
+      hyp.bb = getBB2D(width, height, bb3Ds[objID-1], camMat, hyp.pose);
+
+      //check if bounding box collapses
+      if(hyp.bb.area() < minArea)
+        continue;
+
+      sampled[pending[p]] = hyp;
     }
 
-    break;
+    // slots without a hypothesis draw again in the next round
+    int numPending = 0;
+    for(int p = 0; p < pending.size(); p++)
+    {
+      if(!sampled[pending[p]].objID)
+        pending[numPending++] = pending[p];
+    }
+    pending.resize(numPending);
   }
 
+  groupByObject(sampled, hypMap);
+
   // create a list of all objects where hypptheses have been found
   std::vector<jp::id_t> objList;
   std::cout << std::endl;
@@ -1786,24 +1774,44 @@ void Synthesizer::estimatePose3D(
   // create a working queue of all hypotheses to process
   std::vector<TransHyp*> workingQueue = getWorkingQueue(hypMap, refIt);
 	
+  std::vector<float> bestRates(num_classes, 0); // best inlier rate of each object in the last round, 0 disables the SPRT
+  long evaluated = 0, saved = 0;
+
   // main preemptive RANSAC loop, it will stop if there is max one hypothesis per object remaining which has been refined a minimal number of times
   while(!workingQueue.empty())
   {
     // draw a batch of pixels and check for inliers, the number of pixels looked at is increased in each iteration
-    #pragma omp parallel for
+    // hypotheses which are significantly worse than the best one of their object are abandoned early
+    #pragma omp parallel for reduction(+:evaluated, saved)
     for(int h = 0; h < workingQueue.size(); h++)
-      countInliers3D(*(workingQueue[h]), labels, vertmap, extents, eyeData, inlierThreshold3D, width, num_classes, preemptiveBatch);
+    {
+      TransHyp& hyp = *(workingQueue[h]);
+      saved += countInliers3D(hyp, labels, vertmap, extents, eyeData, inlierThreshold3D, width, num_classes, preemptiveBatch, SPRT(schedule_, bestRates[hyp.objID]));
+      evaluated += hyp.effPixels;
+    }
 	    	    
-    // sort hypothesis according to inlier count and discard bad half
-    #pragma omp parallel for 
+    // if every hypothesis of an object was abandoned, score the most promising one on its full batch
+    #pragma omp parallel for reduction(+:evaluated, saved)
+    for(unsigned o = 0; o < objList.size(); o++)
+    {
+      TransHyp* hyp = abandonedBest(hypMap[objList[o]]);
+      if(!hyp) continue;
+
+      int partial = hyp->effPixels;
+      hyp->maxPixels -= preemptiveBatch;
+      countInliers3D(*hyp, labels, vertmap, extents, eyeData, inlierThreshold3D, width, num_classes, preemptiveBatch, SPRT(schedule_, 0));
+      evaluated += hyp->effPixels - partial;
+      saved -= hyp->effPixels - partial;
+    }
+
+    // sort hypothesis according to inlier count and discard bad half, or all but the best if it dominates
+    #pragma omp parallel for reduction(+:saved)
     for(unsigned o = 0; o < objList.size(); o++)
     {
       jp::id_t objID = objList[o];
-      if(hypMap[objID].size() > 1)
-      {
-	std::sort(hypMap[objID].begin(), hypMap[objID].end());
-	hypMap[objID].erase(hypMap[objID].begin() + hypMap[objID].size() / 2, hypMap[objID].end());
-      }
+      std::vector<TransHyp>& hyps = hypMap[objID];
+      saved += discardHypotheses(hyps, schedule_, hyps[0].maxPixels + preemptiveBatch);
+      bestRates[objID] = (hyps.size() > 1 && hyps[0].effPixels > 0) ? hyps[0].getInlierRate() : 0;
     }
     workingQueue = getWorkingQueue(hypMap, refIt);
 	    
@@ -1818,6 +1826,9 @@ void Synthesizer::estimatePose3D(
     workingQueue = getWorkingQueue(hypMap, refIt);
   }
 
+  schedule_.evaluated = evaluated;
+  schedule_.saved = saved;
+
   for(auto it = hypMap.begin(); it != hypMap.end(); it++)
   for(int h = 0; h < it->second.size(); h++)
   {
@@ -1914,7 +1925,70 @@ void Synthesizer::refinePose(int width, int height, int objID, float znear, floa
 }
 
 
+/**
+ * @brief ICP refinement of several pose hypotheses of one object.
+ *
+ * Up to ICP_BATCH_SIZE hypotheses are rendered in one pass into the tiles of the batch renderer,
+ * copied out of the textures once and refined together, so each batch costs one render and one
+ * copy instead of one per hypothesis.
+ *
+ * @param T_cos Pose hypotheses, refined in place.
+ */
+void Synthesizer::refinePoses(int width, int height, int objID, float znear, float zfar, df::Poly3CameraModel<float> model,
+  std::vector<Sophus::SE3f> & T_cos, int iterations, float maxError)
+{
+  std::vector<pangolin::GlBuffer *> attributeBuffers({&texturedVertices_[objID - 1], &vertexNormals_[objID - 1]});
+  Eigen::Vector2f depthRange(znear, zfar);
+
+  for (int begin = 0; begin < T_cos.size(); begin += ICP_BATCH_SIZE)
+  {
+    int n = std::min<int>(ICP_BATCH_SIZE, T_cos.size() - begin);
+
+    // render the hypotheses of the batch into consecutive tiles
+    std::vector<Eigen::Matrix4f> transforms(n);
+    for (int k = 0; k < n; k++)
+      transforms[k] = T_cos[begin + k].matrix().cast<float>();
+    renderer_vn_batch_->renderTiles(attributeBuffers, texturedIndices_[objID - 1], transforms, height);
+
+    const pangolin::GlTextureCudaArray & vertTex = renderer_vn_batch_->texture(0);
+    const pangolin::GlTextureCudaArray & normTex = renderer_vn_batch_->texture(1);
+
+    // copy predicted normals of all tiles in use
+    {
+      pangolin::CudaScopedMappedArray scopedArray(normTex);
+      cudaMemcpy2DFromArray(predicted_normals_batch_device_->data(), normTex.width*4*sizeof(float), *scopedArray, 0, 0, normTex.width*4*sizeof(float), n * height, cudaMemcpyDeviceToDevice);
+    }
+
+    // copy predicted vertices of all tiles in use
+    {
+      pangolin::CudaScopedMappedArray scopedArray(vertTex);
+      cudaMemcpy2DFromArray(predicted_verts_batch_device_->data(), vertTex.width*4*sizeof(float), *scopedArray, 0, 0, vertTex.width*4*sizeof(float), n * height, cudaMemcpyDeviceToDevice);
+    }
+
+    DeviceTensor2<Eigen::UnalignedVec4<float> > predicted_verts({width, n * height}, predicted_verts_batch_device_->data());
+    DeviceTensor2<Eigen::UnalignedVec4<float> > predicted_normals({width, n * height}, predicted_normals_batch_device_->data());
+
+    std::vector<Sophus::SE3f> updates = icpBatch(*vertex_map_device_, predicted_verts, predicted_normals,
+                                                 model, n, depthRange, maxError, iterations, icp_batch_buffers_);
+
+    for (int k = 0; k < n; k++)
+      T_cos[begin + k] = updates[k] * T_cos[begin + k];
+  }
+}
+
 // ICP
+/**
+ * @brief Pose hypotheses of one object in solveICP, with the data to score them against the depth.
+ */
+struct ICPCandidates
+{
+  bool valid = false; // the object has been refined
+  std::vector<Sophus::SE3f> hyps; // refined pose hypotheses
+  std::vector<float> scores; // SegICP score of each hypothesis
+  std::vector<Vec3> model_points; // object coordinates of the object pixels
+  std::vector<uint8_t> mask; // depth points of the object pixels, per pixel index
+};
+
 void Synthesizer::solveICP(const int* labelmap, unsigned char* depth, int height, int width, float fx, float fy, float px, float py, 
   float znear, float zfar, float factor, int num_roi, int channel_roi, const float* rois, const float* poses, 
   float* outputs, float* outputs_icp, float maxError)
@@ -1923,6 +1997,14 @@ void Synthesizer::solveICP(const int* labelmap, unsigned char* depth, int height
   if (setup_ == 0)
     setup(width, height);
 
+  if (!renderer_)
+  {
+    std::cout << "solveICP needs a window, the poses are not refined" << std::endl;
+    std::copy(poses, poses + num_roi * 7, outputs);
+    std::copy(poses, poses + num_roi * 7, outputs_icp);
+    return;
+  }
+
   // build the camera paramters
   Eigen::Matrix<float,7,1,Eigen::DontAlign> params;
   params[0] = fx;
@@ -1947,9 +2029,18 @@ void Synthesizer::solveICP(const int* labelmap, unsigned char* depth, int height
   // set the depth factor
   depth_factor_ = factor;
 
+  // back-project the frame once for all objects
+  depth_cache_.update(reinterpret_cast<const ushort*>(depth), width, height, fx, fy, px, py, depth_factor_);
+  depth_cache_.labels.build(labelmap, width, height, texturedVertices_.size() + 1);
+  scene_index_.build(depth_cache_.eye, 0.01f);
+
+  // refined hypotheses of each object, scored together after all objects are refined
+  std::vector<ICPCandidates> candidates(num_roi);
+
   pangolin::OpenGlMatrixSpec projectionMatrix = pangolin::ProjectionMatrixRDF_TopLeft(width, height, fx, -fy, px+0.5, height-(py+0.5), znear, zfar);
   renderer_->setProjectionMatrix(projectionMatrix);
   renderer_vn_->setProjectionMatrix(projectionMatrix);
+  renderer_vn_batch_->setProjectionMatrix(projectionMatrix);
 
   // for each object
   for(int i = 0; i < num_roi; i++)
@@ -2004,20 +2095,9 @@ void Synthesizer::solveICP(const int* labelmap, unsigned char* depth, int height
       predicted_verts_->copyFrom(*predicted_verts_device_);
     }
 
-    // convert depth values
-    label_indexes_.clear();
-    float* p = depth_map_->data();
-    ushort* q = reinterpret_cast<ushort *>(depth);
-    for (int j = 0; j < width * height; j++)
-    {
-      if (labelmap[j] == objID)
-      {
-        p[j] = q[j] / depth_factor_;
-        label_indexes_.push_back(j);
-      }
-      else
-        p[j] = 0;
-    }
+    // pixels of the object
+    const LabelIndex& labels = depth_cache_.labels;
+    label_indexes_.assign(labels.data(objID), labels.data(objID) + labels.size(objID));
 
     if (label_indexes_.size() < 400)
     {
@@ -2025,24 +2105,31 @@ void Synthesizer::solveICP(const int* labelmap, unsigned char* depth, int height
       continue;
     }
 
-    // backprojection
-    depth_map_device_->copyFrom(*depth_map_);
-    backproject<float, Poly3CameraModel>(*depth_map_device_, *vertex_map_device_, model);
-    vertex_map_->copyFrom(*vertex_map_device_);
+    // points of the object from the back-projection of the frame, zero elsewhere
+    Vec3* v = vertex_map_->data();
+    std::fill(v, v + width * height, Vec3(0, 0, 0));
+    for (int j = 0; j < label_indexes_.size(); j++)
+    {
+      const jp::coord3_t& e = depth_cache_.point(label_indexes_[j]);
+      v[label_indexes_[j]] = Vec3(e[0], e[1], e[2]);
+    }
+    vertex_map_device_->copyFrom(*vertex_map_);
 
     // compute object center using depth and vertmap
     float Tx = 0;
     float Ty = 0;
     float Tz = 0;
     int c = 0;
-    std::vector<PointT> depth_points;
-    std::vector<Vec3> model_points;
+    ICPCandidates& cand = candidates[i];
+    std::vector<Vec3>& model_points = cand.model_points;
+    cand.mask.assign(width * height, 0);
+    int num_depth_points = 0;
     for (int j = 0; j < label_indexes_.size(); j++)
     {
       int x = label_indexes_[j] % width;
       int y = label_indexes_[j] / width;
 
-      if ((*depth_map_)(x, y) > 0)
+      if (depth_cache_.valid(label_indexes_[j]))
       {
         float vx = vertmap[y * width + x].x - std::round(vertmap[y * width + x].x);
         float vy = vertmap[y * width + x].y;
@@ -2068,11 +2155,9 @@ void Synthesizer::solveICP(const int* labelmap, unsigned char* depth, int height
           mt(2) = vz;
           model_points.push_back(mt);
 
-          PointT pt;
-          pt.x = dpoint(0);
-          pt.y = dpoint(1);
-          pt.z = dpoint(2);
-          depth_points.push_back(pt);
+          // the depth point takes part in the scoring of the hypotheses
+          cand.mask[label_indexes_[j]] = 1;
+          num_depth_points++;
         }
       }
     }
@@ -2146,103 +2231,74 @@ void Synthesizer::solveICP(const int* labelmap, unsigned char* depth, int height
     hyps.push_back(T_co);
     
     iterations = 8;
-    for (int j = 0; j < hyps.size(); j++)
-    {
-      refinePose(width, height, objID, znear, zfar, labelmap, data, model, hyps[j], iterations, maxError, 1);
-      std::cout << "pose " << j << std::endl << hyps[j].matrix() << std::endl;
-    }
+    refinePoses(width, height, objID, znear, zfar, model, hyps, iterations, maxError);
+
+    cand.hyps = hyps;
+    cand.valid = true;
+    if (num_depth_points == 0)
+      cand.model_points.clear(); // nothing to score against, keep the first hypothesis
+  }
+
+  // use the metric in SegICP: fraction of model points with a distinct depth point within 1cm,
+  // all hypotheses of all objects are scored in one pass against the index of the frame
+  std::vector<std::pair<int, int> > tasks;
+  for (int i = 0; i < num_roi; i++)
+  {
+    candidates[i].scores.assign(candidates[i].hyps.size(), 0);
+    if (candidates[i].model_points.empty()) continue;
+    for (int j = 0; j < candidates[i].hyps.size(); j++)
+      tasks.push_back(std::make_pair(i, j));
+  }
 
-    if (depth_points.size() > 0)
+  #pragma omp parallel
+  {
+    // per-thread flags of the depth points already matched, tagged with the task to avoid clearing
+    std::vector<int> matched(width * height, -1);
+
+    #pragma omp for schedule(dynamic)
+    for (int t = 0; t < tasks.size(); t++)
     {
-      // build a kd-tree of the depth points
-      PointCloud::Ptr cloud(new PointCloud);
-      cloud->width = depth_points.size();
-      cloud->height = 1;
-      cloud->points.resize(cloud->width * cloud->height);
-      for (size_t j = 0; j < cloud->points.size(); j++)
-      {
-        cloud->points[j].x = depth_points[j].x;
-        cloud->points[j].y = depth_points[j].y;
-        cloud->points[j].z = depth_points[j].z;
-      }
-      pcl::KdTreeFLANN<pcl::PointXYZ> kdtree;
-      kdtree.setInputCloud(cloud);
+      ICPCandidates& cand = candidates[tasks[t].first];
+      const Sophus::SE3f& hyp = cand.hyps[tasks[t].second];
 
-      // use the metric in SegICP
-      float max_score = -FLT_MAX;
-      int choose = -1;
-      for (int j = 0; j < hyps.size(); j++)
+      int score = 0;
+      for (int k = 0; k < cand.model_points.size(); k++)
       {
-        float score = 0;
-        std::vector<int> flags(depth_points.size(), 0);
-        #pragma omp parallel for
-        for (int k = 0; k < model_points.size(); k++)
+        Vec3 pt = hyp * cand.model_points[k];
+        int id = scene_index_.nearest(pt(0), pt(1), pt(2), 0.01f, cand.mask.data());
+        if (id >= 0 && matched[id] != t)
         {
-          Vec3 pt = hyps[j] * model_points[k];
-          PointT searchPoint;
-          searchPoint.x = pt(0);
-          searchPoint.y = pt(1);
-          searchPoint.z = pt(2);
-
-          std::vector<int> pointIdxRadiusSearch;
-          std::vector<float> pointRadiusSquaredDistance;
-          float radius = 0.01;
-          if (kdtree.radiusSearch (searchPoint, radius, pointIdxRadiusSearch, pointRadiusSquaredDistance) > 0 )
-          {
-            if (flags[pointIdxRadiusSearch[0]] == 0)
-            {
-              flags[pointIdxRadiusSearch[0]] = 1;
-              score++;
-            }
-          }
-/*
-          // nearest neighbor search
-          std::vector<int> pointIdxNKNSearch(1);
-          std::vector<float> pointNKNSquaredDistance(1);
-          if (kdtree.nearestKSearch (searchPoint, 1, pointIdxNKNSearch, pointNKNSquaredDistance) > 0)
-          {
-            // printf("index %d, distance %f, flag %d\n", pointIdxNKNSearch[0], pointNKNSquaredDistance[0], flags[pointIdxNKNSearch[0]]);
-            if (flags[pointIdxNKNSearch[0]] == 0)
-            {
-              flags[pointIdxNKNSearch[0]] = 1;
-              score++;
-            }
-          }
-*/
+          matched[id] = t;
+          score++;
         }
-        score /= model_points.size();
-        if (score > max_score)
-        {
-          max_score = score;
-          choose = j;
-        }
-        printf("hypothesis %d, score %f\n", j, score);
       }
-      printf("select hypothesis %d\n", choose);
+      cand.scores[tasks[t].second] = score / (float) cand.model_points.size();
+    }
+  }
+
+  for (int i = 0; i < num_roi; i++)
+  {
+    ICPCandidates& cand = candidates[i];
+    if (!cand.valid)
+      continue;
 
-      // chose hypothesis
-      /*
-      float dis = 1000000;
-      int choose = -1;
-      for (int j = 0; j < hyps.size(); j++)
+    // chose hypothesis
+    int choose = 0;
+    if (!cand.model_points.empty())
+    {
+      float max_score = -FLT_MAX;
+      for (int j = 0; j < cand.hyps.size(); j++)
       {
-        float cx = hyps[j].translation()(0) / hyps[j].translation()(2);
-        float cy = hyps[j].translation()(1) / hyps[j].translation()(2);
-        float distance = std::sqrt( (cx - rx) * (cx - rx) + (cy - ry) * (cy - ry) );
-        // float distance = (translation_1 - hyps[j].translation()).norm();
-        std::cout << "pose " << j << std::endl << hyps[j].matrix() << std::endl << "distance: " << distance << std::endl;
-        std::cout << "anglur distance: " << T_co.unit_quaternion().angularDistance(hyps[j].unit_quaternion()) << std::endl;
-        if (distance < dis)
+        if (cand.scores[j] > max_score)
         {
-          dis = distance;
+          max_score = cand.scores[j];
           choose = j;
         }
+        printf("object %d, hypothesis %d, score %f\n", i, j, cand.scores[j]);
       }
-      */
-      T_co = hyps[choose];
+      printf("select hypothesis %d\n", choose);
     }
-    else
-      T_co = hyps[0];
+    Sophus::SE3f T_co = cand.hyps[choose];
 
     // set output
     Eigen::Quaternionf quaternion_new = T_co.unit_quaternion();
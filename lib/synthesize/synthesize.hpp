@@ -17,10 +17,6 @@
 #include <opencv2/opencv_modules.hpp>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
-#include <assimp/cimport.h>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-#include <assimp/Importer.hpp>
 #include <OpenEXR/half.h>
 
 #include <pcl/io/pcd_io.h>
@@ -48,10 +44,19 @@
 
 #include "types.h"
 #include "ransac.h"
+#include "ransac_schedule.h"
+#include "inlier_scoring.h"
+#include "pose_refiner.h"
+#include "depth_cache.h"
+#include "scene_index.h"
+#include "pose_library.h"
+#include "mesh_import.h"
 #include "Hypothesis.h"
+#include "rigid_solve.h"
 #include "detection.h"
 #include "thread_rand.h"
 #include "iou.h"
+#include "cpu_rasterizer.h"
 
 typedef pcl::PointXYZ PointT;
 typedef pcl::PointCloud<PointT> PointCloud;
@@ -59,6 +64,8 @@ typedef pcl::PointNormal PointNormalT;
 typedef pcl::PointCloud<PointNormalT> PointCloudWithNormals;
 typedef Eigen::Matrix<float,3,1,Eigen::DontAlign> Vec3;
 
+#define ICP_BATCH_SIZE 8 // maximal number of pose hypotheses rendered and refined together
+
 template <typename Derived>
 inline void operator >>(std::istream & stream, Eigen::MatrixBase<Derived> & M)
 {
@@ -104,7 +111,7 @@ class Synthesizer
   Synthesizer(std::string model_file, std::string pose_file);
   ~Synthesizer();
 
-  void setup(int width, int height);
+  void setup(int width, int height, bool window = true);
   void create_window(int width, int height);
   void destroy_window();
   void render(int width, int height, float fx, float fy, float px, float py, float znear, float zfar, 
@@ -112,12 +119,16 @@ class Synthesizer
               float* vertex_targets, float* vertex_weights, float weight);
   void render_one(int which_class, int width, int height, float fx, float fy, float px, float py, float znear, float zfar, 
               unsigned char* color, float* depth, float* vertmap, float *poses_return, float* centers_return, float* extents);
+  void rasterizeScene(const std::vector<int>& class_ids, const std::vector<Sophus::SE3d>& poses,
+    int width, int height, float fx, float fy, float px, float py, float znear, float zfar, float* vertmap);
+  void shadeScene(int width, int height, float fx, float fy, float px, float py, float znear, float zfar,
+    const float* lightpos, float attenuation, unsigned char* color, float* depth);
+  void saveImages(int width, int height, float znear, float zfar, unsigned char* color, float* depth);
   void loadModels(std::string filename);
   void loadPoses(const std::string filename);
-  aiMesh* loadTexturedMesh(const std::string filename, std::string & texture_name);
-  void initializeBuffers(int model_index, aiMesh* assimpMesh, std::string textureName,
+  void initializeBuffers(int model_index, const MeshCache & mesh,
     pangolin::GlBuffer & vertices, pangolin::GlBuffer & canonicalVertices, pangolin::GlBuffer & colors, pangolin::GlBuffer & normals,
-    pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture, bool is_textured);
+    pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture);
 
   jp::jp_trans_t quat2our(const Sophus::SE3d T_co);
 
@@ -128,16 +139,16 @@ class Synthesizer
   double poseWithOpt(std::vector<double> & vec, DataForOpt data, int iterations);
   void refinePose(int width, int height, int objID, float znear, float zfar,
                   const int* labelmap, DataForOpt data, df::Poly3CameraModel<float> model, Sophus::SE3f & T_co, int iterations, float maxError, int is_icp);
+  void refinePoses(int width, int height, int objID, float znear, float zfar, df::Poly3CameraModel<float> model,
+                   std::vector<Sophus::SE3f> & T_cos, int iterations, float maxError);
 
   // pose estimation with color
   void estimatePose2D(const int* labelmap, const float* vertmap, const float* extents,
         int width, int height, int num_classes, float fx, float fy, float px, float py, float* output);
   inline void filterInliers2D(TransHyp& hyp, int maxInliers);
   inline void updateHyp2D(TransHyp& hyp, const cv::Mat& camMat, int imgWidth, int imgHeight, const std::vector<cv::Point3f>& bb3D, int maxPixels);
-  inline void countInliers2D(TransHyp& hyp, const cv::Mat& camMat, const std::vector<std::vector<int>>& labels, const float* vertmap,
-      const float* extents, float inlierThreshold, int width, int num_classes, int pixelBatch);
-  inline float point2line(cv::Point2d x, cv::Point2f n, cv::Point2f p);
-  std::vector<TransHyp*> getWorkingQueue(std::map<jp::id_t, std::vector<TransHyp>>& hypMap, int maxIt);
+  inline long countInliers2D(TransHyp& hyp, const cv::Mat& camMat, const std::vector<std::vector<int>>& labels, const float* vertmap,
+      const float* extents, float inlierThreshold, int width, int num_classes, int pixelBatch, SPRT test);
   inline bool samplePoint2D(jp::id_t objID, int width, int num_classes, std::vector<cv::Point2f>& pts2D, 
     std::vector<cv::Point3f>& pts3D, const cv::Point2f& pt2D, const float* vertmap, const float* extents, float minDist2D, float minDist3D);
   void getBb3Ds(const float* extents, std::vector<std::vector<cv::Point3f>>& bb3Ds, int num_classes);
@@ -148,15 +159,21 @@ class Synthesizer
         int width, int height, int num_classes, float fx, float fy, float px, float py, float depth_factor, float* output);
   inline void updateHyp3D(TransHyp& hyp, const cv::Mat& camMat, int imgWidth, int imgHeight, const std::vector<cv::Point3f>& bb3D, int maxPixels);
   inline void filterInliers3D(TransHyp& hyp, int maxInliers);
-  inline void countInliers3D(TransHyp& hyp, const std::vector<std::vector<int>>& labels, const float* vertmap, const float* extents, const jp::img_coord_t& eyeData,float inlierThreshold, int width, int num_classes, int pixelBatch);
+  inline long countInliers3D(TransHyp& hyp, const std::vector<std::vector<int>>& labels, const float* vertmap, const float* extents, const jp::img_coord_t& eyeData,float inlierThreshold, int width, int num_classes, int pixelBatch, SPRT test);
   inline bool samplePoint3D(jp::id_t objID, int width, int num_classes, std::vector<cv::Point3f>& eyePts, std::vector<cv::Point3f>& objPts, const cv::Point2f& pt2D,
       const float* vertmap, const float* extents, const jp::img_coord_t& eyeData, float minDist3D);
   inline cv::Point3f getMode3D(jp::id_t objID, const cv::Point2f& pt, const float* vertmap, const float* extents, int width, int num_classes);
   template<class T> inline double getMinDist(const std::vector<T>& pointSet, const T& point);
-  void getEye(unsigned char* rawdepth, jp::img_coord_t& img, jp::img_depth_t& img_depth, int width, int height, float fx, float fy, float px, float py, float depth_factor);
-  jp::coord3_t pxToEye(int x, int y, jp::depth_t depth, float fx, float fy, float px, float py, float depth_factor);
 
-  double refineWithOpt(TransHyp& hyp, cv::Mat& camMat, int iterations, int is_3D);
+  double refineWithOpt(TransHyp& hyp, cv::Mat& camMat, int iterations, int is_3D, RefineReport* report = NULL);
+  double refineWithNLopt(TransHyp& hyp, cv::Mat& camMat, int iterations, int is_3D, RefineReport* report);
+
+  // refinement of the RANSAC poses, Levenberg-Marquardt on SE(3) unless the derivative-free NLopt search is selected
+  RefineSettings& refineSettings() { return refine_settings_; }
+  bool& useNLopt() { return use_nlopt_; }
+
+  // schedule of the preemptive RANSAC, also holds the statistics of the last estimation
+  RansacSchedule& schedule() { return schedule_; }
   inline double pointLineDistance(const cv::Point3f& pt1, const cv::Point3f& pt2, const cv::Point3f& pt3);
 
  private:
@@ -170,8 +187,8 @@ class Synthesizer
   float depth_factor_;
   float depth_cutoff_;
   std::vector<int> label_indexes_;
-  df::ManagedTensor<2, float>* depth_map_;
-  df::ManagedTensor<2, float, df::DeviceResident>* depth_map_device_;
+  DepthCache depth_cache_;
+  SceneIndex scene_index_;
 
   // 3D points
   df::ManagedDeviceTensor2<Vec3>* vertex_map_device_;
@@ -180,21 +197,28 @@ class Synthesizer
   df::ManagedDeviceTensor2<Eigen::UnalignedVec4<float> >* predicted_normals_device_;
   df::ManagedHostTensor2<Eigen::UnalignedVec4<float> >* predicted_verts_;
   df::ManagedHostTensor2<Eigen::UnalignedVec4<float> >* predicted_normals_;
+  df::ManagedDeviceTensor2<Eigen::UnalignedVec4<float> >* predicted_verts_batch_device_; // ICP_BATCH_SIZE predictions stacked vertically
+  df::ManagedDeviceTensor2<Eigen::UnalignedVec4<float> >* predicted_normals_batch_device_;
+  df::ICPBatchBuffers<float> icp_batch_buffers_; // device buffers of the batched ICP, grown to the largest batch
 
   // poses
-  std::vector<float*> poses_;
-  std::vector<int> pose_nums_;
+  PoseLibrary pose_library_;
   std::vector<bool> is_textured_;
 
   // rois
   std::vector<std::vector<cv::Vec<float, 12> > > rois_;
 
+  // preemptive RANSAC
+  RansacSchedule schedule_;
+  uint32_t frame_; // number of estimations so far, selects the random streams of the hypothesis sampling
+
+  // pose refinement
+  RefineSettings refine_settings_;
+  bool use_nlopt_;
+
   // 3D bounding boxes
   std::vector<std::vector<cv::Point3f>> bb3Ds_;
 
-  // 3D models
-  std::vector<aiMesh*> assimpMeshes_;
-
   // pangoline views
   pangolin::View* gtView_;
 
@@ -207,6 +231,12 @@ class Synthesizer
   std::vector<pangolin::GlBuffer> texturedCoords_;
   std::vector<pangolin::GlTexture> texturedTextures_;
 
+  // meshes of the CPU rasterizer, only kept without a window
+  std::vector<MeshCache*> meshes_;
+  CpuRasterizer rasterizer_;
+  RenderBuffers raster_buffers_;
+
   df::GLRenderer<df::CanonicalVertRenderType>* renderer_;
   df::GLRenderer<df::VertAndNormalRenderType>* renderer_vn_;
+  df::GLRenderer<df::VertAndNormalRenderType>* renderer_vn_batch_; // ICP_BATCH_SIZE tiles of the image size stacked vertically
 };
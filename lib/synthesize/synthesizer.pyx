@@ -13,7 +13,7 @@ import ctypes
 cdef extern from "synthesizer.hpp":
     cdef cppclass Synthesizer:
         Synthesizer(string, string) except +
-        void setup(int, int )
+        void setup(int, int, bint) except +
         void render(int, int, float, float, float, float, float, float, unsigned char*, float*, float*, float*, float*, float*, float*, float*, float)
         void render_one(int, int, int, float, float, float, float, float, float, unsigned char*, float*, float*, float*, float*, float*)
         void solveICP(int*, unsigned char*, int, int, float, float, float, float, float, float, float, int, int, const float*, const float*, float*, float*, float)
@@ -29,8 +29,9 @@ cdef class PySynthesizer:
     def __dealloc__(self):
         del self.synthesizer
 
-    def setup(self, int width, int height):
-        self.synthesizer.setup(width, height)
+    # without a window render and render_one use the CPU rasterizer, refine_poses needs a window
+    def setup(self, int width, int height, bint window=True):
+        self.synthesizer.setup(width, height, window)
 
     def render(self, np.ndarray[np.uint8_t, ndim=3] color, np.ndarray[np.float32_t, ndim=2] depth, np.ndarray[np.float32_t, ndim=3] vertmap, \
                np.ndarray[np.float32_t, ndim=1] class_indexes, np.ndarray[np.float32_t, ndim=2] poses, np.ndarray[np.float32_t, ndim=2] centers,\
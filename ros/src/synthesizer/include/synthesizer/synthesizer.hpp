@@ -19,10 +19,6 @@
 #include <opencv2/opencv_modules.hpp>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
-#include <assimp/cimport.h>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-#include <assimp/Importer.hpp>
 
 #include <pcl/io/pcd_io.h>
 #include <pcl/point_types.h>
@@ -47,6 +43,9 @@
 #include <df/util/tensor.h>
 #include <df/optimization/icp.h>
 
+#include "pose_library.h"
+#include "mesh_import.h"
+
 #include <ros/ros.h>
 #include <geometry_msgs/Point32.h>
 
@@ -98,10 +97,9 @@ class Synthesizer
   void destroy_window();
   void loadModels(std::string filename);
   void loadPoses(const std::string filename);
-  aiMesh* loadTexturedMesh(const std::string filename, std::string & texture_name);
-  void initializeBuffers(int model_index, aiMesh* assimpMesh, std::string textureName,
+  void initializeBuffers(int model_index, const MeshCache & mesh,
     pangolin::GlBuffer & vertices, pangolin::GlBuffer & canonicalVertices, pangolin::GlBuffer & colors, pangolin::GlBuffer & normals,
-    pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture, bool is_textured);
+    pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture);
 
   // pose refinement with ICP
   void refineDistance(const int* labelmap, unsigned char* depth, int height, int width, float fx, float fy, float px, float py, float znear, float zfar, 
@@ -137,16 +135,12 @@ class Synthesizer
   df::ManagedHostTensor2<Eigen::UnalignedVec4<float> >* predicted_normals_;
 
   // poses
-  std::vector<float*> poses_;
-  std::vector<int> pose_nums_;
+  PoseLibrary pose_library_;
   std::vector<bool> is_textured_;
 
   // rois
   std::vector<std::vector<cv::Vec<float, 12> > > rois_;
 
-  // 3D models
-  std::vector<aiMesh*> assimpMeshes_;
-
   // pangoline views
   pangolin::View* gtView_;
 
@@ -68,77 +68,19 @@ void Synthesizer::destroy_window()
   delete renderer_vn_;
 }
 
-// read the poses
+// read the poses, a binary pose library or a list of text pose files
 void Synthesizer::loadPoses(const std::string filename)
 {
-  std::ifstream stream(filename);
-  std::vector<std::string> model_names;
-  std::string name;
-
-  while ( std::getline (stream, name) )
-  {
-    std::cout << name << std::endl;
-    model_names.push_back(name);
-  }
-  stream.close();
-
-  // load poses
-  const int num_models = model_names.size();
-  poses_.resize(num_models);
-  pose_nums_.resize(num_models);
-
-  for (int m = 0; m < num_models; ++m)
-  {
-    // cout lines
-    int num_lines = 0;
-    std::ifstream stream1(model_names[m]);
-    std::string name;
-
-    while ( std::getline (stream1, name) )
-      num_lines++;
-    stream1.close();
-    pose_nums_[m] = num_lines;
-
-    // allocate memory
-    float* pose = (float*)malloc(sizeof(float) * num_lines * 7);
-
-    // load data
-    FILE* fp = fopen(model_names[m].c_str(), "r");
-    for (int i = 0; i < num_lines * 7; i++)
-      fscanf(fp, "%f", pose + i);
-    fclose(fp);
-
-    poses_[m] = pose;
-
-    std::cout << model_names[m] << std::endl;
-  }
+  if (!pose_library_.load(filename))
+    std::cout << "failed to load poses from " << filename << std::endl;
 }
 
 // read the 3D models
 void Synthesizer::loadModels(const std::string filename)
 {
-  std::ifstream stream(filename);
-  std::vector<std::string> model_names;
-  std::vector<std::string> texture_names;
-  std::string name;
-
-  while ( std::getline (stream, name) )
-  {
-    std::cout << name << std::endl;
-    model_names.push_back(name);
-  }
-  stream.close();
-
-  // load meshes
-  const int num_models = model_names.size();
-  assimpMeshes_.resize(num_models);
-  texture_names.resize(num_models);
-
-  for (int m = 0; m < num_models; ++m)
-  {
-    assimpMeshes_[m] = loadTexturedMesh(model_names[m], texture_names[m]);
-    std::cout << texture_names[m] << std::endl;
-  }
+  std::vector<MeshCache*> meshes;
+  loadMeshes(filename, meshes);
+  const int num_models = meshes.size();
 
   // buffers
   texturedVertices_.resize(num_models);
@@ -152,81 +94,33 @@ void Synthesizer::loadModels(const std::string filename)
 
   for (int m = 0; m < num_models; m++)
   {
-    bool is_textured;
-    if (texture_names[m] == "")
-      is_textured = false;
-    else
-      is_textured = true;
-    is_textured_[m] = is_textured;
+    const MeshCache & mesh = *meshes[m];
+    is_textured_[m] = mesh.hasTexture();
 
-    initializeBuffers(m, assimpMeshes_[m], texture_names[m], texturedVertices_[m], canonicalVertices_[m], vertexColors_[m], vertexNormals_[m],
-                      texturedIndices_[m], texturedCoords_[m], texturedTextures_[m], is_textured);
+    initializeBuffers(m, mesh, texturedVertices_[m], canonicalVertices_[m], vertexColors_[m], vertexNormals_[m],
+                      texturedIndices_[m], texturedCoords_[m], texturedTextures_[m]);
   }
-}
-
-aiMesh* Synthesizer::loadTexturedMesh(const std::string filename, std::string & texture_name)
-{
-    const struct aiScene * scene = aiImportFile(filename.c_str(), aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals);
-    if (scene == 0) {
-        throw std::runtime_error("error: " + std::string(aiGetErrorString()));
-    }
-
-    if (scene->mNumMeshes != 1) {
-        const int nMeshes = scene->mNumMeshes;
-        aiReleaseImport(scene);
-        throw std::runtime_error("there are " + std::to_string(nMeshes) + " meshes in " + filename);
-    }
-
-    if (!scene->HasMaterials()) {
-        throw std::runtime_error(filename + " has no materials");
-    }
-
-    std::cout << scene->mNumMaterials << " materials" << std::endl;
-
-    std::string textureName = filename.substr(0,filename.find_last_of('/')+1);
-    for (int i = 0; i < scene->mNumMaterials; ++i) 
-    {
-        aiMaterial * material = scene->mMaterials[i];
-        std::cout << "diffuse: " << material->GetTextureCount(aiTextureType_DIFFUSE) << std::endl;
-        std::cout << "specular: " << material->GetTextureCount(aiTextureType_SPECULAR) << std::endl;
-        std::cout << "ambient: " << material->GetTextureCount(aiTextureType_AMBIENT) << std::endl;
-        std::cout << "shininess: " << material->GetTextureCount(aiTextureType_SHININESS) << std::endl;
-
-        if (material->GetTextureCount(aiTextureType_DIFFUSE)) 
-        {
-            aiString path;
-            material->GetTexture(aiTextureType_DIFFUSE,0,&path);
-            textureName = textureName + std::string(path.C_Str());
-        }
-    }
-
-    aiMesh * assimpMesh = scene->mMeshes[0];
-    std::cout << "number of vertices: " << assimpMesh->mNumVertices << std::endl;
-    std::cout << "number of faces: " << assimpMesh->mNumFaces << std::endl;
 
-    if (!assimpMesh->HasTextureCoords(0))
-      texture_name = "";
-    else
-      texture_name = textureName;
-
-    return assimpMesh;
+  // the meshes are only needed until they are uploaded
+  releaseMeshes(meshes);
 }
 
 
-void Synthesizer::initializeBuffers(int model_index, aiMesh* assimpMesh, std::string textureName,
+void Synthesizer::initializeBuffers(int model_index, const MeshCache & mesh,
   pangolin::GlBuffer & vertices, pangolin::GlBuffer & canonicalVertices, pangolin::GlBuffer & colors, pangolin::GlBuffer & normals,
-  pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture, bool is_textured)
+  pangolin::GlBuffer & indices, pangolin::GlBuffer & texCoords, pangolin::GlTexture & texture)
 {
-    std::cout << "number of vertices: " << assimpMesh->mNumVertices << std::endl;
-    std::cout << "number of faces: " << assimpMesh->mNumFaces << std::endl;
-    vertices.Reinitialise(pangolin::GlArrayBuffer, assimpMesh->mNumVertices, GL_FLOAT, 3, GL_STATIC_DRAW);
-    vertices.Upload(assimpMesh->mVertices, assimpMesh->mNumVertices*sizeof(float)*3);
+    const int num_vertices = mesh.numVertices();
+    std::cout << "number of vertices: " << num_vertices << std::endl;
+    std::cout << "number of faces: " << mesh.numFaces() << std::endl;
+    vertices.Reinitialise(pangolin::GlArrayBuffer, num_vertices, GL_FLOAT, 3, GL_STATIC_DRAW);
+    vertices.Upload(mesh.positions(), num_vertices*sizeof(float)*3);
 
     // normals
-    if (assimpMesh->HasNormals())
+    if (mesh.normals())
     {
-      normals.Reinitialise(pangolin::GlArrayBuffer, assimpMesh->mNumVertices, GL_FLOAT, 3, GL_STATIC_DRAW);
-      normals.Upload(assimpMesh->mNormals, assimpMesh->mNumVertices*sizeof(float)*3);
+      normals.Reinitialise(pangolin::GlArrayBuffer, num_vertices, GL_FLOAT, 3, GL_STATIC_DRAW);
+      normals.Upload(mesh.normals(), num_vertices*sizeof(float)*3);
     }
     else
     {
@@ -234,52 +128,36 @@ void Synthesizer::initializeBuffers(int model_index, aiMesh* assimpMesh, std::st
     }
 
     // canonical vertices
-    std::vector<float3> canonicalVerts(assimpMesh->mNumVertices);
-    std::memcpy(canonicalVerts.data(), assimpMesh->mVertices, assimpMesh->mNumVertices*sizeof(float3));
+    std::vector<float3> canonicalVerts(num_vertices);
+    std::memcpy(canonicalVerts.data(), mesh.positions(), num_vertices*sizeof(float3));
 
-    for (std::size_t i = 0; i < assimpMesh->mNumVertices; i++)
+    for (int i = 0; i < num_vertices; i++)
       canonicalVerts[i].x += model_index;
 
-    canonicalVertices.Reinitialise(pangolin::GlArrayBuffer, assimpMesh->mNumVertices, GL_FLOAT, 3, GL_STATIC_DRAW);
-    canonicalVertices.Upload(canonicalVerts.data(), assimpMesh->mNumVertices*sizeof(float3));
+    canonicalVertices.Reinitialise(pangolin::GlArrayBuffer, num_vertices, GL_FLOAT, 3, GL_STATIC_DRAW);
+    canonicalVertices.Upload(canonicalVerts.data(), num_vertices*sizeof(float3));
 
-    std::vector<uint3> faces3(assimpMesh->mNumFaces);
-    for (std::size_t i = 0; i < assimpMesh->mNumFaces; i++) {
-        aiFace & face = assimpMesh->mFaces[i];
-        if (face.mNumIndices != 3) {
-            throw std::runtime_error("not a triangle mesh");
-        }
-        faces3[i] = make_uint3(face.mIndices[0],face.mIndices[1],face.mIndices[2]);
-    }
-
-    indices.Reinitialise(pangolin::GlElementArrayBuffer,assimpMesh->mNumFaces*3,GL_UNSIGNED_INT,3,GL_STATIC_DRAW);
-    indices.Upload(faces3.data(),assimpMesh->mNumFaces*sizeof(int)*3);
+    indices.Reinitialise(pangolin::GlElementArrayBuffer,mesh.numFaces()*3,GL_UNSIGNED_INT,3,GL_STATIC_DRAW);
+    indices.Upload(mesh.indices(),mesh.numFaces()*sizeof(int)*3);
 
-    if (is_textured)
+    if (mesh.hasTexture())
     {
-      std::cout << "loading texture from " << textureName << std::endl;
-      texture.LoadFromFile(textureName);
-
-      std::cout << "loading tex coords..." << std::endl;
-      texCoords.Reinitialise(pangolin::GlArrayBuffer,assimpMesh->mNumVertices,GL_FLOAT,2,GL_STATIC_DRAW);
+      uploadTexture(mesh, texture);
 
-      std::vector<float2> texCoords2(assimpMesh->mNumVertices);
-      for (std::size_t i = 0; i < assimpMesh->mNumVertices; ++i) {
-          texCoords2[i] = make_float2(assimpMesh->mTextureCoords[0][i].x,1.0 - assimpMesh->mTextureCoords[0][i].y);
-      }
-      texCoords.Upload(texCoords2.data(),assimpMesh->mNumVertices*sizeof(float)*2);
+      texCoords.Reinitialise(pangolin::GlArrayBuffer,num_vertices,GL_FLOAT,2,GL_STATIC_DRAW);
+      texCoords.Upload(mesh.texCoords(),num_vertices*sizeof(float)*2);
     }
     else
     {
       // vertex colors
-      std::vector<float3> colors3(assimpMesh->mNumVertices);
-      for (std::size_t i = 0; i < assimpMesh->mNumVertices; i++) 
+      colors.Reinitialise(pangolin::GlArrayBuffer, num_vertices, GL_FLOAT, 3, GL_STATIC_DRAW);
+      if (mesh.colors())
+        colors.Upload(mesh.colors(), num_vertices*sizeof(float)*3);
+      else
       {
-          aiColor4D & color = assimpMesh->mColors[0][i];
-          colors3[i] = make_float3(color.r, color.g, color.b);
+        std::vector<float3> colors3(num_vertices, make_float3(255, 0, 0));
+        colors.Upload(colors3.data(), num_vertices*sizeof(float)*3);
       }
-      colors.Reinitialise(pangolin::GlArrayBuffer, assimpMesh->mNumVertices, GL_FLOAT, 3, GL_STATIC_DRAW);
-      colors.Upload(colors3.data(), assimpMesh->mNumVertices*sizeof(float)*3);
     }
 }
 